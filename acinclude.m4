@@ -581,6 +581,29 @@ AC_DEFUN([LIBXS_CHECK_LANG_VISIBILITY], [{
           [AC_MSG_RESULT(yes) ; $1], [AC_MSG_RESULT(no) ; $2])
 }])
 
+dnl ################################################################################
+dnl # LIBXS_CHECK_POSIX_MEMALIGN([action-if-found], [action-if-not-found])         #
+dnl # Check if posix_memalign is available                                         #
+dnl ################################################################################
+AC_DEFUN([LIBXS_CHECK_POSIX_MEMALIGN], [{
+    AC_MSG_CHECKING(for posix_memalign)
+    AC_LINK_IFELSE(
+        [AC_LANG_PROGRAM(
+        [
+#include <stdlib.h>
+        ],
+[[
+void *ptr;
+int rc = posix_memalign (&ptr, 64, 64);
+if (rc == 0)
+    free (ptr);
+]]
+        )],
+        [AC_MSG_RESULT(yes) ; libxs_cv_have_posix_memalign="yes" ; $1],
+        [AC_MSG_RESULT(no)  ; libxs_cv_have_posix_memalign="no"  ; $2]
+    )
+}])
+
 dnl ################################################################################
 dnl # LIBXS_CHECK_SOCK_CLOEXEC([action-if-found], [action-if-not-found])           #
 dnl # Check if SOCK_CLOEXEC is supported                                           #
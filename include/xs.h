@@ -126,7 +126,16 @@ XS_EXPORT const char *xs_strerror (int errnum);
 /*  Crossroads message definition.                                            */
 /******************************************************************************/
 
-typedef struct {unsigned char _ [32];} xs_msg_t;
+/*  Size of the message structure. Messages up to XS_MSG_SIZE - 3 bytes are   */
+/*  stored directly in the structure. The value has to match the one the      */
+/*  library was built with (see --with-msg-size configure option); xs_init   */
+/*  passes sizeof (xs_msg_t) to the library and fails with EINVAL when the    */
+/*  two layouts differ.                                                       */
+#ifndef XS_MSG_SIZE
+#define XS_MSG_SIZE 32
+#endif
+
+typedef struct {unsigned char _ [XS_MSG_SIZE];} xs_msg_t;
 
 typedef void (xs_free_fn) (void *data, void *hint);
 
@@ -148,11 +157,25 @@ XS_EXPORT int xs_getmsgopt (xs_msg_t *msg, int option, void *optval,
 
 #define XS_MAX_SOCKETS 1
 #define XS_IO_THREADS 2
+#define XS_MSG_POOL 3
+#define XS_MSG_POOL_HITS 4
+#define XS_MSG_POOL_MISSES 5
+#define XS_WAKEUP_SPIN 6
+#define XS_IO_URING 7
+#define XS_IO_THREAD_CPUS 8
+#define XS_REAPER_CPUS 9
+#define XS_IO_THREAD_STATS 10
+#define XS_MEMORY_BUDGET 11
+#define XS_MEMORY_USED 12
 
 XS_EXPORT void *xs_init ();
+XS_EXPORT void *xs_init_msg_size (size_t msg_size);
+#define xs_init() xs_init_msg_size (sizeof (xs_msg_t))
 XS_EXPORT int xs_term (void *context);
 XS_EXPORT int xs_setctxopt (void *context, int option, const void *optval,
     size_t optvallen); 
+XS_EXPORT int xs_getctxopt (void *context, int option, void *optval,
+    size_t *optvallen);
 
 /******************************************************************************/
 /*  Crossroads socket definition.                                             */
@@ -198,6 +221,15 @@ XS_EXPORT int xs_setctxopt (void *context, int option, const void *optval,
 #define XS_RCVTIMEO 27
 #define XS_SNDTIMEO 28
 #define XS_IPV4ONLY 31
+#define XS_BUSY_POLL 32
+#define XS_REUSEPORT 33
+#define XS_STATS 34
+#define XS_LATENCY 35
+#define XS_ZERO_COPY_RECV 36
+#define XS_BATCH_FRAMES 37
+#define XS_SNDHWM_BYTES 38
+#define XS_RCVHWM_BYTES 39
+#define XS_PIPE_STATS 40
 
 /*  Message options                                                           */
 #define XS_MORE 1
@@ -218,6 +250,8 @@ XS_EXPORT int xs_send (void *s, const void *buf, size_t len, int flags);
 XS_EXPORT int xs_recv (void *s, void *buf, size_t len, int flags);
 XS_EXPORT int xs_sendmsg (void *s, xs_msg_t *msg, int flags);
 XS_EXPORT int xs_recvmsg (void *s, xs_msg_t *msg, int flags);
+XS_EXPORT int xs_sendmmsg (void *s, xs_msg_t *msgs, int count, int flags);
+XS_EXPORT int xs_recvmmsg (void *s, xs_msg_t *msgs, int count, int flags);
 
 /******************************************************************************/
 /*  I/O multiplexing.                                                         */
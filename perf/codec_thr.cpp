@@ -0,0 +1,157 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//  The codec is internal to the library and its symbols are not exported.
+//  Thus, the implementation is compiled directly into the test program.
+#include "../src/encoder.cpp"
+#include "../src/decoder.cpp"
+#include "../src/msg.cpp"
+#include "../src/msg_pool.cpp"
+#include "../src/memory_budget.cpp"
+#include "../src/clock.cpp"
+#include "../src/err.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+//  The test measures the time needed to encode and decode a message of
+//  a particular size. Messages are encoded into a contiguous block of
+//  memory, which is then fed to the decoder in the chunks the engines
+//  would normally read from the socket.
+
+//  Produces message_count messages of message_size bytes each.
+class source_t : public xs::i_msg_source
+{
+public:
+
+    source_t (size_t message_size_, unsigned long message_count_) :
+        message_size (message_size_),
+        left (message_count_)
+    {
+        memset (body, 'x', sizeof body);
+    }
+
+    int read (xs::msg_t *msg_)
+    {
+        if (!left) {
+            errno = EAGAIN;
+            return -1;
+        }
+        int rc = msg_->init_size (message_size);
+        errno_assert (rc == 0);
+        memcpy (msg_->data (), body, message_size);
+        left--;
+        return 0;
+    }
+
+private:
+
+    size_t message_size;
+    unsigned long left;
+    unsigned char body [256];
+};
+
+//  Counts and drops the decoded messages.
+class sink_t : public xs::i_msg_sink
+{
+public:
+
+    sink_t () :
+        message_count (0)
+    {
+    }
+
+    int write (xs::msg_t *msg_)
+    {
+        message_count++;
+        int rc = msg_->close ();
+        errno_assert (rc == 0);
+        rc = msg_->init ();
+        errno_assert (rc == 0);
+        return 0;
+    }
+
+    unsigned long message_count;
+};
+
+static void run (size_t message_size_, unsigned long message_count_)
+{
+    std::vector <unsigned char> wire (message_count_ * (message_size_ + 10));
+
+    //  Encode all the messages into the block of memory.
+    source_t source (message_size_, message_count_);
+    xs::encoder_t encoder (xs::out_batch_size);
+    encoder.set_msg_source (&source);
+    size_t wire_size = 0;
+    uint64_t start = xs::clock_t::now_us ();
+    while (true) {
+        unsigned char *data = &wire [wire_size];
+        size_t size = wire.size () - wire_size;
+        encoder.get_data (&data, &size);
+        if (!size)
+            break;
+        wire_size += size;
+    }
+    uint64_t encode_time = xs::clock_t::now_us () - start;
+
+    //  Decode the messages.
+    sink_t sink;
+    xs::decoder_t decoder (xs::in_batch_size, xs::max_in_batch_size, -1);
+    decoder.set_msg_sink (&sink);
+    size_t pos = 0;
+    start = xs::clock_t::now_us ();
+    while (pos != wire_size) {
+        unsigned char *data;
+        size_t size;
+        decoder.get_buffer (&data, &size);
+        size = std::min (size, wire_size - pos);
+        memcpy (data, &wire [pos], size);
+        size_t processed = decoder.process_buffer (data, size);
+        xs_assert (processed == size);
+        pos += size;
+    }
+    uint64_t decode_time = xs::clock_t::now_us () - start;
+    xs_assert (sink.message_count == message_count_);
+
+    printf ("%6d [B]: encode %8.3f [ns], decode %8.3f [ns] per message\n",
+        (int) message_size_, (double) encode_time * 1000 / message_count_,
+        (double) decode_time * 1000 / message_count_);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 2) {
+        printf ("usage: codec_thr <message-count>\n");
+        return 1;
+    }
+    unsigned long message_count = atol (argv [1]);
+    if (!message_count) {
+        printf ("message count has to be positive\n");
+        return 1;
+    }
+
+    printf ("message count: %lu\n", message_count);
+
+    for (size_t message_size = 1; message_size <= 256; message_size *= 2)
+        run (message_size, message_count);
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/xs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/platform.hpp"
+
+#if defined XS_HAVE_WINDOWS
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+static const char *connect_to;
+static int connection_count;
+
+//  Opens the connections one by one. Each connection delivers a single
+//  message and is closed straight away.
+#if defined XS_HAVE_WINDOWS
+static unsigned int __stdcall worker (void *ctx_)
+#else
+static void *worker (void *ctx_)
+#endif
+{
+    void *s;
+    int rc;
+    int i;
+
+    for (i = 0; i != connection_count; i++) {
+
+        s = xs_socket (ctx_, XS_PUSH);
+        if (!s) {
+            printf ("error in xs_socket: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+
+        rc = xs_connect (s, connect_to);
+        if (rc < 0) {
+            printf ("error in xs_connect: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+
+        rc = xs_send (s, "", 0, 0);
+        if (rc < 0) {
+            printf ("error in xs_send: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+
+        rc = xs_close (s);
+        if (rc != 0) {
+            printf ("error in xs_close: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+    }
+
+#if defined XS_HAVE_WINDOWS
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int main (int argc, char *argv [])
+{
+#if defined XS_HAVE_WINDOWS
+    HANDLE remote_thread;
+#else
+    pthread_t remote_thread;
+#endif
+    int io_threads;
+    int reuseport;
+    int max_sockets;
+    void *ctx;
+    void *remote_ctx;
+    void *s;
+    int rc;
+    int i;
+    char buf [1];
+    void *watch;
+    unsigned long elapsed;
+    unsigned long throughput;
+
+    if (argc != 4 && argc != 5) {
+        printf ("usage: connect_thr <address> <connection-count> "
+            "<io-threads> [reuseport]\n");
+        return 1;
+    }
+    connect_to = argv [1];
+    connection_count = atoi (argv [2]);
+    io_threads = atoi (argv [3]);
+    reuseport = argc == 5 ? atoi (argv [4]) : 0;
+
+    ctx = xs_init ();
+    if (!ctx) {
+        printf ("error in xs_init: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    rc = xs_setctxopt (ctx, XS_IO_THREADS, &io_threads, sizeof (io_threads));
+    if (rc != 0) {
+        printf ("error in xs_setctxopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    s = xs_socket (ctx, XS_PULL);
+    if (!s) {
+        printf ("error in xs_socket: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    //  With XS_REUSEPORT, each I/O thread has its own listener and accepts
+    //  the connections in parallel with the others.
+    rc = xs_setsockopt (s, XS_REUSEPORT, &reuseport, sizeof (reuseport));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    //  Make the listen backlog big enough to hold all the connections.
+    //  Otherwise, the measurement is dominated by the retransmissions of
+    //  the dropped connection requests.
+    rc = xs_setsockopt (s, XS_BACKLOG, &connection_count,
+        sizeof (connection_count));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    rc = xs_bind (s, connect_to);
+    if (rc != 0) {
+        printf ("error in xs_bind: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    //  The connecting side uses a separate context. The closed sockets
+    //  linger until their message is sent, so allow all of them to exist
+    //  at the same time.
+    remote_ctx = xs_init ();
+    if (!remote_ctx) {
+        printf ("error in xs_init: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    max_sockets = connection_count + 1;
+    rc = xs_setctxopt (remote_ctx, XS_MAX_SOCKETS, &max_sockets,
+        sizeof (max_sockets));
+    if (rc != 0) {
+        printf ("error in xs_setctxopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    printf ("connection count: %d\n", (int) connection_count);
+    printf ("I/O threads: %d\n", (int) io_threads);
+    printf ("reuseport: %d\n", (int) reuseport);
+
+    watch = xs_stopwatch_start ();
+
+#if defined XS_HAVE_WINDOWS
+    remote_thread = (HANDLE) _beginthreadex (NULL, 0,
+        worker, remote_ctx, 0 , NULL);
+    if (remote_thread == 0) {
+        printf ("error in _beginthreadex\n");
+        return -1;
+    }
+#else
+    rc = pthread_create (&remote_thread, NULL, worker, remote_ctx);
+    if (rc != 0) {
+        printf ("error in pthread_create: %s\n", xs_strerror (rc));
+        return -1;
+    }
+#endif
+
+    //  Each message comes from a different connection.
+    for (i = 0; i != connection_count; i++) {
+        rc = xs_recv (s, buf, sizeof (buf), 0);
+        if (rc < 0) {
+            printf ("error in xs_recv: %s\n", xs_strerror (errno));
+            return -1;
+        }
+    }
+
+    elapsed = xs_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+
+#if defined XS_HAVE_WINDOWS
+    DWORD rc2 = WaitForSingleObject (remote_thread, INFINITE);
+    if (rc2 == WAIT_FAILED) {
+        printf ("error in WaitForSingleObject\n");
+        return -1;
+    }
+    BOOL rc3 = CloseHandle (remote_thread);
+    if (rc3 == 0) {
+        printf ("error in CloseHandle\n");
+        return -1;
+    }
+#else
+    rc = pthread_join (remote_thread, NULL);
+    if (rc != 0) {
+        printf ("error in pthread_join: %s\n", xs_strerror (rc));
+        return -1;
+    }
+#endif
+
+    rc = xs_close (s);
+    if (rc != 0) {
+        printf ("error in xs_close: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    rc = xs_term (remote_ctx);
+    if (rc != 0) {
+        printf ("error in xs_term: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    rc = xs_term (ctx);
+    if (rc != 0) {
+        printf ("error in xs_term: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    throughput = (unsigned long)
+        ((double) connection_count / (double) elapsed * 1000000);
+
+    printf ("mean throughput: %d [connections/s]\n", (int) throughput);
+
+    return 0;
+}
@@ -36,6 +36,7 @@
 
 static size_t message_size;
 static int roundtrip_count;
+static int busy_poll;
 
 #if defined XS_HAVE_WINDOWS
 static unsigned int __stdcall worker (void *ctx_)
@@ -54,6 +55,12 @@ static void *worker (void *ctx_)
         exit (1);
     }
 
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+
     rc = xs_connect (s, "inproc://lat_test");
     if (rc != 0) {
         printf ("error in xs_connect: %s\n", xs_strerror (errno));
@@ -113,14 +120,18 @@ int main (int argc, char *argv [])
     void *watch;
     unsigned long elapsed;
     double latency;
+    int spin;
 
-    if (argc != 3) {
-        printf ("usage: inproc_lat <message-size> <roundtrip-count>\n");
+    if (argc < 3 || argc > 5) {
+        printf ("usage: inproc_lat <message-size> <roundtrip-count> "
+            "[wakeup-spin] [busy-poll]\n");
         return 1;
     }
 
     message_size = atoi (argv [1]);
     roundtrip_count = atoi (argv [2]);
+    spin = argc >= 4 ? atoi (argv [3]) : 0;
+    busy_poll = argc == 5 ? atoi (argv [4]) : 0;
 
     ctx = xs_init ();
     if (!ctx) {
@@ -128,12 +139,29 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    //  When spinning, the wake-ups are passed between the threads without
+    //  system calls as long as the peer replies within the spinning time.
+    rc = xs_setctxopt (ctx, XS_WAKEUP_SPIN, &spin, sizeof (spin));
+    if (rc != 0) {
+        printf ("error in xs_setctxopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
     s = xs_socket (ctx, XS_REQ);
     if (!s) {
         printf ("error in xs_socket: %s\n", xs_strerror (errno));
         return -1;
     }
 
+    //  When busy polling, the messages are passed between the threads
+    //  without system calls as long as the peer replies within the polling
+    //  time.
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
     rc = xs_bind (s, "inproc://lat_test");
     if (rc != 0) {
         printf ("error in xs_bind: %s\n", xs_strerror (errno));
@@ -164,6 +192,8 @@ int main (int argc, char *argv [])
 
     printf ("message size: %d [B]\n", (int) message_size);
     printf ("roundtrip count: %d\n", (int) roundtrip_count);
+    printf ("wakeup spin: %d [us]\n", spin);
+    printf ("busy poll: %d [us]\n", busy_poll);
 
     watch = xs_stopwatch_start ();
 
@@ -162,6 +162,7 @@ int main (int argc, char *argv [])
 
     printf ("message size: %d [B]\n", (int) message_size);
     printf ("message count: %d\n", (int) message_count);
+    printf ("message structure size: %d [B]\n", (int) sizeof (xs_msg_t));
 
     rc = xs_recvmsg (s, &msg, 0);
     if (rc < 0) {
@@ -28,20 +28,22 @@ int main (int argc, char *argv [])
     const char *bind_to;
     int roundtrip_count;
     size_t message_size;
+    int busy_poll;
     void *ctx;
     void *s;
     int rc;
     int i;
     xs_msg_t msg;
 
-    if (argc != 4) {
+    if (argc != 4 && argc != 5) {
         printf ("usage: local_lat <bind-to> <message-size> "
-            "<roundtrip-count>\n");
+            "<roundtrip-count> [busy-poll]\n");
         return 1;
     }
     bind_to = argv [1];
     message_size = atoi (argv [2]);
     roundtrip_count = atoi (argv [3]);
+    busy_poll = argc == 5 ? atoi (argv [4]) : 0;
 
     ctx = xs_init ();
     if (!ctx) {
@@ -55,6 +57,12 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
     rc = xs_bind (s, bind_to);
     if (rc != 0) {
         printf ("error in xs_bind: %s\n", xs_strerror (errno));
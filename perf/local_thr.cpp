@@ -28,23 +28,32 @@ int main (int argc, char *argv [])
     const char *bind_to;
     int message_count;
     size_t message_size;
+    int batch_size;
     void *ctx;
     void *s;
     int rc;
     int i;
+    int j;
     xs_msg_t msg;
+    xs_msg_t *msgs;
     void *watch;
     unsigned long elapsed;
     unsigned long throughput;
     double megabits;
 
-    if (argc != 4) {
-        printf ("usage: local_thr <bind-to> <message-size> <message-count>\n");
+    if (argc != 4 && argc != 5) {
+        printf ("usage: local_thr <bind-to> <message-size> <message-count> "
+            "[<batch-size>]\n");
         return 1;
     }
     bind_to = argv [1];
     message_size = atoi (argv [2]);
     message_count = atoi (argv [3]);
+    batch_size = argc == 5 ? atoi (argv [4]) : 1;
+    if (batch_size < 1) {
+        printf ("batch size must be a positive number\n");
+        return 1;
+    }
 
     ctx = xs_init ();
     if (!ctx) {
@@ -83,17 +92,48 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    msgs = (xs_msg_t*) malloc (sizeof (xs_msg_t) * batch_size);
+    if (!msgs) {
+        printf ("error in malloc\n");
+        return -1;
+    }
+    for (j = 0; j != batch_size; j++) {
+        rc = xs_msg_init (&msgs [j]);
+        if (rc != 0) {
+            printf ("error in xs_msg_init: %s\n", xs_strerror (errno));
+            return -1;
+        }
+    }
+
     watch = xs_stopwatch_start ();
 
-    for (i = 0; i != message_count - 1; i++) {
-        rc = xs_recvmsg (s, &msg, 0);
-        if (rc < 0) {
-            printf ("error in xs_recvmsg: %s\n", xs_strerror (errno));
-            return -1;
+    if (batch_size == 1) {
+        for (i = 0; i != message_count - 1; i++) {
+            rc = xs_recvmsg (s, &msg, 0);
+            if (rc < 0) {
+                printf ("error in xs_recvmsg: %s\n", xs_strerror (errno));
+                return -1;
+            }
+            if (xs_msg_size (&msg) != message_size) {
+                printf ("message of incorrect size received\n");
+                return -1;
+            }
         }
-        if (xs_msg_size (&msg) != message_size) {
-            printf ("message of incorrect size received\n");
-            return -1;
+    }
+    else {
+        for (i = 0; i != message_count - 1; i += rc) {
+            rc = xs_recvmmsg (s, msgs, message_count - 1 - i < batch_size ?
+                message_count - 1 - i : batch_size, 0);
+            if (rc < 0) {
+                printf ("error in xs_recvmmsg: %s\n", xs_strerror (errno));
+                return -1;
+            }
+            for (j = 0; j != rc; j++) {
+                if (xs_msg_size (&msgs [j]) != message_size) {
+                    printf ("message of incorrect size received\n");
+                    return -1;
+                }
+            }
         }
     }
 
@@ -101,6 +141,15 @@ int main (int argc, char *argv [])
     if (elapsed == 0)
         elapsed = 1;
 
+    for (j = 0; j != batch_size; j++) {
+        rc = xs_msg_close (&msgs [j]);
+        if (rc != 0) {
+            printf ("error in xs_msg_close: %s\n", xs_strerror (errno));
+            return -1;
+        }
+    }
+    free (msgs);
+
     rc = xs_msg_close (&msg);
     if (rc != 0) {
         printf ("error in xs_msg_close: %s\n", xs_strerror (errno));
@@ -113,6 +162,7 @@ int main (int argc, char *argv [])
 
     printf ("message size: %d [B]\n", (int) message_size);
     printf ("message count: %d\n", (int) message_count);
+    printf ("batch size: %d\n", (int) batch_size);
     printf ("mean throughput: %d [msg/s]\n", (int) throughput);
     printf ("mean throughput: %.3f [Mb/s]\n", (double) megabits);
 
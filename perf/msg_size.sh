@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+#   Copyright (c) 2012 250bpm s.r.o.
+#   Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+#
+#   This file is part of Crossroads I/O project.
+#
+#   Crossroads I/O is free software; you can redistribute it and/or modify it
+#   under the terms of the GNU Lesser General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   Crossroads is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU Lesser General Public License for more details.
+#
+#   You should have received a copy of the GNU Lesser General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+#   Compares inproc throughput of the 32 and 64 byte message layouts. Builds
+#   the library twice (--with-msg-size=32 and --with-msg-size=64) out of tree
+#   and runs inproc_thr for message sizes around both VSM limits.
+#
+#   usage: perf/msg_size.sh [<build-dir>] [<message-count>]
+
+set -e
+
+srcdir=$(cd "$(dirname "$0")/.." && pwd)
+builddir=${1:-"$srcdir/msg_size_build"}
+count=${2:-10000000}
+sizes="8 16 29 30 32 48 61 62 64 128"
+
+for layout in 32 64; do
+    dir="$builddir/$layout"
+    mkdir -p "$dir"
+    if [ ! -f "$dir/Makefile" ]; then
+        (cd "$dir" && "$srcdir/configure" -q --with-msg-size=$layout >/dev/null)
+    fi
+    make -s -C "$dir" >/dev/null
+done
+
+printf "%8s %16s %16s\n" "size" "32 [msg/s]" "64 [msg/s]"
+for size in $sizes; do
+    row=""
+    for layout in 32 64; do
+        thr=$("$builddir/$layout/perf/inproc_thr" $size $count | \
+            sed -n "s/^mean throughput: \([0-9]*\) \[msg\/s\]/\1/p")
+        row="$row $(printf "%16s" "$thr")"
+    done
+    printf "%8s%s\n" $size "$row"
+done
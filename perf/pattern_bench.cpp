@@ -0,0 +1,1102 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../include/xs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/platform.hpp"
+
+#if defined XS_HAVE_WINDOWS
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+//  Benchmarks the messaging patterns as they are used by the applications
+//  and prints the results in JSON format so that they can be compared
+//  between the library versions by a script. Each pattern is run in
+//  a fresh context for each message size. Within a pattern, the sockets
+//  on the remote side are served by a single worker thread.
+
+#define SYNC_ADDRESS "inproc://pattern_bench_sync"
+#define BACKEND_ADDRESS "inproc://pattern_bench_backend"
+
+//  Size of the topic prepended to PUB/SUB messages ('t' + 4 digits).
+#define TOPIC_SIZE 5
+
+//  Size of the timestamp carried in the messages used to measure latency.
+#define STAMP_SIZE 8
+
+//  Maximum number of messages sent one by one to measure the latency.
+#define MAX_LATENCY_ROUNDS 1000
+
+typedef unsigned long long stamp_t;
+
+#if defined XS_HAVE_WINDOWS
+typedef HANDLE thread_t;
+typedef unsigned int (__stdcall *thread_fn) (void*);
+#define THREAD_RESULT unsigned int __stdcall
+#define THREAD_RETURN return 0
+#else
+typedef pthread_t thread_t;
+typedef void *(*thread_fn) (void*);
+#define THREAD_RESULT void*
+#define THREAD_RETURN return NULL
+#endif
+
+struct bench_t
+{
+    void *ctx;
+    size_t message_size;
+
+    //  Messages measuring latency have to be large enough to hold the
+    //  topic and the timestamp.
+    size_t latency_size;
+    int rounds;
+
+    //  Latencies (in microseconds) measured by either of the threads.
+    double *latencies;
+    int latency_count;
+
+    //  Number of messages delivered during the throughput measurement.
+    unsigned long long delivered;
+
+    //  Thread that runs till the context is terminated, if any, and the
+    //  sockets it owns.
+    bool has_device;
+    thread_t device;
+    void *device_sockets [2];
+};
+
+static const char *address;
+static int message_count;
+static int peer_count;
+static int subscription_count;
+static int connection_count;
+
+static void fail (const char *function_)
+{
+    fprintf (stderr, "error in %s: %s\n", function_, xs_strerror (xs_errno ()));
+    exit (1);
+}
+
+//  Returns monotonic time in microseconds.
+static double now_us ()
+{
+#if defined XS_HAVE_WINDOWS
+    LARGE_INTEGER ticks;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter (&ticks);
+    QueryPerformanceFrequency (&frequency);
+    return (double) ticks.QuadPart * 1000000 / frequency.QuadPart;
+#elif defined CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1000000 + (double) ts.tv_nsec / 1000;
+#else
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (double) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static void write_stamp (xs_msg_t *msg_, size_t offset_)
+{
+    double now = now_us () * 1000;
+    stamp_t stamp = (stamp_t) now;
+    memcpy ((unsigned char*) xs_msg_data (msg_) + offset_, &stamp,
+        sizeof (stamp));
+}
+
+static void record_latency (bench_t *bench_, xs_msg_t *msg_, size_t offset_)
+{
+    stamp_t stamp;
+    memcpy (&stamp, (unsigned char*) xs_msg_data (msg_) + offset_,
+        sizeof (stamp));
+    bench_->latencies [bench_->latency_count++] =
+        (now_us () * 1000 - (double) stamp) / 1000;
+}
+
+//  Fills in the topic number 'index_'.
+static void make_topic (char *topic_, int index_)
+{
+    char buf [16];
+    sprintf (buf, "t%04d", index_ % 10000);
+    memcpy (topic_, buf, TOPIC_SIZE);
+}
+
+static void init_msg (xs_msg_t *msg_, size_t size_)
+{
+    int rc = xs_msg_init_size (msg_, size_);
+    if (rc != 0)
+        fail ("xs_msg_init_size");
+    memset (xs_msg_data (msg_), 0, size_);
+}
+
+static void send_msg (void *s_, xs_msg_t *msg_, int flags_)
+{
+    int rc = xs_sendmsg (s_, msg_, flags_);
+    if (rc < 0)
+        fail ("xs_sendmsg");
+}
+
+static void recv_msg (void *s_, xs_msg_t *msg_)
+{
+    int rc = xs_recvmsg (s_, msg_, 0);
+    if (rc < 0)
+        fail ("xs_recvmsg");
+}
+
+static void *open_socket (void *ctx_, int type_)
+{
+    void *s = xs_socket (ctx_, type_);
+    if (!s)
+        fail ("xs_socket");
+    return s;
+}
+
+static void set_option (void *s_, int option_, int value_)
+{
+    int rc = xs_setsockopt (s_, option_, &value_, sizeof (value_));
+    if (rc != 0)
+        fail ("xs_setsockopt");
+}
+
+static void close_socket (void *s_)
+{
+    set_option (s_, XS_LINGER, 0);
+    int rc = xs_close (s_);
+    if (rc != 0)
+        fail ("xs_close");
+}
+
+//  Sends an empty message to the sync socket.
+static void notify (void *sync_)
+{
+    int rc = xs_send (sync_, "", 0, 0);
+    if (rc < 0)
+        fail ("xs_send");
+}
+
+//  Waits for a message from the sync socket.
+static void wait_for (void *sync_)
+{
+    char buf [1];
+    int rc = xs_recv (sync_, buf, sizeof (buf), 0);
+    if (rc < 0)
+        fail ("xs_recv");
+}
+
+//  Receives a message from any of the sockets. Keeps reading from the same
+//  socket while there are messages available. Returns index of the socket
+//  the message was received from.
+static int recv_any (void **sockets_, xs_pollitem_t *items_, int count_,
+    int *cursor_, xs_msg_t *msg_)
+{
+    int rc;
+    int i;
+    int index;
+
+    while (true) {
+        for (i = 0; i != count_; i++) {
+            index = (*cursor_ + i) % count_;
+            rc = xs_recvmsg (sockets_ [index], msg_, XS_DONTWAIT);
+            if (rc >= 0) {
+                *cursor_ = index;
+                return index;
+            }
+            if (xs_errno () != EAGAIN)
+                fail ("xs_recvmsg");
+        }
+        rc = xs_poll (items_, count_, -1);
+        if (rc < 0)
+            fail ("xs_poll");
+    }
+}
+
+static xs_pollitem_t *make_pollitems (void **sockets_, int count_)
+{
+    xs_pollitem_t *items;
+    int i;
+
+    items = (xs_pollitem_t*) malloc (count_ * sizeof (xs_pollitem_t));
+    if (!items) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (i = 0; i != count_; i++) {
+        items [i].socket = sockets_ [i];
+        items [i].fd = 0;
+        items [i].events = XS_POLLIN;
+        items [i].revents = 0;
+    }
+    return items;
+}
+
+
+static thread_t start_thread (thread_fn fn_, void *arg_)
+{
+    thread_t thread;
+#if defined XS_HAVE_WINDOWS
+    thread = (HANDLE) _beginthreadex (NULL, 0, fn_, arg_, 0 , NULL);
+    if (thread == 0) {
+        fprintf (stderr, "error in _beginthreadex\n");
+        exit (1);
+    }
+#else
+    int rc = pthread_create (&thread, NULL, fn_, arg_);
+    if (rc != 0) {
+        fprintf (stderr, "error in pthread_create: %s\n", xs_strerror (rc));
+        exit (1);
+    }
+#endif
+    return thread;
+}
+
+static void join_thread (thread_t thread_)
+{
+#if defined XS_HAVE_WINDOWS
+    DWORD rc = WaitForSingleObject (thread_, INFINITE);
+    if (rc == WAIT_FAILED) {
+        fprintf (stderr, "error in WaitForSingleObject\n");
+        exit (1);
+    }
+    BOOL rc2 = CloseHandle (thread_);
+    if (rc2 == 0) {
+        fprintf (stderr, "error in CloseHandle\n");
+        exit (1);
+    }
+#else
+    int rc = pthread_join (thread_, NULL);
+    if (rc != 0) {
+        fprintf (stderr, "error in pthread_join: %s\n", xs_strerror (rc));
+        exit (1);
+    }
+#endif
+}
+
+//  PUB/SUB fan-out: one publisher, peer_count subscribers, each of them
+//  subscribed to subscription_count topics. Each message is delivered to
+//  all the subscribers.
+
+static THREAD_RESULT pubsub_worker (void *arg_)
+{
+    bench_t *bench = (bench_t*) arg_;
+    void *sync;
+    void **subs;
+    xs_pollitem_t *items;
+    char *ready;
+    char topic [TOPIC_SIZE];
+    xs_msg_t msg;
+    unsigned long long i;
+    int cursor;
+    int pending;
+    int index;
+    int rc;
+    int j;
+    int k;
+
+    sync = open_socket (bench->ctx, XS_PAIR);
+    rc = xs_connect (sync, SYNC_ADDRESS);
+    if (rc != 0)
+        fail ("xs_connect");
+
+    subs = (void**) malloc (peer_count * sizeof (void*));
+    ready = (char*) calloc (peer_count, 1);
+    if (!subs || !ready) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (j = 0; j != peer_count; j++) {
+        subs [j] = open_socket (bench->ctx, XS_SUB);
+        set_option (subs [j], XS_RCVHWM, 0);
+
+        //  Warm-up messages start with 'w', data messages with 't'.
+        rc = xs_setsockopt (subs [j], XS_SUBSCRIBE, "w", 1);
+        if (rc != 0)
+            fail ("xs_setsockopt");
+        for (k = 0; k != subscription_count; k++) {
+            make_topic (topic, k);
+            rc = xs_setsockopt (subs [j], XS_SUBSCRIBE, topic, TOPIC_SIZE);
+            if (rc != 0)
+                fail ("xs_setsockopt");
+        }
+        rc = xs_connect (subs [j], address);
+        if (rc != 0)
+            fail ("xs_connect");
+    }
+    items = make_pollitems (subs, peer_count);
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    //  Subscriptions are passed to the publisher asynchronously. Once each
+    //  subscriber got a warm-up message, no data messages can be lost.
+    cursor = 0;
+    pending = peer_count;
+    while (pending) {
+        index = recv_any (subs, items, peer_count, &cursor, &msg);
+        if (!ready [index]) {
+            ready [index] = 1;
+            pending--;
+        }
+    }
+    notify (sync);
+
+    //  Throughput.
+    i = 0;
+    while (i != bench->delivered) {
+        recv_any (subs, items, peer_count, &cursor, &msg);
+        if (*(char*) xs_msg_data (&msg) != 'w')
+            i++;
+    }
+    notify (sync);
+
+    //  Latency. Each message is acknowledged once all the subscribers
+    //  got it.
+    for (j = 0; j != bench->rounds; j++) {
+        pending = peer_count;
+        while (pending) {
+            recv_any (subs, items, peer_count, &cursor, &msg);
+            if (*(char*) xs_msg_data (&msg) == 'w')
+                continue;
+            record_latency (bench, &msg, TOPIC_SIZE);
+            pending--;
+        }
+        notify (sync);
+    }
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    for (j = 0; j != peer_count; j++)
+        close_socket (subs [j]);
+    close_socket (sync);
+    free (subs);
+    free (ready);
+    free (items);
+    THREAD_RETURN;
+}
+
+static double pubsub (bench_t *bench_, void *sync_)
+{
+    void *pub;
+    thread_t worker;
+    xs_pollitem_t item;
+    xs_msg_t msg;
+    size_t size;
+    double start;
+    double elapsed;
+    int rc;
+    int i;
+
+    pub = open_socket (bench_->ctx, XS_PUB);
+    set_option (pub, XS_SNDHWM, 0);
+    rc = xs_bind (pub, address);
+    if (rc != 0)
+        fail ("xs_bind");
+
+    bench_->delivered = (unsigned long long) message_count * peer_count;
+    worker = start_thread (pubsub_worker, bench_);
+
+    //  Send warm-up messages till all the subscribers are connected.
+    item.socket = sync_;
+    item.fd = 0;
+    item.events = XS_POLLIN;
+    item.revents = 0;
+    while (true) {
+        rc = xs_send (pub, "w", 1, 0);
+        if (rc < 0)
+            fail ("xs_send");
+        rc = xs_poll (&item, 1, 1);
+        if (rc < 0)
+            fail ("xs_poll");
+        if (rc > 0)
+            break;
+    }
+    wait_for (sync_);
+
+    //  The message has to be large enough to hold the topic.
+    size = bench_->message_size < TOPIC_SIZE ? TOPIC_SIZE :
+        bench_->message_size;
+    start = now_us ();
+    for (i = 0; i != message_count; i++) {
+        init_msg (&msg, size);
+        make_topic ((char*) xs_msg_data (&msg), i % subscription_count);
+        send_msg (pub, &msg, 0);
+    }
+    wait_for (sync_);
+    elapsed = now_us () - start;
+
+    for (i = 0; i != bench_->rounds; i++) {
+        init_msg (&msg, bench_->latency_size);
+        make_topic ((char*) xs_msg_data (&msg), i % subscription_count);
+        write_stamp (&msg, TOPIC_SIZE);
+        send_msg (pub, &msg, 0);
+        wait_for (sync_);
+    }
+
+    join_thread (worker);
+    close_socket (pub);
+    return elapsed;
+}
+
+//  ROUTER with peer_count DEALER peers. The router addresses the messages
+//  to the peers in round-robin fashion.
+
+static THREAD_RESULT router_worker (void *arg_)
+{
+    bench_t *bench = (bench_t*) arg_;
+    void *sync;
+    void **dealers;
+    xs_pollitem_t *items;
+    xs_msg_t msg;
+    unsigned long long i;
+    int cursor;
+    int rc;
+    int j;
+
+    sync = open_socket (bench->ctx, XS_PAIR);
+    rc = xs_connect (sync, SYNC_ADDRESS);
+    if (rc != 0)
+        fail ("xs_connect");
+
+    //  Each peer introduces itself to the router by sending an empty
+    //  message.
+    dealers = (void**) malloc (peer_count * sizeof (void*));
+    if (!dealers) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (j = 0; j != peer_count; j++) {
+        dealers [j] = open_socket (bench->ctx, XS_DEALER);
+        set_option (dealers [j], XS_RCVHWM, 0);
+        rc = xs_connect (dealers [j], address);
+        if (rc != 0)
+            fail ("xs_connect");
+        rc = xs_send (dealers [j], "", 0, 0);
+        if (rc < 0)
+            fail ("xs_send");
+    }
+    items = make_pollitems (dealers, peer_count);
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    cursor = 0;
+    for (i = 0; i != bench->delivered; i++)
+        recv_any (dealers, items, peer_count, &cursor, &msg);
+    notify (sync);
+
+    for (j = 0; j != bench->rounds; j++) {
+        recv_any (dealers, items, peer_count, &cursor, &msg);
+        record_latency (bench, &msg, 0);
+        notify (sync);
+    }
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    for (j = 0; j != peer_count; j++)
+        close_socket (dealers [j]);
+    close_socket (sync);
+    free (dealers);
+    free (items);
+    THREAD_RETURN;
+}
+
+static double router (bench_t *bench_, void *sync_)
+{
+    void *router;
+    thread_t worker;
+    unsigned char (*ids) [256];
+    size_t *id_sizes;
+    char buf [1];
+    xs_msg_t msg;
+    double start;
+    double elapsed;
+    int rc;
+    int i;
+
+    router = open_socket (bench_->ctx, XS_ROUTER);
+    set_option (router, XS_SNDHWM, 0);
+    rc = xs_bind (router, address);
+    if (rc != 0)
+        fail ("xs_bind");
+
+    bench_->delivered = message_count;
+    worker = start_thread (router_worker, bench_);
+
+    //  Learn the identities of the peers.
+    ids = (unsigned char (*) [256]) malloc (peer_count * 256);
+    id_sizes = (size_t*) malloc (peer_count * sizeof (size_t));
+    if (!ids || !id_sizes) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (i = 0; i != peer_count; i++) {
+        rc = xs_recv (router, ids [i], 256, 0);
+        if (rc < 0)
+            fail ("xs_recv");
+        id_sizes [i] = rc;
+        rc = xs_recv (router, buf, sizeof (buf), 0);
+        if (rc < 0)
+            fail ("xs_recv");
+    }
+
+    start = now_us ();
+    for (i = 0; i != message_count; i++) {
+        rc = xs_send (router, ids [i % peer_count], id_sizes [i % peer_count],
+            XS_SNDMORE);
+        if (rc < 0)
+            fail ("xs_send");
+        init_msg (&msg, bench_->message_size);
+        send_msg (router, &msg, 0);
+    }
+    wait_for (sync_);
+    elapsed = now_us () - start;
+
+    for (i = 0; i != bench_->rounds; i++) {
+        rc = xs_send (router, ids [i % peer_count], id_sizes [i % peer_count],
+            XS_SNDMORE);
+        if (rc < 0)
+            fail ("xs_send");
+        init_msg (&msg, bench_->latency_size);
+        write_stamp (&msg, 0);
+        send_msg (router, &msg, 0);
+        wait_for (sync_);
+    }
+
+    join_thread (worker);
+    close_socket (router);
+    free (ids);
+    free (id_sizes);
+    return elapsed;
+}
+
+//  PUSH/PULL fan-in: peer_count PUSH sockets sending to a single PULL
+//  socket.
+
+static THREAD_RESULT pushpull_worker (void *arg_)
+{
+    bench_t *bench = (bench_t*) arg_;
+    void *sync;
+    void **pushes;
+    xs_msg_t msg;
+    int rc;
+    int i;
+
+    sync = open_socket (bench->ctx, XS_PAIR);
+    rc = xs_connect (sync, SYNC_ADDRESS);
+    if (rc != 0)
+        fail ("xs_connect");
+
+    pushes = (void**) malloc (peer_count * sizeof (void*));
+    if (!pushes) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (i = 0; i != peer_count; i++) {
+        pushes [i] = open_socket (bench->ctx, XS_PUSH);
+        set_option (pushes [i], XS_SNDHWM, 0);
+        rc = xs_connect (pushes [i], address);
+        if (rc != 0)
+            fail ("xs_connect");
+    }
+
+    //  Wait till the other side starts measuring the time.
+    notify (sync);
+    wait_for (sync);
+
+    for (i = 0; i != message_count; i++) {
+        init_msg (&msg, bench->message_size);
+        send_msg (pushes [i % peer_count], &msg, 0);
+    }
+
+    //  The messages from different peers may be received in any order,
+    //  so wait till all of them were received before measuring latency.
+    wait_for (sync);
+
+    for (i = 0; i != bench->rounds; i++) {
+        init_msg (&msg, bench->latency_size);
+        write_stamp (&msg, 0);
+        send_msg (pushes [i % peer_count], &msg, 0);
+        wait_for (sync);
+    }
+
+    //  Don't drop the messages that haven't been delivered yet.
+    for (i = 0; i != peer_count; i++) {
+        rc = xs_close (pushes [i]);
+        if (rc != 0)
+            fail ("xs_close");
+    }
+    close_socket (sync);
+    free (pushes);
+    THREAD_RETURN;
+}
+
+static double pushpull (bench_t *bench_, void *sync_)
+{
+    void *pull;
+    thread_t worker;
+    xs_msg_t msg;
+    double start;
+    double elapsed;
+    int rc;
+    int i;
+
+    pull = open_socket (bench_->ctx, XS_PULL);
+    set_option (pull, XS_RCVHWM, 0);
+    rc = xs_bind (pull, address);
+    if (rc != 0)
+        fail ("xs_bind");
+
+    bench_->delivered = message_count;
+    worker = start_thread (pushpull_worker, bench_);
+    wait_for (sync_);
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    start = now_us ();
+    notify (sync_);
+    for (i = 0; i != message_count; i++)
+        recv_msg (pull, &msg);
+    elapsed = now_us () - start;
+    notify (sync_);
+
+    for (i = 0; i != bench_->rounds; i++) {
+        recv_msg (pull, &msg);
+        record_latency (bench_, &msg, 0);
+        notify (sync_);
+    }
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    join_thread (worker);
+    close_socket (pull);
+    return elapsed;
+}
+
+//  REQ/REP through a ROUTER/DEALER device. The client talks to the device
+//  using the benchmarked transport, the device dispatches the requests to
+//  peer_count REP sockets in the same process. The latency is the full
+//  round trip.
+
+static THREAD_RESULT device_worker (void *arg_)
+{
+    void **sockets = ((bench_t*) arg_)->device_sockets;
+    xs_pollitem_t items [2];
+    xs_msg_t msg;
+    int more;
+    size_t more_size;
+    int rc;
+    int i;
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    for (i = 0; i != 2; i++) {
+        items [i].socket = sockets [i];
+        items [i].fd = 0;
+        items [i].events = XS_POLLIN;
+        items [i].revents = 0;
+    }
+
+    //  Pass the messages in both directions till the context is terminated.
+    while (true) {
+        rc = xs_poll (items, 2, -1);
+        if (rc < 0 && xs_errno () == ETERM)
+            break;
+        if (rc < 0)
+            fail ("xs_poll");
+        for (i = 0; i != 2; i++) {
+            if (!(items [i].revents & XS_POLLIN))
+                continue;
+            while (true) {
+                rc = xs_recvmsg (sockets [i], &msg, 0);
+                if (rc < 0)
+                    fail ("xs_recvmsg");
+                more_size = sizeof (more);
+                rc = xs_getsockopt (sockets [i], XS_RCVMORE, &more,
+                    &more_size);
+                if (rc != 0)
+                    fail ("xs_getsockopt");
+                send_msg (sockets [1 - i], &msg, more ? XS_SNDMORE : 0);
+                if (!more)
+                    break;
+            }
+        }
+    }
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    for (i = 0; i != 2; i++) {
+        rc = xs_close (sockets [i]);
+        if (rc != 0)
+            fail ("xs_close");
+    }
+    THREAD_RETURN;
+}
+
+static THREAD_RESULT reqrep_worker (void *arg_)
+{
+    bench_t *bench = (bench_t*) arg_;
+    void *sync;
+    void **reps;
+    xs_pollitem_t *items;
+    xs_msg_t msg;
+    int cursor;
+    int index;
+    int rc;
+    int i;
+
+    sync = open_socket (bench->ctx, XS_PAIR);
+    rc = xs_connect (sync, SYNC_ADDRESS);
+    if (rc != 0)
+        fail ("xs_connect");
+
+    reps = (void**) malloc (peer_count * sizeof (void*));
+    if (!reps) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+    for (i = 0; i != peer_count; i++) {
+        reps [i] = open_socket (bench->ctx, XS_REP);
+        rc = xs_connect (reps [i], BACKEND_ADDRESS);
+        if (rc != 0)
+            fail ("xs_connect");
+    }
+    items = make_pollitems (reps, peer_count);
+    notify (sync);
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    cursor = 0;
+    for (i = 0; i != message_count + bench->rounds; i++) {
+        index = recv_any (reps, items, peer_count, &cursor, &msg);
+        send_msg (reps [index], &msg, 0);
+    }
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    for (i = 0; i != peer_count; i++) {
+        rc = xs_close (reps [i]);
+        if (rc != 0)
+            fail ("xs_close");
+    }
+    close_socket (sync);
+    free (reps);
+    free (items);
+    THREAD_RETURN;
+}
+
+static double reqrep (bench_t *bench_, void *sync_)
+{
+    void **device = bench_->device_sockets;
+    void *req;
+    thread_t worker;
+    xs_msg_t msg;
+    double start;
+    double elapsed;
+    int rc;
+    int i;
+
+    device [0] = open_socket (bench_->ctx, XS_ROUTER);
+    rc = xs_bind (device [0], address);
+    if (rc != 0)
+        fail ("xs_bind");
+    device [1] = open_socket (bench_->ctx, XS_DEALER);
+    rc = xs_bind (device [1], BACKEND_ADDRESS);
+    if (rc != 0)
+        fail ("xs_bind");
+    bench_->device = start_thread (device_worker, bench_);
+    bench_->has_device = true;
+
+    bench_->delivered = message_count;
+    worker = start_thread (reqrep_worker, bench_);
+    wait_for (sync_);
+
+    req = open_socket (bench_->ctx, XS_REQ);
+    rc = xs_connect (req, address);
+    if (rc != 0)
+        fail ("xs_connect");
+
+    start = now_us ();
+    for (i = 0; i != message_count; i++) {
+        init_msg (&msg, bench_->message_size);
+        send_msg (req, &msg, 0);
+        recv_msg (req, &msg);
+        rc = xs_msg_close (&msg);
+        if (rc != 0)
+            fail ("xs_msg_close");
+    }
+    elapsed = now_us () - start;
+
+    for (i = 0; i != bench_->rounds; i++) {
+        init_msg (&msg, bench_->latency_size);
+        write_stamp (&msg, 0);
+        send_msg (req, &msg, 0);
+        recv_msg (req, &msg);
+        record_latency (bench_, &msg, 0);
+        rc = xs_msg_close (&msg);
+        if (rc != 0)
+            fail ("xs_msg_close");
+    }
+
+    join_thread (worker);
+    close_socket (req);
+    return elapsed;
+}
+
+//  Connection churn: each message is sent from a new PUSH socket that is
+//  closed straight away. The latency is the time from opening the socket
+//  to the message being received.
+
+static THREAD_RESULT churn_worker (void *arg_)
+{
+    bench_t *bench = (bench_t*) arg_;
+    void *s;
+    xs_msg_t msg;
+    int rc;
+    int i;
+
+    for (i = 0; i != connection_count; i++) {
+        s = open_socket (bench->ctx, XS_PUSH);
+        init_msg (&msg, bench->latency_size);
+        write_stamp (&msg, 0);
+        rc = xs_connect (s, address);
+        if (rc != 0)
+            fail ("xs_connect");
+        send_msg (s, &msg, 0);
+        rc = xs_close (s);
+        if (rc != 0)
+            fail ("xs_close");
+    }
+    THREAD_RETURN;
+}
+
+static double churn (bench_t *bench_, void*)
+{
+    void *pull;
+    thread_t worker;
+    xs_msg_t msg;
+    double start;
+    double elapsed;
+    int rc;
+    int i;
+
+    pull = open_socket (bench_->ctx, XS_PULL);
+    set_option (pull, XS_RCVHWM, 0);
+
+    //  Make the listen backlog big enough to hold all the connections.
+    set_option (pull, XS_BACKLOG, connection_count);
+    rc = xs_bind (pull, address);
+    if (rc != 0)
+        fail ("xs_bind");
+
+    rc = xs_msg_init (&msg);
+    if (rc != 0)
+        fail ("xs_msg_init");
+
+    bench_->delivered = connection_count;
+    start = now_us ();
+    worker = start_thread (churn_worker, bench_);
+    for (i = 0; i != connection_count; i++) {
+        recv_msg (pull, &msg);
+        record_latency (bench_, &msg, 0);
+    }
+    elapsed = now_us () - start;
+
+    rc = xs_msg_close (&msg);
+    if (rc != 0)
+        fail ("xs_msg_close");
+    join_thread (worker);
+    close_socket (pull);
+    return elapsed;
+}
+
+struct pattern_t
+{
+    const char *name;
+    double (*fn) (bench_t *bench_, void *sync_);
+    bool measures_rounds;
+};
+
+static const pattern_t patterns [] = {
+    {"pubsub", pubsub, true},
+    {"router", router, true},
+    {"pushpull", pushpull, true},
+    {"reqrep", reqrep, true},
+    {"churn", churn, false}
+};
+
+static int compare (const void *lhs_, const void *rhs_)
+{
+    double lhs = *(const double*) lhs_;
+    double rhs = *(const double*) rhs_;
+    return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+}
+
+static double percentile (bench_t *bench_, double fraction_)
+{
+    int index;
+
+    if (!bench_->latency_count)
+        return 0;
+    index = (int) (bench_->latency_count * fraction_);
+    if (index >= bench_->latency_count)
+        index = bench_->latency_count - 1;
+    return bench_->latencies [index];
+}
+
+//  Runs the pattern with the specified message size and prints the result
+//  as a JSON object.
+static void run (const pattern_t *pattern_, size_t message_size_)
+{
+    bench_t bench;
+    void *sync;
+    int max_sockets;
+    double elapsed;
+    int rc;
+
+    memset (&bench, 0, sizeof (bench));
+    bench.message_size = message_size_;
+    bench.latency_size = message_size_;
+    if (bench.latency_size < TOPIC_SIZE + STAMP_SIZE)
+        bench.latency_size = TOPIC_SIZE + STAMP_SIZE;
+    bench.rounds = pattern_->measures_rounds ?
+        (message_count < MAX_LATENCY_ROUNDS ? message_count :
+        MAX_LATENCY_ROUNDS) : 0;
+
+    //  Each peer consumes a latency sample per round.
+    bench.latencies = (double*) malloc (sizeof (double) *
+        (bench.rounds * peer_count + connection_count));
+    if (!bench.latencies) {
+        fprintf (stderr, "error in malloc\n");
+        exit (1);
+    }
+
+    bench.ctx = xs_init ();
+    if (!bench.ctx)
+        fail ("xs_init");
+
+    //  Closed sockets linger till their messages are sent, so allow all
+    //  the churned sockets to exist at the same time.
+    max_sockets = peer_count + connection_count + 16;
+    if (max_sockets < 512)
+        max_sockets = 512;
+    rc = xs_setctxopt (bench.ctx, XS_MAX_SOCKETS, &max_sockets,
+        sizeof (max_sockets));
+    if (rc != 0)
+        fail ("xs_setctxopt");
+
+    sync = open_socket (bench.ctx, XS_PAIR);
+    rc = xs_bind (sync, SYNC_ADDRESS);
+    if (rc != 0)
+        fail ("xs_bind");
+
+    elapsed = pattern_->fn (&bench, sync);
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    close_socket (sync);
+    rc = xs_term (bench.ctx);
+    if (rc != 0)
+        fail ("xs_term");
+    if (bench.has_device)
+        join_thread (bench.device);
+
+    qsort (bench.latencies, bench.latency_count, sizeof (double), compare);
+
+    printf ("    {\"pattern\": \"%s\", \"message_size\": %d, "
+        "\"messages\": %llu, \"elapsed_us\": %.0f, \"throughput\": %.0f, "
+        "\"megabits\": %.3f,\n"
+        "     \"latency_us\": {\"samples\": %d, \"p50\": %.3f, "
+        "\"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}}",
+        pattern_->name, (int) message_size_, bench.delivered, elapsed,
+        (double) bench.delivered / elapsed * 1000000,
+        (double) bench.delivered * message_size_ * 8 / elapsed,
+        bench.latency_count, percentile (&bench, 0.5),
+        percentile (&bench, 0.9), percentile (&bench, 0.99),
+        percentile (&bench, 0.999), percentile (&bench, 1));
+
+    free (bench.latencies);
+}
+
+int main (int argc, char *argv [])
+{
+    size_t pattern;
+    int size;
+    bool first;
+
+    if (argc < 7) {
+        printf ("usage: pattern_bench <address> <message-count> "
+            "<peer-count> <subscription-count> <connection-count> "
+            "<message-size> [<message-size> ...]\n");
+        return 1;
+    }
+    address = argv [1];
+    message_count = atoi (argv [2]);
+    peer_count = atoi (argv [3]);
+    subscription_count = atoi (argv [4]);
+    connection_count = atoi (argv [5]);
+    if (message_count < 1 || peer_count < 1 || connection_count < 1 ||
+          subscription_count < 1 || subscription_count > 10000) {
+        printf ("message, peer and connection counts must be positive, "
+            "subscription count must be between 1 and 10000\n");
+        return 1;
+    }
+
+    printf ("{\"address\": \"%s\", \"message_count\": %d, "
+        "\"peer_count\": %d, \"subscription_count\": %d, "
+        "\"connection_count\": %d,\n \"results\": [\n", address,
+        message_count, peer_count, subscription_count, connection_count);
+
+    first = true;
+    for (pattern = 0; pattern != sizeof (patterns) / sizeof (patterns [0]);
+          pattern++) {
+        for (size = 6; size != argc; size++) {
+            if (!first)
+                printf (",\n");
+            first = false;
+            run (&patterns [pattern], atoi (argv [size]));
+            fflush (stdout);
+        }
+    }
+    printf ("\n]}\n");
+
+    return 0;
+}
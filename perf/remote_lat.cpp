@@ -24,11 +24,37 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define LATENCY_KINDS 4
+#define LATENCY_BUCKETS 272
+
+//  Returns the upper bound (in nanoseconds) of the bucket the specified
+//  fraction of measurements in the histogram falls to.
+static double percentile (unsigned long long *buckets, double fraction)
+{
+    unsigned long long total;
+    unsigned long long sum;
+    int i;
+
+    total = 0;
+    for (i = 0; i != LATENCY_BUCKETS; i++)
+        total += buckets [i];
+    sum = 0;
+    for (i = 0; i != LATENCY_BUCKETS - 1; i++) {
+        sum += buckets [i];
+        if (sum >= total * fraction)
+            break;
+    }
+    if (i < 16)
+        return i + 1;
+    return (double) ((unsigned long long) (9 + i % 8) << (i / 8 - 1));
+}
+
 int main (int argc, char *argv [])
 {
     const char *connect_to;
     int roundtrip_count;
     size_t message_size;
+    int busy_poll;
     void *ctx;
     void *s;
     int rc;
@@ -37,15 +63,20 @@ int main (int argc, char *argv [])
     void *watch;
     unsigned long elapsed;
     double latency;
+    static unsigned long long latencies [LATENCY_KINDS * LATENCY_BUCKETS];
+    size_t size;
+    const char *kinds [LATENCY_KINDS] = {"pipe in", "pipe out", "encode",
+        "decode"};
 
-    if (argc != 4) {
+    if (argc != 4 && argc != 5) {
         printf ("usage: remote_lat <connect-to> <message-size> "
-            "<roundtrip-count>\n");
+            "<roundtrip-count> [busy-poll]\n");
         return 1;
     }
     connect_to = argv [1];
     message_size = atoi (argv [2]);
     roundtrip_count = atoi (argv [3]);
+    busy_poll = argc == 5 ? atoi (argv [4]) : 0;
 
     ctx = xs_init ();
     if (!ctx) {
@@ -59,6 +90,12 @@ int main (int argc, char *argv [])
         return -1;
     }
 
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
     rc = xs_connect (s, connect_to);
     if (rc != 0) {
         printf ("error in xs_connect: %s\n", xs_strerror (errno));
@@ -105,6 +142,18 @@ int main (int argc, char *argv [])
     printf ("roundtrip count: %d\n", (int) roundtrip_count);
     printf ("average latency: %.3f [us]\n", (double) latency);
 
+    //  If the library measures latencies, print the breakdown.
+    size = sizeof (latencies);
+    rc = xs_getsockopt (s, XS_LATENCY, latencies, &size);
+    if (rc == 0) {
+        for (i = 0; i != LATENCY_KINDS; i++)
+            printf ("%s latency p50/p99/p99.9: %.3f/%.3f/%.3f [us]\n",
+                kinds [i],
+                percentile (latencies + i * LATENCY_BUCKETS, 0.5) / 1000,
+                percentile (latencies + i * LATENCY_BUCKETS, 0.99) / 1000,
+                percentile (latencies + i * LATENCY_BUCKETS, 0.999) / 1000);
+    }
+
     rc = xs_close (s);
     if (rc != 0) {
         printf ("error in xs_close: %s\n", xs_strerror (errno));
@@ -29,20 +29,29 @@ int main (int argc, char *argv [])
     const char *connect_to;
     int message_count;
     int message_size;
+    int batch_size;
     void *ctx;
     void *s;
     int rc;
     int i;
+    int j;
+    int n;
     xs_msg_t msg;
+    xs_msg_t *msgs;
 
-    if (argc != 4) {
+    if (argc != 4 && argc != 5) {
         printf ("usage: remote_thr <connect-to> <message-size> "
-            "<message-count>\n");
+            "<message-count> [<batch-size>]\n");
         return 1;
     }
     connect_to = argv [1];
     message_size = atoi (argv [2]);
     message_count = atoi (argv [3]);
+    batch_size = argc == 5 ? atoi (argv [4]) : 1;
+    if (batch_size < 1) {
+        printf ("batch size must be a positive number\n");
+        return 1;
+    }
 
     ctx = xs_init ();
     if (!ctx) {
@@ -65,27 +74,71 @@ int main (int argc, char *argv [])
         return -1;
     }
 
-    for (i = 0; i != message_count; i++) {
+    if (batch_size == 1) {
+        for (i = 0; i != message_count; i++) {
 
-        rc = xs_msg_init_size (&msg, message_size);
-        if (rc != 0) {
-            printf ("error in xs_msg_init_size: %s\n", xs_strerror (errno));
-            return -1;
-        }
+            rc = xs_msg_init_size (&msg, message_size);
+            if (rc != 0) {
+                printf ("error in xs_msg_init_size: %s\n", xs_strerror (errno));
+                return -1;
+            }
 #if defined XS_MAKE_VALGRIND_HAPPY
-        memset (xs_msg_data (&msg), 0, message_size);
+            memset (xs_msg_data (&msg), 0, message_size);
 #endif
 
-        rc = xs_sendmsg (s, &msg, 0);
-        if (rc < 0) {
-            printf ("error in xs_sendmsg: %s\n", xs_strerror (errno));
-            return -1;
+            rc = xs_sendmsg (s, &msg, 0);
+            if (rc < 0) {
+                printf ("error in xs_sendmsg: %s\n", xs_strerror (errno));
+                return -1;
+            }
+            rc = xs_msg_close (&msg);
+            if (rc != 0) {
+                printf ("error in xs_msg_close: %s\n", xs_strerror (errno));
+                return -1;
+            }
         }
-        rc = xs_msg_close (&msg);
-        if (rc != 0) {
-            printf ("error in xs_msg_close: %s\n", xs_strerror (errno));
+    }
+    else {
+        msgs = (xs_msg_t*) malloc (sizeof (xs_msg_t) * batch_size);
+        if (!msgs) {
+            printf ("error in malloc\n");
             return -1;
         }
+        for (i = 0; i != message_count; i += n) {
+
+            //  Fill in the batch.
+            n = message_count - i < batch_size ? message_count - i : batch_size;
+            for (j = 0; j != n; j++) {
+                rc = xs_msg_init_size (&msgs [j], message_size);
+                if (rc != 0) {
+                    printf ("error in xs_msg_init_size: %s\n",
+                        xs_strerror (errno));
+                    return -1;
+                }
+#if defined XS_MAKE_VALGRIND_HAPPY
+                memset (xs_msg_data (&msgs [j]), 0, message_size);
+#endif
+            }
+
+            //  Send the whole batch. The call may send only part of it.
+            for (j = 0; j != n; j += rc) {
+                rc = xs_sendmmsg (s, msgs + j, n - j, 0);
+                if (rc < 0) {
+                    printf ("error in xs_sendmmsg: %s\n", xs_strerror (errno));
+                    return -1;
+                }
+            }
+
+            for (j = 0; j != n; j++) {
+                rc = xs_msg_close (&msgs [j]);
+                if (rc != 0) {
+                    printf ("error in xs_msg_close: %s\n",
+                        xs_strerror (errno));
+                    return -1;
+                }
+            }
+        }
+        free (msgs);
     }
 
     rc = xs_close (s);
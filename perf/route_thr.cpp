@@ -0,0 +1,229 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "../include/xs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int message_count;
+static size_t message_size;
+
+//  Measures the cost of routing a message via ROUTER socket to one of
+//  the 'peers_' connected DEALER sockets.
+static void run (void *ctx_, int peers_)
+{
+    void *router;
+    void **dealers;
+    unsigned char (*ids) [256];
+    size_t *id_sizes;
+    char endpoint [64];
+    char *buf;
+    int hwm;
+    int linger;
+    int rc;
+    int i;
+    void *watch;
+    unsigned long elapsed;
+
+    router = xs_socket (ctx_, XS_ROUTER);
+    if (!router) {
+        printf ("error in xs_socket: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+
+    hwm = 0;
+    rc = xs_setsockopt (router, XS_SNDHWM, &hwm, sizeof (hwm));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+
+    sprintf (endpoint, "inproc://route_thr_%d", peers_);
+    rc = xs_bind (router, endpoint);
+    if (rc != 0) {
+        printf ("error in xs_bind: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+
+    dealers = (void**) malloc (peers_ * sizeof (void*));
+    ids = (unsigned char (*) [256]) malloc (peers_ * 256);
+    id_sizes = (size_t*) malloc (peers_ * sizeof (size_t));
+    buf = (char*) malloc (message_size ? message_size : 1);
+    if (!dealers || !ids || !id_sizes || !buf) {
+        printf ("error in malloc\n");
+        exit (1);
+    }
+    memset (buf, 0, message_size ? message_size : 1);
+
+    //  Connect the peers and let each of them send a message so that
+    //  the router learns its identity.
+    for (i = 0; i != peers_; i++) {
+        dealers [i] = xs_socket (ctx_, XS_DEALER);
+        if (!dealers [i]) {
+            printf ("error in xs_socket: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        rc = xs_setsockopt (dealers [i], XS_RCVHWM, &hwm, sizeof (hwm));
+        if (rc != 0) {
+            printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        rc = xs_connect (dealers [i], endpoint);
+        if (rc != 0) {
+            printf ("error in xs_connect: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        rc = xs_send (dealers [i], "", 0, 0);
+        if (rc < 0) {
+            printf ("error in xs_send: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+    }
+    for (i = 0; i != peers_; i++) {
+        rc = xs_recv (router, ids [i], 256, 0);
+        if (rc < 0) {
+            printf ("error in xs_recv: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        id_sizes [i] = rc;
+        rc = xs_recv (router, buf, message_size, 0);
+        if (rc < 0) {
+            printf ("error in xs_recv: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+    }
+
+    watch = xs_stopwatch_start ();
+
+    for (i = 0; i != message_count; i++) {
+        rc = xs_send (router, ids [i % peers_], id_sizes [i % peers_],
+            XS_SNDMORE);
+        if (rc < 0) {
+            printf ("error in xs_send: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        rc = xs_send (router, buf, message_size, 0);
+        if (rc < 0) {
+            printf ("error in xs_send: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+    }
+
+    elapsed = xs_stopwatch_stop (watch);
+    if (elapsed == 0)
+        elapsed = 1;
+
+    printf ("%10d %15.3f %15d\n", peers_,
+        (double) elapsed * 1000 / message_count,
+        (int) ((double) message_count / elapsed * 1000000));
+
+    linger = 0;
+    for (i = 0; i != peers_; i++) {
+        rc = xs_setsockopt (dealers [i], XS_LINGER, &linger, sizeof (linger));
+        if (rc != 0) {
+            printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+        rc = xs_close (dealers [i]);
+        if (rc != 0) {
+            printf ("error in xs_close: %s\n", xs_strerror (errno));
+            exit (1);
+        }
+    }
+    rc = xs_setsockopt (router, XS_LINGER, &linger, sizeof (linger));
+    if (rc != 0) {
+        printf ("error in xs_setsockopt: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+    rc = xs_close (router);
+    if (rc != 0) {
+        printf ("error in xs_close: %s\n", xs_strerror (errno));
+        exit (1);
+    }
+
+    free (dealers);
+    free (ids);
+    free (id_sizes);
+    free (buf);
+}
+
+int main (int argc, char *argv [])
+{
+    void *ctx;
+    int max_peers;
+    int max_sockets;
+    int peers;
+    int rc;
+
+    if (argc != 4) {
+        printf ("usage: route_thr <max-peer-count> <message-size> "
+            "<message-count>\n");
+        return 1;
+    }
+
+    max_peers = atoi (argv [1]);
+    message_size = atoi (argv [2]);
+    message_count = atoi (argv [3]);
+    if (max_peers < 1 || message_count < 1) {
+        printf ("peer count and message count must be positive\n");
+        return 1;
+    }
+
+    ctx = xs_init ();
+    if (!ctx) {
+        printf ("error in xs_init: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    //  Each peer is a separate socket. Note that every socket consumes
+    //  file descriptors so the process limit may need to be raised when
+    //  testing with large number of peers.
+    max_sockets = max_peers + 1;
+    rc = xs_setctxopt (ctx, XS_MAX_SOCKETS, &max_sockets,
+        sizeof (max_sockets));
+    if (rc != 0) {
+        printf ("error in xs_setctxopt: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    printf ("message size: %d [B]\n", (int) message_size);
+    printf ("message count: %d\n", (int) message_count);
+    printf ("%10s %15s %15s\n", "peers", "send [ns]", "msg/s");
+
+    //  Increase the number of peers by an order of magnitude each round.
+    for (peers = 1; ; peers *= 10) {
+        if (peers > max_peers)
+            peers = max_peers;
+        run (ctx, peers);
+        if (peers == max_peers)
+            break;
+    }
+
+    rc = xs_term (ctx);
+    if (rc != 0) {
+        printf ("error in xs_term: %s\n", xs_strerror (errno));
+        return -1;
+    }
+
+    return 0;
+}
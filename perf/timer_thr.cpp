@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//  Timers are internal to the library and their symbols are not exported.
+//  Thus, the implementation is compiled directly into the test program.
+#include "../src/timers.cpp"
+#include "../src/clock.cpp"
+#include "../src/err.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+
+//  The test simulates an I/O thread handling a large number of connections
+//  that are trying to reconnect to an unavailable peer. Each connection
+//  has a reconnect timer. When the timer expires, the reconnection attempt
+//  fails and the timer is re-added with a random reconnection interval.
+//  Some of the attempts succeed, in which case the timer is cancelled and
+//  the connection schedules a new timer later on.
+
+//  Ordered map of timers as used by the I/O threads previously. It serves
+//  as a baseline for the timer wheel.
+class map_timers_t
+{
+public:
+
+    xs::handle_t add (uint64_t now_, int timeout_, xs::i_poll_events *sink_)
+    {
+        info_t info = {sink_, map_t::iterator ()};
+        map_t::iterator it = timers.insert (
+            map_t::value_type (now_ + timeout_, info));
+        it->second.self = it;
+        return (xs::handle_t) &(it->second);
+    }
+
+    void rm (xs::handle_t handle_)
+    {
+        timers.erase (((info_t*) handle_)->self);
+    }
+
+    uint64_t execute (uint64_t now_)
+    {
+        map_t::iterator it = timers.begin ();
+        while (it != timers.end ()) {
+            if (it->first > now_)
+                return it->first - now_;
+            map_t::iterator o = it;
+            ++it;
+            xs::i_poll_events *sink = o->second.sink;
+            xs::handle_t handle = (xs::handle_t) &o->second;
+            timers.erase (o);
+            sink->timer_event (handle);
+        }
+        return 0;
+    }
+
+private:
+
+    struct info_t;
+    typedef std::multimap <uint64_t, info_t> map_t;
+    struct info_t
+    {
+        xs::i_poll_events *sink;
+        map_t::iterator self;
+    };
+    map_t timers;
+};
+
+static int connection_count;
+static int duration;
+static uint64_t now;
+static unsigned long operations;
+
+template <typename T> struct connection_t : public xs::i_poll_events
+{
+    T *timers;
+    xs::handle_t handle;
+
+    void in_event (xs::fd_t) {}
+    void out_event (xs::fd_t) {}
+
+    void timer_event (xs::handle_t)
+    {
+        //  Reconnection failed. Try again after a random interval.
+        handle = timers->add (now, 100 + rand () % 10000, this);
+        operations += 2;
+    }
+
+    void reconnected ()
+    {
+        //  Connection was established and dropped straight away.
+        timers->rm (handle);
+        handle = timers->add (now, 100 + rand () % 10000, this);
+        operations += 2;
+    }
+};
+
+template <typename T> static void run (const char *name_)
+{
+    T timers;
+    std::vector <connection_t <T> > connections (connection_count);
+
+    srand (1);
+    now = 0;
+    operations = 0;
+    for (int i = 0; i != connection_count; i++) {
+        connections [i].timers = &timers;
+        connections [i].handle = timers.add (now, 100 + rand () % 10000,
+            &connections [i]);
+        operations++;
+    }
+
+    //  Advance the time by one millisecond in each iteration.
+    uint64_t start = xs::clock_t::now_us ();
+    for (int ms = 0; ms != duration; ms++) {
+        now++;
+        for (int i = 0; i != connection_count / 1000; i++)
+            connections [rand () % connection_count].reconnected ();
+        timers.execute (now);
+        operations++;
+    }
+    uint64_t elapsed = xs::clock_t::now_us () - start;
+    if (elapsed == 0)
+        elapsed = 1;
+
+    double latency = (double) elapsed * 1000 / operations;
+    printf ("%s: %lu operations, %.3f [ns] per operation\n", name_,
+        operations, latency);
+}
+
+int main (int argc, char *argv [])
+{
+    if (argc != 3) {
+        printf ("usage: timer_thr <connection-count> <duration-ms>\n");
+        return 1;
+    }
+    connection_count = atoi (argv [1]);
+    duration = atoi (argv [2]);
+
+    printf ("connection count: %d\n", connection_count);
+    printf ("simulated time: %d [ms]\n", duration);
+
+    run <xs::timers_t> ("timer wheel");
+    run <map_timers_t> ("ordered map");
+
+    return 0;
+}
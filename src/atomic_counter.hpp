@@ -129,6 +129,35 @@ namespace xs
 #endif
         }
 
+        //  Atomic compare-and-swap. If the counter is equal to 'cmp' it is
+        //  set to 'val'. Returns the old value.
+        inline integer_t cas (integer_t cmp_, integer_t val_)
+        {
+#if defined XS_ATOMIC_COUNTER_WINDOWS
+            return (integer_t) InterlockedCompareExchange ((LONG*) &value,
+                (LONG) val_, (LONG) cmp_);
+#elif defined XS_ATOMIC_COUNTER_ATOMIC_H
+            return atomic_cas_32 (&value, cmp_, val_);
+#elif defined XS_ATOMIC_COUNTER_X86
+            integer_t old;
+            __asm__ volatile (
+                "lock; cmpxchgl %2, %3"
+                : "=a" (old), "=m" (value)
+                : "r" (val_), "m" (value), "0" (cmp_)
+                : "cc", "memory");
+            return old;
+#elif defined XS_ATOMIC_COUNTER_MUTEX
+            sync.lock ();
+            integer_t old = value;
+            if (value == cmp_)
+                value = val_;
+            sync.unlock ();
+            return old;
+#else
+#error atomic_counter is not implemented for this platform
+#endif
+        }
+
         inline integer_t get ()
         {
             return value;
@@ -72,6 +72,33 @@ namespace xs
             this->ptr = ptr_;
         }
 
+        //  Read the value of the pointer. Memory accesses following the load
+        //  are not reordered before it, so it's safe to access the object
+        //  published by another thread using store, xchg or cas.
+        inline T *load ()
+        {
+#if defined XS_ATOMIC_PTR_X86
+            T *val = (T*) ptr;
+            __asm__ volatile ("" : : : "memory");
+            return val;
+#else
+            return cas (NULL, NULL);
+#endif
+        }
+
+        //  Set the value of the pointer. Memory accesses preceding the store
+        //  are not reordered after it, so the object the pointer refers to
+        //  is fully initialised by the time other threads can see it.
+        inline void store (T *ptr_)
+        {
+#if defined XS_ATOMIC_PTR_X86
+            __asm__ volatile ("" : : : "memory");
+            this->ptr = ptr_;
+#else
+            xchg (ptr_);
+#endif
+        }
+
         //  Perform atomic 'exchange pointers' operation. Pointer is set
         //  to the 'val' value. Old value is returned.
         inline T *xchg (T *val_)
@@ -94,9 +94,10 @@ namespace xs
             } activate_read;
 
             //  Sent by pipe reader to inform pipe writer about how many
-            //  messages it has read so far.
+            //  messages and bytes it has read so far.
             struct {
                 uint64_t msgs_read;
+                uint64_t bytes_read;
             } activate_write;
 
             //  Sent by pipe reader to writer after creating a new inpipe.
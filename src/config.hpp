@@ -34,9 +34,6 @@ namespace xs
         //  memory allocation by approximately 99.6%
         message_pipe_granularity = 256,
 
-        //  Commands in pipe per allocation event.
-        command_pipe_granularity = 16,
-
         //  Determines how often does socket poll for new commands when it
         //  still has unprocessed messages to handle. Thus, if it is set to 100,
         //  socket will process 100 inbound messages before doing the poll.
@@ -51,18 +48,77 @@ namespace xs
         //  unnecessary network stack traversals.
         in_batch_size = 8192,
 
+        //  Engines start with receive buffer of in_batch_size bytes. When
+        //  data are arriving faster than they are read, the buffer grows up
+        //  to this size.
+        max_in_batch_size = 262144,
+
+        //  Maximal number of bytes an engine reads in a single go. When
+        //  the limit is reached, the engine yields to other engines in the
+        //  same I/O thread even if there are more data available. Note that
+        //  the limit applies to each engine and each input event separately;
+        //  there's no budget shared by all the engines of an I/O thread.
+        max_in_event_size = 1048576,
+
         //  Maximal batching size for engines with sending functionality.
         //  So, if there are 10 messages that fit into the batch size, all of
         //  them may be written by a single 'send' system call, thus avoiding
         //  unnecessary network stack traversals.
         out_batch_size = 8192,
 
+        //  Pieces of outbound data at least this long are passed to the kernel
+        //  by reference instead of being copied to the engine's buffer first.
+        //  Only applies to the platforms that support scatter-gather I/O.
+        out_gather_threshold = 512,
+
+        //  Maximal size of a batch frame, i.e. a frame carrying several
+        //  small messages. Has to be smaller than out_gather_threshold so
+        //  that the frame is always copied to the engine's buffer.
+        max_batch_frame_size = 256,
+
+        //  Maximal number of I/O vectors passed to the kernel in a single
+        //  scatter-gather write.
+        max_io_vectors = 64,
+
+        //  Size of CPU cache line. Memory chunks holding queued messages are
+        //  aligned to this boundary.
+        cache_line_size = 64,
+
+        //  Size of each of the two rings in the memory shared by the peers
+        //  connected via shm transport. Has to be a power of two.
+        shm_ring_size = 1048576,
+
+        //  XSUB socket checks the messages against a flat table of
+        //  subscriptions instead of the subscription trie as long as there
+        //  are at most this many subscriptions, none of them longer than
+        //  16 bytes.
+        max_flat_subscriptions = 8,
+
         //  Maximal delta between high and low watermark.
         max_wm_delta = 1024,
 
+        //  Pipes reserve memory from the context-wide memory budget in
+        //  chunks of this size. Pipe readers also report the number of bytes
+        //  read to the writers after reading this many bytes, so that unused
+        //  reservations can be returned to the budget.
+        memory_budget_granularity = 8192,
+
         //  Maximum number of events the I/O thread can process in one go.
         max_io_events = 256,
 
+        //  Number of timer entries allocated in one go. Allocated entries
+        //  are reused by subsequent timers of the same I/O thread.
+        timer_chunk_size = 256,
+
+        //  Length of the period (in milliseconds) over which the utilisation
+        //  of an I/O thread is measured.
+        load_window = 100,
+
+        //  Differences in utilisation of I/O threads (in per mille) smaller
+        //  than this are ignored when choosing an I/O thread for a new
+        //  object. Number of file descriptors is used instead.
+        load_granularity = 50,
+
         //  Maximal delay to process command in API thread (in CPU ticks).
         //  3,000,000 ticks equals to 1 - 2 milliseconds on current CPUs.
         //  Note that delay is only applied when there is continuous stream of
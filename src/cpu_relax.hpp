@@ -0,0 +1,49 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_CPU_RELAX_HPP_INCLUDED__
+#define __XS_CPU_RELAX_HPP_INCLUDED__
+
+#include "platform.hpp"
+
+#if defined XS_HAVE_WINDOWS
+#include "windows.hpp"
+#endif
+
+namespace xs
+{
+
+    //  Tells the CPU that the thread is in a busy-wait loop. This lets the
+    //  other hardware thread of the core run faster and avoids the penalty
+    //  for memory order violation when the loop is exited.
+    inline void cpu_relax ()
+    {
+#if (defined __i386__ || defined __x86_64__) && defined __GNUC__
+        __asm__ volatile ("pause");
+#elif defined __aarch64__ && defined __GNUC__
+        __asm__ volatile ("yield");
+#elif defined XS_HAVE_WINDOWS
+        YieldProcessor ();
+#endif
+    }
+
+}
+
+#endif
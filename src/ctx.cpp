@@ -35,6 +35,11 @@
 #include "pipe.hpp"
 #include "err.hpp"
 #include "msg.hpp"
+#include "msg_pool.hpp"
+#include "memory_budget.hpp"
+#if defined XS_HAVE_LATENCY_STATS
+#include "histogram.hpp"
+#endif
 
 xs::ctx_t::ctx_t () :
     tag (0xbadcafe0),
@@ -44,8 +49,19 @@ xs::ctx_t::ctx_t () :
     slot_count (0),
     slots (NULL),
     max_sockets (512),
-    io_thread_count (1)
+    io_thread_count (1),
+    use_msg_pool (false),
+    use_io_uring (false),
+    wakeup_spin (0),
+    msg_pool (NULL),
+    memory_limit (0),
+    memory_budget (NULL),
+    async_io (false)
 {
+#if defined XS_HAVE_LATENCY_STATS
+    //  Latency histograms need to know how fast the CPU's tick counter runs.
+    histogram_t::calibrate ();
+#endif
 }
 
 bool xs::ctx_t::check_tag ()
@@ -77,6 +93,16 @@ xs::ctx_t::~ctx_t ()
     if (slots)
         free (slots);
 
+    //  Drop the reference to the message pool. The pool itself is deallocated
+    //  when all the messages allocated from it are closed.
+    if (msg_pool)
+        msg_pool->release ();
+
+    //  All the pipes and engines are gone by now, so nobody refers to
+    //  the memory budget anymore.
+    if (memory_budget)
+        delete memory_budget;
+
     //  Remove the tag, so that the object is considered dead.
     tag = 0xdeadbeef;
 }
@@ -145,6 +171,68 @@ int xs::ctx_t::setctxopt (int option_, const void *optval_, size_t optvallen_)
         io_thread_count = *((int*) optval_);
         opt_sync.unlock ();
         break;
+    case XS_MSG_POOL:
+        if (optvallen_ != sizeof (int) || (*((int*) optval_) != 0 &&
+              *((int*) optval_) != 1)) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        use_msg_pool = *((int*) optval_) ? true : false;
+        opt_sync.unlock ();
+        break;
+    case XS_WAKEUP_SPIN:
+        if (optvallen_ != sizeof (int) || *((int*) optval_) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        wakeup_spin = *((int*) optval_);
+        opt_sync.unlock ();
+        break;
+    case XS_IO_URING:
+        if (optvallen_ != sizeof (int) || (*((int*) optval_) != 0 &&
+              *((int*) optval_) != 1)) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        use_io_uring = *((int*) optval_) ? true : false;
+        opt_sync.unlock ();
+        break;
+    case XS_IO_THREAD_CPUS:
+    case XS_REAPER_CPUS:
+        {
+            if (optvallen_ % sizeof (int)) {
+                errno = EINVAL;
+                return -1;
+            }
+            cpus_t cpus ((const int*) optval_,
+                (const int*) optval_ + optvallen_ / sizeof (int));
+            int cpu_count = get_cpu_count ();
+            for (cpus_t::size_type i = 0; i != cpus.size (); i++) {
+                if (cpus [i] < 0 || cpus [i] >= cpu_count) {
+                    errno = EINVAL;
+                    return -1;
+                }
+            }
+            opt_sync.lock ();
+            if (option_ == XS_IO_THREAD_CPUS)
+                io_thread_cpus = cpus;
+            else
+                reaper_cpus = cpus;
+            opt_sync.unlock ();
+            break;
+        }
+    case XS_MEMORY_BUDGET:
+        if (optvallen_ != sizeof (uint64_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        memory_limit = *((uint64_t*) optval_);
+        opt_sync.unlock ();
+        break;
     default:
         errno = EINVAL;
         return -1;
@@ -152,6 +240,149 @@ int xs::ctx_t::setctxopt (int option_, const void *optval_, size_t optvallen_)
     return 0;
 }
 
+int xs::ctx_t::getctxopt (int option_, void *optval_, size_t *optvallen_)
+{
+    switch (option_) {
+    case XS_MAX_SOCKETS:
+    case XS_IO_THREADS:
+    case XS_MSG_POOL:
+    case XS_WAKEUP_SPIN:
+    case XS_IO_URING:
+        if (*optvallen_ < sizeof (int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        if (option_ == XS_MAX_SOCKETS)
+            *((int*) optval_) = max_sockets;
+        else if (option_ == XS_IO_THREADS)
+            *((int*) optval_) = io_thread_count;
+        else if (option_ == XS_WAKEUP_SPIN)
+            *((int*) optval_) = wakeup_spin;
+        else if (option_ == XS_IO_URING)
+            *((int*) optval_) = use_io_uring ? 1 : 0;
+        else
+            *((int*) optval_) = use_msg_pool ? 1 : 0;
+        opt_sync.unlock ();
+        *optvallen_ = sizeof (int);
+        return 0;
+    case XS_IO_THREAD_CPUS:
+    case XS_REAPER_CPUS:
+        {
+            opt_sync.lock ();
+            cpus_t cpus = option_ == XS_IO_THREAD_CPUS ?
+                io_thread_cpus : reaper_cpus;
+            opt_sync.unlock ();
+            if (*optvallen_ < cpus.size () * sizeof (int)) {
+                errno = EINVAL;
+                return -1;
+            }
+            if (!cpus.empty ())
+                memcpy (optval_, &cpus [0], cpus.size () * sizeof (int));
+            *optvallen_ = cpus.size () * sizeof (int);
+            return 0;
+        }
+    case XS_IO_THREAD_STATS:
+        {
+            //  The I/O threads are launched together with the first socket.
+            slot_sync.lock ();
+            io_threads_t threads = io_threads;
+            slot_sync.unlock ();
+
+            //  There are four values per I/O thread.
+            size_t size = threads.size () * 4 * sizeof (uint64_t);
+            if (*optvallen_ < size) {
+                errno = EINVAL;
+                return -1;
+            }
+            uint64_t *values = (uint64_t*) optval_;
+            for (io_threads_t::size_type i = 0; i != threads.size (); i++) {
+                io_thread_stats_t stats;
+                threads [i]->get_stats (&stats);
+                values [i * 4] = stats.bytes;
+                values [i * 4 + 1] = stats.events;
+                values [i * 4 + 2] = stats.busy;
+                values [i * 4 + 3] = threads [i]->get_load ();
+            }
+            *optvallen_ = size;
+            return 0;
+        }
+    case XS_STATS:
+        {
+            if (*optvallen_ < sizeof (socket_stats_t)) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            //  Sum up the statistics of all the sockets in the context.
+            socket_stats_t total;
+            memset (&total, 0, sizeof (total));
+            slot_sync.lock ();
+            for (sockets_t::size_type i = 0; i != sockets.size (); i++) {
+                socket_stats_t stats;
+                sockets [i]->get_stats (&stats);
+                total.add (stats);
+            }
+            slot_sync.unlock ();
+            memcpy (optval_, &total, sizeof (socket_stats_t));
+            *optvallen_ = sizeof (socket_stats_t);
+            return 0;
+        }
+    case XS_MEMORY_BUDGET:
+        if (*optvallen_ < sizeof (uint64_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        opt_sync.lock ();
+        *((uint64_t*) optval_) = memory_limit;
+        opt_sync.unlock ();
+        *optvallen_ = sizeof (uint64_t);
+        return 0;
+    case XS_MEMORY_USED:
+        {
+            if (*optvallen_ < sizeof (uint64_t)) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            //  The budget is created together with the first socket.
+            slot_sync.lock ();
+            memory_budget_t *budget = memory_budget;
+            slot_sync.unlock ();
+
+            *((uint64_t*) optval_) = budget ? budget->get_used () : 0;
+            *optvallen_ = sizeof (uint64_t);
+            return 0;
+        }
+    case XS_MSG_POOL_HITS:
+    case XS_MSG_POOL_MISSES:
+        {
+            if (*optvallen_ < sizeof (uint64_t)) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            //  The pool is created together with the first socket. Make sure
+            //  we don't access the pointer while it is being set.
+            slot_sync.lock ();
+            msg_pool_t *pool = msg_pool;
+            slot_sync.unlock ();
+
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            if (pool)
+                pool->get_stats (&hits, &misses);
+            *((uint64_t*) optval_) =
+                option_ == XS_MSG_POOL_HITS ? hits : misses;
+            *optvallen_ = sizeof (uint64_t);
+            return 0;
+        }
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
 xs::socket_base_t *xs::ctx_t::create_socket (int type_)
 {
     if (unlikely (starting)) {
@@ -163,11 +394,33 @@ xs::socket_base_t *xs::ctx_t::create_socket (int type_)
         opt_sync.lock ();
         int maxs = max_sockets;
         int ios = io_thread_count;
+        bool pooled = use_msg_pool;
+        bool uring = use_io_uring;
+        uint64_t limit = memory_limit;
+        cpus_t io_cpus = io_thread_cpus;
+        cpus_t rcpus = reaper_cpus;
         opt_sync.unlock ();
+
+        //  Create the memory budget, if required.
+        if (limit) {
+            slot_sync.lock ();
+            memory_budget = new (std::nothrow) memory_budget_t (limit);
+            alloc_assert (memory_budget);
+            slot_sync.unlock ();
+        }
         slot_count = maxs + ios + 2;
         slots = (mailbox_t**) malloc (sizeof (mailbox_t*) * slot_count);
         alloc_assert (slots);
 
+        //  Create the message pool, if required. It has to exist before
+        //  any thread that could allocate messages is launched.
+        if (pooled) {
+            slot_sync.lock ();
+            msg_pool = new (std::nothrow) msg_pool_t (slot_count);
+            alloc_assert (msg_pool);
+            slot_sync.unlock ();
+        }
+
         //  Initialise the infrastructure for xs_term thread.
         slots [term_tid] = &term_mailbox;
 
@@ -175,15 +428,24 @@ xs::socket_base_t *xs::ctx_t::create_socket (int type_)
         reaper = new (std::nothrow) reaper_t (this, reaper_tid);
         alloc_assert (reaper);
         slots [reaper_tid] = reaper->get_mailbox ();
-        reaper->start ();
+        reaper->start (rcpus);
 
         //  Create I/O thread objects and launch them.
         for (int i = 2; i != ios + 2; i++) {
-            io_thread_t *io_thread = io_thread_t::create (this, i);
+            io_thread_t *io_thread = io_thread_t::create (this, i, uring);
             errno_assert (io_thread);
+            slot_sync.lock ();
             io_threads.push_back (io_thread);
+            slot_sync.unlock ();
             slots [i] = io_thread->get_mailbox ();
-            io_thread->start ();
+            async_io = io_thread->async_io ();
+
+            //  The I/O threads are assigned the listed CPUs in round-robin
+            //  fashion, each I/O thread being pinned to a single CPU.
+            cpus_t cpus;
+            if (!io_cpus.empty ())
+                cpus.push_back (io_cpus [(i - 2) % io_cpus.size ()]);
+            io_thread->start (cpus);
         }
 
         //  In the unused part of the slot array, create a list of empty slots.
@@ -194,6 +456,10 @@ xs::socket_base_t *xs::ctx_t::create_socket (int type_)
         }
     }
 
+    opt_sync.lock ();
+    int spin = wakeup_spin;
+    opt_sync.unlock ();
+
     slot_sync.lock ();
 
     //  Once xs_term() was called, we can't create new sockets.
@@ -224,6 +490,7 @@ xs::socket_base_t *xs::ctx_t::create_socket (int type_)
         slot_sync.unlock ();
         return NULL;
     }
+    s->get_mailbox ()->set_spin (spin);
     sockets.push_back (s);
     slots [slot] = s->get_mailbox ();
 
@@ -262,27 +529,50 @@ void xs::ctx_t::send_command (uint32_t tid_, const command_t &command_)
     slots [tid_]->send (command_);
 }
 
-xs::io_thread_t *xs::ctx_t::choose_io_thread (uint64_t affinity_)
+//  Returns true if the I/O thread with the specified index is allowed by
+//  the affinity bitmap.
+static bool is_eligible (const std::vector <uint64_t> &affinity_, size_t i_)
+{
+    return affinity_.empty () || (i_ / 64 < affinity_.size () &&
+        (affinity_ [i_ / 64] & (uint64_t (1) << (i_ % 64))));
+}
+
+xs::io_thread_t *xs::ctx_t::choose_io_thread (
+    const std::vector <uint64_t> &affinity_)
 {
     if (io_threads.empty ())
         return NULL;
 
-    //  Find the I/O thread with minimum load.
+    //  Find the I/O thread that was the least busy recently. If there are
+    //  several of them, choose the one with the minimum number of file
+    //  descriptors registered.
+    int min_busy = -1;
     int min_load = -1;
     io_threads_t::size_type result = 0;
     for (io_threads_t::size_type i = 0; i != io_threads.size (); i++) {
-        if (!affinity_ || (affinity_ & (uint64_t (1) << i))) {
+        if (is_eligible (affinity_, i)) {
+            int busy = io_threads [i]->get_utilisation () / load_granularity;
             int load = io_threads [i]->get_load ();
-            if (min_load == -1 || load < min_load) {
+            if (min_busy == -1 || busy < min_busy ||
+                  (busy == min_busy && load < min_load)) {
+                min_busy = busy;
                 min_load = load;
                 result = i;
             }
         }
     }
-    xs_assert (min_load != -1);
+    xs_assert (min_busy != -1);
     return io_threads [result];
 }
 
+void xs::ctx_t::get_io_threads (const std::vector <uint64_t> &affinity_,
+    std::vector <io_thread_t*> &io_threads_)
+{
+    for (io_threads_t::size_type i = 0; i != io_threads.size (); i++)
+        if (is_eligible (affinity_, i))
+            io_threads_.push_back (io_threads [i]);
+}
+
 int xs::ctx_t::register_endpoint (const char *addr_, endpoint_t &endpoint_)
 {
     endpoints_sync.lock ();
@@ -31,6 +31,7 @@
 #include "array.hpp"
 #include "config.hpp"
 #include "mutex.hpp"
+#include "thread.hpp"
 #include "options.hpp"
 #include "atomic_counter.hpp"
 
@@ -41,6 +42,8 @@ namespace xs
     class io_thread_t;
     class socket_base_t;
     class reaper_t;
+    class msg_pool_t;
+    class memory_budget_t;
 
     //  Information associated with inproc endpoint. Note that endpoint options
     //  are registered as well so that the peer can access them without a need
@@ -70,8 +73,9 @@ namespace xs
         //  after the last one is closed.
         int terminate ();
 
-        //  Set context option.
+        //  Set and get context option.
         int setctxopt (int option_, const void *optval_, size_t optvallen_);
+        int getctxopt (int option_, void *optval_, size_t *optvallen_);
 
         //  Create and destroy a socket.
         xs::socket_base_t *create_socket (int type_);
@@ -81,13 +85,40 @@ namespace xs
         void send_command (uint32_t tid_, const command_t &command_);
 
         //  Returns the I/O thread that is the least busy at the moment.
-        //  Affinity specifies which I/O threads are eligible (0 = all).
+        //  Affinity specifies which I/O threads are eligible (empty = all).
         //  Returns NULL is no I/O thread is available.
-        xs::io_thread_t *choose_io_thread (uint64_t affinity_);
+        xs::io_thread_t *choose_io_thread (
+            const std::vector <uint64_t> &affinity_);
+
+        //  Appends all the I/O threads allowed by the affinity to the
+        //  io_threads_ vector.
+        void get_io_threads (const std::vector <uint64_t> &affinity_,
+            std::vector <xs::io_thread_t*> &io_threads_);
 
         //  Returns reaper thread object.
         xs::object_t *get_reaper ();
 
+        //  Returns the pool to allocate message content from. NULL means
+        //  that message pooling is switched off.
+        inline xs::msg_pool_t *get_msg_pool ()
+        {
+            return msg_pool;
+        }
+
+        //  Returns the budget to reserve the memory for buffering messages
+        //  from. NULL means that the memory is not limited.
+        inline xs::memory_budget_t *get_memory_budget ()
+        {
+            return memory_budget;
+        }
+
+        //  Returns true if the I/O threads read and write the data
+        //  themselves, i.e. if they use io_uring.
+        inline bool get_async_io ()
+        {
+            return async_io;
+        }
+
         //  Management of inproc endpoints.
         int register_endpoint (const char *addr_, endpoint_t &endpoint_);
         void unregister_endpoints (xs::socket_base_t *socket_);
@@ -158,6 +189,39 @@ namespace xs
         //  Number of I/O threads to launch.
         int io_thread_count;
 
+        //  If true, message content is allocated from the message pool.
+        bool use_msg_pool;
+
+        //  If true, I/O threads use io_uring instead of the default polling
+        //  mechanism, if available.
+        bool use_io_uring;
+
+        //  Time (in microseconds) the sockets spin waiting for a command
+        //  before going to sleep.
+        int wakeup_spin;
+
+        //  CPUs to run the I/O threads and the reaper thread on. Empty means
+        //  the threads are not pinned.
+        cpus_t io_thread_cpus;
+        cpus_t reaper_cpus;
+
+        //  Pool of message content blocks. Created when the first socket is
+        //  created if use_msg_pool is set.
+        xs::msg_pool_t *msg_pool;
+
+        //  Limit on the memory used to buffer messages in the whole context.
+        //  Zero means no limit.
+        uint64_t memory_limit;
+
+        //  Context-wide memory budget. Created when the first socket is
+        //  created if memory_limit is set.
+        xs::memory_budget_t *memory_budget;
+
+        //  True if the I/O threads perform the reads and writes themselves.
+        //  Set when the first socket is created. If io_uring is requested
+        //  but not available, it stays false.
+        bool async_io;
+
         //  Synchronisation of access to context options.
         mutex_t opt_sync;
 
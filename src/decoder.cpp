@@ -23,14 +23,22 @@
 #include <string.h>
 
 #include "decoder.hpp"
-#include "session_base.hpp"
+#include "encoder.hpp"
 #include "likely.hpp"
 #include "wire.hpp"
 #include "err.hpp"
 
-xs::decoder_t::decoder_t (size_t bufsize_, uint64_t maxmsgsize_) :
-    decoder_base_t <decoder_t> (bufsize_),
-    session (NULL),
+xs::decoder_t::decoder_t (size_t bufsize_, size_t max_bufsize_,
+      uint64_t maxmsgsize_, bool zero_copy_) :
+    decoder_base_t <decoder_t> (bufsize_, max_bufsize_, zero_copy_),
+    msg_sink (NULL),
+    encoder (NULL),
+    pool (NULL),
+    pool_tid (0),
+    batch_count (0),
+    batch_index (0),
+    batch_pos (0),
+    batch_built (false),
     maxmsgsize (maxmsgsize_)
 {
     int rc = in_progress.init ();
@@ -46,71 +54,128 @@ xs::decoder_t::~decoder_t ()
     errno_assert (rc == 0);
 }
 
-void xs::decoder_t::set_session (session_base_t *session_)
+void xs::decoder_t::set_msg_sink (i_msg_sink *msg_sink_, msg_pool_t *pool_,
+    uint32_t tid_)
 {
-    session = session_;
+    msg_sink = msg_sink_;
+    pool = pool_;
+    pool_tid = tid_;
 }
 
-bool xs::decoder_t::one_byte_size_ready ()
+void xs::decoder_t::set_encoder (encoder_t *encoder_)
 {
-    //  First byte of size is read. If it is 0xff read 8-byte size.
-    //  Otherwise allocate the buffer for message data and read the
-    //  message data into it.
-    if (*tmpbuf == 0xff)
-        next_step (tmpbuf, 8, &decoder_t::eight_byte_size_ready);
-    else {
+    encoder = encoder_;
+}
 
-        //  There has to be at least one byte (the flags) in the message).
-        if (!*tmpbuf) {
-            decoding_error ();
-            return false;
-        }
+size_t xs::decoder_t::decode_fast (unsigned char *data_, size_t size_)
+{
+    //  The fast path applies only in between messages. Anything else than
+    //  complete messages with one-byte size is left to the state machine.
+    if (!next_is (&decoder_t::one_byte_size_ready) || unlikely (!msg_sink))
+        return 0;
+    unsigned char *data;
+    bool zero_copy = sliceable (&data) != 0;
 
-        //  in_progress is initialised at this point so in theory we should
-        //  close it before calling xs_msg_init_size, however, it's a 0-byte
-        //  message and thus we can treat it as uninitialised...
-        int rc;
-        if (maxmsgsize >= 0 && (uint64_t) (*tmpbuf - 1) > maxmsgsize) {
-            rc = -1;
-            errno = ENOMEM;
-        }
-        else
-            rc = in_progress.init_size (*tmpbuf - 1);
-        if (rc != 0 && errno == ENOMEM) {
-            rc = in_progress.init ();
+    size_t pos = 0;
+    while (size_ - pos >= 2) {
+        size_t size = data_ [pos];
+        if (size == 0 || size == 0xff || pos + 1 + size > size_)
+            break;
+        if (maxmsgsize >= 0 && size - 1 > maxmsgsize)
+            break;
+
+        //  in_progress is a 0-byte message at this point, so it can be
+        //  treated as uninitialised.
+        if (zero_copy)
+            slice (in_progress, data_ + pos + 2, size - 1);
+        else {
+            int rc = in_progress.init_size (size - 1, pool, pool_tid);
+            if (rc != 0 && errno == ENOMEM) {
+                rc = in_progress.init ();
+                errno_assert (rc == 0);
+                break;
+            }
             errno_assert (rc == 0);
-            decoding_error ();
-            return false;
+
+            //  The size is taken from the message rather than from the wire
+            //  so that the compiler doesn't inline the copy of the bounded
+            //  block as a string instruction, which is slow for short data.
+            memcpy (in_progress.data (), data_ + pos + 2,
+                in_progress.size ());
         }
-        errno_assert (rc == 0);
+        in_progress.set_flags (data_ [pos + 1]);
+        pos += 1 + size;
 
-        next_step (tmpbuf, 1, &decoder_t::flags_ready);
+        //  If the message can't be pushed, the state machine will retry.
+        int rc = msg_sink->write (&in_progress);
+        if (unlikely (rc != 0)) {
+            if (errno != EAGAIN)
+                decoding_error ();
+            else
+                next_step (NULL, 0, &decoder_t::message_ready);
+            break;
+        }
     }
-    return true;
+    return pos;
+}
+
+bool xs::decoder_t::message_boundary ()
+{
+    return next_is (&decoder_t::one_byte_size_ready);
+}
+
+bool xs::decoder_t::one_byte_size_ready ()
+{
+    //  First byte of size is read. If it is 0xff read 8-byte size. If it is
+    //  zero, batch frame follows. Otherwise allocate the buffer for message
+    //  data and read the message data into it.
+    if (*tmpbuf == 0xff) {
+        next_step (tmpbuf, 8, &decoder_t::eight_byte_size_ready);
+        return true;
+    }
+    if (*tmpbuf == 0) {
+        next_step (tmpbuf, 1, &decoder_t::batch_count_ready);
+        return true;
+    }
+    return size_ready (*tmpbuf);
 }
 
 bool xs::decoder_t::eight_byte_size_ready ()
 {
     //  8-byte size is read. Allocate the buffer for message body and
     //  read the message data into it.
-    size_t size = (size_t) get_uint64 (tmpbuf);
+    return size_ready (get_uint64 (tmpbuf));
+}
 
+bool xs::decoder_t::size_ready (uint64_t size_)
+{
     //  There has to be at least one byte (the flags) in the message).
-    if (!size) {
+    if (!size_) {
+        decoding_error ();
+        return false;
+    }
+
+    if (maxmsgsize >= 0 && size_ - 1 > maxmsgsize) {
         decoding_error ();
         return false;
     }
 
+    //  If the flags and the whole message body are already in the receive
+    //  buffer, the message can refer to the buffer instead of copying the
+    //  data out of it. in_progress is a 0-byte message at this point,
+    //  so it can be treated as uninitialised.
+    unsigned char *data;
+    if (sliceable (&data) >= size_) {
+        slice (in_progress, data + 1, (size_t) size_ - 1);
+        in_progress.set_flags (data [0]);
+        skip_step ((size_t) size_, &decoder_t::message_ready);
+        return true;
+    }
+
     //  in_progress is initialised at this point so in theory we should
     //  close it before calling xs_msg_init_size, however, it's a 0-byte
     //  message and thus we can treat it as uninitialised...
-    int rc;
-    if (maxmsgsize >= 0 && (uint64_t) (size - 1) > maxmsgsize) {
-        rc = -1;
-        errno = ENOMEM;
-    }
-    else
-        rc = in_progress.init_size (size - 1);
+    int rc = in_progress.init_size ((size_t) size_ - 1, pool, pool_tid);
     if (rc != 0 && errno == ENOMEM) {
         rc = in_progress.init ();
         errno_assert (rc == 0);
@@ -138,9 +203,9 @@ bool xs::decoder_t::message_ready ()
 {
     //  Message is completely read. Push it further and start reading
     //  new message. (in_progress is a 0-byte message after this point.)
-    if (unlikely (!session))
+    if (unlikely (!msg_sink))
         return false;
-    int rc = session->write (&in_progress);
+    int rc = msg_sink->write (&in_progress);
     if (unlikely (rc != 0)) {
         if (errno != EAGAIN)
             decoding_error ();
@@ -150,3 +215,76 @@ bool xs::decoder_t::message_ready ()
     next_step (tmpbuf, 1, &decoder_t::one_byte_size_ready);
     return true;
 }
+
+bool xs::decoder_t::batch_count_ready ()
+{
+    //  Empty batch frame means that the peer is able to decode batch frames.
+    batch_count = tmpbuf [0];
+    if (!batch_count) {
+        if (encoder)
+            encoder->peer_batching ();
+        next_step (tmpbuf, 1, &decoder_t::one_byte_size_ready);
+        return true;
+    }
+
+    next_step (batch_sizes, batch_count, &decoder_t::batch_sizes_ready);
+    return true;
+}
+
+bool xs::decoder_t::batch_sizes_ready ()
+{
+    //  Check the sizes and read all the message bodies in one go.
+    size_t size = 0;
+    for (size_t i = 0; i != batch_count; i++) {
+        if (maxmsgsize >= 0 && (uint64_t) batch_sizes [i] > maxmsgsize) {
+            decoding_error ();
+            return false;
+        }
+        size += batch_sizes [i];
+    }
+    if (2 + batch_count + size > max_batch_frame_size) {
+        decoding_error ();
+        return false;
+    }
+
+    batch_index = 0;
+    batch_pos = 0;
+    next_step (batch_data, size, &decoder_t::batch_ready);
+    return true;
+}
+
+bool xs::decoder_t::batch_ready ()
+{
+    //  Push all the messages in the batch further. If a message can't be
+    //  pushed, it stays in in_progress till the next attempt.
+    if (unlikely (!msg_sink))
+        return false;
+    while (batch_index != batch_count) {
+        size_t size = batch_sizes [batch_index];
+        if (!batch_built) {
+            int rc = in_progress.init_size (size, pool, pool_tid);
+            if (rc != 0 && errno == ENOMEM) {
+                rc = in_progress.init ();
+                errno_assert (rc == 0);
+                decoding_error ();
+                return false;
+            }
+            errno_assert (rc == 0);
+            memcpy (in_progress.data (), batch_data + batch_pos,
+                in_progress.size ());
+            batch_built = true;
+        }
+        int rc = msg_sink->write (&in_progress);
+        if (unlikely (rc != 0)) {
+            if (errno != EAGAIN)
+                decoding_error ();
+            return false;
+        }
+        batch_built = false;
+        batch_pos += size;
+        batch_index++;
+    }
+
+    next_step (tmpbuf, 1, &decoder_t::one_byte_size_ready);
+    return true;
+}
@@ -29,12 +29,16 @@
 
 #include "err.hpp"
 #include "msg.hpp"
+#include "config.hpp"
 #include "stdint.hpp"
+#include "i_msg_sink.hpp"
+#include "memory_budget.hpp"
 
 namespace xs
 {
 
-    class session_base_t;
+    class msg_pool_t;
+    class encoder_t;
 
     //  Helper base class for decoders that know the amount of data to read
     //  in advance at any moment. Knowing the amount in advance is a property
@@ -46,26 +50,75 @@ namespace xs
     //
     //  This class implements the state machine that parses the incoming buffer.
     //  Derived class should implement individual state machine actions.
+    //
+    //  Derived class should also implement decode_fast function, which is
+    //  called with the data not yet processed. It can decode complete
+    //  messages straight from the data, bypassing the state machine, and
+    //  return the number of bytes consumed. Finally, it should implement
+    //  message_boundary function, which returns true if the decoder is in
+    //  between two messages.
+    //
+    //  The size of the buffer adapts to the amount of data available. If the
+    //  buffer is filled up completely, it is enlarged up to max_bufsize.
+    //  If only a fraction of the buffer is used repeatedly, it shrinks back
+    //  towards the original size. Once there are no more data to read and
+    //  no message is being decoded, enlarged buffer is released altogether
+    //  so that idle connections don't hold the memory.
+    //
+    //  If memory budget is set, the memory needed to enlarge the buffer beyond
+    //  its original size is reserved from the budget. If the budget is
+    //  exhausted, the buffer is not enlarged.
+    //
+    //  In zero-copy mode the buffer is a reference-counted message and
+    //  the derived class can turn parts of it into messages using slice
+    //  function. Once there are such messages alive, a new buffer is
+    //  allocated for the next read rather than overwriting the old one.
 
     template <typename T> class decoder_base_t
     {
     public:
 
-        inline decoder_base_t (size_t bufsize_) :
+        inline decoder_base_t (size_t bufsize_, size_t max_bufsize_,
+              bool zero_copy_ = false) :
             read_pos (NULL),
             to_read (0),
             next (NULL),
-            bufsize (bufsize_)
+            bufsize (bufsize_),
+            buf (NULL),
+            min_bufsize (bufsize_),
+            max_bufsize (std::max (bufsize_, max_bufsize_)),
+            new_bufsize (bufsize_),
+            underruns (0),
+            zero_copy (zero_copy_),
+            budget (NULL),
+            in_pos (NULL),
+            in_size (0)
         {
-            buf = (unsigned char*) malloc (bufsize_);
-            alloc_assert (buf);
+            //  The buffer is allocated only when it's needed for the first
+            //  time. That way it's allocated by the I/O thread the engine
+            //  runs in rather than by the one that has created the engine,
+            //  which makes a difference on NUMA systems.
+            int rc = buf_msg.init ();
+            errno_assert (rc == 0);
         }
 
         //  The destructor doesn't have to be virtual. It is mad virtual
         //  just to keep ICC and code checking tools from complaining.
         inline virtual ~decoder_base_t ()
         {
-            free (buf);
+            if (budget)
+                budget->release (bufsize - min_bufsize);
+            if (!zero_copy)
+                free (buf);
+            int rc = buf_msg.close ();
+            errno_assert (rc == 0);
+        }
+
+        //  Sets the budget to reserve the memory for the buffer from.
+        //  Has to be called before the buffer is first used.
+        inline void set_memory_budget (memory_budget_t *budget_)
+        {
+            budget = budget_;
         }
 
         //  Returns a buffer to be filled with binary data.
@@ -85,10 +138,64 @@ namespace xs
                 return;
             }
 
+            //  Account for the change of the buffer size in the budget.
+            if (budget && new_bufsize > bufsize &&
+                  !budget->reserve (new_bufsize - bufsize))
+                new_bufsize = bufsize;
+            if (budget && new_bufsize < bufsize)
+                budget->release (bufsize - new_bufsize);
+
+            //  The buffer is not in use at this point, so it can be resized
+            //  if needed. Its content doesn't have to be preserved unless
+            //  there are messages referring to it.
+            if (zero_copy) {
+                if (new_bufsize != bufsize || !buf || buf_msg.is_shared ()) {
+                    bufsize = new_bufsize;
+                    int rc = buf_msg.close ();
+                    errno_assert (rc == 0);
+                    rc = buf_msg.init_size (bufsize);
+                    errno_assert (rc == 0);
+                    xs_assert (!buf_msg.is_vsm ());
+                    buf = (unsigned char*) buf_msg.data ();
+                }
+            }
+            else if (new_bufsize != bufsize || !buf) {
+                free (buf);
+                bufsize = new_bufsize;
+                buf = (unsigned char*) malloc (bufsize);
+                alloc_assert (buf);
+            }
+
             *data_ = buf;
             *size_ = bufsize;
         }
 
+        //  To be called when there are no more data to read at the moment
+        //  and all the data in the buffer were processed. If the buffer was
+        //  enlarged and no message is being decoded, it is deallocated. Next
+        //  call to get_buffer allocates a buffer of the original size.
+        inline void release_buffer ()
+        {
+            if (!buf || bufsize == min_bufsize ||
+                  !static_cast <T*> (this)->message_boundary ())
+                return;
+
+            if (budget)
+                budget->release (bufsize - min_bufsize);
+            if (zero_copy) {
+                int rc = buf_msg.close ();
+                errno_assert (rc == 0);
+                rc = buf_msg.init ();
+                errno_assert (rc == 0);
+            }
+            else
+                free (buf);
+            buf = NULL;
+            bufsize = min_bufsize;
+            new_bufsize = min_bufsize;
+            underruns = 0;
+        }
+
         //  Processes the data in the buffer previously allocated using
         //  get_buffer function. size_ argument specifies nemuber of bytes
         //  actually filled into the buffer. Function returns number of
@@ -105,6 +212,7 @@ namespace xs
             if (data_ == read_pos) {
                 read_pos += size_;
                 to_read -= size_;
+                in_size = 0;
 
                 while (!to_read) {
                     if (!(static_cast <T*> (this)->*next) ()) {
@@ -116,12 +224,37 @@ namespace xs
                 return size_;
             }
 
+            //  Adjust the buffer size for the next read. If the whole buffer
+            //  was filled in, there are likely more data available, so let's
+            //  double the size. If only a small part of the buffer was used
+            //  several times in a row, halve the size.
+            if (data_ == buf) {
+                if (size_ == bufsize) {
+                    new_bufsize = std::min (bufsize * 2, max_bufsize);
+                    underruns = 0;
+                }
+                else if (size_ < bufsize / 4 && bufsize > min_bufsize) {
+                    if (++underruns == max_underruns) {
+                        new_bufsize = std::max (bufsize / 2, min_bufsize);
+                        underruns = 0;
+                    }
+                }
+                else
+                    underruns = 0;
+            }
+
+            //  Data can be sliced only if they are in the receive buffer.
+            bool sliceable = zero_copy && buf && data_ >= buf &&
+                data_ + size_ <= buf + bufsize;
+
             size_t pos = 0;
             while (true) {
 
                 //  Try to get more space in the message to fill in.
                 //  If none is available, return.
                 while (!to_read) {
+                    in_pos = data_ + pos;
+                    in_size = sliceable ? size_ - pos : 0;
                     if (!(static_cast <T*> (this)->*next) ()) {
                         if (unlikely (!(static_cast <T*> (this)->next)))
                             return (size_t) -1;
@@ -133,10 +266,25 @@ namespace xs
                 if (pos == size_)
                     return pos;
 
-                //  Copy the data from buffer to the message.
+                //  Try the fast path first.
+                in_pos = data_ + pos;
+                in_size = sliceable ? size_ - pos : 0;
+                size_t decoded = static_cast <T*> (this)->decode_fast (
+                    data_ + pos, size_ - pos);
+                if (decoded) {
+                    pos += decoded;
+                    if (unlikely (!(static_cast <T*> (this)->next)))
+                        return (size_t) -1;
+                    continue;
+                }
+
+                //  Copy the data from buffer to the message. If the data
+                //  were sliced there's nothing to copy.
                 size_t to_copy = std::min (to_read, size_ - pos);
-                memcpy (read_pos, data_ + pos, to_copy);
-                read_pos += to_copy;
+                if (read_pos) {
+                    memcpy (read_pos, data_ + pos, to_copy);
+                    read_pos += to_copy;
+                }
                 pos += to_copy;
                 to_read -= to_copy;
             }
@@ -158,6 +306,39 @@ namespace xs
             next = next_;
         }
 
+        //  Returns true if next_ is the next state machine action.
+        inline bool next_is (step_t next_)
+        {
+            return next == next_;
+        }
+
+        //  Returns number of bytes following the current position in
+        //  the data being processed that can be sliced, i.e. turned into
+        //  messages without copying. The bytes are stored to data_.
+        inline size_t sliceable (unsigned char **data_)
+        {
+            *data_ = in_pos;
+            return in_size;
+        }
+
+        //  Initialises msg_ as a view of size_ sliceable bytes at data_.
+        inline void slice (msg_t &msg_, unsigned char *data_, size_t size_)
+        {
+            xs_assert (data_ >= in_pos && data_ + size_ <= in_pos + in_size);
+            int rc = msg_.init_slice (buf_msg, data_, size_);
+            errno_assert (rc == 0);
+        }
+
+        //  Skips to_skip_ sliceable bytes and schedules next state machine
+        //  action.
+        inline void skip_step (size_t to_skip_, step_t next_)
+        {
+            xs_assert (to_skip_ <= in_size);
+            read_pos = NULL;
+            to_read = to_skip_;
+            next = next_;
+        }
+
         //  This function should be called from the derived class to
         //  abort decoder state machine.
         inline void decoding_error ()
@@ -167,7 +348,8 @@ namespace xs
 
     private:
 
-        //  Where to store the read data.
+        //  Where to store the read data. NULL means that the data are
+        //  skipped rather than copied.
         unsigned char *read_pos;
 
         //  How much data to read before taking next step.
@@ -182,33 +364,99 @@ namespace xs
         size_t bufsize;
         unsigned char *buf;
 
+        //  Limits for the buffer size and the size the buffer should be
+        //  resized to when it's not used.
+        size_t min_bufsize;
+        size_t max_bufsize;
+        size_t new_bufsize;
+
+        //  Number of subsequent reads that used only a small portion of
+        //  the buffer. The buffer is shrunk once max_underruns is reached.
+        enum {max_underruns = 16};
+        int underruns;
+
+        //  If true, the buffer is held by buf_msg and parts of it can be
+        //  handed out as messages.
+        bool zero_copy;
+        msg_t buf_msg;
+
+        //  Budget the memory beyond min_bufsize is reserved from.
+        memory_budget_t *budget;
+
+        //  Position and size of the data not yet processed, valid while
+        //  a state machine action is being executed. The size is zero if
+        //  the data cannot be sliced.
+        unsigned char *in_pos;
+        size_t in_size;
+
         decoder_base_t (const decoder_base_t&);
         const decoder_base_t &operator = (const decoder_base_t&);
     };
 
     //  Decoder for Crossroads framing protocol.
-    //  Converts data batches into messages.
+    //  Converts data batches into messages. Batch frames (see encoder_t)
+    //  are always accepted. Once the peer announces it is able to decode
+    //  them, the encoder is notified so that it can start sending them.
 
     class decoder_t : public decoder_base_t <decoder_t>
     {
     public:
 
-        decoder_t (size_t bufsize_, uint64_t maxmsgsize_);
+        decoder_t (size_t bufsize_, size_t max_bufsize_, uint64_t maxmsgsize_,
+            bool zero_copy_ = false);
         ~decoder_t ();
 
-        void set_session (xs::session_base_t *session_);
+        //  Sets the object to pass the decoded messages to and the pool
+        //  to allocate them from. NULL pool means no pooling. tid_ is the
+        //  thread slot of the thread the decoder runs in.
+        void set_msg_sink (xs::i_msg_sink *msg_sink_,
+            xs::msg_pool_t *pool_ = NULL, uint32_t tid_ = 0);
+
+        //  Sets the encoder to notify when the peer announces it is able
+        //  to decode batch frames.
+        void set_encoder (xs::encoder_t *encoder_);
 
     private:
 
+        friend class decoder_base_t <decoder_t>;
+
+        //  Decodes complete small messages straight from data_, which is
+        //  size_ bytes long. Returns number of bytes consumed.
+        size_t decode_fast (unsigned char *data_, size_t size_);
+
+        //  Returns true if no message is being decoded at the moment.
+        bool message_boundary ();
+
         bool one_byte_size_ready ();
         bool eight_byte_size_ready ();
+        bool size_ready (uint64_t size_);
         bool flags_ready ();
         bool message_ready ();
+        bool batch_count_ready ();
+        bool batch_sizes_ready ();
+        bool batch_ready ();
+
+        xs::i_msg_sink *msg_sink;
+        xs::encoder_t *encoder;
+
+        //  Pool to allocate the messages from. NULL if pooling is disabled.
+        //  pool_tid is the thread slot to allocate the messages for.
+        xs::msg_pool_t *pool;
+        uint32_t pool_tid;
 
-        xs::session_base_t *session;
         unsigned char tmpbuf [8];
         msg_t in_progress;
 
+        //  Batch frame being decoded. batch_index is the index of the next
+        //  message to push further, batch_pos is the position of its body.
+        //  If batch_built is true, the message is already in in_progress.
+        size_t batch_count;
+        unsigned char batch_sizes [255];
+        unsigned char batch_data [max_batch_frame_size];
+        size_t batch_index;
+        size_t batch_pos;
+        bool batch_built;
+
         uint64_t maxmsgsize;
 
         decoder_t (const decoder_t&);
@@ -128,7 +128,7 @@ void xs::devpoll_t::reset_pollout (handle_t handle_)
 
 void xs::devpoll_t::xstart ()
 {
-    worker.start (worker_routine, this);
+    worker.start (worker_routine, this, cpus);
 }
 
 void xs::devpoll_t::xstop ()
@@ -159,7 +159,9 @@ void xs::devpoll_t::loop ()
         poll_req.dp_nfds = max_io_events;
 #endif
         poll_req.dp_timeout = timeout ? timeout : -1;
+        before_wait ();
         int n = ioctl (devpoll_fd, DP_POLL, &poll_req);
+        after_wait (n);
         if (n == -1 && errno == EINTR)
             continue;
         errno_assert (n != -1);
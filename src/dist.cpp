@@ -29,7 +29,8 @@ xs::dist_t::dist_t () :
     matching (0),
     active (0),
     eligible (0),
-    more (false)
+    more (false),
+    dropped (0)
 {
 }
 
@@ -159,7 +160,7 @@ void xs::dist_t::distribute (msg_t *msg_, int flags_)
 
     if (msg_->is_vsm ()) {
         for (pipes_t::size_type i = 0; i < matching; ++i)
-            if (!write (pipes [i], msg_))
+            if (!write (pipes [i], msg_, flags_))
                 --i;
         int rc = msg_->close();
         errno_assert (rc == 0);
@@ -175,7 +176,7 @@ void xs::dist_t::distribute (msg_t *msg_, int flags_)
     //  Push copy of the message to each matching pipe.
     int failed = 0;
     for (pipes_t::size_type i = 0; i < matching; ++i)
-        if (!write (pipes [i], msg_)) {
+        if (!write (pipes [i], msg_, flags_)) {
             --i;
             ++failed;
         }
@@ -193,9 +194,18 @@ bool xs::dist_t::has_out ()
     return true;
 }
 
-bool xs::dist_t::write (pipe_t *pipe_, msg_t *msg_)
+void xs::dist_t::flush ()
+{
+    //  Pipes that reached HWM in the middle of a batch may still hold
+    //  unflushed messages, so we have to flush all of them.
+    for (pipes_t::size_type i = 0; i != pipes.size (); ++i)
+        pipes [i]->flush ();
+}
+
+bool xs::dist_t::write (pipe_t *pipe_, msg_t *msg_, int flags_)
 {
     if (!pipe_->write (msg_)) {
+        dropped++;
         pipes.swap (pipes.index (pipe_), matching - 1);
         matching--;
         pipes.swap (pipes.index (pipe_), active - 1);
@@ -204,8 +214,12 @@ bool xs::dist_t::write (pipe_t *pipe_, msg_t *msg_)
         eligible--;
         return false;
     }
-    if (!(msg_->flags () & msg_t::more))
+    if (!(msg_->flags () & msg_t::more) && !(flags_ & send_noflush))
         pipe_->flush ();
     return true;
 }
 
+uint64_t xs::dist_t::get_dropped ()
+{
+    return dropped;
+}
@@ -65,11 +65,18 @@ namespace xs
 
         bool has_out ();
 
+        //  Flushes all the messages written with send_noflush flag.
+        void flush ();
+
+        //  Returns the number of messages dropped because the pipe they
+        //  were sent to had reached the high watermark.
+        uint64_t get_dropped ();
+
     private:
 
         //  Write the message to the pipe. Make the pipe inactive if writing
         //  fails. In such a case false is returned.
-        bool write (xs::pipe_t *pipe_, xs::msg_t *msg_);
+        bool write (xs::pipe_t *pipe_, xs::msg_t *msg_, int flags_);
 
         //  Put the message to all active pipes.
         void distribute (xs::msg_t *msg_, int flags_);
@@ -96,6 +103,9 @@ namespace xs
         //  True if last we are in the middle of a multipart message.
         bool more;
 
+        //  Number of messages dropped so far.
+        uint64_t dropped;
+
         dist_t (const dist_t&);
         const dist_t &operator = (const dist_t&);
     };
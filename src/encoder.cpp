@@ -21,30 +21,48 @@
 */
 
 #include "encoder.hpp"
-#include "session_base.hpp"
 #include "likely.hpp"
 #include "wire.hpp"
 
-xs::encoder_t::encoder_t (size_t bufsize_) :
+xs::encoder_t::encoder_t (size_t bufsize_, bool batching_) :
     encoder_base_t <encoder_t> (bufsize_),
-    session (NULL)
+    msg_source (NULL),
+    batching (batching_),
+    batching_peer (false),
+    has_pending (false)
 {
     int rc = in_progress.init ();
     errno_assert (rc == 0);
 
-    //  Write 0 bytes to the batch and go to message_ready state.
-    next_step (NULL, 0, &encoder_t::message_ready, true);
+    //  If batching is enabled, let the peer know by sending an empty batch
+    //  frame. Then go to message_ready state.
+    if (batching) {
+        tmpbuf [0] = 0;
+        tmpbuf [1] = 0;
+        next_step (tmpbuf, 2, &encoder_t::message_ready, true);
+    }
+    else
+        next_step (NULL, 0, &encoder_t::message_ready, true);
 }
 
 xs::encoder_t::~encoder_t ()
 {
     int rc = in_progress.close ();
     errno_assert (rc == 0);
+    if (has_pending) {
+        rc = pending.close ();
+        errno_assert (rc == 0);
+    }
+}
+
+void xs::encoder_t::set_msg_source (i_msg_source *msg_source_)
+{
+    msg_source = msg_source_;
 }
 
-void xs::encoder_t::set_session (session_base_t *session_)
+void xs::encoder_t::peer_batching ()
 {
-    session = session_;
+    batching_peer = true;
 }
 
 bool xs::encoder_t::size_ready ()
@@ -57,27 +75,58 @@ bool xs::encoder_t::size_ready ()
 
 bool xs::encoder_t::message_ready ()
 {
-    //  Destroy content of the old message.
-    int rc = in_progress.close ();
-    errno_assert (rc == 0);
+    //  Destroy content of the old message. If its body is still referenced
+    //  from the data being written to the network, it'll be kept alive
+    //  till the write is done.
+    drop (&in_progress);
 
     //  Read new message. If there is none, return false.
     //  Note that new state is set only if write is successful. That way
     //  unsuccessful write will cause retry on the next state machine
     //  invocation.
-    if (unlikely (!session)) {
-        rc = in_progress.init ();
-        errno_assert (rc == 0);
-        return false;
-    }
-    rc = session->read (&in_progress);
-    if (unlikely (rc != 0)) {
-        errno_assert (errno == EAGAIN);
-        rc = in_progress.init ();
-        errno_assert (rc == 0);
+    if (!read (&in_progress))
         return false;
+
+    //  Small messages are sent in batch frames if possible.
+    if (batching && batching_peer && batch ())
+        return true;
+
+    write_header ();
+    return true;
+}
+
+size_t xs::encoder_t::encode_fast (unsigned char *buffer_, size_t size_)
+{
+    //  The fast path applies only in between messages. Batch frames are
+    //  left to the state machine.
+    if (!next_is (&encoder_t::message_ready) || (batching && batching_peer))
+        return 0;
+
+    size_t pos = 0;
+    while (true) {
+        drop (&in_progress);
+        if (!read (&in_progress))
+            return pos;
+
+        //  Messages that need the long size field or that don't fit into
+        //  the rest of the buffer are passed to the state machine.
+        size_t size = in_progress.size () + 1;
+        if (size >= 255 || pos + 1 + size > size_) {
+            write_header ();
+            return pos;
+        }
+
+        //  Write the whole frame in a single go.
+        unsigned char *frame = buffer_ + pos;
+        frame [0] = (unsigned char) size;
+        frame [1] = (in_progress.flags () & ~msg_t::shared);
+        memcpy (frame + 2, in_progress.data (), size - 1);
+        pos += 1 + size;
     }
+}
 
+void xs::encoder_t::write_header ()
+{
     //  Get the message size.
     size_t size = in_progress.size ();
 
@@ -100,5 +149,94 @@ bool xs::encoder_t::message_ready ()
         next_step (tmpbuf, 10, &encoder_t::size_ready,
             !(in_progress.flags () & msg_t::more));
     }
+}
+
+bool xs::encoder_t::read (msg_t *msg_)
+{
+    //  The message left over from the last batch frame goes first.
+    if (has_pending) {
+        *msg_ = pending;
+        has_pending = false;
+        return true;
+    }
+
+    if (unlikely (!msg_source)) {
+        int rc = msg_->init ();
+        errno_assert (rc == 0);
+        return false;
+    }
+    int rc = msg_source->read (msg_);
+    if (unlikely (rc != 0)) {
+        errno_assert (errno == EAGAIN);
+        rc = msg_->init ();
+        errno_assert (rc == 0);
+        return false;
+    }
+    return true;
+}
+
+//  Returns true if msg_ can be added to a batch frame already holding count_
+//  messages with body_size_ bytes of data. Only single-part messages with
+//  no flags can be batched.
+static bool fits (xs::msg_t &msg_, size_t count_, size_t body_size_)
+{
+    return !(msg_.flags () & ~xs::msg_t::shared) && count_ < 255 &&
+        2 + count_ + 1 + body_size_ + msg_.size () <=
+        xs::max_batch_frame_size;
+}
+
+bool xs::encoder_t::batch ()
+{
+    //  Batch frame holding a single message would be longer than
+    //  the ordinary frame, so there has to be one more message to batch
+    //  with. If it can't be batched, it will be sent next.
+    if (!fits (in_progress, 0, 0))
+        return false;
+    msg_t msg;
+    if (!read (&msg))
+        return false;
+    if (!fits (msg, 1, in_progress.size ())) {
+        pending = msg;
+        has_pending = true;
+        return false;
+    }
+
+    //  The table of sizes is stored at the beginning of the buffer till
+    //  the number of messages is known.
+    unsigned char *sizes = batchbuf + 2;
+    unsigned char *bodies = batchbuf + max_batch_frame_size;
+    size_t count = 1;
+    size_t body_size = in_progress.size ();
+    sizes [0] = (unsigned char) body_size;
+    memcpy (bodies, in_progress.data (), body_size);
+    int rc = in_progress.close ();
+    errno_assert (rc == 0);
+    rc = in_progress.init ();
+    errno_assert (rc == 0);
+
+    //  Add subsequent messages while they fit into the frame.
+    while (true) {
+        sizes [count++] = (unsigned char) msg.size ();
+        memcpy (bodies + body_size, msg.data (), msg.size ());
+        body_size += msg.size ();
+        rc = msg.close ();
+        errno_assert (rc == 0);
+
+        if (!read (&msg))
+            break;
+        if (!fits (msg, count, body_size)) {
+            pending = msg;
+            has_pending = true;
+            break;
+        }
+    }
+
+    //  Move the table of sizes right in front of the bodies and prepend
+    //  the header.
+    unsigned char *frame = bodies - count - 2;
+    memmove (frame + 2, sizes, count);
+    frame [0] = 0;
+    frame [1] = (unsigned char) count;
+    next_step (frame, 2 + count + body_size, &encoder_t::message_ready, true);
     return true;
 }
@@ -22,38 +22,54 @@
 #ifndef __XS_ENCODER_HPP_INCLUDED__
 #define __XS_ENCODER_HPP_INCLUDED__
 
+#include "platform.hpp"
+
 #include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <vector>
+
+#if !defined XS_HAVE_WINDOWS
+#include <sys/uio.h>
+#endif
 
 #include "err.hpp"
 #include "msg.hpp"
+#include "config.hpp"
+#include "i_msg_source.hpp"
 
 namespace xs
 {
 
-    class session_base_t;
-
     //  Helper base class for encoders. It implements the state machine that
     //  fills the outgoing buffer. Derived classes should implement individual
     //  state machine actions.
+    //
+    //  Derived classes should also implement encode_fast function, which is
+    //  called when the state machine has nothing to write. It can encode
+    //  complete messages directly to the supplied buffer, bypassing the state
+    //  machine, and return the number of bytes written. Alternatively, it
+    //  can leave the message to the state machine by scheduling next step.
 
     template <typename T> class encoder_base_t
     {
     public:
 
         inline encoder_base_t (size_t bufsize_) :
-            bufsize (bufsize_)
+            referenced (false),
+            bufsize (bufsize_),
+            buf (NULL)
         {
-            buf = (unsigned char*) malloc (bufsize_);
-            alloc_assert (buf);
+            //  The buffer is allocated when it's used for the first time,
+            //  i.e. by the I/O thread the engine runs in.
         }
 
         //  The destructor doesn't have to be virtual. It is made virtual
         //  just to keep ICC and code checking tools from complaining.
         inline virtual ~encoder_base_t ()
         {
+            release ();
             free (buf);
         }
 
@@ -70,6 +86,8 @@ namespace xs
         inline bool get_data (unsigned char **data_, size_t *size_,
             int *offset_ = NULL)
         {
+            if (!*data_ && !buf)
+                alloc_buffer ();
             unsigned char *buffer = !*data_ ? buf : *data_;
             size_t buffersize = !*data_ ? bufsize : *size_;
 
@@ -79,11 +97,17 @@ namespace xs
 
             while (true) {
 
-                //  If there are no more data to return, run the state machine.
+                //  If there are no more data to return, try the fast path
+                //  and then run the state machine. The fast path is not used
+                //  when the caller needs to know where the messages begin.
                 //  If there are still no data, return what we already have
                 //  in the buffer.
                 if (!to_write) {
-                    if (!(static_cast <T*> (this)->*next) ()) {
+                    if (!offset_)
+                        pos += static_cast <T*> (this)->encode_fast (
+                            buffer + pos, buffersize - pos);
+                    if (!to_write &&
+                          !(static_cast <T*> (this)->*next) ()) {
                         *data_ = buffer;
                         *size_ = pos;
                         return false;
@@ -130,6 +154,106 @@ namespace xs
             }
         }
 
+#if !defined XS_HAVE_WINDOWS
+        //  The function fills in the array of I/O vectors with a batch of
+        //  data. On input, iovcnt_ is the size of the array, on output it is
+        //  the number of vectors actually filled in. size_ is set to the
+        //  overall number of bytes in the batch. Pieces of data shorter than
+        //  out_gather_threshold are copied to the encoder's buffer, longer
+        //  ones are referenced directly and thus never copied. The data
+        //  returned remain valid till the function is invoked next time.
+        //  The return value has the same meaning as with get_data.
+        inline bool get_iovecs (iovec *iov_, int *iovcnt_, size_t *size_)
+        {
+            //  The batch returned by the previous call was already written.
+            //  The messages it was referring to can be deallocated now.
+            release ();
+
+            if (!buf)
+                alloc_buffer ();
+
+            int iovcnt = 0;
+            size_t size = 0;
+            size_t pos = 0;
+
+            //  True if the last vector points to the encoder's buffer.
+            bool in_buffer = false;
+
+            while (true) {
+
+                //  Don't make the batch larger than the buffer would be, so
+                //  that only limited amount of data is in flight at any time.
+                if (size >= bufsize)
+                    break;
+
+                //  If there are no more data to return, try the fast path
+                //  and then run the state machine. If there are still no
+                //  data, return what we already have.
+                if (!to_write) {
+                    if (in_buffer || iovcnt != *iovcnt_) {
+                        size_t n = static_cast <T*> (this)->encode_fast (
+                            buf + pos, bufsize - pos);
+                        if (n) {
+                            if (!in_buffer) {
+                                iov_ [iovcnt].iov_base = buf + pos;
+                                iov_ [iovcnt].iov_len = 0;
+                                iovcnt++;
+                                in_buffer = true;
+                            }
+                            iov_ [iovcnt - 1].iov_len += n;
+                            pos += n;
+                            size += n;
+                        }
+                    }
+                    if (!to_write &&
+                          !(static_cast <T*> (this)->*next) ()) {
+                        *iovcnt_ = iovcnt;
+                        *size_ = size;
+                        return false;
+                    }
+                    beginning = false;
+                }
+
+                //  Large pieces of data are referenced rather than copied.
+                if (to_write >= out_gather_threshold) {
+                    if (iovcnt == *iovcnt_)
+                        break;
+                    iov_ [iovcnt].iov_base = write_pos;
+                    iov_ [iovcnt].iov_len = to_write;
+                    iovcnt++;
+                    size += to_write;
+                    write_pos += to_write;
+                    to_write = 0;
+                    referenced = true;
+                    in_buffer = false;
+                    continue;
+                }
+
+                //  Copy the data to the buffer. Contiguous data in the buffer
+                //  are described by a single vector.
+                if (!in_buffer) {
+                    if (iovcnt == *iovcnt_)
+                        break;
+                    iov_ [iovcnt].iov_base = buf + pos;
+                    iov_ [iovcnt].iov_len = 0;
+                    iovcnt++;
+                    in_buffer = true;
+                }
+                size_t to_copy = std::min (to_write, bufsize - pos);
+                memcpy (buf + pos, write_pos, to_copy);
+                iov_ [iovcnt - 1].iov_len += to_copy;
+                pos += to_copy;
+                size += to_copy;
+                write_pos += to_copy;
+                to_write -= to_copy;
+            }
+
+            *iovcnt_ = iovcnt;
+            *size_ = size;
+            return true;
+        }
+#endif
+
     protected:
 
         //  Prototype of state machine action.
@@ -147,8 +271,46 @@ namespace xs
             beginning = beginning_;
         }
 
+        //  Returns true if next_ is the next state machine action.
+        inline bool next_is (step_t next_)
+        {
+            return next == next_;
+        }
+
+        //  Derived class should use this function to deallocate the message
+        //  whose data were passed to next_step. If the data are still
+        //  referenced from the I/O vectors returned by get_iovecs, the message
+        //  is kept alive till the vectors are written. The message is left
+        //  in uninitialised state.
+        inline void drop (msg_t *msg_)
+        {
+            if (referenced) {
+                retained.push_back (*msg_);
+                referenced = false;
+                return;
+            }
+            int rc = msg_->close ();
+            errno_assert (rc == 0);
+        }
+
     private:
 
+        //  Deallocates the messages retained by drop.
+        inline void release ()
+        {
+            for (retained_t::size_type i = 0; i != retained.size (); i++) {
+                int rc = retained [i].close ();
+                errno_assert (rc == 0);
+            }
+            retained.clear ();
+        }
+
+        inline void alloc_buffer ()
+        {
+            buf = (unsigned char*) malloc (bufsize);
+            alloc_assert (buf);
+        }
+
         //  Where to get the data to write from.
         unsigned char *write_pos;
 
@@ -162,6 +324,14 @@ namespace xs
         //  If true, first byte of the message is being written.
         bool beginning;
 
+        //  If true, the data passed to next_step are referenced from the
+        //  I/O vectors and can't be deallocated till the vectors are written.
+        bool referenced;
+
+        //  Messages referenced from the I/O vectors being written.
+        typedef std::vector <msg_t> retained_t;
+        retained_t retained;
+
         //  The buffer for encoded data.
         size_t bufsize;
         unsigned char *buf;
@@ -172,25 +342,65 @@ namespace xs
 
     //  Encoder for Crossroads framing protocol.
     //  Converts messages into data batches.
+    //
+    //  If batching is enabled, the encoder announces it to the peer by
+    //  sending an empty batch frame first. Once the peer announces the same,
+    //  consecutive small single-part messages are packed into batch frames:
+    //  a zero byte, number of messages, a byte holding the size of each
+    //  message and the bodies of the messages.
 
     class encoder_t : public encoder_base_t <encoder_t>
     {
     public:
 
-        encoder_t (size_t bufsize_);
+        encoder_t (size_t bufsize_, bool batching_ = false);
         ~encoder_t ();
 
-        void set_session (xs::session_base_t *session_);
+        //  Sets the object to read the messages to encode from.
+        void set_msg_source (xs::i_msg_source *msg_source_);
+
+        //  Called when the peer announces it is able to decode batch frames.
+        void peer_batching ();
 
     private:
 
+        friend class encoder_base_t <encoder_t>;
+
         bool size_ready ();
         bool message_ready ();
 
-        xs::session_base_t *session;
+        //  Encodes small messages straight into buffer_, which is size_
+        //  bytes long. Returns number of bytes written.
+        size_t encode_fast (unsigned char *buffer_, size_t size_);
+
+        //  Schedules writing of the header of in_progress.
+        void write_header ();
+
+        //  Reads next message to encode. Returns false if there's none.
+        bool read (msg_t *msg_);
+
+        //  Packs in_progress and the messages that follow into a batch
+        //  frame. Returns false if no batch frame was created.
+        bool batch ();
+
+        xs::i_msg_source *msg_source;
         msg_t in_progress;
         unsigned char tmpbuf [10];
 
+        //  True if batching is enabled locally, respectively by the peer.
+        bool batching;
+        bool batching_peer;
+
+        //  Message read from the source that didn't fit into the last
+        //  batch frame. It is to be encoded next.
+        msg_t pending;
+        bool has_pending;
+
+        //  Batch frames are assembled here. Bodies of the messages are
+        //  stored in the second half, the header and the table of sizes
+        //  are placed right in front of them.
+        unsigned char batchbuf [2 * max_batch_frame_size];
+
         encoder_t (const encoder_t&);
         const encoder_t &operator = (const encoder_t&);
     };
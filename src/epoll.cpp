@@ -121,7 +121,7 @@ void xs::epoll_t::reset_pollout (handle_t handle_)
 
 void xs::epoll_t::xstart ()
 {
-    worker.start (worker_routine, this);
+    worker.start (worker_routine, this, cpus);
 }
 
 void xs::epoll_t::xstop ()
@@ -139,8 +139,10 @@ void xs::epoll_t::loop ()
         int timeout = (int) execute_timers ();
 
         //  Wait for events.
+        before_wait ();
         int n = epoll_wait (epoll_fd, &ev_buf [0], max_io_events,
             timeout ? timeout : -1);
+        after_wait (n);
         if (n == -1 && errno == EINTR)
             continue;
         errno_assert (n != -1);
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "histogram.hpp"
+#include "cpu_relax.hpp"
+
+double xs::histogram_t::ns_per_tick = 1.0;
+
+//  0 if the calibration hasn't been done yet, 1 if it is in progress,
+//  2 if ns_per_tick is already valid.
+static xs::atomic_counter_t calibrated;
+
+void xs::histogram_t::calibrate ()
+{
+    //  The calibration is done only once per process. If another thread is
+    //  doing it at the moment, wait till it's finished so that ns_per_tick
+    //  is valid by the time this call returns.
+    atomic_counter_t::integer_t state = calibrated.cas (0, 1);
+    if (state) {
+        while (calibrated.get () != 2)
+            cpu_relax ();
+        return;
+    }
+
+    //  The atomic operation makes the new ns_per_tick visible to the
+    //  other threads before they see the calibration as done.
+    measure ();
+    calibrated.cas (1, 2);
+}
+
+void xs::histogram_t::measure ()
+{
+    //  If TSC is not available, the timestamps are already in nanoseconds.
+    if (!clock_t::rdtsc ())
+        return;
+
+    //  Count the ticks during one millisecond of physical time.
+    uint64_t start_us = clock_t::now_us ();
+    uint64_t start_tsc = clock_t::rdtsc ();
+    uint64_t end_us;
+    do {
+        end_us = clock_t::now_us ();
+    } while (end_us - start_us < 1000);
+    uint64_t end_tsc = clock_t::rdtsc ();
+    if (end_tsc > start_tsc)
+        ns_per_tick = (double) ((end_us - start_us) * 1000) /
+            (double) (end_tsc - start_tsc);
+}
+
+void xs::histogram_t::get (uint64_t *counts_)
+{
+    for (int i = 0; i != bucket_count; i++)
+        counts_ [i] = buckets [i].get ();
+}
+
+int xs::histogram_t::bucket (uint64_t value_)
+{
+    //  Small values are recorded exactly.
+    if (value_ < sub_buckets)
+        return (int) value_;
+    if (value_ >> max_bits)
+        return bucket_count - 1;
+
+    //  Find the highest bit set. The following bits select the bucket
+    //  within the power of two.
+#if defined __GNUC__
+    int bits = 63 - __builtin_clzll (value_);
+#else
+    int bits = sub_bucket_bits;
+    while (value_ >> (bits + 1))
+        bits++;
+#endif
+    return (bits - sub_bucket_bits + 1) * sub_buckets +
+        (int) ((value_ >> (bits - sub_bucket_bits)) & (sub_buckets - 1));
+}
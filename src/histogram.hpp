@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_HISTOGRAM_HPP_INCLUDED__
+#define __XS_HISTOGRAM_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "clock.hpp"
+#include "atomic_counter.hpp"
+
+namespace xs
+{
+
+    //  Histogram of durations in nanoseconds. Each power of two is split
+    //  into 8 buckets of equal width, so the values are recorded with the
+    //  precision of 12.5%. Values can be recorded by several threads at once
+    //  and read by yet another thread without any locking.
+
+    class histogram_t
+    {
+    public:
+
+        enum
+        {
+            sub_bucket_bits = 3,
+            sub_buckets = 1 << sub_bucket_bits,
+
+            //  Values of 2^36 ns (about 68 seconds) and more fall into the
+            //  last bucket.
+            max_bits = 36,
+            bucket_count = (max_bits - sub_bucket_bits + 1) * sub_buckets
+        };
+
+        //  Returns the current timestamp for the purpose of measuring
+        //  durations. It's the CPU's tick counter if available.
+        static inline uint64_t now ()
+        {
+            uint64_t tsc = clock_t::rdtsc ();
+            return tsc ? tsc : clock_t::now_us () * 1000;
+        }
+
+        //  Measures the frequency of the timestamps returned by now().
+        //  Has to be called before any durations are recorded. The
+        //  measurement is done only by the first call in the process.
+        static void calibrate ();
+
+        //  Records the time elapsed since the timestamp start_.
+        inline void record (uint64_t start_)
+        {
+            uint64_t end = now ();
+            if (end < start_)
+                end = start_;
+            buckets [bucket ((uint64_t) ((end - start_) * ns_per_tick))].add (1);
+        }
+
+        //  Retrieves the number of values recorded in each bucket.
+        void get (uint64_t *counts_);
+
+    private:
+
+        //  Does the actual measurement for calibrate().
+        static void measure ();
+
+        //  Returns index of the bucket the value belongs to.
+        static int bucket (uint64_t value_);
+
+        //  Nanoseconds per tick of the timestamp.
+        static double ns_per_tick;
+
+        atomic_counter_t buckets [bucket_count];
+    };
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_I_MSG_SINK_HPP_INCLUDED__
+#define __XS_I_MSG_SINK_HPP_INCLUDED__
+
+namespace xs
+{
+
+    class msg_t;
+
+    //  Interface to be implemented by objects that accept decoded
+    //  messages.
+
+    struct i_msg_sink
+    {
+        virtual ~i_msg_sink () {}
+
+        //  Passes a decoded message further. Returns -1 and sets errno to
+        //  EAGAIN if the message cannot be accepted at the moment. The caller
+        //  keeps the ownership of the message in such case.
+        virtual int write (msg_t *msg_) = 0;
+    };
+
+}
+
+#endif
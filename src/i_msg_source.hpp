@@ -0,0 +1,43 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_I_MSG_SOURCE_HPP_INCLUDED__
+#define __XS_I_MSG_SOURCE_HPP_INCLUDED__
+
+namespace xs
+{
+
+    class msg_t;
+
+    //  Interface to be implemented by objects that supply messages
+    //  to be encoded.
+
+    struct i_msg_source
+    {
+        virtual ~i_msg_source () {}
+
+        //  Fetches next message to encode. Returns -1 and sets errno to
+        //  EAGAIN if there is no message available at the moment.
+        virtual int read (msg_t *msg_) = 0;
+    };
+
+}
+
+#endif
@@ -89,6 +89,33 @@ void xs::io_object_t::rm_timer (handle_t handle_)
     io_thread->rm_timer (handle_);
 }
 
+void xs::io_object_t::account_bytes (size_t bytes_)
+{
+    io_thread->account_bytes (bytes_);
+}
+
+bool xs::io_object_t::async_io ()
+{
+    return io_thread->async_io ();
+}
+
+void xs::io_object_t::async_recv (handle_t handle_)
+{
+    io_thread->async_recv (handle_);
+}
+
+unsigned char *xs::io_object_t::get_send_buffer (handle_t handle_,
+    size_t *size_)
+{
+    return io_thread->get_send_buffer (handle_, size_);
+}
+
+void xs::io_object_t::async_send (handle_t handle_, unsigned char *data_,
+    size_t size_)
+{
+    io_thread->async_send (handle_, data_, size_);
+}
+
 void xs::io_object_t::in_event (fd_t fd_)
 {
     xs_assert (false);
@@ -104,3 +131,13 @@ void xs::io_object_t::timer_event (handle_t handle_)
 {
     xs_assert (false);
 }
+
+void xs::io_object_t::async_in_event (unsigned char *data_, int res_)
+{
+    xs_assert (false);
+}
+
+void xs::io_object_t::async_out_event (int res_)
+{
+    xs_assert (false);
+}
@@ -57,11 +57,19 @@ namespace xs
         void reset_pollout (handle_t handle_);
         handle_t add_timer (int timout_);
         void rm_timer (handle_t handle_);
+        void account_bytes (size_t bytes_);
+        bool async_io ();
+        void async_recv (handle_t handle_);
+        unsigned char *get_send_buffer (handle_t handle_, size_t *size_);
+        void async_send (handle_t handle_, unsigned char *data_,
+            size_t size_);
 
         //  i_poll_events interface implementation.
         void in_event (fd_t fd_);
         void out_event (fd_t fd_);
         void timer_event (handle_t handle_);
+        void async_in_event (unsigned char *data_, int res_);
+        void async_out_event (int res_);
 
     private:
 
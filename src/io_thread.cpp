@@ -18,6 +18,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "io_thread.hpp"
 #include "err.hpp"
 
@@ -26,10 +28,19 @@
 #include "epoll.hpp"
 #include "devpoll.hpp"
 #include "kqueue.hpp"
+#include "uring.hpp"
 
-xs::io_thread_t *xs::io_thread_t::create (xs::ctx_t *ctx_, uint32_t tid_)
+xs::io_thread_t *xs::io_thread_t::create (xs::ctx_t *ctx_, uint32_t tid_,
+    bool io_uring_)
 {
     io_thread_t *result;
+#if defined XS_HAVE_IO_URING
+    if (io_uring_ && uring_t::available ()) {
+        result = new (std::nothrow) uring_t (ctx_, tid_);
+        alloc_assert (result);
+        return result;
+    }
+#endif
 #if defined XS_HAVE_SELECT
     result = new (std::nothrow) select_t (ctx_, tid_);
 #elif defined XS_HAVE_POLL
@@ -46,16 +57,28 @@ xs::io_thread_t *xs::io_thread_t::create (xs::ctx_t *ctx_, uint32_t tid_)
 }
 
 xs::io_thread_t::io_thread_t (xs::ctx_t *ctx_, uint32_t tid_) :
-    object_t (ctx_, tid_)
+    object_t (ctx_, tid_),
+    busy_ticks (0),
+    window_ticks (0),
+    utilisation (0),
+    utilisation_time (0)
 {
+    current.bytes = 0;
+    current.events = 0;
+    current.busy = 0;
+    published = current;
+    busy_since = ticks ();
+    window_start = busy_since;
+    window_start_us = clock_t::now_us ();
 }
 
 xs::io_thread_t::~io_thread_t ()
 {
 }
 
-void xs::io_thread_t::start ()
+void xs::io_thread_t::start (const cpus_t &cpus_)
 {
+    cpus = cpus_;
     mailbox_handle = add_fd (mailbox.get_fd (), this);
     set_pollin (mailbox_handle);
     xstart ();
@@ -91,20 +114,105 @@ void xs::io_thread_t::adjust_load (int amount_)
         load.sub (-amount_);
 }
 
+int xs::io_thread_t::get_utilisation ()
+{
+    //  Retry if the I/O thread has updated the values in the meantime.
+    int result;
+    uint64_t time;
+    while (true) {
+        atomic_counter_t::integer_t seq = stats_seq.add (0);
+        if (seq & 1)
+            continue;
+        result = utilisation;
+        time = utilisation_time;
+        if (stats_seq.add (0) == seq)
+            break;
+    }
+
+    //  If the thread hasn't finished a measurement period for a long time,
+    //  it's been sleeping.
+    if (clock_t::now_us () - time > 2 * load_window * 1000)
+        return 0;
+    return result;
+}
+
+void xs::io_thread_t::get_stats (io_thread_stats_t *stats_)
+{
+    //  Retry if the I/O thread has updated the copy in the meantime.
+    while (true) {
+        atomic_counter_t::integer_t seq = stats_seq.add (0);
+        if (seq & 1)
+            continue;
+        *stats_ = published;
+        if (stats_seq.add (0) == seq)
+            break;
+    }
+}
+
+uint64_t xs::io_thread_t::ticks ()
+{
+    uint64_t tsc = clock_t::rdtsc ();
+    return tsc ? tsc : clock_t::now_us ();
+}
+
+void xs::io_thread_t::before_wait ()
+{
+    //  TSC may jump back when the thread migrates to a different core.
+    //  Such intervals are not accounted for.
+    uint64_t now = ticks ();
+    if (now > busy_since)
+        busy_ticks += now - busy_since;
+
+    //  If the measurement period has likely elapsed, check the precise time.
+    //  Once it has, compute the utilisation of the thread within the period
+    //  and convert the busy time to microseconds.
+    bool measured = false;
+    double busy = 0;
+    uint64_t now_us = 0;
+    if (now < window_start || now - window_start >= window_ticks) {
+        now_us = clock_t::now_us ();
+        uint64_t elapsed_us = now_us - window_start_us;
+        uint64_t elapsed = now > window_start ? now - window_start : 0;
+        if (elapsed_us)
+            window_ticks = (uint64_t) ((double) elapsed *
+                (load_window * 1000) / elapsed_us);
+        if (elapsed_us >= load_window * 1000) {
+            if (elapsed)
+                busy = (double) std::min (busy_ticks, elapsed) / elapsed;
+            current.busy += (uint64_t) (busy * elapsed_us);
+            window_start = now;
+            window_start_us = now_us;
+            busy_ticks = 0;
+            measured = true;
+        }
+    }
+
+    //  Make the statistics available to other threads. The sequence number
+    //  is odd while they are being updated.
+    stats_seq.add (1);
+    published = current;
+    if (measured) {
+        utilisation = (int) (busy * 1000);
+        utilisation_time = now_us;
+    }
+    stats_seq.add (1);
+}
+
+void xs::io_thread_t::after_wait (int events_)
+{
+    busy_since = ticks ();
+    if (events_ > 0)
+        current.events += events_;
+}
+
 xs::handle_t xs::io_thread_t::add_timer (int timeout_, i_poll_events *sink_)
 {
-    uint64_t expiration = clock.now_ms () + timeout_;
-    timer_info_t info = {sink_, timers_t::iterator ()};
-    timers_t::iterator it = timers.insert (
-        timers_t::value_type (expiration, info));
-    it->second.self = it;
-    return (handle_t) &(it->second);
+    return timers.add (clock.now_ms (), timeout_, sink_);
 }
 
 void xs::io_thread_t::rm_timer (handle_t handle_)
 {
-    timer_info_t *info = (timer_info_t*) handle_;
-    timers.erase (info->self);
+    timers.rm (handle_);
 }
 
 uint64_t xs::io_thread_t::execute_timers ()
@@ -113,31 +221,32 @@ uint64_t xs::io_thread_t::execute_timers ()
     if (timers.empty ())
         return 0;
 
-    //  Get the current time.
-    uint64_t current = clock.now_ms ();
-
-    //   Execute the timers that are already due.
-    timers_t::iterator it = timers.begin ();
-    while (it != timers.end ()) {
+    //  Execute the timers that are already due and return the time to wait
+    //  for the next one.
+    return timers.execute (clock.now_ms ());
+}
 
-        //  If we have to wait to execute the item, same will be true about
-        //  all the following items (multimap is sorted). Thus we can stop
-        //  checking the subsequent timers and return the time to wait for
-        //  the next timer (at least 1ms).
-        if (it->first > current)
-            return it->first - current;
+bool xs::io_thread_t::async_io ()
+{
+    return false;
+}
 
-        //  Trigger the timer.
-        it->second.sink->timer_event ((handle_t) &it->second);
+void xs::io_thread_t::async_recv (handle_t handle_)
+{
+    xs_assert (false);
+}
 
-        //  Remove it from the list of active timers.
-        timers_t::iterator o = it;
-        ++it;
-        timers.erase (o);
-    }
+unsigned char *xs::io_thread_t::get_send_buffer (handle_t handle_,
+    size_t *size_)
+{
+    xs_assert (false);
+    return NULL;
+}
 
-    //  There are no more timers.
-    return 0;
+void xs::io_thread_t::async_send (handle_t handle_, unsigned char *data_,
+    size_t size_)
+{
+    xs_assert (false);
 }
 
 void xs::io_thread_t::in_event (fd_t fd_)
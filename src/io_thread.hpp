@@ -21,10 +21,12 @@
 #ifndef __XS_IO_THREAD_HPP_INCLUDED__
 #define __XS_IO_THREAD_HPP_INCLUDED__
 
-#include <map>
+#include <stddef.h>
 
 #include "fd.hpp"
 #include "clock.hpp"
+#include "thread.hpp"
+#include "timers.hpp"
 #include "object.hpp"
 #include "mailbox.hpp"
 #include "atomic_counter.hpp"
@@ -52,22 +54,64 @@ namespace xs
  
         // Called when timer expires.
         virtual void timer_event (handle_t handle_) = 0;
+
+        //  Called by I/O thread when asynchronous receive, respectively
+        //  send, completes. res_ is the number of bytes transferred or
+        //  a negated error code. Only used with I/O threads that support
+        //  asynchronous I/O.
+        virtual void async_in_event (unsigned char *data_, int res_) {}
+        virtual void async_out_event (int res_) {}
+    };
+
+    //  Work done by an I/O thread since it was started.
+    struct io_thread_stats_t
+    {
+        //  Number of bytes read from and written to the network.
+        uint64_t bytes;
+
+        //  Number of events the thread was woken up for.
+        uint64_t events;
+
+        //  Time spent processing the events and timers, in microseconds.
+        uint64_t busy;
     };
 
     class io_thread_t : public object_t, public i_poll_events
     {
     public:
 
-        //  Create optimal polling mechanism for this environment.
-        static io_thread_t *create (xs::ctx_t *ctx_, uint32_t tid_);
+        //  Create optimal polling mechanism for this environment. If io_uring
+        //  is requested but not supported, the default mechanism is used.
+        static io_thread_t *create (xs::ctx_t *ctx_, uint32_t tid_,
+            bool io_uring_ = false);
 
         virtual ~io_thread_t ();
 
-        //  Returns load of the I/O thread. Note that this function can be
-        //  invoked from a different thread!
+        //  Returns number of file descriptors registered with the I/O
+        //  thread. Note that this function can be invoked from a different
+        //  thread!
         int get_load ();
 
-        void start ();
+        //  Returns the portion of the time the I/O thread was busy recently,
+        //  in per mille. Can be invoked from a different thread.
+        int get_utilisation ();
+
+        //  Retrieves the work done by the I/O thread so far. The statistics
+        //  are updated each time the thread goes to sleep, except for the
+        //  busy time, which is updated once per utilisation measurement
+        //  period. Can be invoked from a different thread.
+        void get_stats (io_thread_stats_t *stats_);
+
+        //  Called by the objects living in the I/O thread to report the
+        //  number of bytes they've transferred.
+        inline void account_bytes (size_t bytes_)
+        {
+            current.bytes += bytes_;
+        }
+
+        //  Launches the thread. If cpus_ is not empty, the thread is pinned
+        //  to the CPUs listed.
+        void start (const cpus_t &cpus_ = cpus_t ());
         void stop ();
 
         //  Returns mailbox associated with this I/O thread.
@@ -82,6 +126,27 @@ namespace xs
         virtual void xstart () = 0;
         virtual void xstop () = 0;
 
+        //  Asynchronous I/O. The polling mechanisms that are able to do
+        //  the reads and writes themselves return true from async_io and
+        //  implement the remaining functions. The data are received into,
+        //  respectively sent from, buffers owned by the I/O thread, so that
+        //  the requests in flight can outlive the object that issued them.
+        //  At most one receive and one send can be in flight per handle.
+        virtual bool async_io ();
+
+        //  Starts receiving data. async_in_event is invoked once some data
+        //  arrive. The data remain valid till the next receive is started.
+        virtual void async_recv (handle_t handle_);
+
+        //  Returns the buffer to fill in with the data to send.
+        virtual unsigned char *get_send_buffer (handle_t handle_,
+            size_t *size_);
+
+        //  Starts sending size_ bytes at data_, which must lie within the
+        //  send buffer. async_out_event is invoked once some data were sent.
+        virtual void async_send (handle_t handle_, unsigned char *data_,
+            size_t size_);
+
         //  Add a timeout to expire in timeout_ milliseconds. After the
         //  expiration timer_event on sink_ object will be called.
         handle_t add_timer (int timeout_, xs::i_poll_events *sink_);
@@ -101,10 +166,20 @@ namespace xs
         //  Called by individual io_thread implementations to manage the load.
         void adjust_load (int amount_);
 
+        //  Called by individual io_thread implementations right before
+        //  they start waiting for events and right after the wait returns,
+        //  with the number of events received (or -1 in case of error).
+        //  The time in between is not accounted as busy time.
+        void before_wait ();
+        void after_wait (int events_);
+
         //  Executes any timers that are due. Returns number of milliseconds
         //  to wait to match the next timer or 0 meaning "no timers".
         uint64_t execute_timers ();
 
+        //  CPUs the worker thread is allowed to run on. Empty means any CPU.
+        cpus_t cpus;
+
     private:
 
         void process_stop ();
@@ -112,19 +187,44 @@ namespace xs
         //  Clock instance private to this I/O thread.
         clock_t clock;
 
-        //  List of active timers.
-        struct timer_info_t
-        {
-            xs::i_poll_events *sink;
-            std::multimap <uint64_t, timer_info_t>::iterator self;
-        };
-        typedef std::multimap <uint64_t, timer_info_t> timers_t;
+        //  Active timers.
         timers_t timers;
 
         //  Load of the I/O thread. Currently the number of file descriptors
         //  registered.
         atomic_counter_t load;
 
+        //  Returns the current value of the cheapest monotonic counter
+        //  available, i.e. TSC if supported, microseconds otherwise.
+        static uint64_t ticks ();
+
+        //  The statistics maintained by the I/O thread itself.
+        io_thread_stats_t current;
+
+        //  Busy time is measured in ticks and converted to microseconds at
+        //  the end of each utilisation measurement period, so that the high
+        //  precision clock is read only once per period. busy_since is when
+        //  the thread woke up last time, busy_ticks is the busy time within
+        //  the current period.
+        uint64_t busy_since;
+        uint64_t busy_ticks;
+
+        //  Beginning of the current measurement period, in ticks and in
+        //  microseconds, and the estimated length of the period in ticks.
+        uint64_t window_start;
+        uint64_t window_start_us;
+        uint64_t window_ticks;
+
+        //  The statistics published to other threads, the utilisation
+        //  measured in the last period and the time it was measured at.
+        //  The sequence number is incremented before and after they are
+        //  updated, so that readers can detect they've read a copy that was
+        //  being updated.
+        io_thread_stats_t published;
+        int utilisation;
+        uint64_t utilisation_time;
+        atomic_counter_t stats_seq;
+
         //  I/O thread accesses incoming commands via this mailbox.
         mailbox_t mailbox;
 
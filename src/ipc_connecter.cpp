@@ -26,6 +26,7 @@
 #include <string>
 
 #include "stream_engine.hpp"
+#include "shm_engine.hpp"
 #include "io_thread.hpp"
 #include "platform.hpp"
 #include "random.hpp"
@@ -39,12 +40,13 @@
 
 xs::ipc_connecter_t::ipc_connecter_t (class io_thread_t *io_thread_,
       class session_base_t *session_, const options_t &options_,
-      const char *address_, bool wait_) :
+      const char *address_, bool wait_, bool shm_) :
     own_t (io_thread_, options_),
     io_object_t (io_thread_),
     s (retired_fd),
     handle (NULL),
     wait (wait_),
+    shm (shm_),
     session (session_),
     current_reconnect_ivl(options.reconnect_ivl),
     reconnect_timer (NULL)
@@ -102,7 +104,13 @@ void xs::ipc_connecter_t::out_event (fd_t fd_)
     }
 
     //  Create the engine object for this connection.
-    stream_engine_t *engine = new (std::nothrow) stream_engine_t (fd, options);
+    i_engine *engine;
+#if defined XS_HAVE_SHM
+    if (shm)
+        engine = new (std::nothrow) shm_engine_t (fd, options, true);
+    else
+#endif
+        engine = new (std::nothrow) stream_engine_t (fd, options);
     alloc_assert (engine);
 
     //  Attach the engine to the corresponding session object.
@@ -42,10 +42,11 @@ namespace xs
     public:
 
         //  If 'delay' is true connecter first waits for a while, then starts
-        //  connection process.
+        //  connection process. If 'shm' is true, the messages are passed
+        //  via shared memory rather than via the UNIX domain socket itself.
         ipc_connecter_t (xs::io_thread_t *io_thread_,
             xs::session_base_t *session_, const options_t &options_,
-            const char *address_, bool delay_);
+            const char *address_, bool delay_, bool shm_);
         ~ipc_connecter_t ();
 
     private:
@@ -100,6 +101,9 @@ namespace xs
         //  If true, connecter is waiting a while before trying to connect.
         bool wait;
 
+        //  If true, the connection uses the shared memory engine.
+        bool shm;
+
         //  Reference to the session we belong to.
         xs::session_base_t *session;
 
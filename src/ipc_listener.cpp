@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "stream_engine.hpp"
+#include "shm_engine.hpp"
 #include "ipc_address.hpp"
 #include "io_thread.hpp"
 #include "session_base.hpp"
@@ -40,12 +41,13 @@
 #include <sys/un.h>
 
 xs::ipc_listener_t::ipc_listener_t (io_thread_t *io_thread_,
-      socket_base_t *socket_, const options_t &options_) :
+      socket_base_t *socket_, const options_t &options_, bool shm_) :
     own_t (io_thread_, options_),
     io_object_t (io_thread_),
     has_file (false),
     s (retired_fd),
-    socket (socket_)
+    socket (socket_),
+    shm (shm_)
 {
 }
 
@@ -78,7 +80,13 @@ void xs::ipc_listener_t::in_event (fd_t fd_)
         return;
 
     //  Create the engine object for this connection.
-    stream_engine_t *engine = new (std::nothrow) stream_engine_t (fd, options);
+    i_engine *engine;
+#if defined XS_HAVE_SHM
+    if (shm)
+        engine = new (std::nothrow) shm_engine_t (fd, options, false);
+    else
+#endif
+        engine = new (std::nothrow) stream_engine_t (fd, options);
     alloc_assert (engine);
 
     //  Choose I/O thread to run connecter in. Given that we are already
@@ -42,8 +42,10 @@ namespace xs
     {
     public:
 
+        //  If shm_ is true, the messages are passed via shared memory
+        //  rather than via the UNIX domain socket itself.
         ipc_listener_t (xs::io_thread_t *io_thread_,
-            xs::socket_base_t *socket_, const options_t &options_);
+            xs::socket_base_t *socket_, const options_t &options_, bool shm_);
         ~ipc_listener_t ();
 
         //  Set address to listen on.
@@ -81,6 +83,9 @@ namespace xs
         //  Socket the listerner belongs to.
         xs::socket_base_t *socket;
 
+        //  If true, the connections use the shared memory engine.
+        bool shm;
+
         ipc_listener_t (const ipc_listener_t&);
         const ipc_listener_t &operator = (const ipc_listener_t&);
     };
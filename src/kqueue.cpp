@@ -144,7 +144,7 @@ void xs::kqueue_t::reset_pollout (handle_t handle_)
 
 void xs::kqueue_t::xstart ()
 {
-    worker.start (worker_routine, this);
+    worker.start (worker_routine, this, cpus);
 }
 
 void xs::kqueue_t::xstop ()
@@ -162,8 +162,10 @@ void xs::kqueue_t::loop ()
         //  Wait for events.
         struct kevent ev_buf [max_io_events];
         timespec ts = {timeout / 1000, (timeout % 1000) * 1000000};
+        before_wait ();
         int n = kevent (kqueue_fd, NULL, 0, &ev_buf [0], max_io_events,
             timeout ? &ts: NULL);
+        after_wait (n);
         if (n == -1 && errno == EINTR)
             continue;
         errno_assert (n != -1);
@@ -29,7 +29,8 @@ xs::lb_t::lb_t () :
     active (0),
     current (0),
     more (false),
-    dropping (false)
+    dropping (false),
+    dropped (0)
 {
 }
 
@@ -78,8 +79,10 @@ int xs::lb_t::send (msg_t *msg_, int flags_)
     if (dropping) {
 
         more = msg_->flags () & msg_t::more ? true : false;
-        if (!more)
+        if (!more) {
             dropping = false;
+            dropped++;
+        }
 
         int rc = msg_->close ();
         errno_assert (rc == 0);
@@ -111,7 +114,8 @@ int xs::lb_t::send (msg_t *msg_, int flags_)
     //  If it's final part of the message we can fluch it downstream and
     //  continue round-robinning (load balance).
     if (!more) {
-        pipes [current]->flush ();
+        if (!(flags_ & send_noflush))
+            pipes [current]->flush ();
         current = (current + 1) % active;
     }
 
@@ -122,6 +126,15 @@ int xs::lb_t::send (msg_t *msg_, int flags_)
     return 0;
 }
 
+void xs::lb_t::flush ()
+{
+    //  Messages may have been written to the pipes that were deactivated
+    //  afterwards, so all the pipes have to be flushed, not only the active
+    //  ones. Flushing a pipe with no pending messages is cheap.
+    for (pipes_t::size_type i = 0; i != pipes.size (); ++i)
+        pipes [i]->flush ();
+}
+
 bool xs::lb_t::has_out ()
 {
     //  If one part of the message was already written we can definitely
@@ -153,3 +166,7 @@ bool xs::lb_t::has_out ()
     return false;
 }
 
+uint64_t xs::lb_t::get_dropped ()
+{
+    return dropped;
+}
@@ -45,6 +45,13 @@ namespace xs
         int send (msg_t *msg_, int flags_);
         bool has_out ();
 
+        //  Flushes all the messages written with send_noflush flag.
+        void flush ();
+
+        //  Returns the number of messages dropped because the pipe they
+        //  were being sent to was terminated in the middle of the message.
+        uint64_t get_dropped ();
+
     private:
 
         //  List of outbound pipes.
@@ -64,6 +71,9 @@ namespace xs
         //  True if we are dropping current message.
         bool dropping;
 
+        //  Number of messages dropped so far.
+        uint64_t dropped;
+
         lb_t (const lb_t&);
         const lb_t &operator = (const lb_t&);
     };
@@ -19,22 +19,50 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
+#include <new>
+
 #include "mailbox.hpp"
 #include "err.hpp"
 
+//  Helpers to store the 'receiver is passive' flag in the lowest bit
+//  of the node pointer. Nodes are allocated on the heap and thus aligned.
+static inline bool is_passive (void *ptr_)
+{
+    return ((size_t) ptr_ & 1) != 0;
+}
+
+template <typename T> static inline T *set_passive (T *ptr_)
+{
+    return (T*) ((size_t) ptr_ | 1);
+}
+
+template <typename T> static inline T *clear_passive (T *ptr_)
+{
+    return (T*) ((size_t) ptr_ & ~((size_t) 1));
+}
+
 xs::mailbox_t::mailbox_t ()
 {
-    //  Get the pipe into passive state. That way, if the users starts by
-    //  polling on the associated file descriptor it will get woken up when
-    //  new command is posted.
-    bool ok = cpipe.read (NULL);
-    xs_assert (!ok);
+    //  Start with a dummy node in the list and get the mailbox into passive
+    //  state. That way, if the users starts by polling on the associated
+    //  file descriptor it will get woken up when new command is posted.
+    tail = new (std::nothrow) node_t;
+    alloc_assert (tail);
+    tail->next.set (NULL);
+    head.set (set_passive (tail));
     active = false;
+    signaled = false;
 }
 
 xs::mailbox_t::~mailbox_t ()
 {
-    //  TODO: Retrieve and deallocate commands inside the cpipe.
+    //  TODO: Deallocate the resources held by the commands still in the list.
+    while (tail) {
+        node_t *next = tail->next.xchg (NULL);
+        delete tail;
+        tail = next;
+    }
 }
 
 xs::fd_t xs::mailbox_t::get_fd ()
@@ -42,27 +70,68 @@ xs::fd_t xs::mailbox_t::get_fd ()
     return signaler.get_fd ();
 }
 
+void xs::mailbox_t::set_spin (int spin_)
+{
+    signaler.set_spin (spin_);
+}
+
 void xs::mailbox_t::send (const command_t &cmd_)
 {
-    sync.lock ();
-    cpipe.write (cmd_, false);
-    bool ok = cpipe.flush ();
-    sync.unlock ();
-    if (!ok)
+    node_t *node = new (std::nothrow) node_t;
+    alloc_assert (node);
+    node->cmd = cmd_;
+    node->next.set (NULL);
+
+    //  Append the node to the list. Between swapping the head and linking
+    //  the node to its predecessor the list is broken; the receiver waits
+    //  for the link to be established in such a case.
+    node_t *prev = head.xchg (node);
+    clear_passive (prev)->next.store (node);
+
+    //  If the receiver was passive we are responsible for waking it up.
+    if (is_passive (prev))
         signaler.send ();
 }
 
+bool xs::mailbox_t::read (command_t *cmd_)
+{
+    while (true) {
+
+        node_t *next = tail->next.load ();
+        if (next) {
+            *cmd_ = next->cmd;
+            delete tail;
+            tail = next;
+            return true;
+        }
+
+        //  If the last node in the list is the one we've already read,
+        //  there are no commands available.
+        if (head.load () == tail)
+            return false;
+
+        //  Otherwise some sender is in the middle of appending a node.
+        //  It's going to be linked to the list in a moment.
+    }
+}
+
 int xs::mailbox_t::recv (command_t *cmd_, int timeout_)
 {
     //  Try to get the command straight away.
     if (active) {
-        bool ok = cpipe.read (cmd_);
-        if (ok)
+        if (read (cmd_))
             return 0;
 
         //  If there are no more commands available, switch into passive state.
+        //  If a command arrived in the meantime, we stay active instead.
+        if (head.cas (tail, set_passive (tail)) != tail) {
+            bool ok = read (cmd_);
+            xs_assert (ok);
+            return 0;
+        }
         active = false;
-        signaler.recv ();
+        if (signaled)
+            signaler.recv ();
     }
 
     //  Wait for signal from the command sender.
@@ -72,11 +141,32 @@ int xs::mailbox_t::recv (command_t *cmd_, int timeout_)
 
     //  We've got the signal. Now we can switch into active state.
     active = true;
+    signaled = true;
 
     //  Get a command.
     errno_assert (rc == 0);
-    bool ok = cpipe.read (cmd_);
+    bool ok = read (cmd_);
     xs_assert (ok);
     return 0;
 }
 
+bool xs::mailbox_t::poll (command_t *cmd_)
+{
+    if (!active) {
+
+        //  If there are no commands, switch into active state straight away.
+        //  No sender has seen the mailbox in passive state, thus
+        //  there's no signal to read.
+        if (head.cas (set_passive (tail), tail) == set_passive (tail)) {
+            active = true;
+            signaled = false;
+        }
+
+        //  Otherwise a sender has already signaled us. Get the command in
+        //  the standard way.
+        else
+            return recv (cmd_, 0) == 0;
+    }
+
+    return read (cmd_);
+}
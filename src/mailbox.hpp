@@ -29,8 +29,7 @@
 #include "fd.hpp"
 #include "config.hpp"
 #include "command.hpp"
-#include "ypipe.hpp"
-#include "mutex.hpp"
+#include "atomic_ptr.hpp"
 
 namespace xs
 {
@@ -45,26 +44,59 @@ namespace xs
         fd_t get_fd ();
         void send (const command_t &cmd_);
         int recv (command_t *cmd_, int timeout_);
+
+        //  Retrieves a command without blocking. Unlike recv, it leaves the
+        //  mailbox in active state when there are no commands available,
+        //  so that the senders don't have to signal the receiver while it
+        //  keeps polling for new commands. Returns false if there are no
+        //  commands.
+        bool poll (command_t *cmd_);
+
+        //  Set the time (in microseconds) to spin in recv waiting for
+        //  a command before going to sleep.
+        void set_spin (int spin_);
         
     private:
 
-        //  The pipe to store actual commands.
-        typedef ypipe_t <command_t, command_pipe_granularity> cpipe_t;
-        cpipe_t cpipe;
+        //  Commands are passed in a singly-linked list of nodes, allocated
+        //  by the senders and deallocated by the receiver. The list always
+        //  contains at least one node, the one read most recently (or a dummy
+        //  node at the beginning), so that senders never have to touch the
+        //  nodes the receiver is working with.
+        struct node_t
+        {
+            command_t cmd;
+            atomic_ptr_t <node_t> next;
+        };
+
+        //  Retrieves a command from the list. Returns false if the list
+        //  is empty.
+        bool read (command_t *cmd_);
+
+        //  The most recently written node. Any number of threads can append
+        //  to the list by swapping this pointer, so no lock is needed on the
+        //  sending side. The lowest bit of the pointer is set when the
+        //  receiver is passive, i.e. when the next sender has to wake it
+        //  up. As there's only a single atomic operation involved, the
+        //  sender that appends to an empty list of a passive receiver learns
+        //  about it without any further synchronisation.
+        atomic_ptr_t <node_t> head;
+
+        //  The most recently read node. Accessed only by the receiver thread.
+        node_t *tail;
 
         //  Signaler to pass signals from writer thread to reader thread.
         signaler_t signaler;
 
-        //  There's only one thread receiving from the mailbox, but there
-        //  is arbitrary number of threads sending. Given that ypipe requires
-        //  synchronised access on both of its endpoints, we have to synchronise
-        //  the sending side.
-        mutex_t sync;
-
-        //  True if the underlying pipe is active, ie. when we are allowed to
+        //  True if the mailbox is active, ie. when we are allowed to
         //  read commands from it.
         bool active;
 
+        //  True if the mailbox was activated by a signal that is still to
+        //  be read from the signaler. The signal is read when the mailbox
+        //  switches back into passive state.
+        bool signaled;
+
         //  Disable copying of mailbox_t object.
         mailbox_t (const mailbox_t&);
         const mailbox_t &operator = (const mailbox_t&);
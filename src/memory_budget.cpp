@@ -0,0 +1,60 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "memory_budget.hpp"
+#include "err.hpp"
+
+xs::memory_budget_t::memory_budget_t (uint64_t limit_) :
+    limit (limit_),
+    used (0)
+{
+}
+
+xs::memory_budget_t::~memory_budget_t ()
+{
+    //  All the reservations should have been returned by now.
+    xs_assert (used == 0);
+}
+
+bool xs::memory_budget_t::reserve (uint64_t size_, bool force_)
+{
+    sync.lock ();
+    bool ok = force_ || used + size_ <= limit;
+    if (ok)
+        used += size_;
+    sync.unlock ();
+    return ok;
+}
+
+void xs::memory_budget_t::release (uint64_t size_)
+{
+    sync.lock ();
+    xs_assert (used >= size_);
+    used -= size_;
+    sync.unlock ();
+}
+
+uint64_t xs::memory_budget_t::get_used ()
+{
+    sync.lock ();
+    uint64_t result = used;
+    sync.unlock ();
+    return result;
+}
@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_MEMORY_BUDGET_HPP_INCLUDED__
+#define __XS_MEMORY_BUDGET_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "mutex.hpp"
+
+namespace xs
+{
+
+    //  Context-wide limit on the memory used to buffer messages. Pipes and
+    //  engines reserve memory from the budget before using it and return it
+    //  once it is not needed anymore. Reservations are made in large chunks
+    //  so the lock is taken only occasionally.
+
+    class memory_budget_t
+    {
+    public:
+
+        memory_budget_t (uint64_t limit_);
+        ~memory_budget_t ();
+
+        //  Reserves size_ bytes. Returns false if that would exceed the
+        //  limit. If force_ is true, the reservation is made in any case.
+        bool reserve (uint64_t size_, bool force_ = false);
+
+        //  Returns size_ previously reserved bytes to the budget.
+        void release (uint64_t size_);
+
+        //  Returns number of bytes reserved at the moment.
+        uint64_t get_used ();
+
+    private:
+
+        const uint64_t limit;
+        uint64_t used;
+        mutex_t sync;
+
+        memory_budget_t (const memory_budget_t&);
+        const memory_budget_t &operator = (const memory_budget_t&);
+    };
+
+}
+
+#endif
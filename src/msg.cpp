@@ -29,6 +29,7 @@
 
 #include "stdint.hpp"
 #include "likely.hpp"
+#include "msg_pool.hpp"
 #include "err.hpp"
 
 //  Check whether the sizes of public representation of the message (xs_msg_t)
@@ -49,7 +50,7 @@ int xs::msg_t::init ()
     return 0;
 }
 
-int xs::msg_t::init_size (size_t size_)
+int xs::msg_t::init_size (size_t size_, msg_pool_t *pool_, uint32_t tid_)
 {
     if (size_ <= max_vsm_size) {
         u.vsm.type = type_vsm;
@@ -59,13 +60,27 @@ int xs::msg_t::init_size (size_t size_)
     else {
         u.lmsg.type = type_lmsg;
         u.lmsg.flags = 0;
-        u.lmsg.content =
-            (content_t*) malloc (sizeof (content_t) + size_);
-        if (!u.lmsg.content) {
-            errno = ENOMEM;
-            return -1;
+
+        //  Try to get the block from the pool first. If the size is not
+        //  pooled, fall back to malloc.
+        content_t *content = NULL;
+        if (pool_)
+            content = (content_t*) pool_->allocate (
+                sizeof (content_t) + size_, tid_);
+        if (content) {
+            content->pool = pool_;
+            content->pool_tid = tid_;
+        }
+        else {
+            content = (content_t*) malloc (sizeof (content_t) + size_);
+            if (!content) {
+                errno = ENOMEM;
+                return -1;
+            }
+            content->pool = NULL;
         }
 
+        u.lmsg.content = content;
         u.lmsg.content->data = u.lmsg.content + 1;
         u.lmsg.content->size = size_;
         u.lmsg.content->ffn = NULL;
@@ -90,6 +105,7 @@ int xs::msg_t::init_data (void *data_, size_t size_, msg_free_fn *ffn_,
     u.lmsg.content->size = size_;
     u.lmsg.content->ffn = ffn_;
     u.lmsg.content->hint = hint_;
+    u.lmsg.content->pool = NULL;
     new (&u.lmsg.content->refcnt) xs::atomic_counter_t ();
     return 0;
 
@@ -102,6 +118,41 @@ int xs::msg_t::init_delimiter ()
     return 0;
 }
 
+int xs::msg_t::init_slice (msg_t &buffer_, void *data_, size_t size_)
+{
+    xs_assert (buffer_.u.base.type == type_lmsg);
+    xs_assert ((unsigned char*) data_ >=
+        (unsigned char*) buffer_.u.lmsg.content->data);
+    xs_assert ((unsigned char*) data_ + size_ <=
+        (unsigned char*) buffer_.u.lmsg.content->data +
+        buffer_.u.lmsg.content->size);
+
+    //  Small messages are cheaper to copy than to share.
+    if (size_ <= max_vsm_size) {
+        u.vsm.type = type_vsm;
+        u.vsm.flags = 0;
+        u.vsm.size = (unsigned char) size_;
+        memcpy (u.vsm.data, data_, size_);
+        return 0;
+    }
+
+    //  The slice holds a reference to the content of the buffer, same way
+    //  as a copy of the buffer would do.
+    if (buffer_.u.lmsg.flags & msg_t::shared)
+        buffer_.u.lmsg.content->refcnt.add (1);
+    else {
+        buffer_.u.lmsg.flags |= msg_t::shared;
+        buffer_.u.lmsg.content->refcnt.set (2);
+    }
+
+    u.slice.type = type_slice;
+    u.slice.flags = 0;
+    u.slice.content = buffer_.u.lmsg.content;
+    u.slice.data = (unsigned char*) data_;
+    u.slice.size = size_;
+    return 0;
+}
+
 int xs::msg_t::close ()
 {
     //  Check the validity of the message.
@@ -115,17 +166,14 @@ int xs::msg_t::close ()
         //  If the content is not shared, or if it is shared and the reference
         //  count has dropped to zero, deallocate it.
         if (!(u.lmsg.flags & msg_t::shared) ||
-              !u.lmsg.content->refcnt.sub (1)) {
-
-            //  We used "placement new" operator to initialize the reference
-            //  counter so we call the destructor explicitly now.
-            u.lmsg.content->refcnt.~atomic_counter_t ();
+              !u.lmsg.content->refcnt.sub (1))
+            free_content (u.lmsg.content);
+    }
+    else if (u.base.type == type_slice) {
 
-            if (u.lmsg.content->ffn)
-                u.lmsg.content->ffn (u.lmsg.content->data,
-                    u.lmsg.content->hint);
-            free (u.lmsg.content);
-        }
+        //  Slice always holds a counted reference to the content.
+        if (!u.slice.content->refcnt.sub (1))
+            free_content (u.slice.content);
     }
 
     //  Make the message invalid.
@@ -179,6 +227,8 @@ int xs::msg_t::copy (msg_t &src_)
             src_.u.lmsg.content->refcnt.set (2);
         }
     }
+    else if (src_.u.base.type == type_slice)
+        src_.u.slice.content->refcnt.add (1);
 
     *this = src_;
 
@@ -196,6 +246,8 @@ void *xs::msg_t::data ()
         return u.vsm.data;
     case type_lmsg:
         return u.lmsg.content->data;
+    case type_slice:
+        return u.slice.data;
     default:
         xs_assert (false);
         return NULL;
@@ -212,6 +264,8 @@ size_t xs::msg_t::size ()
         return u.vsm.size;
     case type_lmsg:
         return u.lmsg.content->size;
+    case type_slice:
+        return u.slice.size;
     default:
         xs_assert (false);
         return 0;
@@ -243,6 +297,19 @@ bool xs::msg_t::is_vsm ()
     return u.base.type == type_vsm;
 }
 
+bool xs::msg_t::is_shared ()
+{
+    switch (u.base.type) {
+    case type_lmsg:
+        return (u.lmsg.flags & msg_t::shared) &&
+            u.lmsg.content->refcnt.get () > 1;
+    case type_slice:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void xs::msg_t::add_refs (int refs_)
 {
     xs_assert (refs_ >= 0);
@@ -261,6 +328,8 @@ void xs::msg_t::add_refs (int refs_)
             u.lmsg.flags |= msg_t::shared;
         }
     }
+    else if (u.base.type == type_slice)
+        u.slice.content->refcnt.add (refs_);
 }
 
 bool xs::msg_t::rm_refs (int refs_)
@@ -271,6 +340,16 @@ bool xs::msg_t::rm_refs (int refs_)
     if (!refs_)
         return true;
 
+    //  Slices hold a counted reference even if they are not copied.
+    if (u.base.type == type_slice) {
+        if (!u.slice.content->refcnt.sub (refs_)) {
+            free_content (u.slice.content);
+            u.base.type = 0;
+            return false;
+        }
+        return true;
+    }
+
     //  If there's only one reference close the message.
     if (u.base.type != type_lmsg || !(u.lmsg.flags & msg_t::shared)) {
         close ();
@@ -286,3 +365,17 @@ bool xs::msg_t::rm_refs (int refs_)
     return true;
 }
 
+void xs::msg_t::free_content (content_t *content_)
+{
+    //  We used "placement new" operator to initialize the reference
+    //  counter so we call the destructor explicitly now.
+    content_->refcnt.~atomic_counter_t ();
+
+    if (content_->ffn)
+        content_->ffn (content_->data, content_->hint);
+    if (content_->pool)
+        content_->pool->deallocate (content_, sizeof (content_t) +
+            content_->size, content_->pool_tid);
+    else
+        free (content_);
+}
@@ -25,6 +25,8 @@
 
 #include <stddef.h>
 
+#include "../include/xs.h"
+
 #include "config.hpp"
 #include "atomic_counter.hpp"
 
@@ -39,6 +41,8 @@ extern "C"
 namespace xs
 {
 
+    class msg_pool_t;
+
     //  Note that this structure needs to be explicitly constructed
     //  (init functions) and destructed (close function).
 
@@ -56,10 +60,18 @@ namespace xs
 
         bool check ();
         int init ();
-        int init_size (size_t size_);
+        int init_size (size_t size_, msg_pool_t *pool_ = NULL,
+            uint32_t tid_ = 0);
         int init_data (void *data_, size_t size_, msg_free_fn *ffn_,
             void *hint_);
         int init_delimiter ();
+
+        //  Initialises the message as a view of size_ bytes at data_, which
+        //  must lie within the content of long message buffer_. The message
+        //  shares the content with buffer_ rather than copying the data.
+        //  The content is deallocated once buffer_ and all the messages
+        //  referring to it are closed.
+        int init_slice (msg_t &buffer_, void *data_, size_t size_);
         int close ();
         int move (msg_t &src_);
         int copy (msg_t &src_);
@@ -71,6 +83,10 @@ namespace xs
         bool is_delimiter ();
         bool is_vsm ();
 
+        //  Returns true if the content of the message is referenced by
+        //  other messages as well.
+        bool is_shared ();
+
         //  After calling this function you can copy the message in POD-style
         //  refs_ times. No need to call copy.
         void add_refs (int refs_);
@@ -82,8 +98,9 @@ namespace xs
     private:
 
         //  Size in bytes of the largest message that is still copied around
-        //  rather than being reference-counted.
-        enum {max_vsm_size = 29};
+        //  rather than being reference-counted. The remaining three bytes
+        //  of the structure hold size, type and flags of the message.
+        enum {max_vsm_size = XS_MSG_SIZE - 3};
 
         //  Shared message buffer. Message data are either allocated in one
         //  continuous block along with this structure - thus avoiding one
@@ -91,14 +108,18 @@ namespace xs
         //  In the latter case, ffn member stores pointer to the function to be
         //  used to deallocate the data. If the buffer is actually shared (there
         //  are at least 2 references to it) refcount member contains number of
-        //  references.
+        //  references. If the block was allocated from a message pool, pool
+        //  member points to the pool the block should be returned to and
+        //  pool_tid is the thread slot whose cache it was allocated from.
         struct content_t
         {
             void *data;
             size_t size;
             msg_free_fn *ffn;
             void *hint;
+            msg_pool_t *pool;
             xs::atomic_counter_t refcnt;
+            uint32_t pool_tid;
         };
 
         //  Different message types.
@@ -108,9 +129,13 @@ namespace xs
             type_vsm = 101,
             type_lmsg = 102,
             type_delimiter = 103,
-            type_max = 103
+            type_slice = 104,
+            type_max = 104
         };
 
+        //  Deallocates the content once there are no references to it.
+        static void free_content (content_t *content_);
+
         //  Note that fields shared between different message types are not
         //  moved to tha parent class (msg_t). This way we ger tighter packing
         //  of the data. Shared fields can be accessed via 'base' member of
@@ -138,6 +163,16 @@ namespace xs
                 unsigned char type;
                 unsigned char flags;
             } delimiter;
+            struct {
+                content_t *content;
+                unsigned char *data;
+                size_t size;
+                unsigned char unused [max_vsm_size + 1 -
+                    sizeof (content_t*) - sizeof (unsigned char*) -
+                    sizeof (size_t)];
+                unsigned char type;
+                unsigned char flags;
+            } slice;
         } u;
     };
 
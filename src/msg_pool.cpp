@@ -0,0 +1,156 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <new>
+
+#include "msg_pool.hpp"
+#include "likely.hpp"
+#include "err.hpp"
+
+xs::msg_pool_t::msg_pool_t (uint32_t slot_count_) :
+    slot_count (slot_count_),
+    refs (1)
+{
+    caches = (atomic_ptr_t <cache_t>*) malloc (
+        sizeof (atomic_ptr_t <cache_t>) * slot_count);
+    alloc_assert (caches);
+    for (uint32_t i = 0; i != slot_count; i++)
+        new (&caches [i]) atomic_ptr_t <cache_t> ();
+}
+
+xs::msg_pool_t::~msg_pool_t ()
+{
+    for (uint32_t i = 0; i != slot_count; i++) {
+        cache_t *cache = caches [i].load ();
+        if (cache) {
+            for (int j = 0; j != bucket_count; j++) {
+                free_list (cache->free [j]);
+                free_list (cache->returned [j].xchg (NULL));
+            }
+            delete cache;
+        }
+        caches [i].~atomic_ptr_t <cache_t> ();
+    }
+    free (caches);
+}
+
+int xs::msg_pool_t::bucket_index (size_t size_)
+{
+    size_t block_size = min_block_size;
+    for (int i = 0; i != bucket_count; i++) {
+        if (size_ <= block_size)
+            return i;
+        block_size *= 4;
+    }
+    return -1;
+}
+
+void xs::msg_pool_t::free_list (block_t *block_)
+{
+    while (block_) {
+        block_t *next = block_->next;
+        free (block_);
+        block_ = next;
+    }
+}
+
+void *xs::msg_pool_t::allocate (size_t size_, uint32_t tid_)
+{
+    int index = bucket_index (size_);
+    if (index < 0)
+        return NULL;
+
+    //  Create the cache for this thread slot, if it doesn't exist yet.
+    //  Nobody but the owner can create it, so there's no race here.
+    xs_assert (tid_ < slot_count);
+    cache_t *cache = caches [tid_].load ();
+    if (unlikely (!cache)) {
+        cache = new (std::nothrow) cache_t;
+        alloc_assert (cache);
+        for (int i = 0; i != bucket_count; i++)
+            cache->free [i] = NULL;
+        caches [tid_].store (cache);
+    }
+
+    //  If there are no free blocks, grab all the returned ones.
+    block_t *block = cache->free [index];
+    if (!block)
+        block = cache->returned [index].xchg (NULL);
+    if (block) {
+        cache->free [index] = block->next;
+        cache->hits.add (1);
+    }
+    else {
+
+        //  The pool is empty. Allocate a new block of the full class size
+        //  so that it can be reused for any message within the class.
+        block = (block_t*) malloc ((size_t) min_block_size << (2 * index));
+        if (!block)
+            return NULL;
+        cache->misses.add (1);
+    }
+
+    //  The first outstanding block of the cache keeps the pool alive.
+    if (cache->used.add (1) == 0)
+        refs.add (1);
+    return block;
+}
+
+void xs::msg_pool_t::deallocate (void *block_, size_t size_, uint32_t tid_)
+{
+    int index = bucket_index (size_);
+    xs_assert (index >= 0);
+    cache_t *cache = caches [tid_].load ();
+    xs_assert (cache);
+
+    //  Push the block to the list of returned blocks.
+    block_t *block = (block_t*) block_;
+    block_t *head = NULL;
+    while (true) {
+        block->next = head;
+        block_t *old = cache->returned [index].cas (head, block);
+        if (old == head)
+            break;
+        head = old;
+    }
+
+    if (!cache->used.sub (1) && !refs.sub (1))
+        delete this;
+}
+
+void xs::msg_pool_t::release ()
+{
+    if (!refs.sub (1))
+        delete this;
+}
+
+void xs::msg_pool_t::get_stats (uint64_t *hits_, uint64_t *misses_)
+{
+    *hits_ = 0;
+    *misses_ = 0;
+    for (uint32_t i = 0; i != slot_count; i++) {
+        cache_t *cache = caches [i].load ();
+        if (cache) {
+            *hits_ += cache->hits.get ();
+            *misses_ += cache->misses.get ();
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_MSG_POOL_HPP_INCLUDED__
+#define __XS_MSG_POOL_HPP_INCLUDED__
+
+#include <stddef.h>
+
+#include "stdint.hpp"
+#include "config.hpp"
+#include "atomic_ptr.hpp"
+#include "atomic_counter.hpp"
+
+namespace xs
+{
+
+    //  Context-wide pool of memory blocks used for message content. Blocks
+    //  are grouped into several size classes. Blocks larger than the largest
+    //  size class are not pooled.
+    //
+    //  Each thread slot (I/O thread or socket) allocates from a cache of its
+    //  own. Cache is only ever accessed by a single thread at a time, so the
+    //  allocation doesn't need any synchronisation. Messages are typically
+    //  deallocated in a different thread than the one they were allocated in
+    //  (e.g. allocated by the decoder in an I/O thread, deallocated in the
+    //  application thread). Returned block is thus pushed to the lock-free
+    //  list of returned blocks of the cache it was allocated from. The owner
+    //  of the cache picks up all the returned blocks at once when its own
+    //  list of free blocks is exhausted.
+    //
+    //  The pool is reference counted. Each cache with outstanding blocks
+    //  holds a reference so that the messages can outlive the context that
+    //  created them.
+
+    class msg_pool_t
+    {
+    public:
+
+        //  slot_count_ is the number of thread slots in the context.
+        msg_pool_t (uint32_t slot_count_);
+
+        //  Returns a block of at least size_ bytes from the cache of thread
+        //  slot tid_. If the size is not pooled, NULL is returned and
+        //  the caller should use malloc instead.
+        void *allocate (size_t size_, uint32_t tid_);
+
+        //  Returns the block to the pool. size_ and tid_ must be the same
+        //  as the ones used when the block was allocated. Can be called from
+        //  any thread.
+        void deallocate (void *block_, size_t size_, uint32_t tid_);
+
+        //  Drops the reference held by the owner of the pool. The pool is
+        //  deallocated once all the blocks are returned.
+        void release ();
+
+        //  Number of allocations satisfied from the pool (hits) and number
+        //  of allocations that had to fall back to malloc (misses).
+        void get_stats (uint64_t *hits_, uint64_t *misses_);
+
+    private:
+
+        ~msg_pool_t ();
+
+        //  Size of the smallest size class. Each subsequent class
+        //  is four times larger than the preceding one.
+        enum {
+            min_block_size = 256,
+            bucket_count = 4
+        };
+
+        //  Free block in a list.
+        struct block_t
+        {
+            block_t *next;
+        };
+
+        //  Blocks owned by a single thread slot.
+        struct cache_t
+        {
+            //  Blocks returned to the pool. Pushed to without locking.
+            //  Kept apart from the rest of the cache as it is written to
+            //  by other threads.
+            atomic_ptr_t <block_t> returned [bucket_count];
+            unsigned char unused [cache_line_size -
+                bucket_count * sizeof (atomic_ptr_t <block_t>) %
+                cache_line_size];
+
+            //  Free blocks available for allocation. Accessed by the owner
+            //  of the cache only.
+            block_t *free [bucket_count];
+
+            //  Number of blocks allocated from the cache and not yet
+            //  returned to it.
+            atomic_counter_t used;
+
+            //  Statistics. Updated by the owner of the cache only, however,
+            //  they can be read from any thread.
+            atomic_counter_t hits;
+            atomic_counter_t misses;
+        };
+
+        //  Returns index of the size class for the given size or -1 if
+        //  the size is not pooled.
+        static int bucket_index (size_t size_);
+
+        //  Deallocates all the blocks in the list.
+        static void free_list (block_t *block_);
+
+        //  Caches of individual thread slots. Cache is created by its owner
+        //  when it allocates for the first time.
+        uint32_t slot_count;
+        atomic_ptr_t <cache_t> *caches;
+
+        //  One reference is held by the owner, one by each cache that has
+        //  outstanding blocks.
+        atomic_counter_t refs;
+
+        msg_pool_t (const msg_pool_t&);
+        const msg_pool_t &operator = (const msg_pool_t&);
+    };
+
+}
+
+#endif
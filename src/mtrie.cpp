@@ -20,8 +20,8 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
-#include <new>
 #include <algorithm>
 
 #include "platform.hpp"
@@ -32,405 +32,380 @@
 #include "err.hpp"
 #include "pipe.hpp"
 #include "mtrie.hpp"
+#include "simd.hpp"
 
-xs::mtrie_t::mtrie_t () :
-    pipes (0),
-    min (0),
-    count (0),
-    live_nodes (0)
+xs::mtrie_t::mtrie_t ()
 {
+    root = alloc_node (NULL, 0);
 }
 
 xs::mtrie_t::~mtrie_t ()
 {
-    if (pipes) {
-        delete pipes;
-        pipes = 0;
-    }
-
-    if (count == 1) {
-        xs_assert (next.node);
-        delete next.node;
-        next.node = 0;
-    }
-    else if (count > 1) {
-        for (unsigned short i = 0; i != count; ++i)
-            if (next.table [i])
-                delete next.table [i];
-        free (next.table);
-    }
+    free_node (root);
 }
 
 bool xs::mtrie_t::add (unsigned char *prefix_, size_t size_, pipe_t *pipe_)
 {
-    return add_helper (prefix_, size_, pipe_);
-}
-
-bool xs::mtrie_t::add_helper (unsigned char *prefix_, size_t size_,
-    pipe_t *pipe_)
-{
-    //  We are at the node corresponding to the prefix. We are done.
-    if (!size_) {
-        bool result = !pipes;
-        if (!pipes)
-            pipes = new pipes_t;
-        pipes->insert (pipe_);
-        return result;
-    }
-
-    unsigned char c = *prefix_;
-    if (c < min || c >= min + count) {
-
-        //  The character is out of range of currently handled
-        //  charcters. We have to extend the table.
-        if (!count) {
-            min = c;
-            count = 1;
-            next.node = NULL;
-        }
-        else if (count == 1) {
-            unsigned char oldc = min;
-            mtrie_t *oldp = next.node;
-            count = (min < c ? c - min : min - c) + 1;
-            next.table = (mtrie_t**)
-                malloc (sizeof (mtrie_t*) * count);
-            xs_assert (next.table);
-            for (unsigned short i = 0; i != count; ++i)
-                next.table [i] = 0;
-            min = std::min (min, c);
-            next.table [oldc - min] = oldp;
+    node_t **slot = &root;
+    while (size_) {
+        node_t *node = *slot;
+
+        //  If there's no subnode for the next character, create a new leaf
+        //  node labeled by the rest of the prefix.
+        int index = find (node, *prefix_);
+        if (index < 0) {
+            node_t *leaf = alloc_node (prefix_, size_);
+            *slot = insert (node, leaf);
+            leaf->pipes.insert (pipe_);
+            return true;
         }
-        else if (min < c) {
-
-            //  The new character is above the current character range.
-            unsigned short old_count = count;
-            count = c - min + 1;
-            next.table = (mtrie_t**) realloc ((void*) next.table,
-                sizeof (mtrie_t*) * count);
-            xs_assert (next.table);
-            for (unsigned short i = old_count; i != count; i++)
-                next.table [i] = NULL;
-        }
-        else {
-
-            //  The new character is below the current character range.
-            unsigned short old_count = count;
-            count = (min + old_count) - c;
-            next.table = (mtrie_t**) realloc ((void*) next.table,
-                sizeof (mtrie_t*) * count);
-            xs_assert (next.table);
-            memmove (next.table + min - c, next.table,
-                old_count * sizeof (mtrie_t*));
-            for (unsigned short i = 0; i != min - c; i++)
-                next.table [i] = NULL;
-            min = c;
-        }
-    }
 
-    //  If next node does not exist, create one.
-    if (count == 1) {
-        if (!next.node) {
-            next.node = new (std::nothrow) mtrie_t;
-            ++live_nodes;
-            xs_assert (next.node);
+        //  Find out how much of the subnode's label matches the prefix.
+        //  The first character is already known to match.
+        node_t *subnode = next (node) [index];
+        size_t common = 1;
+        size_t max = std::min ((size_t) subnode->size, size_);
+        while (common != max && subnode->label [common] == prefix_ [common])
+            ++common;
+
+        //  If the prefix diverges from the label or ends in the middle of it
+        //  split the subnode into two.
+        if (common < subnode->size) {
+            node_t *split = alloc_node (prefix_, common);
+            subnode = realloc_node (subnode, NULL, 0, common,
+                subnode->capacity);
+            next (node) [index] = insert (split, subnode);
         }
-        return next.node->add_helper (prefix_ + 1, size_ - 1, pipe_);
-    }
-    else {
-        if (!next.table [c - min]) {
-            next.table [c - min] = new (std::nothrow) mtrie_t;
-            ++live_nodes;
-            xs_assert (next.table [c - min]);
-        }
-        return next.table [c - min]->add_helper (prefix_ + 1, size_ - 1, pipe_);
+
+        slot = &next (node) [index];
+        prefix_ += common;
+        size_ -= common;
     }
-}
 
+    //  We are at the node corresponding to the prefix.
+    bool result = !(*slot)->pipes.size;
+    (*slot)->pipes.insert (pipe_);
+    return result;
+}
 
 void xs::mtrie_t::rm (pipe_t *pipe_,
     void (*func_) (unsigned char *data_, size_t size_, void *arg_),
     void *arg_)
 {
-    unsigned char *buff = NULL;
-    rm_helper (pipe_, &buff, 0, 0, func_, arg_);
+    size_t maxbuffsize = 256;
+    unsigned char *buff = (unsigned char*) malloc (maxbuffsize);
+    alloc_assert (buff);
+    rm_helper (root, pipe_, &buff, 0, &maxbuffsize, func_, arg_);
     free (buff);
 }
 
-void xs::mtrie_t::rm_helper (pipe_t *pipe_, unsigned char **buff_,
-    size_t buffsize_, size_t maxbuffsize_,
+void xs::mtrie_t::rm_helper (node_t *node_, pipe_t *pipe_,
+    unsigned char **buff_, size_t buffsize_, size_t *maxbuffsize_,
     void (*func_) (unsigned char *data_, size_t size_, void *arg_),
     void *arg_)
 {
+    //  Append the label of the node to the buffer.
+    if (buffsize_ + node_->size > *maxbuffsize_) {
+        *maxbuffsize_ = buffsize_ + node_->size + 256;
+        *buff_ = (unsigned char*) realloc (*buff_, *maxbuffsize_);
+        alloc_assert (*buff_);
+    }
+    memcpy (*buff_ + buffsize_, node_->label, node_->size);
+    buffsize_ += node_->size;
+
     //  Remove the subscription from this node.
-    if (pipes && pipes->erase (pipe_) && pipes->empty ()) {
+    if (node_->pipes.erase (pipe_) && !node_->pipes.size)
         func_ (*buff_, buffsize_, arg_);
-        delete pipes;
-        pipes = 0;
-    }
 
-    //  Adjust the buffer.
-    if (buffsize_ >= maxbuffsize_) {
-        maxbuffsize_ = buffsize_ + 256;
-        *buff_ = (unsigned char*) realloc (*buff_, maxbuffsize_);
-        alloc_assert (*buff_);
+    //  Process the subnodes and prune those made redundant by the removal.
+    int index = 0;
+    while (index != node_->count) {
+        rm_helper (next (node_) [index], pipe_, buff_, buffsize_,
+            maxbuffsize_, func_, arg_);
+        if (!compact (node_, index))
+            ++index;
     }
+}
 
-    //  If there are no subnodes in the trie, return.
-    if (count == 0)
-        return;
-
-    //  If there's one subnode (optimisation).
-    if (count == 1) {
-        (*buff_) [buffsize_] = min;
-        buffsize_++;
-        next.node->rm_helper (pipe_, buff_, buffsize_, maxbuffsize_,
-            func_, arg_);
-
-        //  Prune the node if it was made redundant by the removal
-        if (next.node->is_redundant ()) {
-            delete next.node;
-            next.node = 0;
-            count = 0;
-            --live_nodes;
-            xs_assert (live_nodes == 0);
-        }
-        return;
-    }
+bool xs::mtrie_t::rm (unsigned char *prefix_, size_t size_, pipe_t *pipe_)
+{
+    return rm_helper (root, prefix_, size_, pipe_);
+}
 
-    //  If there are multiple subnodes.
-    //
-    //  New min non-null character in the node table after the removal
-    unsigned char new_min = min + count - 1;
-    //  New max non-null character in the node table after the removal
-    unsigned char new_max = min;
-    for (unsigned short c = 0; c != count; c++) {
-        (*buff_) [buffsize_] = min + c;
-        if (next.table [c]) {
-            next.table [c]->rm_helper (pipe_, buff_, buffsize_ + 1,
-                maxbuffsize_, func_, arg_);
-
-            //  Prune redundant nodes from the mtrie
-            if (next.table [c]->is_redundant ()) {
-                delete next.table [c];
-                next.table [c] = 0;
-
-                xs_assert (live_nodes > 0);
-                --live_nodes;
-            }
-            else {
-                //  The node is not redundant, so it's a candidate for being
-                //  the new min/max node.
-                //
-                //  We loop through the node array from left to right, so the
-                //  first non-null, non-redundant node encountered is the new
-                //  minimum index. Conversely, the last non-redundant, non-null
-                //  node encountered is the new maximum index.
-                if (c + min < new_min)
-                    new_min = c + min;
-                if (c + min > new_max)
-                    new_max = c + min;
-            }
-        }
-    }
+bool xs::mtrie_t::rm_helper (node_t *node_, unsigned char *prefix_,
+    size_t size_, pipe_t *pipe_)
+{
+    if (!size_)
+        return node_->pipes.erase (pipe_) && !node_->pipes.size;
 
-    xs_assert (count > 1);
-
-    //  Compact the node table if possible
-    if (live_nodes == 1) {
-        //  If there's only one live node in the table we can
-        //  switch to using the more compact single-node
-        //  representation
-        xs_assert (new_min == new_max);
-        xs_assert (new_min >= min && new_min < min + count);
-        mtrie_t *node = next.table [new_min - min];
-        xs_assert (node);
-        free (next.table);
-        next.node = node;
-        count = 1;
-        min = new_min;
-    }
-    else if (live_nodes > 1 && (new_min > min || new_max < min + count - 1)) {
-        xs_assert (new_max - new_min + 1 > 1);
+    int index = find (node_, *prefix_);
+    if (index < 0)
+        return false;
+    node_t *subnode = next (node_) [index];
+    if (subnode->size > size_ ||
+          memcmp (subnode->label, prefix_, subnode->size) != 0)
+        return false;
 
-        mtrie_t **old_table = next.table;
-        xs_assert (new_min > min || new_max < min + count - 1);
-        xs_assert (new_min >= min);
-        xs_assert (new_max <= min + count - 1);
-        xs_assert (new_max - new_min + 1 < count);
+    bool ret = rm_helper (subnode, prefix_ + subnode->size,
+        size_ - subnode->size, pipe_);
+    compact (node_, index);
+    return ret;
+}
 
-        count = new_max - new_min + 1;
-        next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-        xs_assert (next.table);
+void xs::mtrie_t::match (unsigned char *data_, size_t size_,
+    void (*func_) (pipe_t *pipe_, void *arg_), void *arg_)
+{
+    node_t *current = root;
+    while (true) {
 
-        memmove (next.table, old_table + (new_min - min),
-                 sizeof (mtrie_t*) * count);
-        free (old_table);
+        //  Signal the pipes attached to this node.
+        pipe_t **pipes = current->pipes.data ();
+        for (uint32_t i = 0; i != current->pipes.size; i++)
+            func_ (pipes [i], arg_);
 
-        min = new_min;
+        //  If we are at the end of the message, there's nothing more to match.
+        if (!size_)
+            break;
+
+        //  Find the subnode for the next character.
+        int index = find (current, *data_);
+        if (index < 0)
+            break;
+        current = next (current) [index];
+
+        //  The whole label of the subnode has to match. The first character
+        //  is already known to match.
+        if (current->size > size_ || memcmp (current->label + 1, data_ + 1,
+              current->size - 1) != 0)
+            break;
+        data_ += current->size;
+        size_ -= current->size;
     }
 }
 
-bool xs::mtrie_t::rm (unsigned char *prefix_, size_t size_, pipe_t *pipe_)
+xs::mtrie_t::node_t *xs::mtrie_t::alloc_node (const unsigned char *label_,
+    size_t size_)
+{
+    xs_assert (size_ <= 0xffffffff);
+    node_t *node = (node_t*) malloc (keys_offset (size_));
+    alloc_assert (node);
+    node->pipes.init ();
+    node->size = (uint32_t) size_;
+    node->count = 0;
+    node->capacity = 0;
+    if (size_)
+        memcpy (node->label, label_, size_);
+    return node;
+}
+
+void xs::mtrie_t::free_node (node_t *node_)
 {
-    return rm_helper (prefix_, size_, pipe_);
+    for (unsigned short i = 0; i != node_->count; i++)
+        free_node (next (node_) [i]);
+    node_->pipes.destroy ();
+    free (node_);
 }
 
-bool xs::mtrie_t::rm_helper (unsigned char *prefix_, size_t size_,
-    pipe_t *pipe_)
+xs::mtrie_t::node_t *xs::mtrie_t::realloc_node (node_t *node_,
+    const unsigned char *prefix_, size_t prefix_size_, size_t skip_,
+    unsigned short capacity_)
 {
-    if (!size_) {
-        if (pipes) {
-            pipes_t::size_type erased = pipes->erase (pipe_);
-            xs_assert (erased == 1);
-            if (pipes->empty ()) {
-                delete pipes;
-                pipes = 0;
-            }
+    xs_assert (capacity_ >= node_->count);
+    size_t size = prefix_size_ + node_->size - skip_;
+    xs_assert (size <= 0xffffffff);
+    node_t *node = (node_t*) malloc (keys_offset (size) +
+        (capacity_ ? keys_size (capacity_) + sizeof (node_t*) * capacity_ : 0));
+    alloc_assert (node);
+
+    //  The set of pipes can be moved using memcpy.
+    node->pipes = node_->pipes;
+    node->size = (uint32_t) size;
+    node->count = node_->count;
+    node->capacity = capacity_;
+    if (prefix_size_)
+        memcpy (node->label, prefix_, prefix_size_);
+    memcpy (node->label + prefix_size_, node_->label + skip_,
+        node_->size - skip_);
+    if (capacity_) {
+        memset (keys (node), 0, keys_size (capacity_));
+        if (node_->count) {
+            memcpy (keys (node), keys (node_), node_->count);
+            memcpy (next (node), next (node_),
+                sizeof (node_t*) * node_->count);
         }
-        return !pipes;
     }
 
-    unsigned char c = *prefix_;
-    if (!count || c < min || c >= min + count)
-        return false;
+    free (node_);
+    return node;
+}
 
-    mtrie_t *next_node =
-        count == 1 ? next.node : next.table [c - min];
+size_t xs::mtrie_t::keys_offset (size_t size_)
+{
+    //  Keep the array of characters and the array of pointers aligned.
+    return (offsetof (node_t, label) + size_ + 15) & ~((size_t) 15);
+}
 
-    if (!next_node)
-        return false;
+size_t xs::mtrie_t::keys_size (unsigned short capacity_)
+{
+    //  The array of characters is padded so that it can be read
+    //  16 bytes at a time.
+    return capacity_ < 16 ? 16 : capacity_;
+}
 
-    bool ret = next_node->rm_helper (prefix_ + 1, size_ - 1, pipe_);
+unsigned char *xs::mtrie_t::keys (node_t *node_)
+{
+    return ((unsigned char*) node_) + keys_offset (node_->size);
+}
 
-    if (next_node->is_redundant ()) {
-        delete next_node;
-        xs_assert (count > 0);
+xs::mtrie_t::node_t **xs::mtrie_t::next (node_t *node_)
+{
+    return (node_t**) (keys (node_) + keys_size (node_->capacity));
+}
 
-        if (count == 1) {
-            next.node = 0;
-            count = 0;
-            --live_nodes;
-            xs_assert (live_nodes == 0);
-        }
-        else {
-            next.table [c - min] = 0;
-            xs_assert (live_nodes > 1);
-            --live_nodes;
-
-            //  Compact the table if possible
-            if (live_nodes == 1) {
-                //  If there's only one live node in the table we can
-                //  switch to using the more compact single-node
-                //  representation
-                mtrie_t *node = 0;
-                for (unsigned short i = 0; i < count; ++i) {
-                    if (next.table [i]) {
-                        node = next.table [i];
-                        min = i + min;
-                        break;
-                    }
-                }
-
-                xs_assert (node);
-                free (next.table);
-                next.node = node;
-                count = 1;
-            }
-            else if (c == min) {
-                //  We can compact the table "from the left"
-                unsigned char new_min = min;
-                for (unsigned short i = 1; i < count; ++i) {
-                    if (next.table [i]) {
-                        new_min = i + min;
-                        break;
-                    }
-                }
-                xs_assert (new_min != min);
-
-                mtrie_t **old_table = next.table;
-                xs_assert (new_min > min);
-                xs_assert (count > new_min - min);
-
-                count = count - (new_min - min);
-                next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-                xs_assert (next.table);
-
-                memmove (next.table, old_table + (new_min - min),
-                         sizeof (mtrie_t*) * count);
-                free (old_table);
-
-                min = new_min;
-            }
-            else if (c == min + count - 1) {
-                //  We can compact the table "from the right"
-                unsigned short new_count = count;
-                for (unsigned short i = 1; i < count; ++i) {
-                    if (next.table [count - 1 - i]) {
-                        new_count = count - i;
-                        break;
-                    }
-                }
-                xs_assert (new_count != count);
-                count = new_count;
-
-                mtrie_t **old_table = next.table;
-                next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-                xs_assert (next.table);
-
-                memmove (next.table, old_table, sizeof (mtrie_t*) * count);
-                free (old_table);
-            }
+int xs::mtrie_t::find (node_t *node_, unsigned char c_)
+{
+    unsigned char *k = keys (node_);
+#if defined XS_HAVE_SSE2
+    //  Compare 16 characters at a time. The padding at the end of the array
+    //  may contain a matching character, however, as the characters are
+    //  unique, a match in the padding is found only if there's no match
+    //  in the actual array.
+    __m128i c = _mm_set1_epi8 ((char) c_);
+    for (int i = 0; i < node_->count; i += 16) {
+        __m128i block = _mm_loadu_si128 ((const __m128i*) (k + i));
+        int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (c, block));
+        if (mask) {
+            int index = i + lowest_bit (mask);
+            return index < node_->count ? index : -1;
         }
     }
+#else
+    for (int i = 0; i != node_->count; i++)
+        if (k [i] == c_)
+            return i;
+#endif
+    return -1;
+}
 
-    return ret;
+xs::mtrie_t::node_t *xs::mtrie_t::insert (node_t *node_, node_t *subnode_)
+{
+    //  Grow the arrays if needed.
+    if (node_->count == node_->capacity)
+        node_ = realloc_node (node_, NULL, 0, 0,
+            node_->capacity ? node_->capacity * 2 : 2);
+
+    //  Keep the subnodes sorted by the first character.
+    unsigned char c = subnode_->label [0];
+    unsigned char *k = keys (node_);
+    node_t **n = next (node_);
+    int pos = 0;
+    while (pos != node_->count && k [pos] < c)
+        ++pos;
+    memmove (k + pos + 1, k + pos, node_->count - pos);
+    memmove (n + pos + 1, n + pos, sizeof (node_t*) * (node_->count - pos));
+    k [pos] = c;
+    n [pos] = subnode_;
+    ++node_->count;
+    return node_;
 }
 
-void xs::mtrie_t::match (unsigned char *data_, size_t size_,
-    void (*func_) (pipe_t *pipe_, void *arg_), void *arg_)
+void xs::mtrie_t::remove (node_t *node_, int index_)
 {
-    mtrie_t *current = this;
-    while (true) {
+    unsigned char *k = keys (node_);
+    node_t **n = next (node_);
+    memmove (k + index_, k + index_ + 1, node_->count - index_ - 1);
+    memmove (n + index_, n + index_ + 1,
+        sizeof (node_t*) * (node_->count - index_ - 1));
+    --node_->count;
+    k [node_->count] = 0;
+}
 
-        //  Signal the pipes attached to this node.
-        if (current->pipes) {
-            for (pipes_t::iterator it = current->pipes->begin ();
-                  it != current->pipes->end (); ++it)
-                func_ (*it, arg_);
-        }
+bool xs::mtrie_t::compact (node_t *node_, int index_)
+{
+    node_t *subnode = next (node_) [index_];
 
-        //  If we are at the end of the message, there's nothing more to match.
-        if (!size_)
-            break;
+    if (!subnode->pipes.size) {
 
-        //  If there are no subnodes in the trie, return.
-        if (current->count == 0)
-            break;
+        //  Prune the subnode with no pipes and no subnodes.
+        if (!subnode->count) {
+            free_node (subnode);
+            remove (node_, index_);
+            return true;
+        }
 
-        //  If there's one subnode (optimisation).
-		if (current->count == 1) {
-            if (data_ [0] != current->min)
-                break;
-            current = current->next.node;
-            data_++;
-            size_--;
-		    continue;
-		}
-
-		//  If there are multiple subnodes.
-        if (data_ [0] < current->min || data_ [0] >=
-              current->min + current->count)
-            break;
-        if (!current->next.table [data_ [0] - current->min])
-            break;
-        current = current->next.table [data_ [0] - current->min];
-        data_++;
-        size_--;
+        //  Merge the subnode with no pipes with its only subnode.
+        if (subnode->count == 1) {
+            node_t *child = next (subnode) [0];
+            child = realloc_node (child, subnode->label, subnode->size, 0,
+                child->capacity);
+            subnode->count = 0;
+            free_node (subnode);
+            next (node_) [index_] = child;
+            return false;
+        }
     }
+
+    //  Release the arrays of the subnode with no subnodes left.
+    if (!subnode->count && subnode->capacity)
+        next (node_) [index_] = realloc_node (subnode, NULL, 0, 0, 0);
+
+    return false;
+}
+
+void xs::mtrie_t::pipes_t::init ()
+{
+    size = 0;
+    capacity = inline_capacity;
+}
+
+void xs::mtrie_t::pipes_t::destroy ()
+{
+    if (capacity > inline_capacity)
+        free (items.heap);
 }
 
-bool xs::mtrie_t::is_redundant () const
+xs::pipe_t **xs::mtrie_t::pipes_t::data ()
 {
-    return !pipes && live_nodes == 0;
+    return capacity > inline_capacity ? items.heap : items.local;
 }
 
+bool xs::mtrie_t::pipes_t::insert (pipe_t *pipe_)
+{
+    pipe_t **p = data ();
+    uint32_t pos = (uint32_t) (std::lower_bound (p, p + size, pipe_) - p);
+    if (pos != size && p [pos] == pipe_)
+        return false;
+
+    if (size == capacity) {
+        pipe_t **heap = (pipe_t**) malloc (sizeof (pipe_t*) * capacity * 2);
+        alloc_assert (heap);
+        memcpy (heap, p, sizeof (pipe_t*) * size);
+        destroy ();
+        items.heap = heap;
+        capacity *= 2;
+        p = heap;
+    }
+
+    memmove (p + pos + 1, p + pos, sizeof (pipe_t*) * (size - pos));
+    p [pos] = pipe_;
+    ++size;
+    return true;
+}
+
+bool xs::mtrie_t::pipes_t::erase (pipe_t *pipe_)
+{
+    pipe_t **p = data ();
+    uint32_t pos = (uint32_t) (std::lower_bound (p, p + size, pipe_) - p);
+    if (pos == size || p [pos] != pipe_)
+        return false;
+
+    memmove (p + pos, p + pos + 1, sizeof (pipe_t*) * (size - pos - 1));
+    --size;
+
+    //  Release the memory once the set is empty.
+    if (!size && capacity > inline_capacity) {
+        free (items.heap);
+        capacity = inline_capacity;
+    }
+    return true;
+}
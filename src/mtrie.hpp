@@ -23,7 +23,6 @@
 #define __XS_MTRIE_HPP_INCLUDED__
 
 #include <stddef.h>
-#include <set>
 
 #include "stdint.hpp"
 
@@ -33,6 +32,9 @@ namespace xs
     class pipe_t;
 
     //  Multi-trie. Each node in the trie is a set of pointers to pipes.
+    //  The trie is path-compressed, i.e. chains of nodes with a single
+    //  subnode and no pipes are merged into a single node labeled by
+    //  the whole chain of characters.
 
     class mtrie_t
     {
@@ -62,26 +64,93 @@ namespace xs
 
     private:
 
-        bool add_helper (unsigned char *prefix_, size_t size_,
-            xs::pipe_t *pipe_);
-        void rm_helper (xs::pipe_t *pipe_, unsigned char **buff_,
-            size_t buffsize_, size_t maxbuffsize_,
+        //  Set of pipes attached to a node. The set is kept sorted so that
+        //  it can be searched using binary search. Small sets are stored
+        //  directly in the structure. The structure contains no pointers
+        //  to itself and thus it can be moved using memcpy or realloc.
+        struct pipes_t
+        {
+            enum {inline_capacity = 2};
+
+            union {
+                xs::pipe_t *local [inline_capacity];
+                xs::pipe_t **heap;
+            } items;
+            uint32_t size;
+            uint32_t capacity;
+
+            void init ();
+            void destroy ();
+            xs::pipe_t **data ();
+
+            //  Returns false if the pipe is already in the set.
+            bool insert (xs::pipe_t *pipe_);
+
+            //  Returns false if the pipe is not in the set.
+            bool erase (xs::pipe_t *pipe_);
+        };
+
+        //  Node of the trie. The label of the node is the sequence of
+        //  characters leading from the parent node to this node. Subnodes
+        //  are kept sorted by the first character of their labels. The
+        //  first characters are stored in a separate array so that they can
+        //  be searched for using few SIMD instructions. The label, the array
+        //  of first characters and the array of subnode pointers are stored
+        //  in the same memory block as the node itself, so that matching
+        //  a single node touches as few cache lines as possible. As a
+        //  consequence, the node has to be reallocated when its label
+        //  changes or when the arrays grow.
+        struct node_t
+        {
+            pipes_t pipes;
+            uint32_t size;
+            unsigned short count;
+            unsigned short capacity;
+            unsigned char label [1];
+        };
+
+        static node_t *alloc_node (const unsigned char *label_, size_t size_);
+        static void free_node (node_t *node_);
+
+        //  Moves the node to a new memory block. The new label is 'prefix_'
+        //  followed by the current label with first 'skip_' characters
+        //  removed. The arrays are resized to hold 'capacity_' subnodes.
+        //  Returns the new location of the node.
+        static node_t *realloc_node (node_t *node_,
+            const unsigned char *prefix_, size_t prefix_size_, size_t skip_,
+            unsigned short capacity_);
+
+        //  Layout of the node's memory block.
+        static size_t keys_offset (size_t size_);
+        static size_t keys_size (unsigned short capacity_);
+        static unsigned char *keys (node_t *node_);
+        static node_t **next (node_t *node_);
+
+        //  Returns the index of the subnode whose label starts with
+        //  the specified character or -1 if there is no such subnode.
+        static int find (node_t *node_, unsigned char c_);
+
+        //  Inserts the subnode to the node. Returns the new location
+        //  of the node.
+        static node_t *insert (node_t *node_, node_t *subnode_);
+
+        //  Removes the subnode at the specified index from the node.
+        static void remove (node_t *node_, int index_);
+
+        //  Deletes, merges or shrinks the subnode at the specified index if
+        //  it's made redundant by a removal. Returns true if the subnode was
+        //  deleted.
+        static bool compact (node_t *node_, int index_);
+
+        void rm_helper (node_t *node_, xs::pipe_t *pipe_,
+            unsigned char **buff_, size_t buffsize_, size_t *maxbuffsize_,
             void (*func_) (unsigned char *data_, size_t size_, void *arg_),
             void *arg_);
-        bool rm_helper (unsigned char *prefix_, size_t size_,
+        bool rm_helper (node_t *node_, unsigned char *prefix_, size_t size_,
             xs::pipe_t *pipe_);
-        bool is_redundant () const;
-
-        typedef std::set <xs::pipe_t*> pipes_t;
-        pipes_t *pipes;
 
-        unsigned char min;
-        unsigned short count;
-        unsigned short live_nodes;
-        union {
-            class mtrie_t *node;
-            class mtrie_t **table;
-        } next;
+        //  The root node. Its label is always empty.
+        node_t *root;
 
         mtrie_t (const mtrie_t&);
         const mtrie_t &operator = (const mtrie_t&);
@@ -90,4 +159,3 @@ namespace xs
 }
 
 #endif
-
@@ -65,7 +65,8 @@ void xs::object_t::process_command (command_t &cmd_)
         break;
 
     case command_t::activate_write:
-        process_activate_write (cmd_.args.activate_write.msgs_read);
+        process_activate_write (cmd_.args.activate_write.msgs_read,
+            cmd_.args.activate_write.bytes_read);
         break;
 
     case command_t::stop:
@@ -149,11 +150,18 @@ void xs::object_t::destroy_socket (socket_base_t *socket_)
     ctx->destroy_socket (socket_);
 }
 
-xs::io_thread_t *xs::object_t::choose_io_thread (uint64_t affinity_)
+xs::io_thread_t *xs::object_t::choose_io_thread (
+    const std::vector <uint64_t> &affinity_)
 {
     return ctx->choose_io_thread (affinity_);
 }
 
+void xs::object_t::get_io_threads (const std::vector <uint64_t> &affinity_,
+    std::vector <io_thread_t*> &io_threads_)
+{
+    ctx->get_io_threads (affinity_, io_threads_);
+}
+
 void xs::object_t::send_stop ()
 {
     //  'stop' command goes always from administrative thread to
@@ -238,7 +246,7 @@ void xs::object_t::send_activate_read (pipe_t *destination_)
 }
 
 void xs::object_t::send_activate_write (pipe_t *destination_,
-    uint64_t msgs_read_)
+    uint64_t msgs_read_, uint64_t bytes_read_)
 {
     command_t cmd;
 #if defined XS_MAKE_VALGRIND_HAPPY
@@ -247,6 +255,7 @@ void xs::object_t::send_activate_write (pipe_t *destination_,
     cmd.destination = destination_;
     cmd.type = command_t::activate_write;
     cmd.args.activate_write.msgs_read = msgs_read_;
+    cmd.args.activate_write.bytes_read = bytes_read_;
     send_command (cmd);
 }
 
@@ -384,7 +393,8 @@ void xs::object_t::process_activate_read ()
     xs_assert (false);
 }
 
-void xs::object_t::process_activate_write (uint64_t msgs_read_)
+void xs::object_t::process_activate_write (uint64_t msgs_read_,
+    uint64_t bytes_read_)
 {
     xs_assert (false);
 }
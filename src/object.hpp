@@ -22,6 +22,8 @@
 #ifndef __XS_OBJECT_HPP_INCLUDED__
 #define __XS_OBJECT_HPP_INCLUDED__
 
+#include <vector>
+
 #include "stdint.hpp"
 
 namespace xs
@@ -62,7 +64,12 @@ namespace xs
         void destroy_socket (xs::socket_base_t *socket_);
 
         //  Chooses least loaded I/O thread.
-        xs::io_thread_t *choose_io_thread (uint64_t affinity_);
+        xs::io_thread_t *choose_io_thread (
+            const std::vector <uint64_t> &affinity_);
+
+        //  Returns all the I/O threads allowed by the affinity.
+        void get_io_threads (const std::vector <uint64_t> &affinity_,
+            std::vector <xs::io_thread_t*> &io_threads_);
 
         //  Derived object can use these functions to send commands
         //  to other objects.
@@ -77,7 +84,7 @@ namespace xs
              bool inc_seqnum_ = true);
         void send_activate_read (xs::pipe_t *destination_);
         void send_activate_write (xs::pipe_t *destination_,
-             uint64_t msgs_read_);
+             uint64_t msgs_read_, uint64_t bytes_read_);
         void send_hiccup (xs::pipe_t *destination_, void *pipe_);
         void send_pipe_term (xs::pipe_t *destination_);
         void send_pipe_term_ack (xs::pipe_t *destination_);
@@ -97,7 +104,8 @@ namespace xs
         virtual void process_attach (xs::i_engine *engine_);
         virtual void process_bind (xs::pipe_t *pipe_);
         virtual void process_activate_read ();
-        virtual void process_activate_write (uint64_t msgs_read_);
+        virtual void process_activate_write (uint64_t msgs_read_,
+            uint64_t bytes_read_);
         virtual void process_hiccup (void *pipe_);
         virtual void process_pipe_term ();
         virtual void process_pipe_term_ack ();
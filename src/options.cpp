@@ -23,13 +23,21 @@
 #include <string.h>
 #include <limits>
 
+#include "platform.hpp"
+#if defined XS_HAVE_WINDOWS
+#include "windows.hpp"
+#else
+#include <sys/socket.h>
+#endif
+
 #include "options.hpp"
 #include "err.hpp"
 
 xs::options_t::options_t () :
     sndhwm (1000),
     rcvhwm (1000),
-    affinity (0),
+    sndhwm_bytes (0),
+    rcvhwm_bytes (0),
     identity_size (0),
     rate (100),
     recovery_ivl (10000),
@@ -45,6 +53,10 @@ xs::options_t::options_t () :
     rcvtimeo (-1),
     sndtimeo (-1),
     ipv4only (1),
+    busy_poll (0),
+    reuseport (0),
+    zero_copy_recv (0),
+    batch_frames (0),
     delay_on_close (true),
     delay_on_disconnect (true),
     filter (false),
@@ -75,14 +87,38 @@ int xs::options_t::setsockopt (int option_, const void *optval_,
         rcvhwm = *((int*) optval_);
         return 0;
 
-    case XS_AFFINITY:
+    case XS_SNDHWM_BYTES:
+        if (optvallen_ != sizeof (uint64_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        sndhwm_bytes = *((uint64_t*) optval_);
+        return 0;
+
+    case XS_RCVHWM_BYTES:
         if (optvallen_ != sizeof (uint64_t)) {
             errno = EINVAL;
             return -1;
         }
-        affinity = *((uint64_t*) optval_);
+        rcvhwm_bytes = *((uint64_t*) optval_);
         return 0;
 
+    case XS_AFFINITY:
+        {
+            //  The bitmap can span several 64-bit words so that more than
+            //  64 I/O threads can be addressed.
+            if (!optvallen_ || optvallen_ % sizeof (uint64_t)) {
+                errno = EINVAL;
+                return -1;
+            }
+            const uint64_t *words = (const uint64_t*) optval_;
+            size_t size = optvallen_ / sizeof (uint64_t);
+            while (size && !words [size - 1])
+                size--;
+            affinity.assign (words, words + size);
+            return 0;
+        }
+
     case XS_IDENTITY:
 
         //  Empty identity is invalid as well as identity longer than
@@ -216,6 +252,68 @@ int xs::options_t::setsockopt (int option_, const void *optval_,
             return 0;
         }
 
+    case XS_BUSY_POLL:
+        if (optvallen_ != sizeof (int) || *((int*) optval_) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        busy_poll = *((int*) optval_);
+        return 0;
+
+    case XS_REUSEPORT:
+        {
+            if (optvallen_ != sizeof (int)) {
+                errno = EINVAL;
+                return -1;
+            }
+            int val = *((int*) optval_);
+            if (val != 0 && val != 1) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            //  Sharing a port among several listeners is not supported
+            //  by this OS.
+#if !defined SO_REUSEPORT
+            if (val) {
+                errno = EINVAL;
+                return -1;
+            }
+#endif
+            reuseport = val;
+            return 0;
+        }
+
+    case XS_ZERO_COPY_RECV:
+        {
+            if (optvallen_ != sizeof (int)) {
+                errno = EINVAL;
+                return -1;
+            }
+            int val = *((int*) optval_);
+            if (val != 0 && val != 1) {
+                errno = EINVAL;
+                return -1;
+            }
+            zero_copy_recv = val;
+            return 0;
+        }
+
+    case XS_BATCH_FRAMES:
+        {
+            if (optvallen_ != sizeof (int)) {
+                errno = EINVAL;
+                return -1;
+            }
+            int val = *((int*) optval_);
+            if (val != 0 && val != 1) {
+                errno = EINVAL;
+                return -1;
+            }
+            batch_frames = val;
+            return 0;
+        }
+
     }
 
     errno = EINVAL;
@@ -244,15 +342,39 @@ int xs::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
         *optvallen_ = sizeof (int);
         return 0;
 
-    case XS_AFFINITY:
+    case XS_SNDHWM_BYTES:
         if (*optvallen_ < sizeof (uint64_t)) {
             errno = EINVAL;
             return -1;
         }
-        *((uint64_t*) optval_) = affinity;
+        *((uint64_t*) optval_) = sndhwm_bytes;
         *optvallen_ = sizeof (uint64_t);
         return 0;
 
+    case XS_RCVHWM_BYTES:
+        if (*optvallen_ < sizeof (uint64_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((uint64_t*) optval_) = rcvhwm_bytes;
+        *optvallen_ = sizeof (uint64_t);
+        return 0;
+
+    case XS_AFFINITY:
+        {
+            size_t size = affinity.empty () ? 1 : affinity.size ();
+            if (*optvallen_ < size * sizeof (uint64_t)) {
+                errno = EINVAL;
+                return -1;
+            }
+            if (affinity.empty ())
+                *((uint64_t*) optval_) = 0;
+            else
+                memcpy (optval_, &affinity [0], size * sizeof (uint64_t));
+            *optvallen_ = size * sizeof (uint64_t);
+            return 0;
+        }
+
     case XS_IDENTITY:
         if (*optvallen_ < identity_size) {
             errno = EINVAL;
@@ -388,6 +510,42 @@ int xs::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
         *optvallen_ = sizeof (int);
         return 0;
 
+    case XS_BUSY_POLL:
+        if (*optvallen_ < sizeof (int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((int*) optval_) = busy_poll;
+        *optvallen_ = sizeof (int);
+        return 0;
+
+    case XS_REUSEPORT:
+        if (*optvallen_ < sizeof (int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((int*) optval_) = reuseport;
+        *optvallen_ = sizeof (int);
+        return 0;
+
+    case XS_ZERO_COPY_RECV:
+        if (*optvallen_ < sizeof (int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((int*) optval_) = zero_copy_recv;
+        *optvallen_ = sizeof (int);
+        return 0;
+
+    case XS_BATCH_FRAMES:
+        if (*optvallen_ < sizeof (int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((int*) optval_) = batch_frames;
+        *optvallen_ = sizeof (int);
+        return 0;
+
     }
 
     errno = EINVAL;
@@ -23,6 +23,8 @@
 #ifndef __XS_OPTIONS_HPP_INCLUDED__
 #define __XS_OPTIONS_HPP_INCLUDED__
 
+#include <vector>
+
 #include "stddef.h"
 #include "stdint.hpp"
 
@@ -40,8 +42,14 @@ namespace xs
         int sndhwm;
         int rcvhwm;
 
-        //  I/O thread affinity.
-        uint64_t affinity;
+        //  High-water marks for message pipes in bytes. Zero means no limit.
+        uint64_t sndhwm_bytes;
+        uint64_t rcvhwm_bytes;
+
+        //  I/O thread affinity. Bit N of the bitmap stands for I/O thread N.
+        //  Trailing zero words are not stored, so an empty bitmap means that
+        //  any I/O thread can be used.
+        std::vector <uint64_t> affinity;
 
         //  Socket identity
         unsigned char identity_size;
@@ -89,6 +97,22 @@ namespace xs
         //  connect to and accept connections from both IPv4 and IPv6 hosts.
         int ipv4only;
 
+        //  Time to check for new messages in a busy loop before blocking
+        //  in recv, in microseconds. Zero means no busy polling.
+        int busy_poll;
+
+        //  If 1, TCP listeners are launched in all eligible I/O threads,
+        //  sharing the same port.
+        int reuseport;
+
+        //  If 1, messages received from the network refer to the engine's
+        //  receive buffer rather than having the data copied out of it.
+        int zero_copy_recv;
+
+        //  If 1, small messages are packed into batch frames when sent to
+        //  peers that announced they are able to decode them.
+        int batch_frames;
+
         //  If true, session reads all the pending messages from the pipe and
         //  sends them to the network when socket is closed.
         bool delay_on_close;
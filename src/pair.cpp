@@ -67,7 +67,7 @@ int xs::pair_t::xsend (msg_t *msg_, int flags_)
         return -1;
     }
 
-    if (!(flags_ & XS_SNDMORE))
+    if (!(flags_ & (XS_SNDMORE | send_noflush)))
         pipe->flush ();
 
     //  Detach the original message from the data buffer.
@@ -117,6 +117,12 @@ bool xs::pair_t::xhas_out ()
     return result;
 }
 
+void xs::pair_t::xflush ()
+{
+    if (pipe)
+        pipe->flush ();
+}
+
 xs::pair_session_t::pair_session_t (io_thread_t *io_thread_, bool connect_,
       socket_base_t *socket_, const options_t &options_,
       const char *protocol_, const char *address_) :
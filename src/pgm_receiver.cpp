@@ -33,6 +33,7 @@
 
 #include "pgm_receiver.hpp"
 #include "session_base.hpp"
+#include "ctx.hpp"
 #include "stdint.hpp"
 #include "wire.hpp"
 #include "err.hpp"
@@ -231,10 +232,11 @@ void xs::pgm_receiver_t::in_event (fd_t fd_)
             it->second.joined = true;
 
             //  Create and connect decoder for the peer.
-            it->second.decoder = new (std::nothrow) decoder_t (0,
+            it->second.decoder = new (std::nothrow) decoder_t (0, 0,
                 options.maxmsgsize);
             alloc_assert (it->second.decoder);
-            it->second.decoder->set_session (session);
+            it->second.decoder->set_msg_sink (session,
+                session->get_ctx ()->get_msg_pool (), session->get_tid ());
         }
 
         mru_decoder = it->second.decoder;
@@ -73,7 +73,7 @@ void xs::pgm_sender_t::plug (io_thread_t *io_thread_,
     fd_t rdata_notify_fd = retired_fd;
     fd_t pending_notify_fd = retired_fd;
 
-    encoder.set_session (session_);
+    encoder.set_msg_source (session_);
 
     //  Fill fds from PGM transport and add them to the I/O thread.
     pgm_socket.get_sender_fds (&downlink_socket_fd, &uplink_socket_fd,
@@ -110,7 +110,7 @@ void xs::pgm_sender_t::unplug ()
     rm_fd (uplink_handle);
     rm_fd (rdata_notify_handle);
     rm_fd (pending_notify_handle);
-    encoder.set_session (NULL);
+    encoder.set_msg_source (NULL);
 }
 
 void xs::pgm_sender_t::terminate ()
@@ -24,10 +24,12 @@
 #include <stddef.h>
 
 #include "pipe.hpp"
+#include "ctx.hpp"
+#include "memory_budget.hpp"
 #include "err.hpp"
 
 int xs::pipepair (class object_t *parents_ [2], class pipe_t* pipes_ [2],
-    int hwms_ [2], bool delays_ [2])
+    int hwms_ [2], uint64_t hwm_bytes_ [2], bool delays_ [2])
 {
     //   Creates two pipe objects. These objects are connected by two ypipes,
     //   each to pass messages in one direction.
@@ -38,10 +40,10 @@ int xs::pipepair (class object_t *parents_ [2], class pipe_t* pipes_ [2],
     alloc_assert (upipe2);
 
     pipes_ [0] = new (std::nothrow) pipe_t (parents_ [0], upipe1, upipe2,
-        hwms_ [1], hwms_ [0], delays_ [0]);
+        hwms_ [1], hwms_ [0], hwm_bytes_ [1], hwm_bytes_ [0], delays_ [0]);
     alloc_assert (pipes_ [0]);
     pipes_ [1] = new (std::nothrow) pipe_t (parents_ [1], upipe2, upipe1,
-        hwms_ [0], hwms_ [1], delays_ [1]);
+        hwms_ [0], hwms_ [1], hwm_bytes_ [0], hwm_bytes_ [1], delays_ [1]);
     alloc_assert (pipes_ [1]);
 
     pipes_ [0]->set_peer (pipes_ [1]);
@@ -51,7 +53,8 @@ int xs::pipepair (class object_t *parents_ [2], class pipe_t* pipes_ [2],
 }
 
 xs::pipe_t::pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
-      int inhwm_, int outhwm_, bool delay_) :
+      int inhwm_, int outhwm_, uint64_t inhwm_bytes_, uint64_t outhwm_bytes_,
+      bool delay_) :
     object_t (parent_),
     inpipe (inpipe_),
     outpipe (outpipe_),
@@ -62,15 +65,37 @@ xs::pipe_t::pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
     msgs_read (0),
     msgs_written (0),
     peers_msgs_read (0),
+    queued (NULL),
+    hwm_bytes (outhwm_bytes_),
+    lwm_bytes ((inhwm_bytes_ + 1) / 2),
+    bytes_read (0),
+    bytes_written (0),
+    more_bytes (0),
+    bytes_reported (0),
+    msgs_reported (0),
+    peers_bytes_read (0),
+    more_out (false),
+    budget (NULL),
+    reserved (0),
     peer (NULL),
     sink (NULL),
     state (active),
     delay (delay_)
+#if defined XS_HAVE_LATENCY_STATS
+    , latency (NULL)
+#endif
 {
+    //  With the memory budget in place, the writer has to learn about
+    //  the bytes read often enough to return unused reservations.
+    budget = get_ctx ()->get_memory_budget ();
+    if (budget && (!lwm_bytes || lwm_bytes > memory_budget_granularity))
+        lwm_bytes = memory_budget_granularity;
 }
 
 xs::pipe_t::~pipe_t ()
 {
+    if (budget && reserved)
+        budget->release (reserved);
 }
 
 void xs::pipe_t::set_peer (pipe_t *peer_)
@@ -87,6 +112,32 @@ void xs::pipe_t::set_event_sink (i_pipe_events *sink_)
     sink = sink_;
 }
 
+#if defined XS_HAVE_LATENCY_STATS
+void xs::pipe_t::set_latency (histogram_t *latency_)
+{
+    latency = latency_;
+}
+#endif
+
+void xs::pipe_t::set_queued_counter (uint64_t *counter_)
+{
+    if (queued)
+        *queued -= get_queued ();
+    queued = counter_;
+    if (queued)
+        *queued += get_queued ();
+}
+
+void xs::pipe_t::get_stats (pipe_stats_t *stats_)
+{
+    stats_->msgs_read = msgs_read;
+    stats_->bytes_read = bytes_read;
+    stats_->msgs_written = msgs_written;
+    stats_->bytes_written = bytes_written;
+    stats_->msgs_queued = msgs_written - peers_msgs_read;
+    stats_->bytes_queued = bytes_written - peers_bytes_read;
+}
+
 void xs::pipe_t::set_identity (const blob_t &identity_)
 {
     identity = identity_;
@@ -111,8 +162,8 @@ bool xs::pipe_t::check_read ()
     //  If the next item in the pipe is message delimiter,
     //  initiate termination process.
     if (inpipe->probe (is_delimiter)) {
-        msg_t msg;
-        bool ok = inpipe->read (&msg);
+        entry_t entry;
+        bool ok = inpipe->read (&entry);
         xs_assert (ok);
         delimit ();
         return false;
@@ -126,10 +177,12 @@ bool xs::pipe_t::read (msg_t *msg_)
     if (unlikely (!in_active || (state != active && state != pending)))
         return false;
 
-    if (!inpipe->read (msg_)) {
+    entry_t entry;
+    if (!inpipe->read (&entry)) {
         in_active = false;
         return false;
     }
+    *msg_ = entry.msg;
 
     //  If delimiter was read, start termination process of the pipe.
     if (msg_->is_delimiter ()) {
@@ -137,11 +190,29 @@ bool xs::pipe_t::read (msg_t *msg_)
         return false;
     }
 
-    if (!(msg_->flags () & msg_t::more))
+    bool more = msg_->flags () & msg_t::more ? true : false;
+    if (!more)
         msgs_read++;
-
-    if (lwm > 0 && msgs_read % lwm == 0)
-        send_activate_write (peer, msgs_read);
+    bytes_read += msg_->size ();
+
+#if defined XS_HAVE_LATENCY_STATS
+    if (latency)
+        latency->record (entry.stamp);
+#endif
+
+    //  Let the writer know how much it can write. Byte credits are
+    //  returned at message boundaries only, once half of the byte high
+    //  watermark was read. With the memory budget in place, the pipe
+    //  entries the messages were using are accounted for as well.
+    uint64_t unreported = bytes_read - bytes_reported;
+    if (budget)
+        unreported += (msgs_read - msgs_reported) * sizeof (entry_t);
+    if ((lwm > 0 && msgs_read % lwm == 0) || (lwm_bytes > 0 && !more &&
+          unreported >= lwm_bytes)) {
+        send_activate_write (peer, msgs_read, bytes_read);
+        bytes_reported = bytes_read;
+        msgs_reported = msgs_read;
+    }
 
     return true;
 }
@@ -151,9 +222,10 @@ bool xs::pipe_t::check_write (msg_t *msg_)
     if (unlikely (!out_active || state != active))
         return false;
 
-    bool full = hwm > 0 && msgs_written - peers_msgs_read == uint64_t (hwm);
+    bool full = (hwm > 0 && msgs_written - peers_msgs_read == uint64_t (hwm))
+        || (hwm_bytes > 0 && bytes_written - peers_bytes_read >= hwm_bytes);
 
-    if (unlikely (full)) {
+    if (unlikely (full || (budget && !reserve (msg_->size ())))) {
         out_active = false;
         return false;
     }
@@ -167,9 +239,21 @@ bool xs::pipe_t::write (msg_t *msg_)
         return false;
 
     bool more = msg_->flags () & msg_t::more ? true : false;
-    outpipe->write (*msg_, more);
-    if (!more)
+    more_bytes += msg_->size ();
+    entry_t entry;
+    entry.msg = *msg_;
+#if defined XS_HAVE_LATENCY_STATS
+    entry.stamp = histogram_t::now ();
+#endif
+    outpipe->write (entry, more);
+    more_out = more;
+    if (!more) {
         msgs_written++;
+        bytes_written += more_bytes;
+        more_bytes = 0;
+        if (queued)
+            (*queued)++;
+    }
 
     return true;
 }
@@ -177,14 +261,16 @@ bool xs::pipe_t::write (msg_t *msg_)
 void xs::pipe_t::rollback ()
 {
     //  Remove incomplete message from the outbound pipe.
-    msg_t msg;
+    entry_t entry;
     if (outpipe) {
-		while (outpipe->unwrite (&msg)) {
-		    xs_assert (msg.flags () & msg_t::more);
-		    int rc = msg.close ();
+		while (outpipe->unwrite (&entry)) {
+		    xs_assert (entry.msg.flags () & msg_t::more);
+		    int rc = entry.msg.close ();
 		    errno_assert (rc == 0);
 		}
     }
+    more_bytes = 0;
+    more_out = false;
 }
 
 void xs::pipe_t::flush ()
@@ -209,10 +295,17 @@ void xs::pipe_t::process_activate_read ()
     }
 }
 
-void xs::pipe_t::process_activate_write (uint64_t msgs_read_)
+void xs::pipe_t::process_activate_write (uint64_t msgs_read_,
+    uint64_t bytes_read_)
 {
-    //  Remember the peers's message sequence number.
+    //  Remember the peers's message and byte sequence numbers.
+    if (queued)
+        *queued -= msgs_read_ - peers_msgs_read;
     peers_msgs_read = msgs_read_;
+    peers_bytes_read = bytes_read_;
+
+    if (budget)
+        release ();
 
     if (!out_active && state == active) {
         out_active = true;
@@ -226,9 +319,9 @@ void xs::pipe_t::process_hiccup (void *pipe_)
     //  migrated to this thread.
     xs_assert (outpipe);
     outpipe->flush ();
-    msg_t msg;
-    while (outpipe->read (&msg)) {
-       int rc = msg.close ();
+    entry_t entry;
+    while (outpipe->read (&entry)) {
+       int rc = entry.msg.close ();
        errno_assert (rc == 0);
     }
     delete outpipe;
@@ -310,9 +403,9 @@ void xs::pipe_t::process_pipe_term_ack ()
     //  First, delete all the unread messages in the pipe. We have to do it by
     //  hand because msg_t doesn't have automatic destructor. Then deallocate
     //  the ypipe itself.
-    msg_t msg;
-    while (inpipe->read (&msg)) {
-       int rc = msg.close ();
+    entry_t entry;
+    while (inpipe->read (&entry)) {
+       int rc = entry.msg.close ();
        errno_assert (rc == 0);
     }
     delete inpipe;
@@ -376,16 +469,19 @@ void xs::pipe_t::terminate (bool delay_)
 
 		//  Push delimiter into the outbound pipe. Note that watermarks are not
 		//  checked thus the delimiter can be written even though the pipe is full.
-		msg_t msg;
-		msg.init_delimiter ();
-		outpipe->write (msg, false);
+		entry_t entry;
+		entry.msg.init_delimiter ();
+#if defined XS_HAVE_LATENCY_STATS
+		entry.stamp = histogram_t::now ();
+#endif
+		outpipe->write (entry, false);
 		flush ();
     }
 }
 
-bool xs::pipe_t::is_delimiter (msg_t &msg_)
+bool xs::pipe_t::is_delimiter (entry_t &entry_)
 {
-    return msg_.is_delimiter ();
+    return entry_.msg.is_delimiter ();
 }
 
 int xs::pipe_t::compute_lwm (int hwm_)
@@ -416,6 +512,64 @@ int xs::pipe_t::compute_lwm (int hwm_)
     return result;
 }
 
+uint64_t xs::pipe_t::unread ()
+{
+    //  Each message is charged for the pipe entry it occupies on top of its
+    //  data, so that even empty messages are accounted for. Unfinished
+    //  multi-part message counts as a message as well.
+    uint64_t msgs = msgs_written - peers_msgs_read + (more_out ? 1 : 0);
+    return bytes_written + more_bytes - peers_bytes_read +
+        msgs * sizeof (entry_t);
+}
+
+bool xs::pipe_t::reserve (size_t size_)
+{
+    //  Unless the message continues a multi-part message, it'll need
+    //  an entry of its own.
+    uint64_t pending = unread ();
+    uint64_t needed = pending + size_ + (more_out ? 0 : sizeof (entry_t));
+    if (needed <= reserved)
+        return true;
+
+    uint64_t size = (needed - reserved + memory_budget_granularity - 1) /
+        memory_budget_granularity * memory_budget_granularity;
+    if (!budget->reserve (size)) {
+
+        //  The message is let through even if the budget is exhausted when
+        //  there's less than a single chunk of memory queued in the pipe or
+        //  when it continues a multi-part message. That way each pipe can
+        //  always make progress and multi-part messages are never cut off
+        //  halfway. Only the memory needed for the message itself is taken
+        //  in such case.
+        //
+        //  Note that the peer reports its progress each time it reads one
+        //  chunk worth of messages. Thus, if the pipe is stuck, the peer is
+        //  guaranteed to let us know once it has read the messages, even if
+        //  they were already the last ones in the pipe.
+        if (!more_out && pending >= memory_budget_granularity)
+            return false;
+        size = needed - reserved;
+        bool ok = budget->reserve (size, true);
+        xs_assert (ok);
+    }
+    reserved += size;
+    return true;
+}
+
+void xs::pipe_t::release ()
+{
+    //  Keep only as much memory as the messages not yet read by the peer
+    //  need. The peer doesn't report the last chunk it has read, so idle
+    //  pipe can hold at most one chunk of memory.
+    uint64_t needed = unread ();
+    needed = (needed + memory_budget_granularity - 1) /
+        memory_budget_granularity * memory_budget_granularity;
+    if (reserved > needed) {
+        budget->release (reserved - needed);
+        reserved = needed;
+    }
+}
+
 void xs::pipe_t::delimit ()
 {
     if (state == active) {
@@ -23,6 +23,7 @@
 #ifndef __XS_PIPE_HPP_INCLUDED__
 #define __XS_PIPE_HPP_INCLUDED__
 
+#include "platform.hpp"
 #include "msg.hpp"
 #include "ypipe.hpp"
 #include "config.hpp"
@@ -30,21 +31,49 @@
 #include "stdint.hpp"
 #include "array.hpp"
 #include "blob.hpp"
+#if defined XS_HAVE_LATENCY_STATS
+#include "histogram.hpp"
+#endif
 
 namespace xs
 {
 
     class object_t;
     class pipe_t;
+    class memory_budget_t;
 
     //  Create a pipepair for bi-directional transfer of messages.
     //  First HWM is for messages passed from first pipe to the second pipe.
     //  Second HWM is for messages passed from second pipe to the first pipe.
+    //  Byte HWMs limit the same directions in terms of bytes. Zero HWM
+    //  of either kind means no limit.
     //  Delay specifies how the pipe behaves when the peer terminates. If true
     //  pipe receives all the pending messages before terminating, otherwise it
     //  terminates straight away.
     int pipepair (xs::object_t *parents_ [2], xs::pipe_t* pipes_ [2],
-        int hwms_ [2], bool delays_ [2]);
+        int hwms_ [2], uint64_t hwm_bytes_ [2], bool delays_ [2]);
+
+    //  Internal flag that can be combined with XS_DONTWAIT and XS_SNDMORE
+    //  when passing a message to the socket's xsend function. It asks the
+    //  socket not to flush the pipes after the message is written. The caller
+    //  is responsible for invoking xflush once it is done with writing.
+    enum {send_noflush = 0x8000};
+
+    //  Statistics of a pipe. The fields are in the order they are returned
+    //  by the XS_PIPE_STATS option.
+    struct pipe_stats_t
+    {
+        //  Number of messages and bytes read from and written to the pipe.
+        uint64_t msgs_read;
+        uint64_t bytes_read;
+        uint64_t msgs_written;
+        uint64_t bytes_written;
+
+        //  Number of messages and bytes written to the pipe, but not
+        //  reported as read by the peer yet.
+        uint64_t msgs_queued;
+        uint64_t bytes_queued;
+    };
 
     struct i_pipe_events
     {
@@ -68,13 +97,20 @@ namespace xs
     {
         //  This allows pipepair to create pipe objects.
         friend int pipepair (xs::object_t *parents_ [2],
-            xs::pipe_t* pipes_ [2], int hwms_ [2], bool delays_ [2]);
+            xs::pipe_t* pipes_ [2], int hwms_ [2], uint64_t hwm_bytes_ [2],
+            bool delays_ [2]);
 
     public:
 
         //  Specifies the object to send events to.
         void set_event_sink (i_pipe_events *sink_);
 
+#if defined XS_HAVE_LATENCY_STATS
+        //  Specifies the histogram to record the time the messages spent
+        //  in the pipe to. Only the reading side of the pipe records.
+        void set_latency (histogram_t *latency_);
+#endif
+
         //  Pipe endpoint can store an opaque ID to be used by its clients.
         void set_identity (const blob_t &identity_);
         blob_t get_identity ();
@@ -87,6 +123,8 @@ namespace xs
 
         //  Checks whether messages can be written to the pipe. If writing
         //  the message would cause high watermark the function returns false.
+        //  Byte high watermark is checked before the message is written, so
+        //  a single message larger than the limit can still pass.
         bool check_write (msg_t *msg_);
 
         //  Writes a message to the underlying pipe. Returns false if the
@@ -96,6 +134,21 @@ namespace xs
         //  Remove unfinished parts of the outbound message from the pipe.
         void rollback ();
 
+        //  Returns the number of messages written to the pipe that the peer
+        //  hasn't reported as read yet. The actual number can be lower.
+        inline uint64_t get_queued ()
+        {
+            return msgs_written - peers_msgs_read;
+        }
+
+        //  Specifies the counter to add the changes of the number of queued
+        //  messages to, so that the owner of many pipes doesn't have to sum
+        //  them up. NULL means no counter.
+        void set_queued_counter (uint64_t *counter_);
+
+        //  Fills in the statistics of the pipe.
+        void get_stats (pipe_stats_t *stats_);
+
         //  Flush the messages downsteam.
         void flush ();
 
@@ -112,12 +165,23 @@ namespace xs
 
     private:
 
+        //  Item of the underlying pipe. If latency statistics are enabled,
+        //  each message is stamped with the time it was written at.
+        struct entry_t
+        {
+            msg_t msg;
+#if defined XS_HAVE_LATENCY_STATS
+            uint64_t stamp;
+#endif
+        };
+
         //  Type of the underlying lock-free pipe.
-        typedef ypipe_t <msg_t, message_pipe_granularity> upipe_t;
+        typedef ypipe_t <entry_t, message_pipe_granularity> upipe_t;
 
         //  Command handlers.
         void process_activate_read ();
-        void process_activate_write (uint64_t msgs_read_);
+        void process_activate_write (uint64_t msgs_read_,
+            uint64_t bytes_read_);
         void process_hiccup (void *pipe_);
         void process_pipe_term ();
         void process_pipe_term_ack ();
@@ -125,10 +189,22 @@ namespace xs
         //  Handler for delimiter read from the pipe.
         void delimit ();
 
+        //  Reserves memory for a message of size_ bytes from the memory
+        //  budget. Returns false if the budget is exhausted.
+        bool reserve (size_t size_);
+
+        //  Returns the memory that is not needed anymore to the budget.
+        void release ();
+
+        //  Returns the amount of memory needed by the messages written
+        //  but not yet reported as read by the peer.
+        uint64_t unread ();
+
         //  Constructor is private. Pipe can only be created using
         //  pipepair function.
         pipe_t (object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
-            int inhwm_, int outhwm_, bool delay_);
+            int inhwm_, int outhwm_, uint64_t inhwm_bytes_,
+            uint64_t outhwm_bytes_, bool delay_);
 
         //  Pipepair uses this function to let us know about
         //  the peer pipe object.
@@ -159,6 +235,37 @@ namespace xs
         //  can be higher at the moment.
         uint64_t peers_msgs_read;
 
+        //  Counter the changes of the number of queued messages are added
+        //  to. NULL if there's none.
+        uint64_t *queued;
+
+        //  High watermark for the outbound pipe and low watermark for
+        //  the inbound pipe in bytes.
+        uint64_t hwm_bytes;
+        uint64_t lwm_bytes;
+
+        //  Number of bytes read and written so far. Bytes of a multi-part
+        //  message are accounted as written once the last part is written,
+        //  till then they are kept in more_bytes.
+        uint64_t bytes_read;
+        uint64_t bytes_written;
+        uint64_t more_bytes;
+
+        //  bytes_read and msgs_read as reported to the peer the last time.
+        uint64_t bytes_reported;
+        uint64_t msgs_reported;
+
+        //  Last received peer's bytes_read.
+        uint64_t peers_bytes_read;
+
+        //  True if a multi-part message is being written.
+        bool more_out;
+
+        //  Context-wide memory budget and the number of bytes this pipe
+        //  has reserved from it. NULL if the memory is not limited.
+        memory_budget_t *budget;
+        uint64_t reserved;
+
         //  The pipe object on the other side of the pipepair.
         pipe_t *peer;
 
@@ -188,11 +295,16 @@ namespace xs
         //  asks us to.
         bool delay;
 
+#if defined XS_HAVE_LATENCY_STATS
+        //  Histogram to record the time the messages spent in the pipe to.
+        histogram_t *latency;
+#endif
+
         //  Identity of the writer. Used uniquely by the reader side.
         blob_t identity;
 
         //  Returns true if the message is delimiter; false otherwise.
-        static bool is_delimiter (msg_t &msg_);
+        static bool is_delimiter (entry_t &entry_);
 
         //  Computes appropriate low watermark from the given high watermark.
         static int compute_lwm (int hwm_);
@@ -109,7 +109,7 @@ void xs::poll_t::reset_pollout (handle_t handle_)
 
 void xs::poll_t::xstart ()
 {
-    worker.start (worker_routine, this);
+    worker.start (worker_routine, this, cpus);
 }
 
 void xs::poll_t::xstop ()
@@ -125,7 +125,9 @@ void xs::poll_t::loop ()
         int timeout = (int) execute_timers ();
 
         //  Wait for events.
+        before_wait ();
         int rc = poll (&pollset [0], pollset.size (), timeout ? timeout : -1);
+        after_wait (rc);
         if (rc == -1 && errno == EINTR)
             continue;
         errno_assert (rc != -1);
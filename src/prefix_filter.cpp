@@ -0,0 +1,179 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "prefix_filter.hpp"
+#include "simd.hpp"
+#include "err.hpp"
+
+xs::prefix_filter_t::prefix_filter_t () :
+    subscriptions (0),
+    long_subscriptions (0),
+    flat (true),
+    flat_count (0),
+    flat_all (false)
+{
+}
+
+xs::prefix_filter_t::~prefix_filter_t ()
+{
+}
+
+bool xs::prefix_filter_t::add (unsigned char *prefix_, size_t size_)
+{
+    if (!trie.add (prefix_, size_))
+        return false;
+
+    ++subscriptions;
+    if (size_ > max_flat_size)
+        ++long_subscriptions;
+
+    //  Stop using the flat table if the subscription doesn't fit into it.
+    if (flat) {
+        if (size_ > max_flat_size ||
+              (size_ && flat_count == max_flat_subscriptions))
+            flat = false;
+        else
+            flat_add (prefix_, size_);
+    }
+
+    return true;
+}
+
+bool xs::prefix_filter_t::rm (unsigned char *prefix_, size_t size_)
+{
+    if (!trie.rm (prefix_, size_))
+        return false;
+
+    --subscriptions;
+    if (size_ > max_flat_size)
+        --long_subscriptions;
+
+    if (flat && !size_)
+        flat_all = false;
+    else if (flat) {
+
+        //  Remove the subscription from the flat table. The last subscription
+        //  is moved to its place.
+        int i = 0;
+        while (flat_sizes [i] != size_ ||
+              memcmp (flat_prefixes [i], prefix_, size_) != 0) {
+            ++i;
+            xs_assert (i < flat_count);
+        }
+        --flat_count;
+        if (i != flat_count) {
+            memcpy (flat_prefixes [i], flat_prefixes [flat_count],
+                max_flat_size);
+            flat_sizes [i] = flat_sizes [flat_count];
+            flat_masks [i] = flat_masks [flat_count];
+        }
+    }
+
+    //  Start using the flat table once all the subscriptions fit into it.
+    else if (!long_subscriptions && subscriptions <= max_flat_subscriptions)
+        rebuild ();
+
+    return true;
+}
+
+bool xs::prefix_filter_t::check (unsigned char *data_, size_t size_)
+{
+    if (!flat)
+        return trie.check (data_, size_);
+
+    if (flat_all)
+        return true;
+    if (!size_)
+        return false;
+
+#if defined XS_HAVE_SSE2
+    //  Load the beginning of the message. If the message is shorter than
+    //  the maximal length of a subscription, pad it by zeros. The padding
+    //  is excluded from the comparison so that subscriptions longer than
+    //  the message never match.
+    __m128i data;
+    int valid;
+    if (size_ >= max_flat_size) {
+        data = _mm_loadu_si128 ((const __m128i*) data_);
+        valid = (1 << max_flat_size) - 1;
+    }
+    else {
+        unsigned char buf [max_flat_size];
+        memset (buf, 0, max_flat_size);
+        memcpy (buf, data_, size_);
+        data = _mm_loadu_si128 ((const __m128i*) buf);
+        valid = (1 << size_) - 1;
+    }
+
+    for (int i = 0; i != flat_count; i++) {
+        int eq = _mm_movemask_epi8 (_mm_cmpeq_epi8 (data,
+            _mm_loadu_si128 ((const __m128i*) flat_prefixes [i])));
+        if ((eq & valid & flat_masks [i]) == flat_masks [i])
+            return true;
+    }
+#else
+    for (int i = 0; i != flat_count; i++)
+        if (flat_sizes [i] <= size_ &&
+              memcmp (flat_prefixes [i], data_, flat_sizes [i]) == 0)
+            return true;
+#endif
+
+    return false;
+}
+
+void xs::prefix_filter_t::apply (void (*func_) (unsigned char *data_,
+    size_t size_, void *arg_), void *arg_)
+{
+    trie.apply (func_, arg_);
+}
+
+void xs::prefix_filter_t::rebuild ()
+{
+    flat_count = 0;
+    flat_all = false;
+    trie.apply (rebuild_helper, this);
+    xs_assert ((size_t) flat_count + (flat_all ? 1 : 0) == subscriptions);
+    flat = true;
+}
+
+void xs::prefix_filter_t::rebuild_helper (unsigned char *data_, size_t size_,
+    void *arg_)
+{
+    ((prefix_filter_t*) arg_)->flat_add (data_, size_);
+}
+
+void xs::prefix_filter_t::flat_add (unsigned char *prefix_, size_t size_)
+{
+    if (!size_) {
+        flat_all = true;
+        return;
+    }
+
+    xs_assert (flat_count < max_flat_subscriptions);
+    xs_assert (size_ <= max_flat_size);
+    memset (flat_prefixes [flat_count], 0, max_flat_size);
+    memcpy (flat_prefixes [flat_count], prefix_, size_);
+    flat_sizes [flat_count] = size_;
+    flat_masks [flat_count] = (1 << size_) - 1;
+    ++flat_count;
+}
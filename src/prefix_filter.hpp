@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __XS_PREFIX_FILTER_HPP_INCLUDED__
+#define __XS_PREFIX_FILTER_HPP_INCLUDED__
+
+#include <stddef.h>
+
+#include "trie.hpp"
+#include "config.hpp"
+#include "stdint.hpp"
+
+namespace xs
+{
+
+    //  Set of subscriptions. All the subscriptions are stored in a trie.
+    //  As long as there are only few short subscriptions, they are also
+    //  stored in a flat table that is used to check the messages. Checking
+    //  a message against the flat table requires a single SIMD comparison
+    //  per subscription rather than walking the trie byte by byte.
+
+    class prefix_filter_t
+    {
+    public:
+
+        prefix_filter_t ();
+        ~prefix_filter_t ();
+
+        //  Add key to the filter. Returns true if this is a new item in
+        //  the filter rather than a duplicate.
+        bool add (unsigned char *prefix_, size_t size_);
+
+        //  Remove key from the filter. Returns true if the item is actually
+        //  removed from the filter.
+        bool rm (unsigned char *prefix_, size_t size_);
+
+        //  Check whether particular key is in the filter.
+        bool check (unsigned char *data_, size_t size_);
+
+        //  Apply the function supplied to each subscription in the filter.
+        void apply (void (*func_) (unsigned char *data_, size_t size_,
+            void *arg_), void *arg_);
+
+    private:
+
+        //  Maximal length of a subscription stored in the flat table.
+        enum {max_flat_size = 16};
+
+        //  Rebuilds the flat table from the trie.
+        void rebuild ();
+        static void rebuild_helper (unsigned char *data_, size_t size_,
+            void *arg_);
+
+        //  Adds the subscription to the flat table.
+        void flat_add (unsigned char *prefix_, size_t size_);
+
+        //  Authoritative repository of the subscriptions.
+        trie_t trie;
+
+        //  Number of distinct subscriptions.
+        size_t subscriptions;
+
+        //  Number of distinct subscriptions longer than max_flat_size.
+        size_t long_subscriptions;
+
+        //  If true, the flat table contains all the subscriptions and it's
+        //  used to check the messages.
+        bool flat;
+
+        //  The flat table. Subscriptions are padded by zeros. For each
+        //  subscription there's its length and the mask of bytes that have
+        //  to match. Empty subscription is not stored in the table, it's represented
+        //  by the 'flat_all' flag instead.
+        unsigned char flat_prefixes [max_flat_subscriptions][max_flat_size];
+        size_t flat_sizes [max_flat_subscriptions];
+        int flat_masks [max_flat_subscriptions];
+        int flat_count;
+        bool flat_all;
+
+        prefix_filter_t (const prefix_filter_t&);
+        const prefix_filter_t &operator = (const prefix_filter_t&);
+    };
+
+}
+
+#endif
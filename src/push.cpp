@@ -60,6 +60,16 @@ bool xs::push_t::xhas_out ()
     return lb.has_out ();
 }
 
+void xs::push_t::xflush ()
+{
+    lb.flush ();
+}
+
+uint64_t xs::push_t::xdropped ()
+{
+    return lb.get_dropped ();
+}
+
 xs::push_session_t::push_session_t (io_thread_t *io_thread_, bool connect_,
       socket_base_t *socket_, const options_t &options_,
       const char *protocol_, const char *address_) :
@@ -48,6 +48,8 @@ namespace xs
         void xattach_pipe (xs::pipe_t *pipe_, bool icanhasall_);
         int xsend (xs::msg_t *msg_, int flags_);
         bool xhas_out ();
+        void xflush ();
+        uint64_t xdropped ();
         void xwrite_activated (xs::pipe_t *pipe_);
         void xterminated (xs::pipe_t *pipe_);
 
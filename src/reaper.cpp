@@ -44,10 +44,10 @@ xs::mailbox_t *xs::reaper_t::get_mailbox ()
     return &mailbox;
 }
 
-void xs::reaper_t::start ()
+void xs::reaper_t::start (const cpus_t &cpus_)
 {
     //  Start the thread.
-    io_thread->start ();
+    io_thread->start (cpus_);
 }
 
 void xs::reaper_t::stop ()
@@ -40,7 +40,8 @@ namespace xs
 
         mailbox_t *get_mailbox ();
 
-        void start ();
+        //  Launches the reaper thread, pinned to the CPUs listed if any.
+        void start (const cpus_t &cpus_ = cpus_t ());
         void stop ();
 
         //  i_poll_events implementation.
@@ -0,0 +1,272 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <new>
+#include <string.h>
+#include <algorithm>
+
+#include "routing_table.hpp"
+#include "random.hpp"
+#include "wire.hpp"
+#include "err.hpp"
+
+xs::routing_table_t::routing_table_t () :
+    slots_used (0),
+    next_peer_id (generate_random ()),
+    nodes (0)
+{
+    slot_t empty = {0, {NULL, false}};
+    slots.resize (min_size, empty);
+    buckets.resize (min_size, NULL);
+    rekey ();
+}
+
+xs::routing_table_t::~routing_table_t ()
+{
+    for (buckets_t::size_type i = 0; i != buckets.size (); i++) {
+        node_t *node = buckets [i];
+        while (node) {
+            node_t *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+}
+
+xs::blob_t xs::routing_table_t::add (pipe_t *pipe_)
+{
+    //  Keep the table at most half full so that a free slot is found
+    //  after few steps.
+    if ((slots_used + 1) * 2 > slots.size ()) {
+        bool ok = resize_slots (slots.size () * 2);
+        xs_assert (ok);
+    }
+
+    //  Skip the IDs whose slot is occupied by a live peer.
+    uint32_t mask = (uint32_t) slots.size () - 1;
+    while (slots [next_peer_id & mask].outpipe.pipe)
+        ++next_peer_id;
+
+    slot_t &slot = slots [next_peer_id & mask];
+    slot.id = next_peer_id;
+    slot.outpipe.pipe = pipe_;
+    slot.outpipe.active = true;
+    ++slots_used;
+
+    unsigned char buf [generated_size];
+    buf [0] = 0;
+    put_uint32 (buf + 1, next_peer_id);
+    ++next_peer_id;
+    return blob_t (buf, generated_size);
+}
+
+bool xs::routing_table_t::add (const blob_t &identity_, pipe_t *pipe_)
+{
+    //  Identities in the format of generated identities are reserved.
+    if (identity_.size () == generated_size && identity_ [0] == 0)
+        return false;
+
+    if (find (identity_.data (), identity_.size ()))
+        return false;
+
+    if (nodes + 1 > buckets.size ())
+        resize_buckets (buckets.size () * 2);
+
+    node_t *node = new (std::nothrow) node_t;
+    alloc_assert (node);
+    node->identity = identity_;
+    node->outpipe.pipe = pipe_;
+    node->outpipe.active = true;
+    node_t *&bucket = buckets [hash (identity_.data (), identity_.size ()) &
+        (buckets.size () - 1)];
+    node->next = bucket;
+    bucket = node;
+    ++nodes;
+
+    //  Long chain means either extremely bad luck or that the key has
+    //  leaked somehow. Either way, the peers are not allowed to keep the
+    //  lookups slow.
+    size_t chain = 0;
+    for (node = bucket; node; node = node->next)
+        ++chain;
+    if (chain > max_chain)
+        rekey ();
+
+    return true;
+}
+
+xs::routing_table_t::outpipe_t *xs::routing_table_t::find (
+    const unsigned char *data_, size_t size_)
+{
+    if (size_ == generated_size && data_ [0] == 0) {
+        uint32_t id = get_uint32 (data_ + 1);
+        slot_t &slot = slots [id & (slots.size () - 1)];
+        if (slot.outpipe.pipe && slot.id == id)
+            return &slot.outpipe;
+        return NULL;
+    }
+
+    node_t *node = buckets [hash (data_, size_) & (buckets.size () - 1)];
+    while (node) {
+        if (node->identity.size () == size_ &&
+              memcmp (node->identity.data (), data_, size_) == 0)
+            return &node->outpipe;
+        node = node->next;
+    }
+    return NULL;
+}
+
+void xs::routing_table_t::erase (const blob_t &identity_)
+{
+    if (identity_.size () == generated_size && identity_ [0] == 0) {
+        uint32_t id = get_uint32 (identity_.data () + 1);
+        slot_t &slot = slots [id & (slots.size () - 1)];
+        xs_assert (slot.outpipe.pipe && slot.id == id);
+        slot.outpipe.pipe = NULL;
+        --slots_used;
+
+        //  Try to halve the table when it gets sparse. Live IDs may prevent
+        //  that, so to avoid re-trying on every erase the attempt is made
+        //  only when the number of IDs drops to 1/8 of the table size.
+        //  An empty table can always be shrunk.
+        if (slots.size () > min_size) {
+            if (!slots_used)
+                resize_slots (min_size);
+            else if (slots_used == slots.size () / 8)
+                resize_slots (slots.size () / 2);
+        }
+        return;
+    }
+
+    node_t **prev = &buckets [hash (identity_.data (), identity_.size ()) &
+        (buckets.size () - 1)];
+    while (*prev) {
+        node_t *node = *prev;
+        if (node->identity == identity_) {
+            *prev = node->next;
+            delete node;
+            --nodes;
+            if (buckets.size () > min_size && nodes * 4 < buckets.size ())
+                resize_buckets (buckets.size () / 2);
+            return;
+        }
+        prev = &node->next;
+    }
+    xs_assert (false);
+}
+
+bool xs::routing_table_t::empty ()
+{
+    return slots_used == 0 && nodes == 0;
+}
+
+bool xs::routing_table_t::resize_slots (size_t size_)
+{
+    //  When growing, two IDs that map to the same slot in the new table
+    //  would map to the same slot in the old table as well. Thus, there are
+    //  no collisions. When shrinking, there may be.
+    slot_t empty = {0, {NULL, false}};
+    slots_t resized (size_, empty);
+    uint32_t mask = (uint32_t) size_ - 1;
+    for (slots_t::size_type i = 0; i != slots.size (); i++) {
+        if (!slots [i].outpipe.pipe)
+            continue;
+        slot_t &slot = resized [slots [i].id & mask];
+        if (slot.outpipe.pipe)
+            return false;
+        slot = slots [i];
+    }
+    resized.swap (slots);
+    return true;
+}
+
+void xs::routing_table_t::resize_buckets (size_t size_)
+{
+    buckets_t old (size_, NULL);
+    old.swap (buckets);
+    for (buckets_t::size_type i = 0; i != old.size (); i++) {
+        node_t *node = old [i];
+        while (node) {
+            node_t *next = node->next;
+            node_t *&bucket = buckets [hash (node->identity.data (),
+                node->identity.size ()) & (buckets.size () - 1)];
+            node->next = bucket;
+            bucket = node;
+            node = next;
+        }
+    }
+}
+
+void xs::routing_table_t::rekey ()
+{
+    for (int i = 0; i != 2; i++)
+        key [i] = (uint64_t) generate_random () << 32 | generate_random ();
+    resize_buckets (buckets.size ());
+}
+
+static inline uint64_t rotl (uint64_t x_, int b_)
+{
+    return (x_ << b_) | (x_ >> (64 - b_));
+}
+
+static inline void sip_round (uint64_t &v0_, uint64_t &v1_, uint64_t &v2_,
+    uint64_t &v3_)
+{
+    v0_ += v1_; v1_ = rotl (v1_, 13); v1_ ^= v0_; v0_ = rotl (v0_, 32);
+    v2_ += v3_; v3_ = rotl (v3_, 16); v3_ ^= v2_;
+    v0_ += v3_; v3_ = rotl (v3_, 21); v3_ ^= v0_;
+    v2_ += v1_; v1_ = rotl (v1_, 17); v1_ ^= v2_; v2_ = rotl (v2_, 32);
+}
+
+uint32_t xs::routing_table_t::hash (const unsigned char *data_, size_t size_)
+{
+    //  SipHash-2-4. The constants spell "somepseudorandomlygeneratedbytes".
+    uint64_t v0 = key [0] ^ ((uint64_t) 0x736f6d65 << 32 | 0x70736575);
+    uint64_t v1 = key [1] ^ ((uint64_t) 0x646f7261 << 32 | 0x6e646f6d);
+    uint64_t v2 = key [0] ^ ((uint64_t) 0x6c796765 << 32 | 0x6e657261);
+    uint64_t v3 = key [1] ^ ((uint64_t) 0x74656462 << 32 | 0x79746573);
+
+    //  Process the data in 8-byte little-endian words. The last word is
+    //  padded by zeroes and has the length in its most significant byte.
+    size_t pos = 0;
+    while (true) {
+        uint64_t m = 0;
+        size_t n = std::min (size_ - pos, (size_t) 8);
+        for (size_t i = 0; i != n; i++)
+            m |= (uint64_t) data_ [pos + i] << (i * 8);
+        pos += n;
+        bool last = n < 8;
+        if (last)
+            m |= (uint64_t) (size_ & 0xff) << 56;
+        v3 ^= m;
+        sip_round (v0, v1, v2, v3);
+        sip_round (v0, v1, v2, v3);
+        v0 ^= m;
+        if (last)
+            break;
+    }
+
+    v2 ^= 0xff;
+    for (int i = 0; i != 4; i++)
+        sip_round (v0, v1, v2, v3);
+    uint64_t h = v0 ^ v1 ^ v2 ^ v3;
+    return (uint32_t) (h ^ (h >> 32));
+}
@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __XS_ROUTING_TABLE_HPP_INCLUDED__
+#define __XS_ROUTING_TABLE_HPP_INCLUDED__
+
+#include <stddef.h>
+#include <vector>
+
+#include "blob.hpp"
+#include "stdint.hpp"
+
+namespace xs
+{
+
+    class pipe_t;
+
+    //  Maps peer identities to outbound pipes in O(1) time. Identities
+    //  generated by the socket itself (binary zero followed by a 32-bit
+    //  peer ID) are stored in a table directly indexed by the peer ID.
+    //  Identities set by the peers themselves are stored in a hash table.
+    //  As the peers choose those identities, the hash is keyed by a random
+    //  per-table key so that they can't precompute colliding identities.
+    //  Both tables shrink once most of the entries are gone.
+
+    class routing_table_t
+    {
+    public:
+
+        struct outpipe_t
+        {
+            xs::pipe_t *pipe;
+            bool active;
+        };
+
+        routing_table_t ();
+        ~routing_table_t ();
+
+        //  Generates a new unique identity for the pipe and adds the pipe
+        //  to the table. Returns the generated identity.
+        blob_t add (xs::pipe_t *pipe_);
+
+        //  Adds the pipe to the table using the identity supplied by the
+        //  peer. Returns false if the identity is already in use or if it
+        //  has the format of the generated identities, which is reserved.
+        bool add (const blob_t &identity_, xs::pipe_t *pipe_);
+
+        //  Returns the outpipe associated with the identity or NULL if
+        //  there is no such identity in the table.
+        outpipe_t *find (const unsigned char *data_, size_t size_);
+
+        //  Removes the identity from the table. The identity must exist.
+        void erase (const blob_t &identity_);
+
+        bool empty ();
+
+    private:
+
+        //  Length of the auto-generated identities.
+        enum {generated_size = 5};
+
+        //  Table of pipes with auto-generated identities. The slot for
+        //  a particular peer ID is 'id & (slots.size () - 1)'. The peer IDs
+        //  are allocated in such a way that no two live IDs share a slot.
+        struct slot_t
+        {
+            uint32_t id;
+            outpipe_t outpipe;
+        };
+        typedef std::vector <slot_t> slots_t;
+        slots_t slots;
+
+        //  Number of used slots.
+        size_t slots_used;
+
+        //  Peer IDs are generated. It's a simple increment and wrap-over
+        //  algorithm. This value is the next ID to use (if not used already).
+        uint32_t next_peer_id;
+
+        //  Hash table of pipes with identities set by the peers. Collisions
+        //  are resolved by chaining.
+        struct node_t
+        {
+            blob_t identity;
+            outpipe_t outpipe;
+            node_t *next;
+        };
+        typedef std::vector <node_t*> buckets_t;
+        buckets_t buckets;
+
+        //  Number of nodes in the hash table.
+        size_t nodes;
+
+        //  Key of the hash function.
+        uint64_t key [2];
+
+        //  If a chain grows longer than this, the hash table is re-keyed.
+        enum {max_chain = 8};
+
+        //  Minimal size of the tables.
+        enum {min_size = 16};
+
+        //  Re-indexes the slots into a table of size_ slots. Returns false
+        //  and leaves the table as is if two live IDs would share a slot.
+        bool resize_slots (size_t size_);
+
+        //  Re-hashes the nodes into size_ buckets.
+        void resize_buckets (size_t size_);
+
+        //  Generates a new random key and re-hashes the nodes.
+        void rekey ();
+
+        //  SipHash-2-4 of the data using the table's key.
+        uint32_t hash (const unsigned char *data_, size_t size_);
+
+        routing_table_t (const routing_table_t&);
+        const routing_table_t &operator = (const routing_table_t&);
+    };
+
+}
+
+#endif
@@ -141,7 +141,7 @@ void xs::select_t::reset_pollout (handle_t handle_)
 
 void xs::select_t::xstart ()
 {
-    worker.start (worker_routine, this);
+    worker.start (worker_routine, this, cpus);
 }
 
 void xs::select_t::xstop ()
@@ -162,15 +162,18 @@ void xs::select_t::loop ()
         memcpy (&exceptfds, &source_set_err, sizeof source_set_err);
 
         //  Wait for events.
+        before_wait ();
         struct timeval tv = {(long) (timeout / 1000),
             (long) (timeout % 1000 * 1000)};
 #ifdef XS_HAVE_WINDOWS
         int rc = select (0, &readfds, &writefds, &exceptfds,
             timeout ? &tv : NULL);
+        after_wait (rc);
         wsa_assert (rc != SOCKET_ERROR);
 #else
         int rc = select (maxfd + 1, &readfds, &writefds, &exceptfds,
             timeout ? &tv : NULL);
+        after_wait (rc);
         if (rc == -1 && errno == EINTR)
             continue;
         errno_assert (rc != -1);
@@ -144,6 +144,9 @@ void xs::session_base_t::attach_pipe (pipe_t *pipe_)
     xs_assert (pipe_);
     pipe = pipe_;
     pipe->set_event_sink (this);
+#if defined XS_HAVE_LATENCY_STATS
+    pipe->set_latency (socket->get_latency (latency_pipe_out));
+#endif
 }
 
 int xs::session_base_t::read (msg_t *msg_)
@@ -191,6 +194,18 @@ void xs::session_base_t::flush ()
         pipe->flush ();
 }
 
+void xs::session_base_t::protocol_error ()
+{
+    socket->account_protocol_error ();
+}
+
+#if defined XS_HAVE_LATENCY_STATS
+xs::histogram_t *xs::session_base_t::get_latency (int kind_)
+{
+    return socket->get_latency (kind_);
+}
+#endif
+
 void xs::session_base_t::clean_pipes ()
 {
     if (pipe) {
@@ -274,12 +289,16 @@ void xs::session_base_t::process_attach (i_engine *engine_)
         object_t *parents [2] = {this, socket};
         pipe_t *pipes [2] = {NULL, NULL};
         int hwms [2] = {options.rcvhwm, options.sndhwm};
+        uint64_t hwm_bytes [2] = {options.rcvhwm_bytes, options.sndhwm_bytes};
         bool delays [2] = {options.delay_on_close, options.delay_on_disconnect};
-        int rc = pipepair (parents, pipes, hwms, delays);
+        int rc = pipepair (parents, pipes, hwms, hwm_bytes, delays);
         errno_assert (rc == 0);
 
         //  Plug the local end of the pipe.
         pipes [0]->set_event_sink (this);
+#if defined XS_HAVE_LATENCY_STATS
+        pipes [0]->set_latency (socket->get_latency (latency_pipe_out));
+#endif
 
         //  Remember the local end of the pipe.
         xs_assert (!pipe);
@@ -373,6 +392,7 @@ void xs::session_base_t::detached ()
     }
 
     //  Reconnect.
+    socket->account_reconnect ();
     start_connecting (true);
 
     //  For subscriber sockets we hiccup the inbound pipe, which will cause
@@ -403,7 +423,17 @@ void xs::session_base_t::start_connecting (bool wait_)
 #if !defined XS_HAVE_WINDOWS && !defined XS_HAVE_OPENVMS
     if (protocol == "ipc") {
         ipc_connecter_t *connecter = new (std::nothrow) ipc_connecter_t (
-            io_thread, this, options, address.c_str (), wait_);
+            io_thread, this, options, address.c_str (), wait_, false);
+        alloc_assert (connecter);
+        launch_child (connecter);
+        return;
+    }
+#endif
+
+#if defined XS_HAVE_SHM
+    if (protocol == "shm") {
+        ipc_connecter_t *connecter = new (std::nothrow) ipc_connecter_t (
+            io_thread, this, options, address.c_str (), wait_, true);
         alloc_assert (connecter);
         launch_child (connecter);
         return;
@@ -28,6 +28,8 @@
 #include "own.hpp"
 #include "io_object.hpp"
 #include "pipe.hpp"
+#include "i_msg_source.hpp"
+#include "i_msg_sink.hpp"
 
 namespace xs
 {
@@ -40,7 +42,9 @@ namespace xs
     class session_base_t :
         public own_t,
         public io_object_t,
-        public i_pipe_events
+        public i_pipe_events,
+        public i_msg_source,
+        public i_msg_sink
     {
     public:
 
@@ -53,12 +57,23 @@ namespace xs
         //  To be used once only, when creating the session.
         void attach_pipe (xs::pipe_t *pipe_);
 
-        //  Following functions are the interface exposed towards the engine.
+        //  i_msg_source and i_msg_sink interface implementation, used by
+        //  the engine's encoder and decoder.
         virtual int read (msg_t *msg_);
         virtual int write (msg_t *msg_);
+
+        //  Following functions are the interface exposed towards the engine.
         void flush ();
         void detach ();
 
+        //  Called by the engine when the peer sends malformed data.
+        void protocol_error ();
+
+#if defined XS_HAVE_LATENCY_STATS
+        //  Returns the socket's latency histogram of the specified kind.
+        histogram_t *get_latency (int kind_);
+#endif
+
         //  i_pipe_events interface implementation.
         void read_activated (xs::pipe_t *pipe_);
         void write_activated (xs::pipe_t *pipe_);
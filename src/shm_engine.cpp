@@ -0,0 +1,536 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shm_engine.hpp"
+
+#if defined XS_HAVE_SHM
+
+#include <new>
+#include <algorithm>
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "io_thread.hpp"
+#include "session_base.hpp"
+#include "ctx.hpp"
+#include "likely.hpp"
+#include "err.hpp"
+#include "ip.hpp"
+
+//  Identifies the layout of the shared memory region.
+#define XS_SHM_MAGIC 0x58534d31
+
+#if defined MSG_NOSIGNAL
+#define XS_SHM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define XS_SHM_SEND_FLAGS 0
+#endif
+
+//  The control blocks of the rings are shared with another process, so
+//  the usual in-process synchronisation primitives can't be used.
+
+static inline uint32_t load_acquire (uint32_t *value_)
+{
+    return __atomic_load_n (value_, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release (uint32_t *value_, uint32_t new_value_)
+{
+    __atomic_store_n (value_, new_value_, __ATOMIC_RELEASE);
+}
+
+static inline void full_barrier ()
+{
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+}
+
+//  Clears the flag. Returns true if it was set before.
+static inline bool test_and_clear (uint32_t *flag_)
+{
+    return __atomic_load_n (flag_, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n (flag_, 0, __ATOMIC_SEQ_CST);
+}
+
+xs::shm_engine_t::shm_engine_t (fd_t fd_, const options_t &options_,
+      bool connecting_) :
+    s (fd_),
+    handle (NULL),
+    connecting (connecting_),
+    region (NULL),
+    region_size (0),
+    ring_size (0),
+    in (NULL),
+    in_data (NULL),
+    out (NULL),
+    out_data (NULL),
+    stuck (false),
+    decoder (in_batch_size, max_in_batch_size, options_.maxmsgsize),
+    encoder (out_batch_size, options_.batch_frames == 1),
+    session (NULL),
+    leftover_session (NULL),
+    options (options_),
+    plugged (false)
+{
+    //  Let the encoder know when the peer is able to decode batch frames.
+    decoder.set_encoder (&encoder);
+
+    //  Get the socket into non-blocking mode.
+    unblock_socket (s);
+
+#if defined XS_HAVE_OSX || defined XS_HAVE_FREEBSD
+    //  Make sure that SIGPIPE signal is not generated when waking up
+    //  a peer that has already disconnected.
+    int set = 1;
+    int rc = setsockopt (s, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof (int));
+    errno_assert (rc == 0);
+#endif
+}
+
+xs::shm_engine_t::~shm_engine_t ()
+{
+    xs_assert (!plugged);
+
+    if (region) {
+        int rc = munmap (region, region_size);
+        errno_assert (rc == 0);
+    }
+
+    int rc = close (s);
+    errno_assert (rc == 0);
+}
+
+void xs::shm_engine_t::plug (io_thread_t *io_thread_,
+    session_base_t *session_)
+{
+    xs_assert (!plugged);
+    plugged = true;
+    leftover_session = NULL;
+
+    //  Connect to session object.
+    xs_assert (!session);
+    xs_assert (session_);
+    encoder.set_msg_source (session_);
+    decoder.set_msg_sink (session_, session_->get_ctx ()->get_msg_pool (),
+        session_->get_tid ());
+    session = session_;
+
+    //  Connect to the io_thread object. The socket is polled only for
+    //  wake-ups and disconnection, data never pass through it.
+    io_object_t::plug (io_thread_);
+    handle = add_fd (s);
+    set_pollin (handle);
+
+    //  The connecting side sets up the shared memory straight away.
+    if (connecting && !region && !create_region ()) {
+        error ();
+        return;
+    }
+
+    //  Process whatever was already passed to us.
+    in_event (s);
+}
+
+void xs::shm_engine_t::unplug ()
+{
+    xs_assert (plugged);
+    plugged = false;
+
+    //  Cancel all fd subscriptions.
+    rm_fd (handle);
+
+    //  Disconnect from the io_thread object.
+    io_object_t::unplug ();
+
+    //  Disconnect from session object.
+    encoder.set_msg_source (NULL);
+    decoder.set_msg_sink (NULL);
+    leftover_session = session;
+    session = NULL;
+}
+
+void xs::shm_engine_t::terminate ()
+{
+    unplug ();
+    delete this;
+}
+
+void xs::shm_engine_t::in_event (fd_t fd_)
+{
+    //  The accepting side gets the shared memory first.
+    if (!region) {
+        bool failed = false;
+        if (!receive_region (failed)) {
+            if (failed) {
+                if (session)
+                    session->protocol_error ();
+                error ();
+            }
+            return;
+        }
+    }
+
+    //  Drain the wake-ups. The content is irrelevant, the rings are checked
+    //  anyway.
+    bool disconnection = false;
+    unsigned char buf [64];
+    while (true) {
+        ssize_t nbytes = recv (s, buf, sizeof (buf), 0);
+        if (nbytes > 0)
+            continue;
+        if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+              errno == EINTR))
+            break;
+        errno_assert (nbytes == 0 || errno == ECONNRESET);
+        disconnection = true;
+        break;
+    }
+
+    //  Process the data even if the peer has already disconnected. It may
+    //  have written them before disconnecting.
+    if (!consume ()) {
+        error ();
+        return;
+    }
+    if (unlikely (!plugged))
+        return;
+
+    if (disconnection) {
+        error ();
+        return;
+    }
+
+    produce ();
+}
+
+void xs::shm_engine_t::out_event (fd_t fd_)
+{
+    //  The socket is never polled for output.
+    xs_assert (false);
+}
+
+void xs::shm_engine_t::activate_out ()
+{
+    produce ();
+}
+
+void xs::shm_engine_t::activate_in ()
+{
+    stuck = false;
+    if (!consume ())
+        error ();
+}
+
+bool xs::shm_engine_t::create_region ()
+{
+    ring_size = shm_ring_size;
+    size_t size = sizeof (region_t) + 2 * (size_t) ring_size;
+
+    //  Create anonymous shared memory. Memory content is initialised
+    //  to zero, i.e. both rings are empty. The size of the memory is sealed
+    //  so that neither peer can truncate it while the other one has it
+    //  mapped; accessing the truncated pages would kill it with SIGBUS.
+    fd_t fd = memfd_create ("xs-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1)
+        return false;
+    int rc = ftruncate (fd, size);
+    if (rc == 0)
+        rc = fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+            F_SEAL_SEAL);
+    if (rc != 0 || !map_region (fd, size)) {
+        rc = close (fd);
+        errno_assert (rc == 0);
+        return false;
+    }
+    region->magic = XS_SHM_MAGIC;
+    region->ring_size = ring_size;
+
+    //  Pass the file descriptor to the peer along with a single byte of
+    //  data. The socket was just connected so there's space to send it.
+    unsigned char byte = 0;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    union {
+        cmsghdr align;
+        unsigned char buf [CMSG_SPACE (sizeof (int))];
+    } control;
+    memset (&control, 0, sizeof (control));
+    msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+    cmsghdr *cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+    memcpy (CMSG_DATA (cmsg), &fd, sizeof (int));
+    ssize_t nbytes = sendmsg (s, &msg, XS_SHM_SEND_FLAGS);
+    rc = close (fd);
+    errno_assert (rc == 0);
+    if (nbytes != 1)
+        return false;
+
+    //  The connecting side writes to the first ring.
+    unsigned char *data = (unsigned char*) (region + 1);
+    out = &region->rings [0];
+    out_data = data;
+    in = &region->rings [1];
+    in_data = data + ring_size;
+    return true;
+}
+
+bool xs::shm_engine_t::receive_region (bool &failed_)
+{
+    unsigned char byte;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    union {
+        cmsghdr align;
+        unsigned char buf [CMSG_SPACE (sizeof (int))];
+    } control;
+    msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+#if defined MSG_CMSG_CLOEXEC
+    ssize_t nbytes = recvmsg (s, &msg, MSG_CMSG_CLOEXEC);
+#else
+    ssize_t nbytes = recvmsg (s, &msg, 0);
+#endif
+    if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+          errno == EINTR))
+        return false;
+    if (nbytes != 1) {
+        failed_ = true;
+        return false;
+    }
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR (&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+          cmsg->cmsg_type != SCM_RIGHTS ||
+          cmsg->cmsg_len != CMSG_LEN (sizeof (int))) {
+        failed_ = true;
+        return false;
+    }
+    fd_t fd;
+    memcpy (&fd, CMSG_DATA (cmsg), sizeof (int));
+
+    //  Map the memory and check that it's laid out the way we expect.
+    //  The peer must have sealed its size, otherwise it would be able to
+    //  truncate the memory later on and crash this process.
+    int seals = fcntl (fd, F_GET_SEALS);
+    struct stat st;
+    bool mapped = seals != -1 &&
+        (seals & (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) ==
+            (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) &&
+        fstat (fd, &st) == 0 &&
+        st.st_size >= (off_t) sizeof (region_t) &&
+        map_region (fd, st.st_size);
+    int rc = close (fd);
+    errno_assert (rc == 0);
+    if (!mapped) {
+        failed_ = true;
+        return false;
+    }
+    ring_size = region->ring_size;
+    if (region->magic != XS_SHM_MAGIC || !ring_size ||
+          (ring_size & (ring_size - 1)) ||
+          region_size != sizeof (region_t) + 2 * (size_t) ring_size) {
+        failed_ = true;
+        return false;
+    }
+
+    //  The accepting side writes to the second ring.
+    unsigned char *data = (unsigned char*) (region + 1);
+    in = &region->rings [0];
+    in_data = data;
+    out = &region->rings [1];
+    out_data = data + ring_size;
+    return true;
+}
+
+bool xs::shm_engine_t::map_region (fd_t fd_, size_t size_)
+{
+    void *addr = mmap (NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd_, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    region = (region_t*) addr;
+    region_size = size_;
+    return true;
+}
+
+bool xs::shm_engine_t::consume ()
+{
+    if (stuck || !region)
+        return true;
+
+    //  The decoder may hold a complete message it was not able to pass
+    //  to the session before. Give it a chance to do so now.
+    if (unlikely (decoder.process_buffer (in_data, 0) == (size_t) -1)) {
+        if (session)
+            session->protocol_error ();
+        return false;
+    }
+
+    uint32_t tail = in->tail;
+    while (true) {
+
+        //  If there are no data, announce that we are going to sleep and
+        //  check once again, so that the wake-up can't be missed.
+        uint32_t head = load_acquire (&in->head);
+        if (head == tail) {
+            __atomic_store_n (&in->consumer_sleeping, 1, __ATOMIC_SEQ_CST);
+            full_barrier ();
+            if (load_acquire (&in->head) == tail)
+                break;
+            __atomic_store_n (&in->consumer_sleeping, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        //  Pass the contiguous chunk of data to the decoder.
+        size_t offset = tail & (ring_size - 1);
+        size_t size = std::min ((size_t) (head - tail),
+            (size_t) ring_size - offset);
+        size_t processed = decoder.process_buffer (in_data + offset, size);
+        if (unlikely (processed == (size_t) -1)) {
+            if (session)
+                session->protocol_error ();
+            return false;
+        }
+
+        //  Release the space and wake the producer up if it's waiting for it.
+        if (processed) {
+            tail += (uint32_t) processed;
+            store_release (&in->tail, tail);
+            account_bytes (processed);
+            full_barrier ();
+            if (test_and_clear (&in->producer_sleeping))
+                wake_peer ();
+        }
+
+        //  This may happen if queue limits are in effect. We'll be activated
+        //  once there's space for more messages.
+        if (processed < size) {
+            stuck = true;
+            break;
+        }
+
+        if (unlikely (!plugged))
+            break;
+    }
+
+    //  Flush all messages the decoder may have produced.
+    //  If IO handler has unplugged engine, flush transient IO handler.
+    if (unlikely (!plugged)) {
+        xs_assert (leftover_session);
+        leftover_session->flush ();
+    }
+    else
+        session->flush ();
+    return true;
+}
+
+void xs::shm_engine_t::produce ()
+{
+    //  The accepting side can't write till it gets the shared memory.
+    if (!region)
+        return;
+
+    uint32_t head = out->head;
+    while (true) {
+
+        //  If the ring is full, announce that we are waiting for space and
+        //  check once again, so that the wake-up can't be missed.
+        uint32_t tail = load_acquire (&out->tail);
+        uint32_t space = ring_size - (head - tail);
+        if (!space) {
+            __atomic_store_n (&out->producer_sleeping, 1, __ATOMIC_SEQ_CST);
+            full_barrier ();
+            if (load_acquire (&out->tail) == tail)
+                return;
+            __atomic_store_n (&out->producer_sleeping, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        //  Let the encoder write directly to the contiguous free space.
+        size_t offset = head & (ring_size - 1);
+        unsigned char *data = out_data + offset;
+        size_t size = std::min ((size_t) space, (size_t) ring_size - offset);
+        bool more_data = encoder.get_data (&data, &size);
+        xs_assert (data == out_data + offset);
+
+        //  Publish the data and wake the consumer up if it's sleeping.
+        if (size) {
+            head += (uint32_t) size;
+            store_release (&out->head, head);
+            account_bytes (size);
+            full_barrier ();
+            if (test_and_clear (&out->consumer_sleeping))
+                wake_peer ();
+        }
+
+        //  If IO handler has unplugged engine, flush transient IO handler.
+        if (unlikely (!plugged)) {
+            xs_assert (leftover_session);
+            leftover_session->flush ();
+            return;
+        }
+
+        if (!more_data)
+            return;
+    }
+}
+
+void xs::shm_engine_t::wake_peer ()
+{
+    //  If the socket buffer is full, there are wake-ups pending already.
+    //  If the peer has disconnected, in_event will find out.
+    unsigned char token = 0;
+    while (true) {
+        ssize_t nbytes = send (s, &token, 1, XS_SHM_SEND_FLAGS);
+        if (nbytes == -1 && errno == EINTR)
+            continue;
+        errno_assert (nbytes == 1 || errno == EAGAIN ||
+            errno == EWOULDBLOCK || errno == EPIPE || errno == ECONNRESET);
+        break;
+    }
+}
+
+void xs::shm_engine_t::error ()
+{
+    xs_assert (session);
+    session->detach ();
+    unplug ();
+    delete this;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __XS_SHM_ENGINE_HPP_INCLUDED__
+#define __XS_SHM_ENGINE_HPP_INCLUDED__
+
+#include "platform.hpp"
+
+#if defined XS_HAVE_SHM
+
+#include <stddef.h>
+
+#include "fd.hpp"
+#include "i_engine.hpp"
+#include "io_object.hpp"
+#include "encoder.hpp"
+#include "decoder.hpp"
+#include "options.hpp"
+#include "config.hpp"
+#include "stdint.hpp"
+
+namespace xs
+{
+
+    class io_thread_t;
+    class session_base_t;
+
+    //  This engine passes the messages between two processes on the same
+    //  host via a pair of single-producer/single-consumer rings in shared
+    //  memory. The connecting side creates the memory and passes its file
+    //  descriptor to the peer over a UNIX domain socket. Afterwards, the
+    //  socket is only used to wake up the peer when it's sleeping, either
+    //  waiting for data or waiting for free space in the ring, and to detect
+    //  that the peer has disconnected.
+
+    class shm_engine_t : public io_object_t, public i_engine
+    {
+    public:
+
+        shm_engine_t (fd_t fd_, const options_t &options_, bool connecting_);
+        ~shm_engine_t ();
+
+        //  i_engine interface implementation.
+        void plug (xs::io_thread_t *io_thread_,
+           xs::session_base_t *session_);
+        void unplug ();
+        void terminate ();
+        void activate_in ();
+        void activate_out ();
+
+        //  i_poll_events interface implementation.
+        void in_event (fd_t fd_);
+        void out_event (fd_t fd_);
+
+    private:
+
+        //  Control block of a ring. Positions are free-running counters,
+        //  the offset into the ring is the position modulo the ring size.
+        //  The fields written by the different processes are kept in
+        //  separate cache lines.
+        struct ring_t
+        {
+            //  Position the producer will write next. Written by producer.
+            uint32_t head;
+            unsigned char unused1 [cache_line_size - sizeof (uint32_t)];
+
+            //  Position the consumer will read next. Written by consumer.
+            uint32_t tail;
+            unsigned char unused2 [cache_line_size - sizeof (uint32_t)];
+
+            //  Set when the consumer waits for data or when the producer
+            //  waits for free space. Whoever clears the flag has to wake
+            //  the sleeping party up.
+            uint32_t consumer_sleeping;
+            uint32_t producer_sleeping;
+            unsigned char unused3 [cache_line_size - 2 * sizeof (uint32_t)];
+        };
+
+        //  Header of the shared memory region. It's followed by the data
+        //  of the ring the connecting side writes to and the data of the
+        //  ring the accepting side writes to.
+        struct region_t
+        {
+            uint32_t magic;
+            uint32_t ring_size;
+            unsigned char unused [cache_line_size - 2 * sizeof (uint32_t)];
+            ring_t rings [2];
+        };
+
+        //  Creates the shared memory region and sends it to the peer.
+        //  Returns false if it can't be done.
+        bool create_region ();
+
+        //  Receives the shared memory region from the peer. Returns false if
+        //  it was not received yet, sets 'failed' if it can't be received.
+        bool receive_region (bool &failed_);
+
+        //  Maps the shared memory region into the address space.
+        bool map_region (fd_t fd_, size_t size_);
+
+        //  Passes the data from the inbound ring to the decoder.
+        //  Returns false if the data are malformed.
+        bool consume ();
+
+        //  Fills the outbound ring with the data from the encoder.
+        void produce ();
+
+        //  Wakes the peer up.
+        void wake_peer ();
+
+        //  Function to handle disconnections.
+        void error ();
+
+        //  UNIX domain socket connected to the peer.
+        fd_t s;
+        handle_t handle;
+
+        //  True if this side has created the shared memory.
+        bool connecting;
+
+        //  The shared memory region and its size.
+        region_t *region;
+        size_t region_size;
+        uint32_t ring_size;
+
+        //  The rings this engine reads from and writes to and their data.
+        ring_t *in;
+        unsigned char *in_data;
+        ring_t *out;
+        unsigned char *out_data;
+
+        //  If true, the decoder can't accept more data at the moment.
+        bool stuck;
+
+        decoder_t decoder;
+        encoder_t encoder;
+
+        //  The session this engine is attached to.
+        xs::session_base_t *session;
+
+        //  Detached transient session.
+        xs::session_base_t *leftover_session;
+
+        options_t options;
+
+        bool plugged;
+
+        shm_engine_t (const shm_engine_t&);
+        const shm_engine_t &operator = (const shm_engine_t&);
+    };
+
+}
+
+#endif
+
+#endif
@@ -58,6 +58,8 @@
 
 #include "signaler.hpp"
 #include "likely.hpp"
+#include "cpu_relax.hpp"
+#include "clock.hpp"
 #include "stdint.hpp"
 #include "config.hpp"
 #include "err.hpp"
@@ -78,7 +80,9 @@
 #include <sys/socket.h>
 #endif
 
-xs::signaler_t::signaler_t ()
+xs::signaler_t::signaler_t () :
+    spin (0),
+    state (idle)
 {
     //  Create the socketpair for signaling.
     int rc = make_fdpair (&r, &w);
@@ -112,8 +116,17 @@ xs::fd_t xs::signaler_t::get_fd ()
     return r;
 }
 
+void xs::signaler_t::set_spin (int spin_)
+{
+    spin = spin_;
+}
+
 void xs::signaler_t::send ()
 {
+    //  If the reader is spinning, pass it the signal without a system call.
+    if (state.cas (spinning, signaled) == spinning)
+        return;
+
 #if defined XS_HAVE_EVENTFD
     const uint64_t inc = 1;
     ssize_t sz = write (w, &inc, sizeof (inc));
@@ -137,6 +150,34 @@ void xs::signaler_t::send ()
 
 int xs::signaler_t::wait (int timeout_)
 {
+    //  Signal passed through memory haven't been received yet.
+    if (unlikely (state.get () == signaled))
+        return 0;
+
+    //  If there's a chance to get a signal soon, check for it for a while
+    //  before going to sleep. Given that the sender passes the signal to
+    //  a spinning reader without touching the file descriptor, the file
+    //  descriptor has to be checked at the end, not during the spinning.
+    //  Spinning never takes longer than the timeout and the time spent
+    //  spinning is deducted from it.
+    if (spin && timeout_ != 0) {
+        uint64_t spin_us = spin;
+        if (timeout_ > 0 && (uint64_t) timeout_ * 1000 < spin_us)
+            spin_us = (uint64_t) timeout_ * 1000;
+        state.set (spinning);
+        uint64_t start = clock_t::now_us ();
+        uint64_t now = start;
+        while (state.get () == spinning &&
+              (now = clock_t::now_us ()) < start + spin_us)
+            cpu_relax ();
+        if (state.cas (spinning, idle) == signaled)
+            return 0;
+        if (timeout_ > 0) {
+            int spent = (int) ((now - start) / 1000);
+            timeout_ = spent < timeout_ ? timeout_ - spent : 0;
+        }
+    }
+
 #ifdef XS_SIGNALER_WAIT_BASED_ON_POLL
 
     struct pollfd pfd;
@@ -191,6 +232,12 @@ int xs::signaler_t::wait (int timeout_)
 
 void xs::signaler_t::recv ()
 {
+    //  If the signal was passed through memory, there's nothing to read.
+    if (state.get () == signaled) {
+        state.set (idle);
+        return;
+    }
+
     //  Attempt to read a signal.
 #if defined XS_HAVE_EVENTFD
     uint64_t dummy;
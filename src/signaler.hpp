@@ -22,6 +22,7 @@
 #define __XS_SIGNALER_HPP_INCLUDED__
 
 #include "fd.hpp"
+#include "atomic_counter.hpp"
 
 namespace xs
 {
@@ -30,6 +31,10 @@ namespace xs
     //  to signal_fd there can be at most one signal in the signaler at any
     //  given moment. Attempt to send a signal before receiving the previous
     //  one will result in undefined behaviour.
+    //
+    //  Optionally, wait can spin for a while before blocking on the file
+    //  descriptor. Signals sent while the reader is spinning are passed
+    //  through memory and don't require any system calls on either side.
 
     class signaler_t
     {
@@ -42,7 +47,10 @@ namespace xs
         void send ();
         int wait (int timeout_);
         void recv ();
-        
+
+        //  Set the time (in microseconds) to spin in wait before blocking.
+        void set_spin (int spin_);
+
     private:
 
         //  Creates a pair of filedescriptors that will be used
@@ -53,6 +61,18 @@ namespace xs
         fd_t w;
         fd_t r;
 
+        //  Spinning time in microseconds. Zero means no spinning.
+        int spin;
+
+        //  Signaled means that the signal was passed without writing to
+        //  the file descriptor and that it haven't been received yet.
+        enum {
+            idle,
+            spinning,
+            signaled
+        };
+        atomic_counter_t state;
+
         //  Disable copying of signaler_t object.
         signaler_t (const signaler_t&);
         const signaler_t &operator = (const signaler_t&);
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __XS_SIMD_HPP_INCLUDED__
+#define __XS_SIMD_HPP_INCLUDED__
+
+//  Detects whether SSE2 instructions can be used. SSE2 is available on all
+//  x86-64 CPUs and on x86 CPUs when the compiler is asked to use it.
+
+#if defined __SSE2__ || defined _M_X64 || \
+    (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define XS_HAVE_SSE2
+#include <emmintrin.h>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace xs
+{
+
+    //  Returns the index of the lowest bit set in a non-zero mask.
+    inline int lowest_bit (int mask_)
+    {
+#if defined _MSC_VER
+        unsigned long index;
+        _BitScanForward (&index, (unsigned long) mask_);
+        return (int) index;
+#elif defined __GNUC__
+        return __builtin_ctz ((unsigned int) mask_);
+#else
+        int index = 0;
+        while (!(mask_ & 1)) {
+            mask_ >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+}
+
+#endif
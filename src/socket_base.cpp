@@ -23,6 +23,7 @@
 #include <new>
 #include <string>
 #include <algorithm>
+#include <string.h>
 
 #include "platform.hpp"
 
@@ -43,6 +44,7 @@
 #include "session_base.hpp"
 #include "config.hpp"
 #include "clock.hpp"
+#include "cpu_relax.hpp"
 #include "pipe.hpp"
 #include "err.hpp"
 #include "ctx.hpp"
@@ -124,6 +126,8 @@ xs::socket_base_t::socket_base_t (ctx_t *parent_, uint32_t tid_, int sid_) :
     rcvmore (false)
 {
     options.socket_id = sid_;
+    memset (&stats, 0, sizeof (stats));
+    memset (&published, 0, sizeof (published));
 }
 
 xs::socket_base_t::~socket_base_t ()
@@ -169,7 +173,7 @@ int xs::socket_base_t::check_protocol (const std::string &protocol_)
 {
     //  First check out whether the protcol is something we are aware of.
     if (protocol_ != "inproc" && protocol_ != "ipc" && protocol_ != "tcp" &&
-          protocol_ != "pgm" && protocol_ != "epgm") {
+          protocol_ != "shm" && protocol_ != "pgm" && protocol_ != "epgm") {
         errno = EPROTONOSUPPORT;
         return -1;
     }
@@ -192,6 +196,14 @@ int xs::socket_base_t::check_protocol (const std::string &protocol_)
     }
 #endif
 
+    //  Shared memory transport needs support from the OS and the compiler.
+#if !defined XS_HAVE_SHM
+    if (protocol_ == "shm") {
+        errno = EPROTONOSUPPORT;
+        return -1;
+    }
+#endif
+
     //  Check whether socket type and transport protocol match.
     //  Specifically, multicast protocols can't be combined with
     //  bi-directional messaging patterns (socket types).
@@ -210,7 +222,11 @@ void xs::socket_base_t::attach_pipe (pipe_t *pipe_, bool icanhasall_)
 {
     //  First, register the pipe so that we can terminate it later on.
     pipe_->set_event_sink (this);
+    pipe_->set_queued_counter (&stats.msgs_queued);
     pipes.push_back (pipe_);
+#if defined XS_HAVE_LATENCY_STATS
+    pipe_->set_latency (&latencies [latency_pipe_in]);
+#endif
     
     //  Let the derived socket type know about new pipe.
     xattach_pipe (pipe_, icanhasall_);
@@ -231,6 +247,17 @@ int xs::socket_base_t::setsockopt (int option_, const void *optval_,
         return -1;
     }
 
+    //  Messages received in zero-copy mode keep the whole receive buffer
+    //  alive, which the memory budget is not able to account for. With
+    //  io_uring, the data are received into the I/O thread's buffers rather
+    //  than the decoder's, so there's nothing to slice the messages from.
+    if (option_ == XS_ZERO_COPY_RECV && (get_ctx ()->get_memory_budget () ||
+          get_ctx ()->get_async_io ()) &&
+          optvallen_ == sizeof (int) && *((int*) optval_)) {
+        errno = EINVAL;
+        return -1;
+    }
+
     //  First, check whether specific socket type overloads the option.
     int rc = xsetsockopt (option_, optval_, optvallen_);
     if (rc == 0 || errno != EINVAL)
@@ -288,6 +315,47 @@ int xs::socket_base_t::getsockopt (int option_, void *optval_,
         return 0;
     }
 
+    if (option_ == XS_STATS) {
+        if (*optvallen_ < sizeof (socket_stats_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        socket_stats_t current;
+        collect_stats (&current);
+        memcpy (optval_, &current, sizeof (socket_stats_t));
+        *optvallen_ = sizeof (socket_stats_t);
+        return 0;
+    }
+
+    if (option_ == XS_PIPE_STATS) {
+        size_t size = pipes.size () * sizeof (pipe_stats_t);
+        if (*optvallen_ < size) {
+            *optvallen_ = size;
+            errno = EINVAL;
+            return -1;
+        }
+        for (pipes_t::size_type i = 0; i != pipes.size (); i++)
+            pipes [i]->get_stats (((pipe_stats_t*) optval_) + i);
+        *optvallen_ = size;
+        return 0;
+    }
+
+#if defined XS_HAVE_LATENCY_STATS
+    if (option_ == XS_LATENCY) {
+        size_t size = latency_count * histogram_t::bucket_count *
+            sizeof (uint64_t);
+        if (*optvallen_ < size) {
+            errno = EINVAL;
+            return -1;
+        }
+        for (int i = 0; i != latency_count; i++)
+            latencies [i].get ((uint64_t*) optval_ +
+                i * histogram_t::bucket_count);
+        *optvallen_ = size;
+        return 0;
+    }
+#endif
+
     return options.getsockopt (option_, optval_, optvallen_);
 }
 
@@ -332,22 +400,42 @@ int xs::socket_base_t::bind (const char *addr_)
     }
 
     if (protocol == "tcp") {
-        tcp_listener_t *listener = new (std::nothrow) tcp_listener_t (
-            io_thread, this, options);
-        alloc_assert (listener);
-        int rc = listener->set_address (address.c_str ());
-        if (rc != 0) {
-            delete listener;
-            return -1;
+
+        //  If XS_REUSEPORT is set, there's a listener in each eligible I/O
+        //  thread and the kernel distributes the incoming connections among
+        //  them. Otherwise, single listener is created.
+        std::vector <io_thread_t*> io_threads;
+        if (options.reuseport)
+            get_io_threads (options.affinity, io_threads);
+        else
+            io_threads.push_back (io_thread);
+
+        //  Open all the listening sockets before launching any of the
+        //  listeners so that the bind either succeeds or fails as a whole.
+        std::vector <tcp_listener_t*> listeners;
+        for (size_t i = 0; i != io_threads.size (); i++) {
+            tcp_listener_t *listener = new (std::nothrow) tcp_listener_t (
+                io_threads [i], this, options);
+            alloc_assert (listener);
+            listeners.push_back (listener);
+            int rc = listener->set_address (address.c_str ());
+            if (rc != 0) {
+                int err = errno;
+                for (size_t j = 0; j != listeners.size (); j++)
+                    delete listeners [j];
+                errno = err;
+                return -1;
+            }
         }
-        launch_child (listener);
+        for (size_t i = 0; i != listeners.size (); i++)
+            launch_child (listeners [i]);
         return 0;
     }
 
 #if !defined XS_HAVE_WINDOWS && !defined XS_HAVE_OPENVMS
-    if (protocol == "ipc") {
+    if (protocol == "ipc" || protocol == "shm") {
         ipc_listener_t *listener = new (std::nothrow) ipc_listener_t (
-            io_thread, this, options);
+            io_thread, this, options, protocol == "shm");
         alloc_assert (listener);
         int rc = listener->set_address (address.c_str ());
         if (rc != 0) {
@@ -404,13 +492,24 @@ int xs::socket_base_t::connect (const char *addr_)
             rcvhwm = 0;
         else
             rcvhwm = options.rcvhwm + peer.options.sndhwm;
+        uint64_t sndhwm_bytes;
+        uint64_t rcvhwm_bytes;
+        if (options.sndhwm_bytes == 0 || peer.options.rcvhwm_bytes == 0)
+            sndhwm_bytes = 0;
+        else
+            sndhwm_bytes = options.sndhwm_bytes + peer.options.rcvhwm_bytes;
+        if (options.rcvhwm_bytes == 0 || peer.options.sndhwm_bytes == 0)
+            rcvhwm_bytes = 0;
+        else
+            rcvhwm_bytes = options.rcvhwm_bytes + peer.options.sndhwm_bytes;
 
         //  Create a bi-directional pipe to connect the peers.
         object_t *parents [2] = {this, peer.socket};
         pipe_t *pipes [2] = {NULL, NULL};
         int hwms [2] = {sndhwm, rcvhwm};
+        uint64_t hwm_bytes [2] = {sndhwm_bytes, rcvhwm_bytes};
         bool delays [2] = {options.delay_on_disconnect, options.delay_on_close};
-        int rc = pipepair (parents, pipes, hwms, delays);
+        int rc = pipepair (parents, pipes, hwms, hwm_bytes, delays);
         errno_assert (rc == 0);
 
         //  Attach local end of the pipe to this socket object.
@@ -451,8 +550,9 @@ int xs::socket_base_t::connect (const char *addr_)
     object_t *parents [2] = {this, session};
     pipe_t *pipes [2] = {NULL, NULL};
     int hwms [2] = {options.sndhwm, options.rcvhwm};
+    uint64_t hwm_bytes [2] = {options.sndhwm_bytes, options.rcvhwm_bytes};
     bool delays [2] = {options.delay_on_disconnect, options.delay_on_close};
-    rc = pipepair (parents, pipes, hwms, delays);
+    rc = pipepair (parents, pipes, hwms, hwm_bytes, delays);
     errno_assert (rc == 0);
 
     // PGM does not support subscription forwarding; ask for all data to be
@@ -499,12 +599,23 @@ int xs::socket_base_t::send (msg_t *msg_, int flags_)
     if (flags_ & XS_SNDMORE)
         msg_->set_flags (msg_t::more);
 
+    //  Internal flags cannot be passed in by the user.
+    flags_ &= ~send_noflush;
+
+    //  The message is emptied by xsend, so remember its size beforehand.
+    size_t size = msg_->size ();
+
     //  Try to send the message.
     rc = xsend (msg_, flags_);
-    if (rc == 0)
+    if (rc == 0) {
+        stats.bytes_sent += size;
+        if (!(flags_ & XS_SNDMORE))
+            stats.msgs_sent++;
         return 0;
+    }
     if (unlikely (errno != EAGAIN))
         return -1;
+    stats.sends_blocked++;
 
     //  In case of non-blocking send we'll simply propagate
     //  the error - including EAGAIN - up the stack.
@@ -537,6 +648,9 @@ int xs::socket_base_t::send (msg_t *msg_, int flags_)
         }
     }
 
+    stats.bytes_sent += size;
+    if (!(flags_ & XS_SNDMORE))
+        stats.msgs_sent++;
     return 0;
 }
 
@@ -602,6 +716,41 @@ int xs::socket_base_t::recv (msg_t *msg_, int flags_)
     int timeout = options.rcvtimeo;
     uint64_t end = timeout < 0 ? 0 : (clock.now_ms () + timeout);
 
+    //  In busy-poll mode, keep checking the pipes and the mailbox for a while
+    //  before going to sleep. The mailbox stays active in the meantime so
+    //  that the peers pass the commands to us without signaling. Polling
+    //  never goes on past the timeout and the time spent polling is
+    //  deducted from the timeout.
+    if (options.busy_poll > 0) {
+        uint64_t now = clock_t::now_us ();
+        uint64_t spin_end = now + options.busy_poll;
+        if (timeout > 0 && spin_end > end * 1000)
+            spin_end = end * 1000;
+        while (true) {
+            if (unlikely (poll_commands () != 0))
+                return -1;
+            rc = xrecv (msg_, flags_);
+            if (rc == 0) {
+                ticks = 0;
+                extract_flags (msg_);
+                return 0;
+            }
+            if (unlikely (errno != EAGAIN))
+                return -1;
+            now = clock_t::now_us ();
+            if (now >= spin_end)
+                break;
+            cpu_relax ();
+        }
+        if (timeout > 0) {
+            if (now / 1000 >= end) {
+                errno = EAGAIN;
+                return -1;
+            }
+            timeout = (int) (end - now / 1000);
+        }
+    }
+
     //  In blocking scenario, commands are processed over and over again until
     //  we are able to fetch a message.
     bool block = (ticks != 0);
@@ -629,6 +778,117 @@ int xs::socket_base_t::recv (msg_t *msg_, int flags_)
     return 0;
 }
 
+int xs::socket_base_t::sendv (msg_t *msgs_, int count_, int flags_)
+{
+    //  Check whether the library haven't been shut down yet.
+    if (unlikely (ctx_terminated)) {
+        errno = ETERM;
+        return -1;
+    }
+
+    //  Check whether the array of messages is valid.
+    if (unlikely (count_ < 0 || (count_ && !msgs_))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!count_)
+        return 0;
+
+    //  Process pending commands, if any. This is done once per batch.
+    int rc = process_commands (0, true);
+    if (unlikely (rc != 0))
+        return -1;
+
+    //  Write as many messages as possible without blocking. The pipes are
+    //  not flushed after each message. Instead, all the messages are pushed
+    //  to the peers in one go afterwards.
+    int nmsgs = 0;
+    while (nmsgs != count_) {
+        msg_t *msg = &msgs_ [nmsgs];
+        if (unlikely (!msg->check ())) {
+            errno = EFAULT;
+            break;
+        }
+        msg->reset_flags (msg_t::more);
+        if (flags_ & XS_SNDMORE)
+            msg->set_flags (msg_t::more);
+        size_t size = msg->size ();
+        rc = xsend (msg, flags_ | send_noflush);
+        if (rc != 0)
+            break;
+        stats.bytes_sent += size;
+        ++nmsgs;
+    }
+    xflush ();
+    if (!(flags_ & XS_SNDMORE))
+        stats.msgs_sent += nmsgs;
+
+    //  If at least one message was sent, report success. The error, if any,
+    //  will be reported by the next call.
+    if (nmsgs) {
+        if (nmsgs != count_ && errno == EAGAIN)
+            stats.sends_blocked++;
+        return nmsgs;
+    }
+
+    //  No message could be sent. In the blocking case send the first message
+    //  using the standard algorithm, which waits for the pipes to become
+    //  writeable. Then send whatever more can be sent without blocking.
+    if (errno != EAGAIN || flags_ & XS_DONTWAIT || options.sndtimeo == 0) {
+        if (errno == EAGAIN)
+            stats.sends_blocked++;
+        return -1;
+    }
+    rc = send (msgs_, flags_);
+    if (rc != 0)
+        return -1;
+    if (count_ == 1)
+        return 1;
+    rc = sendv (msgs_ + 1, count_ - 1, flags_ | XS_DONTWAIT);
+    return rc > 0 ? rc + 1 : 1;
+}
+
+int xs::socket_base_t::recvv (msg_t *msgs_, int count_, int flags_)
+{
+    //  Check whether the array of messages is valid.
+    if (unlikely (count_ < 0 || (count_ && !msgs_))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!count_)
+        return 0;
+
+    //  The first message is received using the standard algorithm. That way
+    //  the blocking, timeouts and command processing work as expected.
+    int rc = recv (msgs_, flags_);
+    if (rc != 0)
+        return -1;
+
+    //  Retrieve any further messages that are immediately available.
+    int nmsgs = 1;
+    while (nmsgs != count_) {
+        msg_t *msg = &msgs_ [nmsgs];
+        if (unlikely (!msg->check ()))
+            break;
+        rc = xrecv (msg, flags_ | XS_DONTWAIT);
+        if (rc != 0)
+            break;
+        extract_flags (msg);
+        ++nmsgs;
+    }
+
+    //  Commands are checked once every inbound_poll_rate messages, same
+    //  as in recv. The messages are already fetched, thus we don't report
+    //  errors here. The next call will do so.
+    ticks += nmsgs - 1;
+    if (ticks >= inbound_poll_rate) {
+        process_commands (0, false);
+        ticks = 0;
+    }
+
+    return nmsgs;
+}
+
 int xs::socket_base_t::close ()
 {
     //  Mark the socket as dead.
@@ -715,6 +975,26 @@ int xs::socket_base_t::process_commands (int timeout_, bool throttle_)
         rc = mailbox.recv (&cmd, 0);
      }
 
+    //  Make the current statistics available to other threads. The sequence
+    //  number is odd while the copy is being updated.
+    stats_seq.add (1);
+    collect_stats (&published);
+    stats_seq.add (1);
+
+    if (ctx_terminated) {
+        errno = ETERM;
+        return -1;
+    }
+
+    return 0;
+}
+
+int xs::socket_base_t::poll_commands ()
+{
+    command_t cmd;
+    while (mailbox.poll (&cmd))
+        cmd.destination->process_command (cmd);
+
     if (ctx_terminated) {
         errno = ETERM;
         return -1;
@@ -780,6 +1060,15 @@ int xs::socket_base_t::xsend (msg_t *msg_, int flags_)
     return -1;
 }
 
+void xs::socket_base_t::xflush ()
+{
+}
+
+uint64_t xs::socket_base_t::xdropped ()
+{
+    return 0;
+}
+
 bool xs::socket_base_t::xhas_in ()
 {
     return false;
@@ -866,6 +1155,7 @@ void xs::socket_base_t::terminated (pipe_t *pipe_)
 
     //  Remove the pipe from the list of attached pipes and confirm its
     //  termination if we are already shutting down.
+    pipe_->set_queued_counter (NULL);
     pipes.erase (pipe_);
     if (is_terminating ())
         unregister_term_ack ();
@@ -880,5 +1170,47 @@ void xs::socket_base_t::extract_flags (msg_t *msg_)
   
     //  Remove MORE flag.
     rcvmore = msg_->flags () & msg_t::more ? true : false;
+
+    stats.bytes_received += msg_->size ();
+    if (!rcvmore)
+        stats.msgs_received++;
 }
 
+void xs::socket_base_t::collect_stats (socket_stats_t *stats_)
+{
+    *stats_ = stats;
+    stats_->msgs_dropped = xdropped ();
+    stats_->reconnects = reconnects.get ();
+    stats_->protocol_errors = protocol_errors.get ();
+}
+
+void xs::socket_base_t::get_stats (socket_stats_t *stats_)
+{
+    //  Retry if the socket has updated the copy in the meantime.
+    while (true) {
+        atomic_counter_t::integer_t seq = stats_seq.add (0);
+        if (seq & 1)
+            continue;
+        *stats_ = published;
+        if (stats_seq.add (0) == seq)
+            break;
+    }
+}
+
+void xs::socket_base_t::account_reconnect ()
+{
+    reconnects.add (1);
+}
+
+void xs::socket_base_t::account_protocol_error ()
+{
+    protocol_errors.add (1);
+}
+
+#if defined XS_HAVE_LATENCY_STATS
+xs::histogram_t *xs::socket_base_t::get_latency (int kind_)
+{
+    return &latencies [kind_];
+}
+#endif
+
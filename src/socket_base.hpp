@@ -33,6 +33,9 @@
 #include "mailbox.hpp"
 #include "stdint.hpp"
 #include "pipe.hpp"
+#if defined XS_HAVE_LATENCY_STATS
+#include "histogram.hpp"
+#endif
 
 namespace xs
 {
@@ -41,6 +44,64 @@ namespace xs
     class msg_t;
     class pipe_t;
 
+    //  Statistics of a socket. The fields are in the order they are returned
+    //  by the XS_STATS option.
+    struct socket_stats_t
+    {
+        //  Number of messages and bytes sent and received. Bytes are
+        //  counted for all the message parts.
+        uint64_t msgs_sent;
+        uint64_t bytes_sent;
+        uint64_t msgs_received;
+        uint64_t bytes_received;
+
+        //  Number of times a message couldn't be sent immediately because
+        //  all the peers had reached the high watermark or there were none.
+        uint64_t sends_blocked;
+
+        //  Number of messages dropped by the socket because the peer had
+        //  reached the high watermark or disconnected.
+        uint64_t msgs_dropped;
+
+        //  Number of messages written to the pipes, but not read by the
+        //  peers yet.
+        uint64_t msgs_queued;
+
+        //  Number of reconnection attempts.
+        uint64_t reconnects;
+
+        //  Number of connections closed because of malformed data.
+        uint64_t protocol_errors;
+
+        inline void add (const socket_stats_t &other_)
+        {
+            msgs_sent += other_.msgs_sent;
+            bytes_sent += other_.bytes_sent;
+            msgs_received += other_.msgs_received;
+            bytes_received += other_.bytes_received;
+            sends_blocked += other_.sends_blocked;
+            msgs_dropped += other_.msgs_dropped;
+            msgs_queued += other_.msgs_queued;
+            reconnects += other_.reconnects;
+            protocol_errors += other_.protocol_errors;
+        }
+    };
+
+    //  Latency histograms of a socket, in the order they are returned by
+    //  the XS_LATENCY option. The messages are measured when passing
+    //  through the pipes from the sessions to the socket and vice versa,
+    //  from the moment the engine starts encoding a batch of messages till
+    //  it's written to the network and from the moment the data are read
+    //  from the network till the decoded messages are passed to the pipe.
+    enum
+    {
+        latency_pipe_in,
+        latency_pipe_out,
+        latency_encode,
+        latency_decode,
+        latency_count
+    };
+
     class socket_base_t :
         public own_t,
         public array_item_t <>,
@@ -74,6 +135,12 @@ namespace xs
         int recv (xs::msg_t *msg_, int flags_);
         int close ();
 
+        //  Batched versions of send and recv. Commands are processed and
+        //  pipes are flushed once per batch rather than once per message.
+        //  Return the number of messages actually transferred.
+        int sendv (xs::msg_t *msgs_, int count_, int flags_);
+        int recvv (xs::msg_t *msgs_, int count_, int flags_);
+
         //  These functions are used by the polling mechanism to determine
         //  which events are to be reported from this socket.
         bool has_in ();
@@ -83,6 +150,22 @@ namespace xs
         //  its I/O thread.
         void start_reaping (io_thread_t *io_thread_);
 
+        //  Retrieves the statistics as they were when the socket processed
+        //  commands last time. This function can be called from a different
+        //  thread! It never blocks the socket.
+        void get_stats (socket_stats_t *stats_);
+
+        //  Called by the sessions of the socket. These functions can be
+        //  called from a different thread!
+        void account_reconnect ();
+        void account_protocol_error ();
+
+#if defined XS_HAVE_LATENCY_STATS
+        //  Returns the latency histogram of the specified kind. The values
+        //  can be recorded from a different thread.
+        histogram_t *get_latency (int kind_);
+#endif
+
         //  i_poll_events implementation. This interface is used when socket
         //  is handled by the io_thread in the reaper thread.
         void in_event (fd_t fd_);
@@ -115,6 +198,15 @@ namespace xs
         virtual bool xhas_out ();
         virtual int xsend (xs::msg_t *msg_, int flags_);
 
+        //  Flushes the messages passed to xsend with send_noflush flag.
+        //  The default implementation assumes there's nothing to flush.
+        virtual void xflush ();
+
+        //  Returns the number of messages dropped by the socket type.
+        //  The default implementation assumes that messages are never
+        //  dropped.
+        virtual uint64_t xdropped ();
+
         //  The default implementation assumes that recv in not supported.
         virtual bool xhas_in ();
         virtual int xrecv (xs::msg_t *msg_, int flags_);
@@ -135,9 +227,13 @@ namespace xs
         void check_destroy ();
 
         //  Moves the flags from the message to local variables,
-        //  to be later retrieved by getsockopt.
+        //  to be later retrieved by getsockopt. Accounts for the received
+        //  message.
         void extract_flags (msg_t *msg_);
 
+        //  Fills in the up-to-date statistics of the socket.
+        void collect_stats (socket_stats_t *stats_);
+
         //  Used to check whether the object is a socket.
         uint32_t tag;
 
@@ -166,6 +262,10 @@ namespace xs
         //  in a predefined time period.
         int process_commands (int timeout_, bool throttle_);
 
+        //  Processes the commands available at the moment without letting
+        //  the mailbox switch into passive state. Used in busy-poll mode.
+        int poll_commands ();
+
         //  Handlers for incoming commands.
         void process_stop ();
         void process_bind (xs::pipe_t *pipe_);
@@ -192,6 +292,22 @@ namespace xs
         //  True if the last message received had MORE flag set.
         bool rcvmore;
 
+        //  Statistics maintained by the socket's thread. The counters
+        //  updated by the sessions are kept separately.
+        socket_stats_t stats;
+        atomic_counter_t reconnects;
+        atomic_counter_t protocol_errors;
+
+        //  Statistics published to other threads. The sequence number is
+        //  incremented before and after the copy is updated, so that readers
+        //  can detect they've read a copy that was being updated.
+        socket_stats_t published;
+        atomic_counter_t stats_seq;
+
+#if defined XS_HAVE_LATENCY_STATS
+        histogram_t latencies [latency_count];
+#endif
+
         socket_base_t (const socket_base_t&);
         const socket_base_t &operator = (const socket_base_t&);
     };
@@ -25,6 +25,7 @@
 #else
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
@@ -34,10 +35,15 @@
 
 #include <string.h>
 #include <new>
+#include <algorithm>
 
 #include "stream_engine.hpp"
 #include "io_thread.hpp"
 #include "session_base.hpp"
+#include "ctx.hpp"
+#if defined XS_HAVE_LATENCY_STATS
+#include "socket_base.hpp"
+#endif
 #include "config.hpp"
 #include "err.hpp"
 #include "ip.hpp"
@@ -46,15 +52,33 @@ xs::stream_engine_t::stream_engine_t (fd_t fd_, const options_t &options_) :
     s (fd_),
     inpos (NULL),
     insize (0),
-    decoder (in_batch_size, options_.maxmsgsize),
+    decoder (in_batch_size, max_in_batch_size, options_.maxmsgsize,
+        options_.zero_copy_recv == 1),
     outpos (NULL),
     outsize (0),
-    encoder (out_batch_size),
+    encoder (out_batch_size, options_.batch_frames == 1),
     session (NULL),
     leftover_session (NULL),
     options (options_),
-    plugged (false)
+    plugged (false),
+    async (false),
+    receiving (false),
+    sending (false)
+#if defined XS_HAVE_LATENCY_STATS
+    ,
+    encode_latency (NULL),
+    decode_latency (NULL),
+    encode_start (0)
+#endif
 {
+#if !defined XS_HAVE_WINDOWS
+    outiovcnt = 0;
+    outiovpos = 0;
+#endif
+
+    //  Let the encoder know when the peer is able to decode batch frames.
+    decoder.set_encoder (&encoder);
+
     //  Get the socket into non-blocking mode.
     unblock_socket (s);
 
@@ -113,13 +137,29 @@ void xs::stream_engine_t::plug (io_thread_t *io_thread_,
     //  Connect to session object.
     xs_assert (!session);
     xs_assert (session_);
-    encoder.set_session (session_);
-    decoder.set_session (session_);
+    encoder.set_msg_source (session_);
+    decoder.set_msg_sink (session_, session_->get_ctx ()->get_msg_pool (),
+        session_->get_tid ());
+    decoder.set_memory_budget (session_->get_ctx ()->get_memory_budget ());
     session = session_;
+#if defined XS_HAVE_LATENCY_STATS
+    encode_latency = session_->get_latency (latency_encode);
+    decode_latency = session_->get_latency (latency_decode);
+#endif
 
     //  Connect to the io_thread object.
     io_object_t::plug (io_thread_);
     handle = add_fd (s);
+
+    //  If the I/O thread is able to read and write the data itself, there's
+    //  no need to poll the socket. Start sending and receiving straight away.
+    async = async_io ();
+    if (async) {
+        start_output ();
+        activate_in ();
+        return;
+    }
+
     set_pollin (handle);
     set_pollout (handle);
 
@@ -139,8 +179,8 @@ void xs::stream_engine_t::unplug ()
     io_object_t::unplug ();
 
     //  Disconnect from session object.
-    encoder.set_session (NULL);
-    decoder.set_session (NULL);
+    encoder.set_msg_source (NULL);
+    decoder.set_msg_sink (NULL);
     leftover_session = session;
     session = NULL;
 }
@@ -155,30 +195,55 @@ void xs::stream_engine_t::in_event (fd_t fd_)
 {
     bool disconnection = false;
 
-    //  If there's no data to process in the buffer...
-    if (!insize) {
+    //  Keep reading till there are no more data available in the socket.
+    //  To be fair to other engines in the same I/O thread, stop once
+    //  max_in_event_size bytes were read.
+    size_t budget = max_in_event_size;
+#if defined XS_HAVE_LATENCY_STATS
+    uint64_t decode_start = 0;
+#endif
+    bool drained = false;
+    while (true) {
+
+        //  If there's no data to process in the buffer...
+        if (!insize) {
+
+            //  Retrieve the buffer and read as much data as possible.
+            //  Note that buffer can be arbitrarily large. However, we assume
+            //  the underlying TCP layer has fixed buffer size and thus the
+            //  number of bytes read will be always limited.
+            decoder.get_buffer (&inpos, &insize);
+            size_t requested = insize;
+            insize = read (inpos, insize);
+
+            //  Check whether the peer has closed the connection.
+            if (insize == (size_t) -1) {
+                insize = 0;
+                disconnection = true;
+            }
+
+            //  If less data than requested were read, there are no more data
+            //  in the socket at the moment. No need to try reading again.
+            else {
+                drained = insize < requested;
+                budget -= std::min (budget, insize);
+                account_bytes (insize);
+#if defined XS_HAVE_LATENCY_STATS
+                if (insize && !decode_start)
+                    decode_start = histogram_t::now ();
+#endif
+            }
+        }
 
-        //  Retrieve the buffer and read as much data as possible.
-        //  Note that buffer can be arbitrarily large. However, we assume
-        //  the underlying TCP layer has fixed buffer size and thus the
-        //  number of bytes read will be always limited.
-        decoder.get_buffer (&inpos, &insize);
-        insize = read (inpos, insize);
+        //  Push the data to the decoder.
+        size_t processed = decoder.process_buffer (inpos, insize);
 
-        //  Check whether the peer has closed the connection.
-        if (insize == (size_t) -1) {
-            insize = 0;
+        if (unlikely (processed == (size_t) -1)) {
+            if (session)
+                session->protocol_error ();
             disconnection = true;
+            break;
         }
-    }
-
-    //  Push the data to the decoder.
-    size_t processed = decoder.process_buffer (inpos, insize);
-
-    if (unlikely (processed == (size_t) -1)) {
-        disconnection = true;
-    }
-    else {
 
         //  Stop polling for input if we got stuck.
         if (processed < insize) {
@@ -186,13 +251,26 @@ void xs::stream_engine_t::in_event (fd_t fd_)
             //  This may happen if queue limits are in effect.
             if (plugged)
                 reset_pollin (handle);
+
+            //  Adjust the buffer.
+            inpos += processed;
+            insize -= processed;
+            break;
         }
 
         //  Adjust the buffer.
         inpos += processed;
         insize -= processed;
+
+        if (disconnection || drained || !budget || !plugged)
+            break;
     }
 
+    //  There are no more data to read at the moment. If all of them were
+    //  processed, the receive buffer is not needed till new data arrive.
+    if (drained && !insize)
+        decoder.release_buffer ();
+
     //  Flush all messages the decoder may have produced.
     //  If IO handler has unplugged engine, flush transient IO handler.
     if (unlikely (!plugged)) {
@@ -202,6 +280,13 @@ void xs::stream_engine_t::in_event (fd_t fd_)
         session->flush ();
     }
 
+#if defined XS_HAVE_LATENCY_STATS
+    //  Time from the first byte read to the messages being handed over
+    //  to the session.
+    if (decode_start && decode_latency)
+        decode_latency->record (decode_start);
+#endif
+
     if (session && disconnection)
         error ();
 }
@@ -213,8 +298,18 @@ void xs::stream_engine_t::out_event (fd_t fd_)
     //  If write buffer is empty, try to read new data from the encoder.
     if (!outsize) {
 
+#if defined XS_HAVE_LATENCY_STATS
+        encode_start = histogram_t::now ();
+#endif
+
+#if defined XS_HAVE_WINDOWS
         outpos = NULL;
         more_data = encoder.get_data (&outpos, &outsize);
+#else
+        outiovcnt = max_io_vectors;
+        outiovpos = 0;
+        more_data = encoder.get_iovecs (outiov, &outiovcnt, &outsize);
+#endif
 
         //  If IO handler has unplugged engine, flush transient IO handler.
         if (unlikely (!plugged)) {
@@ -235,25 +330,190 @@ void xs::stream_engine_t::out_event (fd_t fd_)
     //  arbitratily large. However, we assume that underlying TCP layer has
     //  limited transmission buffer and thus the actual number of bytes
     //  written should be reasonably modest.
+#if defined XS_HAVE_WINDOWS
     int nbytes = write (outpos, outsize);
+#else
+    int nbytes = writev (outiov + outiovpos, outiovcnt - outiovpos);
+#endif
 
     //  Handle problems with the connection.
     if (nbytes == -1) {
         error ();
         return;
     }
+    account_bytes (nbytes);
 
+#if defined XS_HAVE_WINDOWS
     outpos += nbytes;
+#else
+    //  Skip the vectors that were written completely and adjust the one
+    //  that was written partially.
+    size_t written = nbytes;
+    while (written) {
+        iovec &iov = outiov [outiovpos];
+        if (written < iov.iov_len) {
+            iov.iov_base = (unsigned char*) iov.iov_base + written;
+            iov.iov_len -= written;
+            break;
+        }
+        written -= iov.iov_len;
+        outiovpos++;
+    }
+#endif
     outsize -= nbytes;
 
+#if defined XS_HAVE_LATENCY_STATS
+    //  Time from starting to encode the batch to having it all written
+    //  to the socket.
+    if (!outsize && encode_latency)
+        encode_latency->record (encode_start);
+#endif
+
     //  If the encoder reports that there are no more data to get from it
-    //  we can stop polling for POLLOUT immediately.
-    if (!more_data)
+    //  and all the data were written we can stop polling for POLLOUT
+    //  immediately.
+    if (!more_data && !outsize)
         reset_pollout (handle);
 }
 
+void xs::stream_engine_t::async_in_event (unsigned char *data_, int res_)
+{
+    receiving = false;
+
+    //  Zero means orderly shutdown by the peer.
+    bool disconnection = false;
+    if (res_ > 0) {
+        inpos = data_;
+        insize = res_;
+        account_bytes (insize);
+    }
+    else if (res_ != -EAGAIN && res_ != -EINTR) {
+        if (res_ && res_ != -ECONNRESET && res_ != -ECONNREFUSED &&
+              res_ != -ETIMEDOUT && res_ != -EHOSTUNREACH &&
+              res_ != -ENOTCONN) {
+            errno = -res_;
+            errno_assert (false);
+        }
+        disconnection = true;
+    }
+
+#if defined XS_HAVE_LATENCY_STATS
+    uint64_t decode_start = insize ? histogram_t::now () : 0;
+#endif
+    if (!decode ())
+        disconnection = true;
+#if defined XS_HAVE_LATENCY_STATS
+    if (decode_start && decode_latency)
+        decode_latency->record (decode_start);
+#endif
+
+    if (session && disconnection) {
+        error ();
+        return;
+    }
+    start_input ();
+}
+
+void xs::stream_engine_t::async_out_event (int res_)
+{
+    sending = false;
+
+    if (res_ < 0) {
+        if (res_ != -EAGAIN && res_ != -EINTR) {
+            if (res_ != -ECONNRESET && res_ != -EPIPE) {
+                errno = -res_;
+                errno_assert (false);
+            }
+            error ();
+            return;
+        }
+        res_ = 0;
+    }
+    account_bytes (res_);
+    outpos += res_;
+    outsize -= res_;
+
+#if defined XS_HAVE_LATENCY_STATS
+    if (!outsize && encode_latency)
+        encode_latency->record (encode_start);
+#endif
+
+    start_output ();
+}
+
+bool xs::stream_engine_t::decode ()
+{
+    //  The data are processed even if there are none. The decoder may hold
+    //  a complete message it was not able to pass to the session before.
+    bool ok = true;
+    size_t processed = decoder.process_buffer (inpos, insize);
+    if (unlikely (processed == (size_t) -1)) {
+        if (session)
+            session->protocol_error ();
+        ok = false;
+    }
+    else {
+        inpos += processed;
+        insize -= processed;
+    }
+
+    //  Flush all messages the decoder may have produced.
+    //  If IO handler has unplugged engine, flush transient IO handler.
+    if (unlikely (!plugged)) {
+        xs_assert (leftover_session);
+        leftover_session->flush ();
+    } else {
+        session->flush ();
+    }
+    return ok;
+}
+
+void xs::stream_engine_t::start_input ()
+{
+    //  If the session wasn't able to accept all the data, wait till it
+    //  asks for more via activate_in.
+    if (!plugged || receiving || insize)
+        return;
+    async_recv (handle);
+    receiving = true;
+}
+
+void xs::stream_engine_t::start_output ()
+{
+    if (sending)
+        return;
+
+    //  If all the data were sent, get a new batch from the encoder.
+    if (!outsize) {
+#if defined XS_HAVE_LATENCY_STATS
+        encode_start = histogram_t::now ();
+#endif
+        outpos = get_send_buffer (handle, &outsize);
+        encoder.get_data (&outpos, &outsize);
+
+        //  If IO handler has unplugged engine, flush transient IO handler.
+        if (unlikely (!plugged)) {
+            xs_assert (leftover_session);
+            leftover_session->flush ();
+            return;
+        }
+
+        //  If there's nothing to send, wait for activate_out.
+        if (!outsize)
+            return;
+    }
+
+    async_send (handle, outpos, outsize);
+    sending = true;
+}
+
 void xs::stream_engine_t::activate_out ()
 {
+    if (async) {
+        start_output ();
+        return;
+    }
+
     set_pollout (handle);
 
     //  Speculative write: The assumption is that at the moment new message
@@ -265,6 +525,17 @@ void xs::stream_engine_t::activate_out ()
 
 void xs::stream_engine_t::activate_in ()
 {
+    //  Pass the data the session wasn't able to accept before and receive
+    //  more once all of them were processed.
+    if (async) {
+        if (!decode () && session) {
+            error ();
+            return;
+        }
+        start_input ();
+        return;
+    }
+
     set_pollin (handle);
 
     //  Speculative read.
@@ -324,6 +595,33 @@ int xs::stream_engine_t::write (const void *data_, size_t size_)
 #endif
 }
 
+#if !defined XS_HAVE_WINDOWS
+
+int xs::stream_engine_t::writev (const iovec *iov_, int iovcnt_)
+{
+    msghdr hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.msg_iov = (iovec*) iov_;
+    hdr.msg_iovlen = iovcnt_;
+    ssize_t nbytes = sendmsg (s, &hdr, 0);
+
+    //  Several errors are OK. When speculative write is being done we may not
+    //  be able to write a single byte from the socket. Also, SIGSTOP issued
+    //  by a debugging tool can result in EINTR error.
+    if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+          errno == EINTR))
+        return 0;
+
+    //  Signalise peer failure.
+    if (nbytes == -1 && (errno == ECONNRESET || errno == EPIPE))
+        return -1;
+
+    errno_assert (nbytes != -1);
+    return (size_t) nbytes;
+}
+
+#endif
+
 int xs::stream_engine_t::read (void *data_, size_t size_)
 {
 #ifdef XS_HAVE_WINDOWS
@@ -30,6 +30,11 @@
 #include "encoder.hpp"
 #include "decoder.hpp"
 #include "options.hpp"
+#include "config.hpp"
+#include "platform.hpp"
+#if defined XS_HAVE_LATENCY_STATS
+#include "histogram.hpp"
+#endif
 
 namespace xs
 {
@@ -58,9 +63,22 @@ namespace xs
         //  i_poll_events interface implementation.
         void in_event (fd_t fd_);
         void out_event (fd_t fd_);
+        void async_in_event (unsigned char *data_, int res_);
+        void async_out_event (int res_);
 
     private:
 
+        //  Pushes the received data to the decoder and flushes the messages
+        //  produced. Returns false in case of protocol error.
+        bool decode ();
+
+        //  Used instead of polling when the I/O thread does the reads and
+        //  writes itself. start_input starts receiving if all the received
+        //  data were processed. start_output fills in the I/O thread's send
+        //  buffer from the encoder and starts sending it.
+        void start_input ();
+        void start_output ();
+
         //  Function to handle network disconnections.
         void error ();
 
@@ -69,6 +87,12 @@ namespace xs
         //  of error or orderly shutdown by the other peer -1 is returned.
         int write (const void *data_, size_t size_);
 
+#if !defined XS_HAVE_WINDOWS
+        //  Writes data described by the array of I/O vectors to the socket.
+        //  The semantics of return value are the same as with write.
+        int writev (const iovec *iov_, int iovcnt_);
+#endif
+
         //  Reads data from the socket (up to 'size' bytes). Returns the number
         //  of bytes actually read (even zero is to be considered to be
         //  a success). In case of error or orderly shutdown by the other
@@ -88,6 +112,14 @@ namespace xs
         size_t outsize;
         encoder_t encoder;
 
+#if !defined XS_HAVE_WINDOWS
+        //  Data to write are described by the array of I/O vectors rather
+        //  than by outpos. Vectors before outiovpos were already written.
+        iovec outiov [max_io_vectors];
+        int outiovcnt;
+        int outiovpos;
+#endif
+
         //  The session this engine is attached to.
         xs::session_base_t *session;
 
@@ -98,6 +130,24 @@ namespace xs
 
         bool plugged;
 
+        //  True if the I/O thread does the reads and writes for the engine.
+        //  In such case the socket is never polled.
+        bool async;
+
+        //  True if asynchronous receive, respectively send, is in flight.
+        bool receiving;
+        bool sending;
+
+#if defined XS_HAVE_LATENCY_STATS
+        //  Histograms of the time spent encoding and writing the outbound
+        //  batches and reading and decoding the inbound data.
+        histogram_t *encode_latency;
+        histogram_t *decode_latency;
+
+        //  Time when encoding of the batch being written started.
+        uint64_t encode_start;
+#endif
+
         stream_engine_t (const stream_engine_t&);
         const stream_engine_t &operator = (const stream_engine_t&);
     };
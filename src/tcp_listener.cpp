@@ -54,6 +54,7 @@ xs::tcp_listener_t::tcp_listener_t (io_thread_t *io_thread_,
     io_object_t (io_thread_),
     has_file (false),
     s (retired_fd),
+    io_thread (io_thread_),
     socket (socket_)
 {
 }
@@ -79,31 +80,38 @@ void xs::tcp_listener_t::process_term (int linger_)
 
 void xs::tcp_listener_t::in_event (fd_t fd_)
 {
-    fd_t fd = accept ();
-
-    //  If connection was reset by the peer in the meantime, just ignore it.
+    //  Accept all the pending connections. If a connection was reset by
+    //  the peer in the meantime, stop and wait for the next event.
     //  TODO: Handle specific errors like ENFILE/EMFILE etc.
-    if (fd == retired_fd)
-        return;
-
-    tune_tcp_socket (fd);
-
-    //  Create the engine object for this connection.
-    stream_engine_t *engine = new (std::nothrow) stream_engine_t (fd, options);
-    alloc_assert (engine);
-
-    //  Choose I/O thread to run connecter in. Given that we are already
-    //  running in an I/O thread, there must be at least one available.
-    io_thread_t *io_thread = choose_io_thread (options.affinity);
-    xs_assert (io_thread);
-
-    //  Create and launch a session object. 
-    session_base_t *session = session_base_t::create (io_thread, false, socket,
-        options, NULL, NULL);
-    errno_assert (session);
-    session->inc_seqnum ();
-    launch_child (session);
-    send_attach (session, engine, false);
+    while (true) {
+        fd_t fd = accept ();
+        if (fd == retired_fd)
+            return;
+
+        tune_tcp_socket (fd);
+
+        //  Create the engine object for this connection.
+        stream_engine_t *engine =
+            new (std::nothrow) stream_engine_t (fd, options);
+        alloc_assert (engine);
+
+        //  Choose I/O thread to run the session in. If the port is shared
+        //  by listeners in several I/O threads, the kernel has already
+        //  balanced the connections, so the session stays in this thread.
+        //  Otherwise, given that we are already running in an I/O thread,
+        //  there must be at least one available.
+        io_thread_t *session_thread = options.reuseport ?
+            io_thread : choose_io_thread (options.affinity);
+        xs_assert (session_thread);
+
+        //  Create and launch a session object. 
+        session_base_t *session = session_base_t::create (session_thread,
+            false, socket, options, NULL, NULL);
+        errno_assert (session);
+        session->inc_seqnum ();
+        launch_child (session);
+        send_attach (session, engine, false);
+    }
 }
 
 void xs::tcp_listener_t::close ()
@@ -157,6 +165,10 @@ int xs::tcp_listener_t::set_address (const char *addr_)
     if (address.family () == AF_INET6)
         enable_ipv4_mapping (s);
 
+    //  The connections are accepted in a loop until there are no more of
+    //  them, so the listening socket must not block.
+    unblock_socket (s);
+
     //  Allow reusing of the address.
     int flag = 1;
 #ifdef XS_HAVE_WINDOWS
@@ -168,6 +180,15 @@ int xs::tcp_listener_t::set_address (const char *addr_)
     errno_assert (rc == 0);
 #endif
 
+    //  Allow several listeners to share the port.
+#ifdef SO_REUSEPORT
+    if (options.reuseport) {
+        rc = setsockopt (s, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof (int));
+        if (rc != 0)
+            return -1;
+    }
+#endif
+
     //  Bind the socket to the network interface and port.
     rc = bind (s, address.addr (), address.addrlen ());
 #ifdef XS_HAVE_WINDOWS
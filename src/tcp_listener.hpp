@@ -58,8 +58,9 @@ namespace xs
         void close ();
 
         //  Accept the new connection. Returns the file descriptor of the
-        //  newly created connection. The function may return retired_fd
-        //  if the connection was dropped while waiting in the listen backlog.
+        //  newly created connection. The function returns retired_fd if
+        //  there are no more connections waiting in the listen backlog or
+        //  if the connection was dropped while waiting there.
         fd_t accept ();
 
         //  Address to listen on.
@@ -74,6 +75,9 @@ namespace xs
         //  Handle corresponding to the listening socket.
         handle_t handle;
 
+        //  I/O thread the listener runs in.
+        xs::io_thread_t *io_thread;
+
         //  Socket the listerner belongs to.
         xs::socket_base_t *socket;
 
@@ -23,6 +23,75 @@
 #include "err.hpp"
 #include "platform.hpp"
 
+#if defined XS_HAVE_LINUX
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#if !defined XS_HAVE_WINDOWS
+#include <unistd.h>
+#endif
+
+int xs::get_cpu_count ()
+{
+#if defined XS_HAVE_WINDOWS
+    //  Only the CPUs in the thread's processor group can be used.
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    return (int) info.dwNumberOfProcessors;
+#elif defined _SC_NPROCESSORS_CONF
+    long count = sysconf (_SC_NPROCESSORS_CONF);
+    return count > 0 ? (int) count : 1;
+#else
+    return 1;
+#endif
+}
+
+//  Restricts the calling thread to the CPUs listed.
+static void bind_to_cpus (const xs::cpus_t &cpus_)
+{
+    if (cpus_.empty ())
+        return;
+
+#if defined XS_HAVE_WINDOWS
+    //  Only the CPUs in the thread's processor group can be used. The CPU
+    //  numbers were checked against the size of the group beforehand.
+    DWORD_PTR mask = 0;
+    for (xs::cpus_t::size_type i = 0; i != cpus_.size (); i++)
+        if (cpus_ [i] < (int) (sizeof (DWORD_PTR) * 8))
+            mask |= ((DWORD_PTR) 1) << cpus_ [i];
+    if (mask)
+        SetThreadAffinityMask (GetCurrentThread (), mask);
+#elif defined XS_HAVE_LINUX
+    //  Dynamically sized CPU set is used so that there's no limit on the
+    //  number of CPUs.
+    int max_cpu = 0;
+    for (xs::cpus_t::size_type i = 0; i != cpus_.size (); i++)
+        if (cpus_ [i] > max_cpu)
+            max_cpu = cpus_ [i];
+    cpu_set_t *set = CPU_ALLOC (max_cpu + 1);
+    alloc_assert (set);
+    size_t size = CPU_ALLOC_SIZE (max_cpu + 1);
+    CPU_ZERO_S (size, set);
+    for (xs::cpus_t::size_type i = 0; i != cpus_.size (); i++)
+        CPU_SET_S (cpus_ [i], size, set);
+    int rc = sched_setaffinity (0, size, set);
+    CPU_FREE (set);
+
+    //  If the CPUs are not available to the process, run unrestricted.
+    if (rc != 0)
+        return;
+
+    //  Allocate the memory from the NUMA node the thread runs on, even if
+    //  the process as a whole uses a different memory policy. That way
+    //  the buffers and pipe chunks allocated by the thread are local to it.
+#if defined MPOL_LOCAL && defined SYS_set_mempolicy
+    syscall (SYS_set_mempolicy, MPOL_LOCAL, NULL, 0);
+#endif
+#endif
+}
+
 #ifdef XS_HAVE_WINDOWS
 
 extern "C"
@@ -30,15 +99,17 @@ extern "C"
     static unsigned int __stdcall thread_routine (void *arg_)
     {
         xs::thread_t *self = (xs::thread_t*) arg_;
+        bind_to_cpus (self->cpus);
         self->tfn (self->arg);
         return 0;
     }
 }
 
-void xs::thread_t::start (thread_fn *tfn_, void *arg_)
+void xs::thread_t::start (thread_fn *tfn_, void *arg_, const cpus_t &cpus_)
 {
     tfn = tfn_;
     arg =arg_;
+    cpus = cpus_;
     descriptor = (HANDLE) _beginthreadex (NULL, 0,
         &::thread_routine, this, 0 , NULL);
     win_assert (descriptor != NULL);    
@@ -70,16 +141,18 @@ extern "C"
         posix_assert (rc);
 #endif
 
-        xs::thread_t *self = (xs::thread_t*) arg_;   
+        xs::thread_t *self = (xs::thread_t*) arg_;
+        bind_to_cpus (self->cpus);
         self->tfn (self->arg);
         return NULL;
     }
 }
 
-void xs::thread_t::start (thread_fn *tfn_, void *arg_)
+void xs::thread_t::start (thread_fn *tfn_, void *arg_, const cpus_t &cpus_)
 {
     tfn = tfn_;
     arg =arg_;
+    cpus = cpus_;
     int rc = pthread_create (&descriptor, NULL, thread_routine, this);
     posix_assert (rc);
 }
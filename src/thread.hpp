@@ -22,6 +22,8 @@
 #ifndef __XS_THREAD_HPP_INCLUDED__
 #define __XS_THREAD_HPP_INCLUDED__
 
+#include <vector>
+
 #include "platform.hpp"
 
 #ifdef XS_HAVE_WINDOWS
@@ -35,6 +37,13 @@ namespace xs
 
     typedef void (thread_fn) (void*);
 
+    //  Set of CPUs, each identified by its number.
+    typedef std::vector <int> cpus_t;
+
+    //  Returns number of CPUs configured in the system. Numbers of the CPUs
+    //  the threads are pinned to have to be lower than this value.
+    int get_cpu_count ();
+
     //  Class encapsulating OS thread. Thread initiation/termination is done
     //  using special functions rather than in constructor/destructor so that
     //  thread isn't created during object construction by accident, causing
@@ -51,8 +60,12 @@ namespace xs
         }
 
         //  Creates OS thread. 'tfn' is main thread function. It'll be passed
-        //  'arg' as an argument.
-        void start (thread_fn *tfn_, void *arg_);
+        //  'arg' as an argument. If 'cpus' is not empty, the thread is allowed
+        //  to run only on the CPUs listed and it allocates memory on its
+        //  local NUMA node. Pinning is done on a best-effort basis; it is
+        //  ignored if the OS doesn't support it.
+        void start (thread_fn *tfn_, void *arg_,
+            const cpus_t &cpus_ = cpus_t ());
 
         //  Waits for thread termination.
         void stop ();
@@ -61,6 +74,7 @@ namespace xs
         //  they would not be accessible from the main C routine of the thread.
         thread_fn *tfn;
         void *arg;
+        cpus_t cpus;
         
     private:
 
@@ -0,0 +1,292 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+
+#include "timers.hpp"
+#include "io_thread.hpp"
+#include "config.hpp"
+#include "err.hpp"
+
+//  Returns the index of the lowest bit set. The argument must not be zero.
+static inline int lowest_set_bit (uint64_t bits_)
+{
+#if defined __GNUC__
+    return __builtin_ctzll (bits_);
+#else
+    int index = 0;
+    while (!(bits_ & 1)) {
+        bits_ >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+//  Returns the distance from position pos_ to the first set bit at or after
+//  pos_ in the circular bitmap of size_ bits, or -1 if no bit is set.
+static int scan_bitmap (const uint64_t *bitmap_, int size_, int pos_)
+{
+    int words = size_ / 64;
+    int first = pos_ / 64;
+    uint64_t bits = bitmap_ [first] & (~((uint64_t) 0) << (pos_ % 64));
+    for (int i = 0; i <= words; i++) {
+        int word = (first + i) % words;
+        if (i == words)
+            bits = bitmap_ [first] & ((((uint64_t) 1) << (pos_ % 64)) - 1);
+        else if (i)
+            bits = bitmap_ [word];
+        if (bits)
+            return (word * 64 + lowest_set_bit (bits) - pos_ + size_) % size_;
+    }
+    return -1;
+}
+
+xs::timers_t::timers_t () :
+    current (0),
+    count (0),
+    free_entries (NULL)
+{
+    for (int i = 0; i != slot_count; i++) {
+        slots [i].prev = &slots [i];
+        slots [i].next = &slots [i];
+    }
+    for (int i = 0; i != slot_count / 64; i++)
+        occupied [i] = 0;
+}
+
+xs::timers_t::~timers_t ()
+{
+    for (chunks_t::iterator it = chunks.begin (); it != chunks.end (); ++it)
+        free (*it);
+}
+
+xs::handle_t xs::timers_t::add (uint64_t now_, int timeout_,
+    i_poll_events *sink_)
+{
+    //  If there are no timers, there's nothing to process in the past.
+    //  Move the wheel forward to the present time.
+    if (!count && now_ > current)
+        current = now_;
+
+    entry_t *entry = alloc_entry ();
+    entry->expiration = now_ + timeout_;
+    entry->sink = sink_;
+    insert (entry);
+    count++;
+    return (handle_t) entry;
+}
+
+void xs::timers_t::rm (handle_t handle_)
+{
+    entry_t *entry = (entry_t*) handle_;
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    if (entry->slot >= 0 && slots [entry->slot].next == &slots [entry->slot])
+        occupied [entry->slot / 64] &= ~(((uint64_t) 1) << (entry->slot % 64));
+    free_entry (entry);
+    count--;
+}
+
+bool xs::timers_t::empty ()
+{
+    return count == 0;
+}
+
+uint64_t xs::timers_t::execute (uint64_t now_)
+{
+    while (count && current <= now_) {
+
+        //  At the beginning of each period of the first level, move the
+        //  timers expiring within it from the upper levels.
+        if (!(current & (level0_slots - 1)))
+            cascade ();
+
+        //  Execute the timers due at this millisecond. Timers added while
+        //  executing them fall into the next millisecond at the earliest.
+        link_t due;
+        take ((int) (current & (level0_slots - 1)), &due);
+        current++;
+        while (due.next != &due) {
+            entry_t *entry = (entry_t*) due.next;
+            i_poll_events *sink = entry->sink;
+            rm ((handle_t) entry);
+            sink->timer_event ((handle_t) entry);
+        }
+
+        //  Skip the empty slots till the end of the period.
+        if (current & (level0_slots - 1)) {
+            int pos = (int) (current & (level0_slots - 1));
+            int distance = scan_bitmap (occupied, level0_slots, pos);
+            uint64_t next;
+            if (distance < 0 || pos + distance >= level0_slots)
+                next = (current | (level0_slots - 1)) + 1;
+            else
+                next = current + distance;
+            current = next <= now_ ? next : now_ + 1;
+        }
+    }
+
+    //  There are no more timers.
+    if (!count)
+        return 0;
+
+    //  Return the time to wait for the next timer (at least 1ms).
+    uint64_t next = next_expiration ();
+    return next > now_ ? next - now_ : 1;
+}
+
+void xs::timers_t::insert (entry_t *entry_)
+{
+    //  Timers that are already due go to the slot processed next.
+    uint64_t expiration = entry_->expiration;
+    if (expiration < current)
+        expiration = current;
+    uint64_t delta = expiration - current;
+
+    int slot;
+    if (delta < level0_slots)
+        slot = (int) (expiration & (level0_slots - 1));
+    else {
+
+        //  Find the level covering the expiration time. Timers expiring
+        //  beyond the range of the top level are placed to its last slot.
+        //  They'll get there once again when the slot is cascaded.
+        int level = 1;
+        int shift = level0_bits;
+        while (delta >= ((uint64_t) 1) << (shift + level_bits)) {
+            if (level == levels - 1) {
+                expiration = current +
+                    (((uint64_t) 1) << (shift + level_bits)) - 1;
+                break;
+            }
+            level++;
+            shift += level_bits;
+        }
+        slot = level0_slots + (level - 1) * level_slots +
+            (int) ((expiration >> shift) & (level_slots - 1));
+    }
+
+    //  Append the timer to the slot.
+    entry_->slot = slot;
+    entry_->prev = slots [slot].prev;
+    entry_->next = &slots [slot];
+    slots [slot].prev->next = entry_;
+    slots [slot].prev = entry_;
+    occupied [slot / 64] |= ((uint64_t) 1) << (slot % 64);
+}
+
+void xs::timers_t::take (int slot_, link_t *list_)
+{
+    link_t *head = &slots [slot_];
+    if (head->next == head) {
+        list_->prev = list_;
+        list_->next = list_;
+        return;
+    }
+
+    //  Mark the timers as not belonging to any slot.
+    for (link_t *it = head->next; it != head; it = it->next)
+        ((entry_t*) it)->slot = -1;
+
+    //  Move the whole list.
+    list_->prev = head->prev;
+    list_->next = head->next;
+    list_->prev->next = list_;
+    list_->next->prev = list_;
+    head->prev = head;
+    head->next = head;
+    occupied [slot_ / 64] &= ~(((uint64_t) 1) << (slot_ % 64));
+}
+
+void xs::timers_t::cascade ()
+{
+    //  The period of a level starts when the index of the previous level
+    //  wraps around to zero.
+    int shift = level0_bits;
+    for (int level = 1; level != levels; level++) {
+        int index = (int) ((current >> shift) & (level_slots - 1));
+        link_t list;
+        take (level0_slots + (level - 1) * level_slots + index, &list);
+        while (list.next != &list) {
+            entry_t *entry = (entry_t*) list.next;
+            list.next = entry->next;
+            insert (entry);
+        }
+        if (index)
+            break;
+        shift += level_bits;
+    }
+}
+
+uint64_t xs::timers_t::next_expiration ()
+{
+    //  First level holds the exact expiration times.
+    uint64_t result = (uint64_t) -1;
+    int distance = scan_bitmap (occupied, level0_slots,
+        (int) (current & (level0_slots - 1)));
+    if (distance >= 0)
+        result = current + distance;
+
+    //  For the upper levels, use the beginning of the period covered by the
+    //  first non-empty slot. If the period of the slot at the current index
+    //  has already started, the slot holds the timers for the next round,
+    //  so the scan starts at the following slot.
+    int shift = level0_bits;
+    for (int level = 1; level != levels; level++) {
+        const uint64_t *bitmap = &occupied [(level0_slots +
+            (level - 1) * level_slots) / 64];
+        uint64_t base = current >> shift;
+        if (current & ((((uint64_t) 1) << shift) - 1))
+            base++;
+        distance = scan_bitmap (bitmap, level_slots,
+            (int) (base & (level_slots - 1)));
+        if (distance >= 0) {
+            uint64_t start = (base + distance) << shift;
+            if (start < result)
+                result = start;
+        }
+        shift += level_bits;
+    }
+
+    return result;
+}
+
+xs::timers_t::entry_t *xs::timers_t::alloc_entry ()
+{
+    if (!free_entries) {
+        entry_t *chunk = (entry_t*) malloc (sizeof (entry_t) *
+            timer_chunk_size);
+        alloc_assert (chunk);
+        chunks.push_back (chunk);
+        for (int i = 0; i != timer_chunk_size; i++)
+            free_entry (&chunk [i]);
+    }
+    entry_t *entry = free_entries;
+    free_entries = (entry_t*) entry->next;
+    return entry;
+}
+
+void xs::timers_t::free_entry (entry_t *entry_)
+{
+    entry_->next = free_entries;
+    free_entries = entry_;
+}
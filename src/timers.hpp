@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __XS_TIMERS_HPP_INCLUDED__
+#define __XS_TIMERS_HPP_INCLUDED__
+
+#include <stddef.h>
+#include <vector>
+
+#include "stdint.hpp"
+
+namespace xs
+{
+
+    struct i_poll_events;
+    typedef void* handle_t;
+
+    //  Set of timers implemented as a hierarchical timer wheel. The first
+    //  level has a slot for each millisecond of the following 256 ms. Each
+    //  of the subsequent levels has 64 slots, each slot covering 64 times
+    //  longer period than a slot of the previous level. As the time passes,
+    //  timers are moved from the upper levels to the lower ones. Adding and
+    //  cancelling a timer thus doesn't depend on the number of timers.
+
+    class timers_t
+    {
+    public:
+
+        timers_t ();
+        ~timers_t ();
+
+        //  Add a timer to expire in timeout_ milliseconds from now_. After
+        //  the expiration timer_event on sink_ object will be called.
+        handle_t add (uint64_t now_, int timeout_, xs::i_poll_events *sink_);
+
+        //  Cancel the timer identified by the handle.
+        void rm (handle_t handle_);
+
+        //  Returns true if there are no active timers.
+        bool empty ();
+
+        //  Executes the timers that are due at now_. Returns number of
+        //  milliseconds to wait for the next timer or 0 meaning "no timers".
+        uint64_t execute (uint64_t now_);
+
+    private:
+
+        enum {
+            level0_bits = 8,
+            level_bits = 6,
+            levels = 5,
+            level0_slots = 1 << level0_bits,
+            level_slots = 1 << level_bits,
+            slot_count = level0_slots + (levels - 1) * level_slots
+        };
+
+        //  Timers are stored in circular doubly-linked lists. Each slot is
+        //  represented by the list head.
+        struct link_t
+        {
+            link_t *prev;
+            link_t *next;
+        };
+
+        struct entry_t : link_t
+        {
+            uint64_t expiration;
+            xs::i_poll_events *sink;
+
+            //  Index of the slot the timer belongs to, -1 if the timer
+            //  is about to be executed.
+            int slot;
+        };
+
+        //  Inserts the timer into the appropriate slot.
+        void insert (entry_t *entry_);
+
+        //  Moves all the timers from the slot to the list.
+        void take (int slot_, link_t *list_);
+
+        //  Moves the timers from the upper levels that expire within
+        //  the period starting now to the lower levels.
+        void cascade ();
+
+        //  Returns the earliest time a timer can expire at.
+        uint64_t next_expiration ();
+
+        //  Management of unused timer entries.
+        entry_t *alloc_entry ();
+        void free_entry (entry_t *entry_);
+
+        //  The first millisecond that haven't been processed yet.
+        uint64_t current;
+
+        //  The slots and a bitmap of those that are not empty.
+        link_t slots [slot_count];
+        uint64_t occupied [slot_count / 64];
+
+        //  Number of active timers.
+        size_t count;
+
+        //  List of unused entries.
+        entry_t *free_entries;
+
+        //  Memory blocks holding the entries.
+        typedef std::vector <entry_t*> chunks_t;
+        chunks_t chunks;
+
+        timers_t (const timers_t&);
+        const timers_t &operator = (const timers_t&);
+    };
+
+}
+
+#endif
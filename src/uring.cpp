@@ -0,0 +1,484 @@
+/*
+    Copyright (c) 2009-2012 250bpm s.r.o.
+    Copyright (c) 2007-2009 iMatix Corporation
+    Copyright (c) 2007-2011 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "uring.hpp"
+
+#if defined XS_HAVE_IO_URING
+
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <endian.h>
+#include <time.h>
+#include <new>
+
+#include "config.hpp"
+#include "err.hpp"
+
+//  Features of the kernel interface the implementation relies on.
+#define XS_URING_FEATURES \
+    (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG)
+
+//  The lowest two bits of the user data identify the kind of the request.
+//  The rest is the pointer to the poll entry.
+#define XS_URING_POLL 0
+#define XS_URING_CANCEL 1
+#define XS_URING_RECV 2
+#define XS_URING_SEND 3
+#define XS_URING_KIND 3
+
+static int uring_setup (unsigned entries_, io_uring_params *params_)
+{
+    return (int) syscall (__NR_io_uring_setup, entries_, params_);
+}
+
+static int uring_enter (int fd_, unsigned to_submit_, unsigned min_complete_,
+    unsigned flags_, void *arg_, size_t argsz_)
+{
+    return (int) syscall (__NR_io_uring_enter, fd_, to_submit_, min_complete_,
+        flags_, arg_, argsz_);
+}
+
+bool xs::uring_t::available ()
+{
+    io_uring_params params;
+    memset (&params, 0, sizeof (params));
+    int fd = uring_setup (max_io_events, &params);
+    if (fd == -1)
+        return false;
+    int rc = close (fd);
+    errno_assert (rc == 0);
+    return (params.features & XS_URING_FEATURES) == XS_URING_FEATURES;
+}
+
+xs::uring_t::uring_t (xs::ctx_t *ctx_, uint32_t tid_) :
+    io_thread_t (ctx_, tid_),
+    stopping (false)
+{
+    io_uring_params params;
+    memset (&params, 0, sizeof (params));
+    ring_fd = uring_setup (max_io_events, &params);
+    errno_assert (ring_fd != -1);
+    xs_assert ((params.features & XS_URING_FEATURES) == XS_URING_FEATURES);
+
+    //  Map submission and completion rings. With IORING_FEAT_SINGLE_MMAP
+    //  both of them live in a single memory area.
+    ring_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    size_t cq_size = params.cq_off.cqes +
+        params.cq_entries * sizeof (io_uring_cqe);
+    if (cq_size > ring_size)
+        ring_size = cq_size;
+    ring_ptr = mmap (NULL, ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    errno_assert (ring_ptr != MAP_FAILED);
+    sqes_size = params.sq_entries * sizeof (io_uring_sqe);
+    sqes = (io_uring_sqe*) mmap (NULL, sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    errno_assert (sqes != MAP_FAILED);
+
+    unsigned char *ptr = (unsigned char*) ring_ptr;
+    sq_head = (unsigned*) (ptr + params.sq_off.head);
+    sq_tail = (unsigned*) (ptr + params.sq_off.tail);
+    sq_mask = *(unsigned*) (ptr + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_array = (unsigned*) (ptr + params.sq_off.array);
+    cq_head = (unsigned*) (ptr + params.cq_off.head);
+    cq_tail = (unsigned*) (ptr + params.cq_off.tail);
+    cq_mask = *(unsigned*) (ptr + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*) (ptr + params.cq_off.cqes);
+}
+
+xs::uring_t::~uring_t ()
+{
+    //  Wait till the worker thread exits.
+    worker.stop ();
+
+    //  Closing the ring cancels all the requests in flight. However, the
+    //  kernel may still write to the buffers of the receives that are being
+    //  cancelled, so wait for those to complete before freeing the buffers.
+    for (changed_t::size_type i = 0; i != changed.size (); i++) {
+        changed [i]->changed = false;
+        sync (changed [i]);
+    }
+    changed.clear ();
+    while (true) {
+        bool busy = false;
+        for (retired_t::size_type i = 0; i != retired.size (); i++)
+            if (retired [i]->receiving || retired [i]->sending)
+                busy = true;
+        if (!busy)
+            break;
+        enter (true, 0);
+        process_completions ();
+    }
+
+    int rc = munmap (sqes, sqes_size);
+    errno_assert (rc == 0);
+    rc = munmap (ring_ptr, ring_size);
+    errno_assert (rc == 0);
+    close (ring_fd);
+    for (retired_t::iterator it = retired.begin (); it != retired.end (); ++it)
+        free_entry (*it);
+}
+
+xs::handle_t xs::uring_t::add_fd (fd_t fd_, i_poll_events *events_)
+{
+    poll_entry_t *pe = new (std::nothrow) poll_entry_t;
+    alloc_assert (pe);
+
+    pe->fd = fd_;
+    pe->mask = 0;
+    pe->armed = 0;
+    pe->cancelling = false;
+    pe->changed = false;
+    pe->receiving = false;
+    pe->sending = false;
+    pe->recv_buf = NULL;
+    pe->send_buf = NULL;
+    pe->pending = 0;
+    pe->events = events_;
+
+    //  Increase the load metric of the thread.
+    adjust_load (1);
+
+    return pe;
+}
+
+void xs::uring_t::rm_fd (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    pe->fd = retired_fd;
+    pe->mask = 0;
+
+    //  Cancel the requests in flight straight away rather than in the next
+    //  iteration of the loop. That way the kernel drops its references to
+    //  the file before the caller closes it, e.g. the listening socket is
+    //  unbound by the time the close returns.
+    if (pe->receiving)
+        cancel (pe, ((uint64_t) (size_t) pe) | XS_URING_RECV);
+    if (pe->sending)
+        cancel (pe, ((uint64_t) (size_t) pe) | XS_URING_SEND);
+    sync (pe);
+    enter (false, 0);
+    retired.push_back (pe);
+
+    //  Decrease the load metric of the thread.
+    adjust_load (-1);
+}
+
+void xs::uring_t::set_pollin (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    pe->mask |= POLLIN;
+    change (pe);
+}
+
+void xs::uring_t::reset_pollin (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    pe->mask &= ~((short) POLLIN);
+}
+
+void xs::uring_t::set_pollout (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    pe->mask |= POLLOUT;
+    change (pe);
+}
+
+void xs::uring_t::reset_pollout (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    pe->mask &= ~((short) POLLOUT);
+}
+
+void xs::uring_t::xstart ()
+{
+    worker.start (worker_routine, this, cpus);
+}
+
+void xs::uring_t::xstop ()
+{
+    stopping = true;
+}
+
+bool xs::uring_t::async_io ()
+{
+    return true;
+}
+
+void xs::uring_t::async_recv (handle_t handle_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    xs_assert (!pe->receiving);
+    if (!pe->recv_buf) {
+        pe->recv_buf = (unsigned char*) malloc (in_batch_size);
+        alloc_assert (pe->recv_buf);
+    }
+
+    io_uring_sqe *sqe = get_sqe ();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pe->fd;
+    sqe->addr = (uint64_t) (size_t) pe->recv_buf;
+    sqe->len = in_batch_size;
+    sqe->user_data = ((uint64_t) (size_t) pe) | XS_URING_RECV;
+    pe->receiving = true;
+    pe->pending++;
+}
+
+unsigned char *xs::uring_t::get_send_buffer (handle_t handle_, size_t *size_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    xs_assert (!pe->sending);
+    if (!pe->send_buf) {
+        pe->send_buf = (unsigned char*) malloc (out_batch_size);
+        alloc_assert (pe->send_buf);
+    }
+    *size_ = out_batch_size;
+    return pe->send_buf;
+}
+
+void xs::uring_t::async_send (handle_t handle_, unsigned char *data_,
+    size_t size_)
+{
+    poll_entry_t *pe = (poll_entry_t*) handle_;
+    xs_assert (!pe->sending);
+    xs_assert (pe->send_buf && data_ >= pe->send_buf &&
+        data_ + size_ <= pe->send_buf + out_batch_size);
+
+    io_uring_sqe *sqe = get_sqe ();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = pe->fd;
+    sqe->addr = (uint64_t) (size_t) data_;
+    sqe->len = (uint32_t) size_;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = ((uint64_t) (size_t) pe) | XS_URING_SEND;
+    pe->sending = true;
+    pe->pending++;
+}
+
+void xs::uring_t::change (poll_entry_t *pe_)
+{
+    if (!pe_->changed) {
+        pe_->changed = true;
+        changed.push_back (pe_);
+    }
+}
+
+void xs::uring_t::sync (poll_entry_t *pe_)
+{
+    //  Resetting the events doesn't cancel the request in flight. Instead,
+    //  the events that are no longer of interest are ignored once it
+    //  completes. Only retired entries have to be cancelled so that the
+    //  kernel drops its reference to the underlying file.
+    if (pe_->armed) {
+        if (pe_->cancelling)
+            return;
+        if (pe_->fd != retired_fd && (pe_->armed & pe_->mask) == pe_->mask)
+            return;
+
+        //  Cancel the request. If the entry is still in use, a new one will
+        //  be issued once the cancelled request completes.
+        cancel (pe_, ((uint64_t) (size_t) pe_) | XS_URING_POLL);
+        pe_->cancelling = true;
+        return;
+    }
+
+    if (pe_->fd == retired_fd || !pe_->mask)
+        return;
+
+    //  Issue a new poll request.
+    io_uring_sqe *sqe = get_sqe ();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = pe_->fd;
+    uint32_t events = (uint32_t) pe_->mask;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->poll32_events = events;
+    sqe->user_data = (uint64_t) (size_t) pe_;
+    pe_->armed = pe_->mask;
+    pe_->pending++;
+}
+
+void xs::uring_t::cancel (poll_entry_t *pe_, uint64_t user_data_)
+{
+    io_uring_sqe *sqe = get_sqe ();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data_;
+    sqe->user_data = ((uint64_t) (size_t) pe_) | XS_URING_CANCEL;
+    pe_->pending++;
+}
+
+void xs::uring_t::free_entry (poll_entry_t *pe_)
+{
+    free (pe_->recv_buf);
+    free (pe_->send_buf);
+    delete pe_;
+}
+
+io_uring_sqe *xs::uring_t::get_sqe ()
+{
+    //  If the submission ring is full, pass the requests to the kernel to
+    //  make space. The kernel consumes all of them during the call.
+    unsigned tail = *sq_tail;
+    if (tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE) == sq_entries)
+        enter (false, 0);
+    xs_assert (tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE) <
+        sq_entries);
+    unsigned index = tail & sq_mask;
+    sq_array [index] = index;
+    io_uring_sqe *sqe = &sqes [index];
+    memset (sqe, 0, sizeof (io_uring_sqe));
+    __atomic_store_n (sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+int xs::uring_t::enter (bool wait_, int timeout_)
+{
+    unsigned to_submit = *sq_tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE);
+    if (!to_submit && !wait_)
+        return 0;
+
+    struct __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    memset (&arg, 0, sizeof (arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if (timeout_) {
+        ts.tv_sec = timeout_ / 1000;
+        ts.tv_nsec = (long long) (timeout_ % 1000) * 1000000;
+        arg.ts = (uint64_t) (size_t) &ts;
+    }
+
+    int rc = uring_enter (ring_fd, to_submit, wait_ ? 1 : 0,
+        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof (arg));
+    if (rc == -1) {
+        errno_assert (errno == EINTR || errno == ETIME || errno == EBUSY ||
+            errno == EAGAIN);
+        return -1;
+    }
+    return 0;
+}
+
+void xs::uring_t::process_completions ()
+{
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n (cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+
+        io_uring_cqe *cqe = &cqes [head & cq_mask];
+        uint64_t data = cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n (cq_head, head, __ATOMIC_RELEASE);
+
+        poll_entry_t *pe = (poll_entry_t*) (size_t)
+            (data & ~(uint64_t) XS_URING_KIND);
+        pe->pending--;
+        switch (data & XS_URING_KIND) {
+        case XS_URING_CANCEL:
+            continue;
+        case XS_URING_RECV:
+            pe->receiving = false;
+            if (pe->fd != retired_fd)
+                pe->events->async_in_event (pe->recv_buf, res);
+            continue;
+        case XS_URING_SEND:
+            pe->sending = false;
+            if (pe->fd != retired_fd)
+                pe->events->async_out_event (res);
+            continue;
+        }
+
+        //  The poll request completed, either because of an event or
+        //  because it was cancelled.
+        pe->armed = 0;
+        pe->cancelling = false;
+        if (pe->fd == retired_fd)
+            continue;
+        change (pe);
+        if (res == -ECANCELED)
+            continue;
+        short revents = res < 0 ? POLLERR : (short) res;
+
+        if (revents & (POLLERR | POLLHUP))
+            pe->events->in_event (pe->fd);
+        if (pe->fd == retired_fd)
+            continue;
+        if (revents & pe->mask & POLLOUT)
+            pe->events->out_event (pe->fd);
+        if (pe->fd == retired_fd)
+            continue;
+        if (revents & pe->mask & POLLIN)
+            pe->events->in_event (pe->fd);
+    }
+}
+
+void xs::uring_t::loop ()
+{
+    while (!stopping) {
+
+        //  Execute any due timers.
+        int timeout = (int) execute_timers ();
+
+        //  Queue the poll requests for the entries that have changed.
+        for (changed_t::size_type i = 0; i != changed.size (); i++) {
+            changed [i]->changed = false;
+            sync (changed [i]);
+        }
+        changed.clear ();
+
+        //  Submit the requests, including the reads and writes queued while
+        //  processing the previous events, and wait for events.
+        before_wait ();
+        enter (true, timeout);
+        after_wait ((int) (__atomic_load_n (cq_tail, __ATOMIC_ACQUIRE) -
+            *cq_head));
+
+        //  Process the events.
+        process_completions ();
+
+        //  Destroy retired event sources that have no requests in flight
+        //  and are not waiting to be synchronised.
+        retired_t::size_type pos = 0;
+        for (retired_t::size_type i = 0; i != retired.size (); i++) {
+            if (retired [i]->pending || retired [i]->changed)
+                retired [pos++] = retired [i];
+            else
+                free_entry (retired [i]);
+        }
+        retired.resize (pos);
+    }
+}
+
+void xs::uring_t::worker_routine (void *arg_)
+{
+    ((uring_t*) arg_)->loop ();
+}
+
+#endif
@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2009-2012 250bpm s.r.o.
+    Copyright (c) 2007-2009 iMatix Corporation
+    Copyright (c) 2007-2011 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __XS_URING_HPP_INCLUDED__
+#define __XS_URING_HPP_INCLUDED__
+
+#include "platform.hpp"
+
+#if defined XS_HAVE_IO_URING
+
+#include <vector>
+#include <linux/io_uring.h>
+
+#include "fd.hpp"
+#include "thread.hpp"
+#include "io_thread.hpp"
+
+namespace xs
+{
+
+    class ctx_t;
+    struct i_poll_events;
+
+    //  This class implements socket polling mechanism using the Linux-specific
+    //  io_uring interface. Poll requests are queued in the submission ring
+    //  and submitted together with waiting for completions, so that a single
+    //  system call per loop iteration handles both the changes in the pollset
+    //  and the readiness notifications. The objects that support it can have
+    //  their reads and writes done by the ring as well. These are submitted
+    //  in the same system call and the kernel performs them as soon as the
+    //  socket is ready, so no separate readiness notification is needed.
+
+    class uring_t : public io_thread_t
+    {
+    public:
+
+        //  Returns true if io_uring is supported by the kernel.
+        static bool available ();
+
+        uring_t (xs::ctx_t *ctx_, uint32_t tid_);
+        ~uring_t ();
+
+        //  Implementation of virtual functions from io_thread_t.
+        handle_t add_fd (fd_t fd_, xs::i_poll_events *events_);
+        void rm_fd (handle_t handle_);
+        void set_pollin (handle_t handle_);
+        void reset_pollin (handle_t handle_);
+        void set_pollout (handle_t handle_);
+        void reset_pollout (handle_t handle_);
+        void xstart ();
+        void xstop ();
+        bool async_io ();
+        void async_recv (handle_t handle_);
+        unsigned char *get_send_buffer (handle_t handle_, size_t *size_);
+        void async_send (handle_t handle_, unsigned char *data_,
+            size_t size_);
+
+    private:
+
+        struct poll_entry_t
+        {
+            fd_t fd;
+
+            //  Events the user is interested in.
+            short mask;
+
+            //  Events of the poll request in flight, zero if there is none.
+            //  Poll requests are one-shot, they are re-armed after each
+            //  completion.
+            short armed;
+
+            //  True if the poll request in flight is being cancelled.
+            bool cancelling;
+
+            //  True if the entry is in the list of changed entries.
+            bool changed;
+
+            //  True if asynchronous receive, respectively send, is in flight.
+            bool receiving;
+            bool sending;
+
+            //  Buffers for asynchronous I/O. They are allocated on first use
+            //  and deallocated together with the entry, so that the kernel
+            //  never accesses freed memory.
+            unsigned char *recv_buf;
+            unsigned char *send_buf;
+
+            //  Number of requests in flight referring to the entry. Retired
+            //  entries can't be deallocated before this drops to zero.
+            int pending;
+
+            xs::i_poll_events *events;
+        };
+
+        //  Main worker thread routine.
+        static void worker_routine (void *arg_);
+
+        //  Main event loop.
+        void loop ();
+
+        //  Marks the entry to be synchronised with the kernel.
+        void change (poll_entry_t *pe_);
+
+        //  Queues the requests needed to get the poll request in flight
+        //  in sync with the events the user is interested in.
+        void sync (poll_entry_t *pe_);
+
+        //  Queues cancellation of the request identified by user data.
+        void cancel (poll_entry_t *pe_, uint64_t user_data_);
+
+        //  Deallocates the entry along with its buffers.
+        void free_entry (poll_entry_t *pe_);
+
+        //  Returns an empty submission queue entry. If the submission ring
+        //  is full, the requests queued so far are submitted first.
+        io_uring_sqe *get_sqe ();
+
+        //  Submits the queued requests and waits for at least one completion
+        //  if 'wait' is true. Timeout is in milliseconds, zero meaning
+        //  infinite. Returns -1 if interrupted or timed out.
+        int enter (bool wait_, int timeout_);
+
+        //  Processes all the completions available at the moment.
+        void process_completions ();
+
+        //  The ring file descriptor.
+        fd_t ring_fd;
+
+        //  Mapped memory of the rings and the submission queue entries.
+        void *ring_ptr;
+        size_t ring_size;
+        io_uring_sqe *sqes;
+        size_t sqes_size;
+
+        //  Submission ring.
+        unsigned *sq_head;
+        unsigned *sq_tail;
+        unsigned sq_mask;
+        unsigned sq_entries;
+        unsigned *sq_array;
+
+        //  Completion ring.
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned cq_mask;
+        io_uring_cqe *cqes;
+
+        //  Entries that need their poll requests updated.
+        typedef std::vector <poll_entry_t*> changed_t;
+        changed_t changed;
+
+        //  List of retired event sources.
+        typedef std::vector <poll_entry_t*> retired_t;
+        retired_t retired;
+
+        //  If true, thread is in the process of shutting down.
+        bool stopping;
+
+        //  Handle of the physical thread doing the I/O work.
+        thread_t worker;
+
+        uring_t (const uring_t&);
+        const uring_t &operator = (const uring_t&);
+    };
+
+}
+
+#endif
+
+#endif
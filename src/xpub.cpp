@@ -142,6 +142,16 @@ bool xs::xpub_t::xhas_out ()
     return dist.has_out ();
 }
 
+void xs::xpub_t::xflush ()
+{
+    dist.flush ();
+}
+
+uint64_t xs::xpub_t::xdropped ()
+{
+    return dist.get_dropped ();
+}
+
 int xs::xpub_t::xrecv (msg_t *msg_, int flags_)
 {
     //  If there is at least one 
@@ -51,6 +51,8 @@ namespace xs
         void xattach_pipe (xs::pipe_t *pipe_, bool icanhasall_);
         int xsend (xs::msg_t *msg_, int flags_);
         bool xhas_out ();
+        void xflush ();
+        uint64_t xdropped ();
         int xrecv (xs::msg_t *msg_, int flags_);
         bool xhas_in ();
         void xread_activated (xs::pipe_t *pipe_);
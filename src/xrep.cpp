@@ -22,8 +22,6 @@
 
 #include "xrep.hpp"
 #include "pipe.hpp"
-#include "wire.hpp"
-#include "random.hpp"
 #include "likely.hpp"
 #include "err.hpp"
 
@@ -33,7 +31,7 @@ xs::xrep_t::xrep_t (class ctx_t *parent_, uint32_t tid_, int sid_) :
     more_in (false),
     current_out (NULL),
     more_out (false),
-    next_peer_id (generate_random ())
+    dropped (0)
 {
     options.type = XS_XREP;
 
@@ -59,18 +57,9 @@ void xs::xrep_t::xattach_pipe (pipe_t *pipe_, bool icanhasall_)
 {
     xs_assert (pipe_);
 
-    //  Generate a new unique peer identity.
-    unsigned char buf [5];
-    buf [0] = 0;
-    put_uint32 (buf + 1, next_peer_id);
-    blob_t identity (buf, 5);
-    ++next_peer_id;
-
-    //  Add the pipe to the map out outbound pipes.
-    outpipe_t outpipe = {pipe_, true};
-    bool ok = outpipes.insert (outpipes_t::value_type (
-        identity, outpipe)).second;
-    xs_assert (ok);
+    //  Add the pipe to the map of outbound pipes. This generates a new
+    //  unique peer identity.
+    blob_t identity = outpipes.add (pipe_);
 
     //  Add the pipe to the list of inbound pipes.
     pipe_->set_identity (identity);
@@ -81,16 +70,9 @@ void xs::xrep_t::xterminated (pipe_t *pipe_)
 {
     fq.terminated (pipe_);
 
-    for (outpipes_t::iterator it = outpipes.begin ();
-          it != outpipes.end (); ++it) {
-        if (it->second.pipe == pipe_) {
-            outpipes.erase (it);
-            if (pipe_ == current_out)
-                current_out = NULL;
-            return;
-        }
-    }
-    xs_assert (false);
+    outpipes.erase (pipe_->get_identity ());
+    if (pipe_ == current_out)
+        current_out = NULL;
 }
 
 void xs::xrep_t::xread_activated (pipe_t *pipe_)
@@ -100,15 +82,12 @@ void xs::xrep_t::xread_activated (pipe_t *pipe_)
 
 void xs::xrep_t::xwrite_activated (pipe_t *pipe_)
 {
-    for (outpipes_t::iterator it = outpipes.begin ();
-          it != outpipes.end (); ++it) {
-        if (it->second.pipe == pipe_) {
-            xs_assert (!it->second.active);
-            it->second.active = true;
-            return;
-        }
-    }
-    xs_assert (false);
+    blob_t identity = pipe_->get_identity ();
+    routing_table_t::outpipe_t *outpipe =
+        outpipes.find (identity.data (), identity.size ());
+    xs_assert (outpipe && outpipe->pipe == pipe_);
+    xs_assert (!outpipe->active);
+    outpipe->active = true;
 }
 
 int xs::xrep_t::xsend (msg_t *msg_, int flags_)
@@ -127,16 +106,17 @@ int xs::xrep_t::xsend (msg_t *msg_, int flags_)
 
             //  Find the pipe associated with the identity stored in the prefix.
             //  If there's no such pipe just silently ignore the message.
-            blob_t identity ((unsigned char*) msg_->data (), msg_->size ());
-            outpipes_t::iterator it = outpipes.find (identity);
+            routing_table_t::outpipe_t *outpipe = outpipes.find (
+                (unsigned char*) msg_->data (), msg_->size ());
 
-            if (it != outpipes.end ()) {
-                current_out = it->second.pipe;
+            if (outpipe) {
+                current_out = outpipe->pipe;
                 msg_t empty;
                 int rc = empty.init ();
                 errno_assert (rc == 0);
                 if (!current_out->check_write (&empty)) {
-                    it->second.active = false;
+                    dropped++;
+                    outpipe->active = false;
                     more_out = false;
                     current_out = NULL;
                 }
@@ -159,16 +139,24 @@ int xs::xrep_t::xsend (msg_t *msg_, int flags_)
     //  Push the message into the pipe. If there's no out pipe, just drop it.
     if (current_out) {
         bool ok = current_out->write (msg_);
-        if (unlikely (!ok))
+        if (unlikely (!ok)) {
             current_out = NULL;
+            if (!more_out)
+                dropped++;
+        }
         else if (!more_out) {
-            current_out->flush ();
+            if (!(flags_ & send_noflush))
+                current_out->flush ();
+            else if (unflushed.empty () || unflushed.back () != current_out)
+                unflushed.push_back (current_out);
             current_out = NULL;
         }
     }
     else {
         int rc = msg_->close ();
         errno_assert (rc == 0);
+        if (!more_out)
+            dropped++;
     }
 
     //  Detach the message from the data buffer.
@@ -217,29 +205,18 @@ int xs::xrep_t::xrecv (msg_t *msg_, int flags_)
         //  Empty identity means we can preserve the auto-generated identity.
         if (msg_->size () != 0) {
 
-            //  Actual change of the identity.
-            bool changed = false;
-            outpipes_t::iterator it = outpipes.begin ();
-            while (it != outpipes.end ()) {
-                if (it->second.pipe == pipe) {
-                    blob_t identity ((unsigned char*) msg_->data (),
-                        msg_->size ());
-                    pipe->set_identity (identity);
-                    outpipes.erase (it);
-                    outpipe_t outpipe = {pipe, true};
-                    if (!outpipes.insert (outpipes_t::value_type (identity,
-                        outpipe)).second) {
-
-                        //  Duplicate identity.
-                        //  TODO: Drop the new connection.
-                        xs_assert (false);
-                    }
-                    changed = true;
-                    break;
-                }
-                ++it;
+            //  If the identity is reserved or already in use, drop the new
+            //  connection. It keeps the auto-generated identity till it is
+            //  terminated, so that it can be removed from the table.
+            blob_t identity ((unsigned char*) msg_->data (), msg_->size ());
+            if (!outpipes.add (identity, pipe)) {
+                pipe->terminate (false);
+                continue;
             }
-            xs_assert (changed);
+
+            //  Actual change of the identity.
+            outpipes.erase (pipe->get_identity ());
+            pipe->set_identity (identity);
         }
     }
 
@@ -314,6 +291,20 @@ bool xs::xrep_t::xhas_out ()
     return true;
 }
 
+void xs::xrep_t::xflush ()
+{
+    //  Batched send is finished before any commands are processed, so none
+    //  of the pipes could have been terminated in the meantime.
+    for (unflushed_t::size_type i = 0; i != unflushed.size (); ++i)
+        unflushed [i]->flush ();
+    unflushed.clear ();
+}
+
+uint64_t xs::xrep_t::xdropped ()
+{
+    return dropped;
+}
+
 xs::xrep_session_t::xrep_session_t (io_thread_t *io_thread_, bool connect_,
       socket_base_t *socket_, const options_t &options_,
       const char *protocol_, const char *address_) :
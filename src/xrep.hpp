@@ -23,7 +23,7 @@
 #ifndef __XS_XREP_HPP_INCLUDED__
 #define __XS_XREP_HPP_INCLUDED__
 
-#include <map>
+#include <vector>
 
 #include "socket_base.hpp"
 #include "session_base.hpp"
@@ -31,6 +31,7 @@
 #include "blob.hpp"
 #include "msg.hpp"
 #include "fq.hpp"
+#include "routing_table.hpp"
 
 namespace xs
 {
@@ -39,7 +40,6 @@ namespace xs
     class pipe_t;
     class io_thread_t;
 
-    //  TODO: This class uses O(n) scheduling. Rewrite it to use O(1) algorithm.
     class xrep_t :
         public socket_base_t
     {
@@ -54,6 +54,8 @@ namespace xs
         int xrecv (msg_t *msg_, int flags_);
         bool xhas_in ();
         bool xhas_out ();
+        void xflush ();
+        uint64_t xdropped ();
         void xread_activated (xs::pipe_t *pipe_);
         void xwrite_activated (xs::pipe_t *pipe_);
         void xterminated (xs::pipe_t *pipe_);
@@ -81,15 +83,8 @@ namespace xs
         //  If true, more incoming message parts are expected.
         bool more_in;
 
-        struct outpipe_t
-        {
-            xs::pipe_t *pipe;
-            bool active;
-        };
-
         //  Outbound pipes indexed by the peer IDs.
-        typedef std::map <blob_t, outpipe_t> outpipes_t;
-        outpipes_t outpipes;
+        routing_table_t outpipes;
 
         //  The pipe we are currently writing to.
         xs::pipe_t *current_out;
@@ -97,9 +92,14 @@ namespace xs
         //  If true, more outgoing message parts are expected.
         bool more_out;
 
-        //  Peer ID are generated. It's a simple increment and wrap-over
-        //  algorithm. This value is the next ID to use (if not used already).
-        uint32_t next_peer_id;
+        //  Number of messages dropped because the peer had reached the high
+        //  watermark or wasn't connected.
+        uint64_t dropped;
+
+        //  Pipes written to with send_noflush flag that have to be flushed
+        //  by the subsequent xflush call.
+        typedef std::vector <xs::pipe_t*> unflushed_t;
+        unflushed_t unflushed;
 
         xrep_t (const xrep_t&);
         const xrep_t &operator = (const xrep_t&);
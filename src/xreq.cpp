@@ -99,6 +99,16 @@ bool xs::xreq_t::xhas_out ()
     return lb.has_out ();
 }
 
+void xs::xreq_t::xflush ()
+{
+    lb.flush ();
+}
+
+uint64_t xs::xreq_t::xdropped ()
+{
+    return lb.get_dropped ();
+}
+
 void xs::xreq_t::xread_activated (pipe_t *pipe_)
 {
     fq.activated (pipe_);
@@ -51,6 +51,8 @@ namespace xs
         int xrecv (xs::msg_t *msg_, int flags_);
         bool xhas_in ();
         bool xhas_out ();
+        void xflush ();
+        uint64_t xdropped ();
         void xread_activated (xs::pipe_t *pipe_);
         void xwrite_activated (xs::pipe_t *pipe_);
         void xterminated (xs::pipe_t *pipe_);
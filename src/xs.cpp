@@ -64,7 +64,7 @@ const char *xs_strerror (int errnum_)
     return xs::errno_to_string (errnum_);
 }
 
-void *xs_init ()
+void *(xs_init) ()
 {
 #if defined XS_HAVE_OPENPGM
 
@@ -111,6 +111,17 @@ void *xs_init ()
     return (void*) ctx;
 }
 
+void *xs_init_msg_size (size_t msg_size_)
+{
+    //  The caller's xs_msg_t has to have the layout the library was built
+    //  with, otherwise every message passed in would be overrun.
+    if (msg_size_ != sizeof (xs_msg_t)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return (xs_init) ();
+}
+
 int xs_term (void *ctx_)
 {
     if (!ctx_ || !((xs::ctx_t*) ctx_)->check_tag ()) {
@@ -148,6 +159,16 @@ int xs_setctxopt (void *ctx_, int option_, const void *optval_,
     return ((xs::ctx_t*) ctx_)->setctxopt (option_, optval_, optvallen_);
 }
 
+int xs_getctxopt (void *ctx_, int option_, void *optval_, size_t *optvallen_)
+{
+    if (!ctx_ || !((xs::ctx_t*) ctx_)->check_tag ()) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    return ((xs::ctx_t*) ctx_)->getctxopt (option_, optval_, optvallen_);
+}
+
 void *xs_socket (void *ctx_, int type_)
 {
     if (!ctx_ || !((xs::ctx_t*) ctx_)->check_tag ()) {
@@ -214,8 +235,16 @@ int xs_connect (void *s_, const char *addr_)
 
 int xs_send (void *s_, const void *buf_, size_t len_, int flags_)
 {
+    xs::socket_base_t *s = (xs::socket_base_t*) s_;
+    if (!s || !s->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    //  Use the context's message pool, if any.
     xs_msg_t msg;
-    int rc = xs_msg_init_size (&msg, len_);
+    int rc = ((xs::msg_t*) &msg)->init_size (len_,
+        s->get_ctx ()->get_msg_pool (), s->get_tid ());
     if (rc != 0)
         return -1;
     memcpy (xs_msg_data (&msg), buf_, len_);
@@ -287,6 +316,26 @@ int xs_recvmsg (void *s_, xs_msg_t *msg_, int flags_)
     return (int) xs_msg_size (msg_);
 }
 
+int xs_sendmmsg (void *s_, xs_msg_t *msgs_, int count_, int flags_)
+{
+    xs::socket_base_t *s = (xs::socket_base_t*) s_;
+    if (!s || !s->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return s->sendv ((xs::msg_t*) msgs_, count_, flags_);
+}
+
+int xs_recvmmsg (void *s_, xs_msg_t *msgs_, int count_, int flags_)
+{
+    xs::socket_base_t *s = (xs::socket_base_t*) s_;
+    if (!s || !s->check_tag ()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return s->recvv ((xs::msg_t*) msgs_, count_, flags_);
+}
+
 int xs_msg_init (xs_msg_t *msg_)
 {
     return ((xs::msg_t*) msg_)->init ();
@@ -117,6 +117,11 @@ bool xs::xsub_t::xhas_out ()
     return true;
 }
 
+void xs::xsub_t::xflush ()
+{
+    dist.flush ();
+}
+
 int xs::xsub_t::xrecv (msg_t *msg_, int flags_)
 {
     //  If there's already a message prepared by a previous call to xs_poll,
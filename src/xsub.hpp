@@ -25,7 +25,7 @@
 #include "session_base.hpp"
 #include "dist.hpp"
 #include "fq.hpp"
-#include "trie.hpp"
+#include "prefix_filter.hpp"
 
 namespace xs
 {
@@ -48,6 +48,7 @@ namespace xs
         void xattach_pipe (xs::pipe_t *pipe_, bool icanhasall_);
         int xsend (xs::msg_t *msg_, int flags_);
         bool xhas_out ();
+        void xflush ();
         int xrecv (xs::msg_t *msg_, int flags_);
         bool xhas_in ();
         void xread_activated (xs::pipe_t *pipe_);
@@ -72,7 +73,7 @@ namespace xs
         dist_t dist;
 
         //  The repository of subscriptions.
-        trie_t subscriptions;
+        prefix_filter_t subscriptions;
 
         //  If true, 'message' contains a matching message to return on the
         //  next recv call.
@@ -25,7 +25,13 @@
 #include <stdlib.h>
 #include <stddef.h>
 
+#include "platform.hpp"
+#if defined XS_HAVE_WINDOWS
+#include <malloc.h>
+#endif
+
 #include "err.hpp"
+#include "config.hpp"
 #include "atomic_ptr.hpp"
 
 namespace xs
@@ -43,6 +49,10 @@ namespace xs
     //  T is the type of the object in the queue.
     //  N is granularity of the queue (how many pushes have to be done till
     //  actual memory allocation is required).
+    //
+    //  Chunks are aligned to the cache line boundary. Thus, if the size of T
+    //  is a divisor or a multiple of the cache line size, no element of the
+    //  queue straddles two cache lines.
 
     template <typename T, int N> class yqueue_t
     {
@@ -51,8 +61,7 @@ namespace xs
         //  Create the queue.
         inline yqueue_t ()
         {
-             begin_chunk = (chunk_t*) malloc (sizeof (chunk_t));
-             alloc_assert (begin_chunk);
+             begin_chunk = allocate_chunk ();
              begin_pos = 0;
              back_chunk = NULL;
              back_pos = 0;
@@ -65,17 +74,17 @@ namespace xs
         {
             while (true) {
                 if (begin_chunk == end_chunk) {
-                    free (begin_chunk);
+                    deallocate_chunk (begin_chunk);
                     break;
                 } 
                 chunk_t *o = begin_chunk;
                 begin_chunk = begin_chunk->next;
-                free (o);
+                deallocate_chunk (o);
             }
 
             chunk_t *sc = spare_chunk.xchg (NULL);
             if (sc)
-                free (sc);
+                deallocate_chunk (sc);
         }
 
         //  Returns reference to the front element of the queue.
@@ -106,8 +115,7 @@ namespace xs
                 end_chunk->next = sc;
                 sc->prev = end_chunk;
             } else {
-                end_chunk->next = (chunk_t*) malloc (sizeof (chunk_t));
-                alloc_assert (end_chunk->next);
+                end_chunk->next = allocate_chunk ();
                 end_chunk->next->prev = end_chunk;
             }
             end_chunk = end_chunk->next;
@@ -140,7 +148,7 @@ namespace xs
             else {
                 end_pos = N - 1;
                 end_chunk = end_chunk->prev;
-                free (end_chunk->next);
+                deallocate_chunk (end_chunk->next);
                 end_chunk->next = NULL;
             }
         }
@@ -159,7 +167,7 @@ namespace xs
                 //  use 'o' as the spare.
                 chunk_t *cs = spare_chunk.xchg (o);
                 if (cs)
-                    free (cs);
+                    deallocate_chunk (cs);
             }
         }
 
@@ -173,6 +181,31 @@ namespace xs
              chunk_t *next;
         };
 
+        //  Allocates a chunk aligned to the cache line boundary.
+        static inline chunk_t *allocate_chunk ()
+        {
+#if defined XS_HAVE_WINDOWS
+            void *chunk = _aligned_malloc (sizeof (chunk_t), cache_line_size);
+#elif defined XS_HAVE_POSIX_MEMALIGN
+            void *chunk;
+            if (posix_memalign (&chunk, cache_line_size, sizeof (chunk_t)))
+                chunk = NULL;
+#else
+            void *chunk = malloc (sizeof (chunk_t));
+#endif
+            alloc_assert (chunk);
+            return (chunk_t*) chunk;
+        }
+
+        static inline void deallocate_chunk (chunk_t *chunk_)
+        {
+#if defined XS_HAVE_WINDOWS
+            _aligned_free (chunk_);
+#else
+            free (chunk_);
+#endif
+        }
+
         //  Back position may point to invalid memory if the queue is empty,
         //  while begin & end positions are always valid. Begin position is
         //  accessed exclusively be queue reader (front/pop), while back and
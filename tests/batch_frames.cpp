@@ -0,0 +1,173 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+//  Returns the number of bytes sent and received by the context's only
+//  I/O thread.
+static uint64_t io_bytes (void *ctx_)
+{
+    uint64_t stats [4];
+    size_t stats_size = sizeof (stats);
+    int rc = xs_getctxopt (ctx_, XS_IO_THREAD_STATS, stats, &stats_size);
+    assert (rc == 0);
+    assert (stats_size == sizeof (stats));
+    return stats [0];
+}
+
+static void batch_frames (const char *addr_, int sb_batch_, int sc_batch_)
+{
+    const int count = 10000;
+
+    //  Each socket has its own context so that the I/O thread statistics
+    //  of the receiving side can be inspected.
+    void *ctxb = xs_init ();
+    assert (ctxb);
+    void *ctxc = xs_init ();
+    assert (ctxc);
+
+    void *sb = xs_socket (ctxb, XS_PAIR);
+    assert (sb);
+    int rc = xs_setsockopt (sb, XS_BATCH_FRAMES, &sb_batch_,
+        sizeof (sb_batch_));
+    assert (rc == 0);
+    rc = xs_bind (sb, addr_);
+    assert (rc != -1);
+    void *sc = xs_socket (ctxc, XS_PAIR);
+    assert (sc);
+    rc = xs_setsockopt (sc, XS_BATCH_FRAMES, &sc_batch_, sizeof (sc_batch_));
+    assert (rc == 0);
+
+    //  All the messages are sent before they are received.
+    int hwm = 0;
+    rc = xs_setsockopt (sc, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (sc, addr_);
+    assert (rc != -1);
+
+    //  Once the reply arrives, the connecting side knows whether the
+    //  binding side is able to decode batch frames.
+    char buf [1000];
+    rc = xs_send (sc, "SYNC", 4, 0);
+    assert (rc == 4);
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == 4);
+    rc = xs_send (sb, "SYNC", 4, 0);
+    assert (rc == 4);
+    rc = xs_recv (sc, buf, sizeof (buf), 0);
+    assert (rc == 4);
+    rc = xs_poll (NULL, 0, 100);
+    assert (rc == 0);
+    uint64_t bytes_before = io_bytes (ctxb);
+
+    //  Tick-like stream of 8-byte messages.
+    for (int i = 0; i != count; i++) {
+        memset (buf, i & 0xff, 8);
+        rc = xs_send (sc, buf, 8, 0);
+        assert (rc == 8);
+    }
+    for (int i = 0; i != count; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 8);
+        for (int j = 0; j != 8; j++)
+            assert (buf [j] == (char) (i & 0xff));
+    }
+
+    //  Wait for the I/O thread to update its statistics. With ordinary
+    //  frames each message takes 10 bytes on the wire.
+    uint64_t bytes = 0;
+    for (int i = 0; i != 100; i++) {
+        bytes = io_bytes (ctxb) - bytes_before;
+        if (bytes >= count * 8)
+            break;
+        rc = xs_poll (NULL, 0, 10);
+        assert (rc == 0);
+    }
+    if (sb_batch_ && sc_batch_)
+        assert (bytes < count * 10);
+    else
+        assert (bytes == count * 10);
+
+    //  Mix of small messages, multi-part messages, empty messages and
+    //  messages too large to be batched.
+    for (int i = 0; i != count; i++) {
+        size_t size = i % 100 == 0 ? 1000 : i % 40;
+        memset (buf, i & 0xff, size);
+        rc = xs_send (sc, buf, size, i % 7 == 0 ? XS_SNDMORE : 0);
+        assert (rc == (int) size);
+    }
+    for (int i = 0; i != count; i++) {
+        size_t size = i % 100 == 0 ? 1000 : i % 40;
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == (int) size);
+        for (size_t j = 0; j != size; j++)
+            assert (buf [j] == (char) (i & 0xff));
+        int more;
+        size_t more_size = sizeof (more);
+        rc = xs_getsockopt (sb, XS_RCVMORE, &more, &more_size);
+        assert (rc == 0);
+        assert (more == (i % 7 == 0 ? 1 : 0));
+    }
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctxc);
+    assert (rc == 0);
+    rc = xs_term (ctxb);
+    assert (rc == 0);
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "batch_frames test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *s = xs_socket (ctx, XS_PAIR);
+    assert (s);
+    int batch = 2;
+    int rc = xs_setsockopt (s, XS_BATCH_FRAMES, &batch, sizeof (batch));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    batch = 1;
+    rc = xs_setsockopt (s, XS_BATCH_FRAMES, &batch, sizeof (batch));
+    assert (rc == 0);
+    batch = 0;
+    size_t batch_size = sizeof (batch);
+    rc = xs_getsockopt (s, XS_BATCH_FRAMES, &batch, &batch_size);
+    assert (rc == 0);
+    assert (batch == 1);
+    rc = xs_close (s);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    //  Batch frames are used only if both peers enable them.
+    batch_frames ("tcp://127.0.0.1:5560", 1, 1);
+    batch_frames ("tcp://127.0.0.1:5560", 1, 0);
+    batch_frames ("tcp://127.0.0.1:5560", 0, 1);
+#if !defined XS_HAVE_WINDOWS && !defined XS_HAVE_OPENVMS
+    batch_frames ("ipc:///tmp/tester", 1, 1);
+#endif
+
+    return 0 ;
+}
@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+extern "C"
+{
+    static void busy_poll_worker (void *s_)
+    {
+        int rc;
+        int i;
+        char buf [3];
+
+        //  Echo the messages back. Every now and then reply with a delay
+        //  so that the peer stops polling and falls asleep.
+        for (i = 0; i != 1000; i++) {
+            rc = xs_recv (s_, buf, sizeof (buf), 0);
+            assert (rc == 3);
+            if (i % 100 == 0) {
+                rc = xs_poll (NULL, 0, 10);
+                assert (rc == 0);
+            }
+            rc = xs_send (s_, buf, sizeof (buf), 0);
+            assert (rc == 3);
+        }
+    }
+}
+
+static void busy_poll_pingpong (void *ctx_, const char *addr_)
+{
+    void *sb = xs_socket (ctx_, XS_PAIR);
+    assert (sb);
+    int busy_poll = 100;
+    int rc = xs_setsockopt (sb, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    assert (rc == 0);
+    rc = xs_bind (sb, addr_);
+    assert (rc != -1);
+    void *sc = xs_socket (ctx_, XS_PAIR);
+    assert (sc);
+    rc = xs_setsockopt (sc, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    assert (rc == 0);
+    rc = xs_connect (sc, addr_);
+    assert (rc != -1);
+
+    //  Ping-pong the messages between two threads. Both of them wait for
+    //  the messages in the blocking recv.
+    void *thread = thread_create (busy_poll_worker, sc);
+    assert (thread);
+    char buf [3];
+    for (int i = 0; i != 1000; i++) {
+        rc = xs_send (sb, "ABC", 3, 0);
+        assert (rc == 3);
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 3);
+        assert (memcmp (buf, "ABC", 3) == 0);
+    }
+    thread_join (thread);
+
+    //  Polling for the socket works after busy polling.
+    rc = xs_send (sc, "ABC", 3, 0);
+    assert (rc == 3);
+    xs_pollitem_t item = {sb, 0, XS_POLLIN, 0};
+    rc = xs_poll (&item, 1, 1000);
+    assert (rc == 1);
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == 3);
+
+    //  The timeouts still work when busy polling.
+    int timeo = 50;
+    rc = xs_setsockopt (sb, XS_RCVTIMEO, &timeo, sizeof (timeo));
+    assert (rc == 0);
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "busy_poll test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    void *s = xs_socket (ctx, XS_PULL);
+    assert (s);
+    int busy_poll = -1;
+    int rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    busy_poll = 20;
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    assert (rc == 0);
+    busy_poll = 0;
+    size_t busy_poll_size = sizeof (busy_poll);
+    rc = xs_getsockopt (s, XS_BUSY_POLL, &busy_poll, &busy_poll_size);
+    assert (rc == 0);
+    assert (busy_poll == 20);
+
+    //  Busy polling doesn't extend the timeouts even if it is set to take
+    //  longer than they do.
+    busy_poll = 500000;
+    rc = xs_setsockopt (s, XS_BUSY_POLL, &busy_poll, sizeof (busy_poll));
+    assert (rc == 0);
+    int timeo = 10;
+    rc = xs_setsockopt (s, XS_RCVTIMEO, &timeo, sizeof (timeo));
+    assert (rc == 0);
+    void *watch = xs_stopwatch_start ();
+    char buf [3];
+    rc = xs_recv (s, buf, sizeof (buf), 0);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+    unsigned long elapsed = xs_stopwatch_stop (watch);
+    assert (elapsed < 250000);
+    rc = xs_close (s);
+    assert (rc == 0);
+
+    busy_poll_pingpong (ctx, "inproc://a");
+    busy_poll_pingpong (ctx, "tcp://127.0.0.1:5560");
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,113 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+#include <limits.h>
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "cpu_affinity test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    //  Invalid CPU sets are rejected.
+    int cpus [2] = {0, -1};
+    int rc = xs_setctxopt (ctx, XS_IO_THREAD_CPUS, cpus, sizeof (cpus));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    rc = xs_setctxopt (ctx, XS_REAPER_CPUS, cpus, 3);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    cpus [1] = INT_MAX;
+    rc = xs_setctxopt (ctx, XS_IO_THREAD_CPUS, cpus, sizeof (cpus));
+    assert (rc == -1 && xs_errno () == EINVAL);
+
+    //  Pin all the threads to the first CPU, which is always there.
+    cpus [1] = 0;
+    rc = xs_setctxopt (ctx, XS_IO_THREAD_CPUS, cpus, sizeof (cpus));
+    assert (rc == 0);
+    rc = xs_setctxopt (ctx, XS_REAPER_CPUS, cpus, sizeof (int));
+    assert (rc == 0);
+    int out [4];
+    size_t out_size = sizeof (out);
+    rc = xs_getctxopt (ctx, XS_IO_THREAD_CPUS, out, &out_size);
+    assert (rc == 0);
+    assert (out_size == 2 * sizeof (int));
+    assert (out [0] == 0 && out [1] == 0);
+    out_size = 0;
+    rc = xs_getctxopt (ctx, XS_REAPER_CPUS, out, &out_size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    out_size = sizeof (out);
+    rc = xs_getctxopt (ctx, XS_REAPER_CPUS, out, &out_size);
+    assert (rc == 0);
+    assert (out_size == sizeof (int));
+
+    //  Use more than 64 I/O threads.
+    int io_threads = 70;
+    rc = xs_setctxopt (ctx, XS_IO_THREADS, &io_threads, sizeof (io_threads));
+    assert (rc == 0);
+
+    void *sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    void *sc = xs_socket (ctx, XS_PAIR);
+    assert (sc);
+
+    //  Affinity can address the I/O threads beyond the first 64.
+    uint64_t affinity [2] = {0, 2};
+    rc = xs_setsockopt (sb, XS_AFFINITY, affinity, sizeof (affinity));
+    assert (rc == 0);
+    uint64_t affinity_out [2] = {0, 0};
+    size_t affinity_size = sizeof (uint64_t);
+    rc = xs_getsockopt (sb, XS_AFFINITY, affinity_out, &affinity_size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    affinity_size = sizeof (affinity_out);
+    rc = xs_getsockopt (sb, XS_AFFINITY, affinity_out, &affinity_size);
+    assert (rc == 0);
+    assert (affinity_size == sizeof (affinity_out));
+    assert (affinity_out [0] == 0 && affinity_out [1] == 2);
+    rc = xs_setsockopt (sc, XS_AFFINITY, affinity, sizeof (affinity));
+    assert (rc == 0);
+
+    //  Single-word affinity works as it used to.
+    affinity [0] = 0;
+    rc = xs_setsockopt (sc, XS_AFFINITY, affinity, sizeof (uint64_t));
+    assert (rc == 0);
+    affinity_size = sizeof (affinity_out);
+    rc = xs_getsockopt (sc, XS_AFFINITY, affinity_out, &affinity_size);
+    assert (rc == 0);
+    assert (affinity_size == sizeof (uint64_t));
+    assert (affinity_out [0] == 0);
+
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    bounce (sb, sc);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,231 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//  The decoder is internal to the library and its symbols are not exported.
+//  Thus, the implementation is compiled directly into the test program.
+#include "../src/encoder.cpp"
+#include "../src/decoder.cpp"
+#include "../src/msg.cpp"
+#include "../src/msg_pool.cpp"
+#include "../src/memory_budget.cpp"
+#include "../src/clock.cpp"
+#include "../src/err.cpp"
+
+#include "testutil.hpp"
+
+#include <vector>
+
+//  Produces 100-byte messages, as many as needed.
+class source_t : public xs::i_msg_source
+{
+public:
+
+    int read (xs::msg_t *msg_)
+    {
+        int rc = msg_->init_size (100);
+        errno_assert (rc == 0);
+        memset (msg_->data (), 'x', 100);
+        return 0;
+    }
+};
+
+//  Counts and drops the decoded messages.
+class sink_t : public xs::i_msg_sink
+{
+public:
+
+    sink_t () :
+        message_count (0)
+    {
+    }
+
+    int write (xs::msg_t *msg_)
+    {
+        message_count++;
+        int rc = msg_->close ();
+        errno_assert (rc == 0);
+        rc = msg_->init ();
+        errno_assert (rc == 0);
+        return 0;
+    }
+
+    unsigned long message_count;
+};
+
+//  The stream of encoded messages the decoder is fed from, the way an
+//  engine would feed it from the socket.
+class wire_t
+{
+public:
+
+    wire_t (size_t size_) :
+        data (size_),
+        pos (0)
+    {
+        source_t source;
+        xs::encoder_t encoder (xs::out_batch_size);
+        encoder.set_msg_source (&source);
+        size_t filled = 0;
+        while (filled != data.size ()) {
+            unsigned char *buf = &data [filled];
+            size_t size = data.size () - filled;
+            encoder.get_data (&buf, &size);
+            assert (buf == &data [filled]);
+            filled += size;
+        }
+    }
+
+    //  Reads up to size_ bytes into the decoder, the way a recv call would,
+    //  and returns the size of the buffer the decoder offered.
+    size_t read (xs::decoder_t &decoder_, size_t size_)
+    {
+        unsigned char *buf;
+        size_t bufsize;
+        decoder_.get_buffer (&buf, &bufsize);
+        size_t size = std::min (std::min (size_, bufsize), data.size () - pos);
+        memcpy (buf, &data [pos], size);
+        size_t processed = decoder_.process_buffer (buf, size);
+        assert (processed == size);
+        pos += size;
+        return bufsize;
+    }
+
+    //  Returns number of bytes till the end of the current message.
+    size_t to_boundary ()
+    {
+        return (frame_size - pos % frame_size) % frame_size;
+    }
+
+    //  Returns the size of the buffer the decoder would offer next.
+    size_t next_bufsize (xs::decoder_t &decoder_)
+    {
+        unsigned char *buf;
+        size_t bufsize;
+        decoder_.get_buffer (&buf, &bufsize);
+        return bufsize;
+    }
+
+private:
+
+    //  Each message is a one-byte size, flags and the 100-byte body.
+    enum {frame_size = 102};
+
+    std::vector <unsigned char> data;
+    size_t pos;
+};
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "decoder_buffer test running...\n");
+
+    const size_t min = xs::in_batch_size;
+    const size_t max = xs::max_in_batch_size;
+
+    wire_t wire (4 * 1024 * 1024);
+    sink_t sink;
+    xs::decoder_t decoder (min, max, -1);
+    decoder.set_msg_sink (&sink);
+    size_t bufsize;
+
+    //  A burst of data fills the buffer completely on each read, so it
+    //  doubles from the original size up to the limit and stays there.
+    size_t expected = min;
+    for (int i = 0; i != 12; i++) {
+        bufsize = wire.read (decoder, max);
+        assert (bufsize == expected);
+        expected = std::min (expected * 2, max);
+    }
+    assert (expected == max);
+
+    //  Once the burst is over, reads use a small part of the buffer only.
+    //  The buffer is halved after every 16 such reads in a row.
+    for (int i = 0; i != 16; i++) {
+        bufsize = wire.read (decoder, 100);
+        assert (bufsize == max);
+    }
+    for (int i = 0; i != 16; i++) {
+        bufsize = wire.read (decoder, 100);
+        assert (bufsize == max / 2);
+    }
+    bufsize = wire.next_bufsize (decoder);
+    assert (bufsize == max / 4);
+
+    //  A single full read in between resets the count of the short reads.
+    for (int i = 0; i != 15; i++) {
+        bufsize = wire.read (decoder, 100);
+        assert (bufsize == max / 4);
+    }
+    bufsize = wire.read (decoder, max);
+    assert (bufsize == max / 4);
+    for (int i = 0; i != 16; i++) {
+        bufsize = wire.read (decoder, 100);
+        assert (bufsize == max / 2);
+    }
+    bufsize = wire.next_bufsize (decoder);
+    assert (bufsize == max / 4);
+
+    //  The connection goes idle in the middle of a message. The buffer is
+    //  kept as the partial message may refer to it.
+    if (!wire.to_boundary ()) {
+        bufsize = wire.read (decoder, 50);
+        assert (bufsize == max / 4);
+    }
+    decoder.release_buffer ();
+    bufsize = wire.next_bufsize (decoder);
+    assert (bufsize == max / 4);
+
+    //  Once the message is complete, the enlarged buffer is released and
+    //  the next read starts over with the original size.
+    bufsize = wire.read (decoder, wire.to_boundary ());
+    assert (bufsize == max / 4);
+    decoder.release_buffer ();
+    bufsize = wire.next_bufsize (decoder);
+    assert (bufsize == min);
+    bufsize = wire.read (decoder, max);
+    assert (bufsize == min);
+    bufsize = wire.read (decoder, max);
+    assert (bufsize == 2 * min);
+
+    //  With a memory budget the buffer grows only as far as the budget
+    //  allows, and releasing the buffer returns the memory.
+    xs::memory_budget_t budget (3 * min);
+    xs::decoder_t limited (min, max, -1);
+    limited.set_memory_budget (&budget);
+    limited.set_msg_sink (&sink);
+    wire_t wire2 (1024 * 1024);
+    bufsize = wire2.read (limited, max);
+    assert (bufsize == min);
+    bufsize = wire2.read (limited, max);
+    assert (bufsize == 2 * min);
+    bufsize = wire2.read (limited, max);
+    assert (bufsize == 4 * min);
+    assert (budget.get_used () == 3 * min);
+    bufsize = wire2.read (limited, max);
+    assert (bufsize == 4 * min);
+    assert (budget.get_used () == 3 * min);
+    bufsize = wire2.read (limited, wire2.to_boundary ());
+    assert (bufsize == 4 * min);
+    limited.release_buffer ();
+    assert (budget.get_used () == 0);
+    bufsize = wire2.next_bufsize (limited);
+    assert (bufsize == min);
+
+    return 0 ;
+}
@@ -31,5 +31,9 @@ int XS_TEST_MAIN ()
     int rc = xs_term (ctx);
     assert (rc == 0);
 
+    //  A message structure layout different from the library's is refused.
+    ctx = xs_init_msg_size (sizeof (xs_msg_t) + 32);
+    assert (!ctx && errno == EINVAL);
+
     return 0 ;
 }
@@ -0,0 +1,110 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "hwm_bytes test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    //  Create pair of sockets, each with byte high watermark of 500 and no
+    //  limit on the number of messages. Thus the total buffer space should
+    //  be 1000 bytes.
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    int hwm = 0;
+    int rc = xs_setsockopt (sb, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    uint64_t hwm_bytes = 500;
+    rc = xs_setsockopt (sb, XS_RCVHWM_BYTES, &hwm_bytes, sizeof (hwm_bytes));
+    assert (rc == 0);
+    rc = xs_bind (sb, "inproc://a");
+    assert (rc == 0);
+
+    void *sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+    rc = xs_setsockopt (sc, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_setsockopt (sc, XS_SNDHWM_BYTES, &hwm_bytes, sizeof (hwm_bytes));
+    assert (rc == 0);
+    rc = xs_connect (sc, "inproc://a");
+    assert (rc == 0);
+
+    //  Check the option values.
+    uint64_t value;
+    size_t size = sizeof (value);
+    rc = xs_getsockopt (sc, XS_SNDHWM_BYTES, &value, &size);
+    assert (rc == 0);
+    assert (size == sizeof (value) && value == 500);
+    int invalid = 500;
+    rc = xs_setsockopt (sc, XS_SNDHWM_BYTES, &invalid, sizeof (invalid));
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Try to send 20 messages of 100 bytes. Only 10 should succeed.
+    char buf [10000];
+    memset (buf, 0, sizeof (buf));
+    for (int i = 0; i < 20; i++) {
+        rc = xs_send (sc, buf, 100, XS_DONTWAIT);
+        if (i < 10)
+            assert (rc == 100);
+        else
+            assert (rc < 0 && errno == EAGAIN);
+    }
+
+    //  Consume the messages.
+    for (int i = 0; i != 10; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 100);
+    }
+
+    //  A message larger than the limit can be sent as the pipe is empty.
+    rc = xs_send (sc, buf, 10000, 0);
+    assert (rc == 10000);
+    rc = xs_send (sc, buf, 1, XS_DONTWAIT);
+    assert (rc < 0 && errno == EAGAIN);
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == 10000);
+
+    //  Byte limit doesn't throttle a stream of empty messages. The first
+    //  send blocks till the writer learns that the large message was read.
+    for (int i = 0; i != 10000; i++) {
+        rc = xs_send (sc, NULL, 0, i ? XS_DONTWAIT : 0);
+        assert (rc == 0);
+    }
+    for (int i = 0; i != 10000; i++) {
+        rc = xs_recv (sb, NULL, 0, 0);
+        assert (rc == 0);
+    }
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+
+    rc = xs_close (sb);
+    assert (rc == 0);
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
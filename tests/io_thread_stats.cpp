@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "io_thread_stats test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    int io_threads = 2;
+    int rc = xs_setctxopt (ctx, XS_IO_THREADS, &io_threads,
+        sizeof (io_threads));
+    assert (rc == 0);
+
+    //  There are no I/O threads before the first socket is created.
+    uint64_t stats [8];
+    size_t stats_size = sizeof (stats);
+    rc = xs_getctxopt (ctx, XS_IO_THREAD_STATS, stats, &stats_size);
+    assert (rc == 0);
+    assert (stats_size == 0);
+
+    void *sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    void *sc = xs_socket (ctx, XS_PAIR);
+    assert (sc);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    for (int i = 0; i != 10; i++)
+        bounce (sb, sc);
+
+    //  Give the I/O threads time to go to sleep and publish the statistics.
+    rc = xs_poll (NULL, 0, 100);
+    assert (rc == 0);
+
+    //  The buffer has to be large enough for all the I/O threads.
+    stats_size = sizeof (uint64_t) * 4;
+    rc = xs_getctxopt (ctx, XS_IO_THREAD_STATS, stats, &stats_size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+
+    stats_size = sizeof (stats);
+    rc = xs_getctxopt (ctx, XS_IO_THREAD_STATS, stats, &stats_size);
+    assert (rc == 0);
+    assert (stats_size == sizeof (stats));
+    uint64_t bytes = 0;
+    uint64_t events = 0;
+    uint64_t fds = 0;
+    for (int i = 0; i != io_threads; i++) {
+        bytes += stats [i * 4];
+        events += stats [i * 4 + 1];
+        fds += stats [i * 4 + 3];
+    }
+
+    //  Each of the 40 message parts was both written and read by the I/O
+    //  threads.
+    assert (bytes >= 40 * 32 * 2);
+    assert (events > 0);
+
+    //  At least the listener and both ends of the connection are registered.
+    assert (fds >= 3);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2010-2012 250bpm s.r.o.
+    Copyright (c) 2011 iMatix Corporation
+    Copyright (c) 2010-2011 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "io_uring test running...\n");
+
+    //  The option is accepted even if io_uring is not available. In such
+    //  case the default polling mechanism is used.
+    void *ctx = xs_init ();
+    assert (ctx);
+    int uring = 2;
+    int rc = xs_setctxopt (ctx, XS_IO_URING, &uring, sizeof (uring));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    uring = 1;
+    rc = xs_setctxopt (ctx, XS_IO_URING, &uring, sizeof (uring));
+    assert (rc == 0);
+    uring = 0;
+    size_t uring_size = sizeof (uring);
+    rc = xs_getctxopt (ctx, XS_IO_URING, &uring, &uring_size);
+    assert (rc == 0);
+    assert (uring == 1);
+    int io_threads = 2;
+    rc = xs_setctxopt (ctx, XS_IO_THREADS, &io_threads, sizeof (io_threads));
+    assert (rc == 0);
+
+    //  Connect before bind so that the reconnection timer is used.
+    void *sc = xs_socket (ctx, XS_PAIR);
+    assert (sc);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+    void *sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+
+    bounce (sb, sc);
+
+    //  Zero-copy receive is refused if io_uring is actually in use.
+    int zero_copy = 1;
+    rc = xs_setsockopt (sb, XS_ZERO_COPY_RECV, &zero_copy, sizeof (zero_copy));
+    assert (rc == 0 || xs_errno () == EINVAL);
+    zero_copy = 0;
+    rc = xs_setsockopt (sb, XS_ZERO_COPY_RECV, &zero_copy, sizeof (zero_copy));
+    assert (rc == 0);
+
+    //  Peers going away are noticed by the pending receives while the
+    //  others keep working.
+    void *in = xs_socket (ctx, XS_PULL);
+    assert (in);
+    rc = xs_bind (in, "tcp://127.0.0.1:5562");
+    assert (rc != -1);
+    for (int i = 0; i != 3; i++) {
+        void *out = xs_socket (ctx, XS_PUSH);
+        assert (out);
+        rc = xs_connect (out, "tcp://127.0.0.1:5562");
+        assert (rc == 0);
+        rc = xs_send (out, "ABC", 3, 0);
+        assert (rc == 3);
+        char tmp [3];
+        rc = xs_recv (in, tmp, sizeof (tmp), 0);
+        assert (rc == 3);
+        rc = xs_close (out);
+        assert (rc == 0);
+    }
+    rc = xs_close (in);
+    assert (rc == 0);
+
+    //  Pass enough data to fill the TCP buffers so that the engines have
+    //  to wait for the sockets to become writable.
+    void *pull = xs_socket (ctx, XS_PULL);
+    assert (pull);
+    rc = xs_bind (pull, "tcp://127.0.0.1:5561");
+    assert (rc == 0);
+    void *push [4];
+    for (int i = 0; i != 4; i++) {
+        push [i] = xs_socket (ctx, XS_PUSH);
+        assert (push [i]);
+        rc = xs_connect (push [i], "tcp://127.0.0.1:5561");
+        assert (rc == 0);
+    }
+    char *buf = (char*) malloc (100000);
+    assert (buf);
+    memset (buf, 'A', 100000);
+    for (int i = 0; i != 100; i++) {
+        rc = xs_send (push [i % 4], buf, 100000, 0);
+        assert (rc == 100000);
+    }
+    for (int i = 0; i != 100; i++) {
+        rc = xs_recv (pull, buf, 100000, 0);
+        assert (rc == 100000);
+    }
+    free (buf);
+
+    for (int i = 0; i != 4; i++) {
+        rc = xs_close (push [i]);
+        assert (rc == 0);
+    }
+    rc = xs_close (pull);
+    assert (rc == 0);
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,124 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+//  Histograms returned by XS_LATENCY.
+enum {
+    latency_pipe_in,
+    latency_pipe_out,
+    latency_encode,
+    latency_decode,
+    latency_count
+};
+
+const int bucket_count = 272;
+
+static uint64_t total (uint64_t *latencies_, int kind_)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i != bucket_count; i++)
+        sum += latencies_ [kind_ * bucket_count + i];
+    return sum;
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "latency test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    void *sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+
+    //  If the library was built without latency measurement there's
+    //  nothing to test.
+    static uint64_t latencies [latency_count * bucket_count];
+    size_t size = sizeof (latencies);
+    int rc = xs_getsockopt (sb, XS_LATENCY, latencies, &size);
+    if (rc == -1) {
+        assert (xs_errno () == EINVAL);
+        rc = xs_close (sc);
+        assert (rc == 0);
+        rc = xs_close (sb);
+        assert (rc == 0);
+        rc = xs_term (ctx);
+        assert (rc == 0);
+        return 0;
+    }
+    assert (rc == 0);
+    assert (size == sizeof (latencies));
+    for (int i = 0; i != latency_count; i++)
+        assert (total (latencies, i) == 0);
+
+    //  Too small buffer.
+    size = sizeof (uint64_t);
+    rc = xs_getsockopt (sb, XS_LATENCY, latencies, &size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+
+    //  Pass some messages over TCP.
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+    for (int i = 0; i != 10; i++) {
+        rc = xs_send (sc, "ABC", 3, 0);
+        assert (rc == 3);
+    }
+    char buf [3];
+    for (int i = 0; i != 10; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 3);
+    }
+
+    //  Give the I/O threads time to finish recording.
+    rc = xs_poll (NULL, 0, 100);
+    assert (rc == 0);
+
+    //  The receiving side has measured decoding and passing messages to
+    //  the application.
+    size = sizeof (latencies);
+    rc = xs_getsockopt (sb, XS_LATENCY, latencies, &size);
+    assert (rc == 0);
+    assert (total (latencies, latency_pipe_in) == 10);
+    assert (total (latencies, latency_pipe_out) == 0);
+    assert (total (latencies, latency_decode) > 0);
+
+    //  The sending side has measured passing messages to the I/O thread
+    //  and encoding them.
+    size = sizeof (latencies);
+    rc = xs_getsockopt (sc, XS_LATENCY, latencies, &size);
+    assert (rc == 0);
+    assert (total (latencies, latency_pipe_in) == 0);
+    assert (total (latencies, latency_pipe_out) == 10);
+    assert (total (latencies, latency_encode) > 0);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2010-2012 250bpm s.r.o.
+    Copyright (c) 2011 iMatix Corporation
+    Copyright (c) 2010-2011 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+#define MAILBOX_STRESS_THREADS 50
+#define MAILBOX_STRESS_MSGS 100
+
+extern "C"
+{
+    static void mailbox_stress_worker (void *ctx_)
+    {
+        int rc;
+        int i;
+
+        //  Connecting, sending and closing the socket all send commands to
+        //  the mailboxes of the peer socket, the I/O threads and the reaper
+        //  in parallel with the other workers.
+        void *s = xs_socket (ctx_, XS_PUSH);
+        assert (s);
+        rc = xs_connect (s, "inproc://mailbox_stress");
+        assert (rc == 0);
+        for (i = 0; i != MAILBOX_STRESS_MSGS; i++) {
+            rc = xs_send (s, "ABC", 3, 0);
+            assert (rc == 3);
+        }
+        rc = xs_close (s);
+        assert (rc == 0);
+    }
+}
+
+int XS_TEST_MAIN ()
+{
+    void *ctx;
+    void *s;
+    int i;
+    int j;
+    int rc;
+    char buf [3];
+    void *threads [MAILBOX_STRESS_THREADS];
+
+    fprintf (stderr, "mailbox_stress test running...\n");
+
+    for (j = 0; j != 10; j++) {
+
+        ctx = xs_init ();
+        assert (ctx);
+
+        s = xs_socket (ctx, XS_PULL);
+        assert (s);
+        rc = xs_bind (s, "inproc://mailbox_stress");
+        assert (rc == 0);
+
+        for (i = 0; i != MAILBOX_STRESS_THREADS; i++) {
+            threads [i] = thread_create (mailbox_stress_worker, ctx);
+            assert (threads [i]);
+        }
+
+        //  All the messages from all the senders have to arrive.
+        for (i = 0; i != MAILBOX_STRESS_THREADS * MAILBOX_STRESS_MSGS; i++) {
+            rc = xs_recv (s, buf, sizeof (buf), 0);
+            assert (rc == 3);
+        }
+
+        for (i = 0; i != MAILBOX_STRESS_THREADS; i++)
+            thread_join (threads [i]);
+
+        rc = xs_close (s);
+        assert (rc == 0);
+
+        rc = xs_term (ctx);
+        assert (rc == 0);
+    }
+
+    return 0;
+}
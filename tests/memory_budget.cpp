@@ -0,0 +1,214 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+static uint64_t memory_used (void *ctx_)
+{
+    uint64_t used;
+    size_t size = sizeof (used);
+    int rc = xs_getctxopt (ctx_, XS_MEMORY_USED, &used, &size);
+    assert (rc == 0);
+    assert (size == sizeof (used));
+    return used;
+}
+
+//  Makes the socket process the commands sent to it.
+static void process_commands (void *s_)
+{
+    int events;
+    size_t size = sizeof (events);
+    int rc = xs_getsockopt (s_, XS_EVENTS, &events, &size);
+    assert (rc == 0);
+}
+
+//  Sends 1000-byte messages till the socket refuses to accept more.
+static int fill (void *s_)
+{
+    char buf [1000];
+    memset (buf, 0, sizeof (buf));
+    int count = 0;
+    while (true) {
+        int rc = xs_send (s_, buf, sizeof (buf), XS_DONTWAIT);
+        if (rc < 0) {
+            assert (errno == EAGAIN);
+            return count;
+        }
+        assert (rc == sizeof (buf));
+        count++;
+    }
+}
+
+static void drain (void *s_, int count_)
+{
+    char buf [1000];
+    for (int i = 0; i != count_; i++) {
+        int rc = xs_recv (s_, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+    }
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "memory_budget test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    //  Check the option values.
+    uint64_t budget = 100000;
+    int rc = xs_setctxopt (ctx, XS_MEMORY_BUDGET, &budget, sizeof (int));
+    assert (rc == -1 && errno == EINVAL);
+    rc = xs_setctxopt (ctx, XS_MEMORY_BUDGET, &budget, sizeof (budget));
+    assert (rc == 0);
+    uint64_t value;
+    size_t size = sizeof (value);
+    rc = xs_getctxopt (ctx, XS_MEMORY_BUDGET, &value, &size);
+    assert (rc == 0);
+    assert (size == sizeof (value) && value == budget);
+    assert (memory_used (ctx) == 0);
+
+    //  Create two pairs of sockets with no high watermarks so that only
+    //  the budget limits the amount of queued data.
+    int hwm = 0;
+    void *pull1 = xs_socket (ctx, XS_PULL);
+    assert (pull1);
+    rc = xs_setsockopt (pull1, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_bind (pull1, "inproc://a");
+    assert (rc == 0);
+    void *push1 = xs_socket (ctx, XS_PUSH);
+    assert (push1);
+    rc = xs_setsockopt (push1, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (push1, "inproc://a");
+    assert (rc == 0);
+
+    void *pull2 = xs_socket (ctx, XS_PULL);
+    assert (pull2);
+    rc = xs_setsockopt (pull2, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_bind (pull2, "inproc://b");
+    assert (rc == 0);
+    void *push2 = xs_socket (ctx, XS_PUSH);
+    assert (push2);
+    rc = xs_setsockopt (push2, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (push2, "inproc://b");
+    assert (rc == 0);
+
+    //  The first pipe takes up the whole budget.
+    int count1 = fill (push1);
+    assert (count1 > 50 && count1 <= 100);
+    assert (memory_used (ctx) <= budget);
+
+    //  The second pipe is always allowed to pass a few kilobytes, but no
+    //  more.
+    int count2 = fill (push2);
+    assert (count2 >= 1 && count2 <= 9);
+
+    //  Once the first pipe is drained, the second one can borrow its share
+    //  of the budget.
+    drain (pull1, count1);
+    process_commands (push1);
+    drain (pull2, count2);
+    process_commands (push2);
+    count2 = fill (push2);
+    assert (count2 > 50 && count2 <= 100);
+    assert (memory_used (ctx) <= budget);
+    drain (pull2, count2);
+    process_commands (push2);
+
+    //  Idle pipes keep at most 8kB each.
+    assert (memory_used (ctx) <= 2 * 8192);
+
+    //  Empty messages are charged for as well.
+    count2 = 0;
+    while (xs_send (push2, NULL, 0, XS_DONTWAIT) == 0) {
+        count2++;
+        assert (count2 < (int) budget);
+    }
+    assert (errno == EAGAIN);
+    assert (memory_used (ctx) <= budget);
+    for (int i = 0; i != count2; i++) {
+        rc = xs_recv (pull2, NULL, 0, 0);
+        assert (rc == 0);
+    }
+    process_commands (push2);
+    assert (memory_used (ctx) <= 2 * 8192);
+
+    //  Zero-copy receive can't be used with the budget.
+    int zero_copy = 1;
+    rc = xs_setsockopt (pull1, XS_ZERO_COPY_RECV, &zero_copy,
+        sizeof (zero_copy));
+    assert (rc == -1 && errno == EINVAL);
+
+    //  PUB socket drops the messages when the budget is exhausted.
+    void *sub = xs_socket (ctx, XS_SUB);
+    assert (sub);
+    rc = xs_setsockopt (sub, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_setsockopt (sub, XS_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    rc = xs_bind (sub, "inproc://c");
+    assert (rc == 0);
+    void *pub = xs_socket (ctx, XS_PUB);
+    assert (pub);
+    rc = xs_setsockopt (pub, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (pub, "inproc://c");
+    assert (rc == 0);
+
+    //  Let the subscription get to the publisher.
+    process_commands (sub);
+    process_commands (pub);
+
+    char buf [1000];
+    memset (buf, 0, sizeof (buf));
+    for (int i = 0; i != 1000; i++) {
+        rc = xs_send (pub, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+    }
+    assert (memory_used (ctx) <= budget);
+    int count = 0;
+    while (xs_recv (sub, buf, sizeof (buf), XS_DONTWAIT) == sizeof (buf))
+        count++;
+    assert (errno == EAGAIN);
+    assert (count > 50 && count <= 100);
+
+    rc = xs_close (pub);
+    assert (rc == 0);
+    rc = xs_close (sub);
+    assert (rc == 0);
+    rc = xs_close (push1);
+    assert (rc == 0);
+    rc = xs_close (pull1);
+    assert (rc == 0);
+    rc = xs_close (push2);
+    assert (rc == 0);
+    rc = xs_close (pull2);
+    assert (rc == 0);
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "msg_batch test running...\n");
+
+    //  Create the infrastructure.
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    int rc = xs_bind (sb, "inproc://a");
+    assert (rc == 0);
+    void *sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+    rc = xs_connect (sc, "inproc://a");
+    assert (rc == 0);
+
+    //  Invalid arguments.
+    xs_msg_t msgs [16];
+    rc = xs_sendmmsg (sc, msgs, -1, 0);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    rc = xs_sendmmsg (sc, NULL, 1, 0);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    rc = xs_sendmmsg (sc, msgs, 0, 0);
+    assert (rc == 0);
+
+    //  Send a batch of 10 messages.
+    for (int i = 0; i != 10; i++) {
+        rc = xs_msg_init_size (&msgs [i], 1);
+        assert (rc == 0);
+        *(char*) xs_msg_data (&msgs [i]) = 'A' + i;
+    }
+    rc = xs_sendmmsg (sc, msgs, 10, 0);
+    assert (rc == 10);
+    for (int i = 0; i != 10; i++) {
+        rc = xs_msg_close (&msgs [i]);
+        assert (rc == 0);
+    }
+
+    //  Receive them in a single call. There's more space available in
+    //  the array than there are messages.
+    for (int i = 0; i != 16; i++) {
+        rc = xs_msg_init (&msgs [i]);
+        assert (rc == 0);
+    }
+    rc = xs_recvmmsg (sb, msgs, 16, 0);
+    assert (rc == 10);
+    for (int i = 0; i != 10; i++) {
+        assert (xs_msg_size (&msgs [i]) == 1);
+        assert (*(char*) xs_msg_data (&msgs [i]) == 'A' + i);
+    }
+
+    //  No more messages are available.
+    rc = xs_recvmmsg (sb, msgs, 16, XS_DONTWAIT);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    //  Batch sending is not supported by PULL socket.
+    rc = xs_sendmmsg (sb, msgs, 1, XS_DONTWAIT);
+    assert (rc == -1 && xs_errno () == ENOTSUP);
+
+    //  Send a multi-part message consisting of 3 parts. The first two are
+    //  sent as a batch.
+    for (int i = 0; i != 2; i++) {
+        rc = xs_msg_init_size (&msgs [i], 1);
+        assert (rc == 0);
+    }
+    rc = xs_sendmmsg (sc, msgs, 2, XS_SNDMORE);
+    assert (rc == 2);
+    rc = xs_send (sc, "C", 1, 0);
+    assert (rc == 1);
+
+    //  Receive the parts in batches of 2. Check the more flags.
+    int more;
+    size_t more_size;
+    rc = xs_recvmmsg (sb, msgs, 2, 0);
+    assert (rc == 2);
+    for (int i = 0; i != 2; i++) {
+        more_size = sizeof (more);
+        rc = xs_getmsgopt (&msgs [i], XS_MORE, &more, &more_size);
+        assert (rc == 0);
+        assert (more == 1);
+    }
+    more_size = sizeof (more);
+    rc = xs_getsockopt (sb, XS_RCVMORE, &more, &more_size);
+    assert (rc == 0);
+    assert (more == 1);
+    rc = xs_recvmmsg (sb, msgs, 2, 0);
+    assert (rc == 1);
+    assert (*(char*) xs_msg_data (&msgs [0]) == 'C');
+    more_size = sizeof (more);
+    rc = xs_getmsgopt (&msgs [0], XS_MORE, &more, &more_size);
+    assert (rc == 0);
+    assert (more == 0);
+
+    for (int i = 0; i != 16; i++) {
+        rc = xs_msg_close (&msgs [i]);
+        assert (rc == 0);
+    }
+
+    //  Deallocate the infrastructure.
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
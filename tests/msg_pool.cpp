@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "msg_pool test running...\n");
+
+    //  Create the infrastructure.
+    void *ctx = xs_init ();
+    assert (ctx);
+    int pool = 2;
+    int rc = xs_setctxopt (ctx, XS_MSG_POOL, &pool, sizeof (pool));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    pool = 1;
+    rc = xs_setctxopt (ctx, XS_MSG_POOL, &pool, sizeof (pool));
+    assert (rc == 0);
+    pool = 0;
+    size_t pool_size = sizeof (pool);
+    rc = xs_getctxopt (ctx, XS_MSG_POOL, &pool, &pool_size);
+    assert (rc == 0);
+    assert (pool == 1);
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+    void *sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc == 0);
+
+    //  Pass messages one by one so that the pooled blocks get reused.
+    //  Both sending and receiving side allocate from the pool.
+    char buf [200];
+    memset (buf, 'A', sizeof (buf));
+    for (int i = 0; i != 100; i++) {
+        rc = xs_send (sc, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+    }
+
+    uint64_t hits;
+    size_t hits_size = sizeof (hits);
+    rc = xs_getctxopt (ctx, XS_MSG_POOL_HITS, &hits, &hits_size);
+    assert (rc == 0);
+    assert (hits_size == sizeof (hits));
+    uint64_t misses;
+    size_t misses_size = sizeof (misses);
+    rc = xs_getctxopt (ctx, XS_MSG_POOL_MISSES, &misses, &misses_size);
+    assert (rc == 0);
+    assert (hits + misses == 200);
+    assert (hits > 0 && misses > 0);
+
+    //  Pooled message can outlive the context.
+    rc = xs_send (sc, buf, sizeof (buf), 0);
+    assert (rc == sizeof (buf));
+    xs_msg_t msg;
+    rc = xs_msg_init (&msg);
+    assert (rc == 0);
+    rc = xs_recvmsg (sb, &msg, 0);
+    assert (rc == sizeof (buf));
+
+    //  Deallocate the infrastructure.
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    assert (memcmp (xs_msg_data (&msg), buf, sizeof (buf)) == 0);
+    rc = xs_msg_close (&msg);
+    assert (rc == 0);
+
+    return 0 ;
+}
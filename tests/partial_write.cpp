@@ -0,0 +1,112 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+//  Parts of 1 to 8 kB with sizes that are not multiples of anything the
+//  kernel is likely to round socket buffers to.
+static size_t part_size (int msg_, int part_)
+{
+    return 1024 + ((msg_ * 7 + part_ * 13) * 131) % 7169;
+}
+
+static unsigned char part_byte (int msg_, int part_, size_t pos_)
+{
+    return (unsigned char) (msg_ * 31 + part_ * 7 + pos_);
+}
+
+static void partial_write (void *ctx_, const char *addr_)
+{
+    const int count = 300;
+    const int parts = 3;
+
+    //  A tiny send buffer makes many of the writevs short, so the encoder
+    //  has to resume in the middle of frame headers and bodies. (Shrinking
+    //  the receive buffer as well only makes TCP crawl along on window
+    //  probes.)
+    int buf = 4096;
+    int hwm = 0;
+    void *sb = xs_socket (ctx_, XS_PULL);
+    assert (sb);
+    int rc = xs_setsockopt (sb, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_bind (sb, addr_);
+    assert (rc != -1);
+    void *sc = xs_socket (ctx_, XS_PUSH);
+    assert (sc);
+    rc = xs_setsockopt (sc, XS_SNDBUF, &buf, sizeof (buf));
+    assert (rc == 0);
+    rc = xs_setsockopt (sc, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (sc, addr_);
+    assert (rc != -1);
+
+    unsigned char *data = (unsigned char*) malloc (8 * 1024);
+    assert (data);
+    for (int i = 0; i != count; i++) {
+        for (int j = 0; j != parts; j++) {
+            size_t size = part_size (i, j);
+            for (size_t k = 0; k != size; k++)
+                data [k] = part_byte (i, j, k);
+            rc = xs_send (sc, data, size, j + 1 < parts ? XS_SNDMORE : 0);
+            assert (rc == (int) size);
+        }
+    }
+
+    //  The sender is well ahead of the receiver at this point.
+    for (int i = 0; i != count; i++) {
+        for (int j = 0; j != parts; j++) {
+            size_t size = part_size (i, j);
+            rc = xs_recv (sb, data, 8 * 1024, 0);
+            assert (rc == (int) size);
+            for (size_t k = 0; k != size; k++)
+                assert (data [k] == part_byte (i, j, k));
+            int more;
+            size_t more_size = sizeof (more);
+            rc = xs_getsockopt (sb, XS_RCVMORE, &more, &more_size);
+            assert (rc == 0);
+            assert (more == (j + 1 < parts));
+        }
+    }
+    free (data);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "partial_write test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    partial_write (ctx, "tcp://127.0.0.1:5560");
+#if !defined XS_HAVE_WINDOWS && !defined XS_HAVE_OPENVMS
+    partial_write (ctx, "ipc:///tmp/tester");
+#endif
+
+    int rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "reuseport test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    int io_threads = 4;
+    int rc = xs_setctxopt (ctx, XS_IO_THREADS, &io_threads,
+        sizeof (io_threads));
+    assert (rc == 0);
+
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    int reuseport = 2;
+    rc = xs_setsockopt (sb, XS_REUSEPORT, &reuseport, sizeof (reuseport));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    reuseport = 1;
+    rc = xs_setsockopt (sb, XS_REUSEPORT, &reuseport, sizeof (reuseport));
+
+    //  The OS doesn't support sharing ports.
+    if (rc == -1) {
+        assert (xs_errno () == EINVAL);
+        rc = xs_close (sb);
+        assert (rc == 0);
+        rc = xs_term (ctx);
+        assert (rc == 0);
+        return 0;
+    }
+
+    reuseport = 0;
+    size_t reuseport_size = sizeof (reuseport);
+    rc = xs_getsockopt (sb, XS_REUSEPORT, &reuseport, &reuseport_size);
+    assert (rc == 0);
+    assert (reuseport == 1);
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+
+    //  Sockets not sharing the port can't bind to it.
+    void *s = xs_socket (ctx, XS_PULL);
+    assert (s);
+    rc = xs_bind (s, "tcp://127.0.0.1:5560");
+    assert (rc == -1 && xs_errno () == EADDRINUSE);
+    rc = xs_close (s);
+    assert (rc == 0);
+
+    //  Open lots of connections at once. Each of them has to be accepted
+    //  by one of the listeners.
+    void *sc [50];
+    for (int i = 0; i != 50; i++) {
+        sc [i] = xs_socket (ctx, XS_PUSH);
+        assert (sc [i]);
+        rc = xs_connect (sc [i], "tcp://127.0.0.1:5560");
+        assert (rc != -1);
+        rc = xs_send (sc [i], "ABC", 3, 0);
+        assert (rc == 3);
+    }
+    char buf [3];
+    for (int i = 0; i != 50; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 3);
+        assert (memcmp (buf, "ABC", 3) == 0);
+    }
+    for (int i = 0; i != 50; i++) {
+        rc = xs_close (sc [i]);
+        assert (rc == 0);
+    }
+
+    //  The messages are still passed in both directions when the sessions
+    //  run in the I/O threads of the listeners.
+    s = xs_socket (ctx, XS_PAIR);
+    assert (s);
+    rc = xs_setsockopt (s, XS_REUSEPORT, &reuseport, sizeof (reuseport));
+    assert (rc == 0);
+    rc = xs_bind (s, "tcp://127.0.0.1:5561");
+    assert (rc != -1);
+    void *sc2 = xs_socket (ctx, XS_PAIR);
+    assert (sc2);
+    rc = xs_connect (sc2, "tcp://127.0.0.1:5561");
+    assert (rc != -1);
+    bounce (s, sc2);
+    rc = xs_close (sc2);
+    assert (rc == 0);
+    rc = xs_close (s);
+    assert (rc == 0);
+
+    rc = xs_close (sb);
+    assert (rc == 0);
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "router test running...\n");
+
+    const int peers = 100;
+
+    //  Create the infrastructure.
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *router = xs_socket (ctx, XS_ROUTER);
+    assert (router);
+    int rc = xs_bind (router, "inproc://a");
+    assert (rc == 0);
+
+    //  Connect the peers. Every other peer sets its own identity, the others
+    //  get one generated by the router.
+    void *dealers [peers];
+    char name [16];
+    for (int i = 0; i != peers; i++) {
+        dealers [i] = xs_socket (ctx, XS_DEALER);
+        assert (dealers [i]);
+        if (i % 2) {
+            sprintf (name, "peer%d", i);
+            rc = xs_setsockopt (dealers [i], XS_IDENTITY, name, strlen (name));
+            assert (rc == 0);
+        }
+        rc = xs_connect (dealers [i], "inproc://a");
+        assert (rc == 0);
+        rc = xs_send (dealers [i], &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+
+    //  Learn the identities of the peers.
+    unsigned char ids [peers][256];
+    size_t id_sizes [peers];
+    for (int i = 0; i != peers; i++) {
+        unsigned char id [256];
+        rc = xs_recv (router, id, sizeof (id), 0);
+        assert (rc > 0);
+        size_t id_size = rc;
+        int peer;
+        rc = xs_recv (router, &peer, sizeof (peer), 0);
+        assert (rc == sizeof (peer));
+        assert (peer >= 0 && peer < peers);
+        if (peer % 2) {
+            sprintf (name, "peer%d", peer);
+            assert (id_size == strlen (name));
+            assert (memcmp (id, name, id_size) == 0);
+        }
+        else
+            assert (id_size == 5 && id [0] == 0);
+        memcpy (ids [peer], id, id_size);
+        id_sizes [peer] = id_size;
+    }
+
+    //  Route a message to each peer, in the reverse order.
+    for (int i = peers - 1; i >= 0; i--) {
+        rc = xs_send (router, ids [i], id_sizes [i], XS_SNDMORE);
+        assert (rc == (int) id_sizes [i]);
+        rc = xs_send (router, &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+    for (int i = 0; i != peers; i++) {
+        int peer;
+        rc = xs_recv (dealers [i], &peer, sizeof (peer), 0);
+        assert (rc == sizeof (peer));
+        assert (peer == i);
+    }
+
+    //  Messages to unknown peers are silently dropped.
+    unsigned char unknown [5] = {0, 0xff, 0xff, 0xff, 0xff};
+    rc = xs_send (router, unknown, sizeof (unknown), XS_SNDMORE);
+    assert (rc == sizeof (unknown));
+    rc = xs_send (router, "ABC", 3, 0);
+    assert (rc == 3);
+    rc = xs_send (router, "unknown", 7, XS_SNDMORE);
+    assert (rc == 7);
+    rc = xs_send (router, "ABC", 3, 0);
+    assert (rc == 3);
+
+    //  Peer with an identity already in use is disconnected.
+    void *rejected = xs_socket (ctx, XS_DEALER);
+    assert (rejected);
+    rc = xs_setsockopt (rejected, XS_IDENTITY, "peer1", 5);
+    assert (rc == 0);
+    rc = xs_connect (rejected, "inproc://a");
+    assert (rc == 0);
+    rc = xs_send (rejected, "ABC", 3, 0);
+    assert (rc == 3);
+    int timeo = 100;
+    rc = xs_setsockopt (router, XS_RCVTIMEO, &timeo, sizeof (timeo));
+    assert (rc == 0);
+    unsigned char id [256];
+    rc = xs_recv (router, id, sizeof (id), 0);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    //  The original owner of the identity is still reachable.
+    rc = xs_send (router, "peer1", 5, XS_SNDMORE);
+    assert (rc == 5);
+    rc = xs_send (router, "ABC", 3, 0);
+    assert (rc == 3);
+    char buf [3];
+    rc = xs_recv (dealers [1], buf, sizeof (buf), 0);
+    assert (rc == 3);
+    rc = xs_close (rejected);
+    assert (rc == 0);
+
+    //  Deallocate the infrastructure.
+    for (int i = 0; i != peers; i++) {
+        rc = xs_close (dealers [i]);
+        assert (rc == 0);
+    }
+    rc = xs_close (router);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//  The routing table is internal to the library and its symbols are not
+//  exported. Thus, the implementation is compiled directly into the test
+//  program.
+#include "../src/routing_table.cpp"
+#include "../src/random.cpp"
+#include "../src/clock.cpp"
+#include "../src/err.cpp"
+
+#include "testutil.hpp"
+
+#include <vector>
+
+//  The table never dereferences the pipes, so fake ones will do.
+static xs::pipe_t *fake_pipe (int i_)
+{
+    return (xs::pipe_t*) (size_t) (i_ + 1);
+}
+
+static xs::blob_t identity (int i_)
+{
+    char buf [32];
+    int size = sprintf (buf, "peer-%d", i_);
+    return xs::blob_t ((unsigned char*) buf, size);
+}
+
+static bool has (xs::routing_table_t &table_, const xs::blob_t &identity_,
+    int i_)
+{
+    xs::routing_table_t::outpipe_t *outpipe =
+        table_.find (identity_.data (), identity_.size ());
+    if (!outpipe)
+        return false;
+    assert (outpipe->pipe == fake_pipe (i_));
+    return true;
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "routing_table test running...\n");
+
+    const int count = 5000;
+
+    xs::seed_random ();
+    xs::routing_table_t table;
+    assert (table.empty ());
+
+    //  Fill in both generated and peer-chosen identities.
+    std::vector <xs::blob_t> generated;
+    for (int i = 0; i != count; i++) {
+        generated.push_back (table.add (fake_pipe (i)));
+        bool ok = table.add (identity (i), fake_pipe (count + i));
+        assert (ok);
+    }
+
+    //  Duplicates and identities in the generated format are refused.
+    bool ok = table.add (identity (7), fake_pipe (0));
+    assert (!ok);
+    ok = table.add (generated [7], fake_pipe (0));
+    assert (!ok);
+
+    for (int i = 0; i != count; i++) {
+        assert (has (table, generated [i], i));
+        assert (has (table, identity (i), count + i));
+    }
+
+    //  Remove most of the entries so that the tables shrink. The rest has
+    //  to survive the re-indexing.
+    for (int i = 0; i != count; i++) {
+        if (i % 100 == 0)
+            continue;
+        table.erase (generated [i]);
+        table.erase (identity (i));
+    }
+    for (int i = 0; i != count; i++) {
+        assert (has (table, generated [i], i) == (i % 100 == 0));
+        assert (has (table, identity (i), count + i) == (i % 100 == 0));
+    }
+
+    //  New generated identities don't clash with the surviving ones.
+    std::vector <xs::blob_t> more;
+    for (int i = 0; i != count; i++)
+        more.push_back (table.add (fake_pipe (2 * count + i)));
+    for (int i = 0; i != count; i++) {
+        assert (has (table, more [i], 2 * count + i));
+        if (i % 100 == 0)
+            assert (has (table, generated [i], i));
+    }
+
+    //  Empty the table completely and fill it in again.
+    for (int i = 0; i != count; i++) {
+        table.erase (more [i]);
+        if (i % 100 == 0) {
+            table.erase (generated [i]);
+            table.erase (identity (i));
+        }
+    }
+    assert (table.empty ());
+    for (int i = 0; i != count; i++) {
+        ok = table.add (identity (i), fake_pipe (i));
+        assert (ok);
+    }
+    for (int i = 0; i != count; i++)
+        assert (has (table, identity (i), i));
+    for (int i = 0; i != count; i++)
+        table.erase (identity (i));
+    assert (table.empty ());
+
+    return 0 ;
+}
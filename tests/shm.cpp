@@ -0,0 +1,99 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "shm test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    //  The transport may not be available on this platform.
+    //  Small receive high water mark makes the receiver stop reading
+    //  from the ring every now and then.
+    void *sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    int hwm = 10;
+    int rc = xs_setsockopt (sb, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_bind (sb, "shm:///tmp/tester_shm");
+    if (rc == -1) {
+        assert (xs_errno () == EPROTONOSUPPORT);
+        rc = xs_close (sb);
+        assert (rc == 0);
+        rc = xs_term (ctx);
+        assert (rc == 0);
+        return 0;
+    }
+
+    void *sc = xs_socket (ctx, XS_PAIR);
+    assert (sc);
+    hwm = 0;
+    rc = xs_setsockopt (sc, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (sc, "shm:///tmp/tester_shm");
+    assert (rc == 0);
+
+    bounce (sb, sc);
+
+    //  Send more data than fits into the ring at once so that the sender
+    //  has to wait for the receiver.
+    const int count = 10000;
+    char buf [1000];
+    for (int i = 0; i != count; i++) {
+        memset (buf, i % 256, sizeof (buf));
+        rc = xs_send (sc, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+    }
+    for (int i = 0; i != count; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == sizeof (buf));
+        assert (buf [0] == (char) (i % 256));
+        assert (buf [sizeof (buf) - 1] == (char) (i % 256));
+    }
+
+    //  Message larger than the ring is passed in several pieces.
+    size_t size = 3 * 1024 * 1024;
+    xs_msg_t msg;
+    rc = xs_msg_init_size (&msg, size);
+    assert (rc == 0);
+    for (size_t i = 0; i != size; i++)
+        ((unsigned char*) xs_msg_data (&msg)) [i] = (unsigned char) (i % 251);
+    rc = xs_sendmsg (sb, &msg, 0);
+    assert (rc == (int) size);
+    rc = xs_recvmsg (sc, &msg, 0);
+    assert (rc == (int) size);
+    for (size_t i = 0; i != size; i++)
+        assert (((unsigned char*) xs_msg_data (&msg)) [i] ==
+            (unsigned char) (i % 251));
+    rc = xs_msg_close (&msg);
+    assert (rc == 0);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
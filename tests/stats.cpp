@@ -0,0 +1,224 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+#include "../src/stdint.hpp"
+
+//  Indices of the values returned by XS_STATS.
+enum {
+    msgs_sent,
+    bytes_sent,
+    msgs_received,
+    bytes_received,
+    sends_blocked,
+    msgs_dropped,
+    msgs_queued,
+    reconnects,
+    protocol_errors,
+    stats_count
+};
+
+//  Indices of the values returned by XS_PIPE_STATS for each peer.
+enum {
+    pipe_msgs_received,
+    pipe_bytes_received,
+    pipe_msgs_sent,
+    pipe_bytes_sent,
+    pipe_msgs_queued,
+    pipe_bytes_queued,
+    pipe_stats_count
+};
+
+static void get_stats (void *s_, uint64_t *stats_)
+{
+    size_t size = stats_count * sizeof (uint64_t);
+    int rc = xs_getsockopt (s_, XS_STATS, stats_, &size);
+    assert (rc == 0);
+    assert (size == stats_count * sizeof (uint64_t));
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "stats test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    //  Too small buffer.
+    void *sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    uint64_t stats [stats_count];
+    size_t size = sizeof (uint64_t);
+    int rc = xs_getsockopt (sb, XS_STATS, stats, &size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+
+    //  Sending with no peers is blocked.
+    void *sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+    rc = xs_send (sc, "ABC", 3, XS_DONTWAIT);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+    get_stats (sc, stats);
+    assert (stats [msgs_sent] == 0);
+    assert (stats [sends_blocked] == 1);
+
+    //  Messages and bytes are counted on both sides. Multi-part message
+    //  counts as a single message. The messages not read yet are reported
+    //  as queued.
+    rc = xs_bind (sb, "inproc://a");
+    assert (rc == 0);
+    rc = xs_connect (sc, "inproc://a");
+    assert (rc == 0);
+    rc = xs_send (sc, "ABC", 3, XS_SNDMORE);
+    assert (rc == 3);
+    rc = xs_send (sc, "DEFG", 4, 0);
+    assert (rc == 4);
+    rc = xs_send (sc, "H", 1, 0);
+    assert (rc == 1);
+    get_stats (sc, stats);
+    assert (stats [msgs_sent] == 2);
+    assert (stats [bytes_sent] == 8);
+    assert (stats [msgs_queued] == 2);
+    char buf [4];
+    for (int i = 0; i != 3; i++) {
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc > 0);
+    }
+    get_stats (sb, stats);
+    assert (stats [msgs_received] == 2);
+    assert (stats [bytes_received] == 8);
+
+    //  The same is available for each peer. Too small buffer is rejected
+    //  and the required size is reported.
+    uint64_t pipe_stats [2 * pipe_stats_count];
+    size = 0;
+    rc = xs_getsockopt (sc, XS_PIPE_STATS, pipe_stats, &size);
+    assert (rc == -1 && xs_errno () == EINVAL);
+    assert (size == pipe_stats_count * sizeof (uint64_t));
+    size = sizeof (pipe_stats);
+    rc = xs_getsockopt (sc, XS_PIPE_STATS, pipe_stats, &size);
+    assert (rc == 0);
+    assert (size == pipe_stats_count * sizeof (uint64_t));
+    assert (pipe_stats [pipe_msgs_sent] == 2);
+    assert (pipe_stats [pipe_bytes_sent] == 8);
+    assert (pipe_stats [pipe_msgs_received] == 0);
+    size = sizeof (pipe_stats);
+    rc = xs_getsockopt (sb, XS_PIPE_STATS, pipe_stats, &size);
+    assert (rc == 0);
+    assert (size == pipe_stats_count * sizeof (uint64_t));
+    assert (pipe_stats [pipe_msgs_received] == 2);
+    assert (pipe_stats [pipe_bytes_received] == 8);
+    assert (pipe_stats [pipe_msgs_queued] == 0);
+
+    //  The context sums up the statistics of all the sockets.
+    int events;
+    size_t events_size = sizeof (events);
+    rc = xs_getsockopt (sb, XS_EVENTS, &events, &events_size);
+    assert (rc == 0);
+    rc = xs_getsockopt (sc, XS_EVENTS, &events, &events_size);
+    assert (rc == 0);
+    size = stats_count * sizeof (uint64_t);
+    rc = xs_getctxopt (ctx, XS_STATS, stats, &size);
+    assert (rc == 0);
+    assert (size == stats_count * sizeof (uint64_t));
+    assert (stats [msgs_sent] == 2);
+    assert (stats [msgs_received] == 2);
+    assert (stats [bytes_sent] == 8);
+    assert (stats [bytes_received] == 8);
+    assert (stats [sends_blocked] == 1);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+
+    //  Publisher drops the messages when the subscriber is not reading.
+    void *pub = xs_socket (ctx, XS_PUB);
+    assert (pub);
+    int hwm = 2;
+    rc = xs_setsockopt (pub, XS_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_bind (pub, "inproc://b");
+    assert (rc == 0);
+    void *sub = xs_socket (ctx, XS_SUB);
+    assert (sub);
+    rc = xs_setsockopt (sub, XS_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    rc = xs_setsockopt (sub, XS_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = xs_connect (sub, "inproc://b");
+    assert (rc == 0);
+    for (int i = 0; i != 10; i++) {
+        rc = xs_send (pub, "ABC", 3, 0);
+        assert (rc == 3);
+    }
+    get_stats (pub, stats);
+    assert (stats [msgs_sent] == 10);
+    assert (stats [msgs_dropped] > 0);
+    rc = xs_close (sub);
+    assert (rc == 0);
+    rc = xs_close (pub);
+    assert (rc == 0);
+
+    //  Messages exceeding the maximum size are reported as protocol errors.
+    sb = xs_socket (ctx, XS_PULL);
+    assert (sb);
+    int64_t maxmsgsize = 2;
+    rc = xs_setsockopt (sb, XS_MAXMSGSIZE, &maxmsgsize, sizeof (maxmsgsize));
+    assert (rc == 0);
+    rc = xs_bind (sb, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    sc = xs_socket (ctx, XS_PUSH);
+    assert (sc);
+    rc = xs_connect (sc, "tcp://127.0.0.1:5560");
+    assert (rc != -1);
+    rc = xs_send (sc, "ABC", 3, 0);
+    assert (rc == 3);
+    for (int i = 0; i != 100; i++) {
+        get_stats (sb, stats);
+        if (stats [protocol_errors])
+            break;
+        rc = xs_poll (NULL, 0, 10);
+        assert (rc == 0);
+    }
+    assert (stats [protocol_errors] == 1);
+
+    //  The connecting side reconnects after the connection was broken.
+    for (int i = 0; i != 100; i++) {
+        get_stats (sc, stats);
+        if (stats [reconnects])
+            break;
+        rc = xs_poll (NULL, 0, 10);
+        assert (rc == 0);
+    }
+    assert (stats [reconnects] > 0);
+
+    int linger = 0;
+    rc = xs_setsockopt (sc, XS_LINGER, &linger, sizeof (linger));
+    assert (rc == 0);
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
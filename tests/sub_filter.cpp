@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "sub_filter test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *pub = xs_socket (ctx, XS_PUB);
+    assert (pub);
+    int rc = xs_bind (pub, "inproc://a");
+    assert (rc == 0);
+    void *sub = xs_socket (ctx, XS_SUB);
+    assert (sub);
+    rc = xs_connect (sub, "inproc://a");
+    assert (rc == 0);
+
+    //  Subscribe to a number of short topics and to a long one.
+    const char *long_topic = "a-topic-longer-than-16-bytes";
+    char topic [16];
+    for (int i = 0; i != 10; i++) {
+        sprintf (topic, "t%02d", i);
+        rc = xs_setsockopt (sub, XS_SUBSCRIBE, topic, strlen (topic));
+        assert (rc == 0);
+    }
+    rc = xs_setsockopt (sub, XS_SUBSCRIBE, long_topic, strlen (long_topic));
+    assert (rc == 0);
+
+    //  Publish a message for each topic. The messages are queued in the
+    //  subscriber.
+    char buff [64];
+    for (int i = 0; i != 10; i++) {
+        sprintf (buff, "t%02d-msg", i);
+        rc = xs_send (pub, buff, strlen (buff), 0);
+        assert (rc == (int) strlen (buff));
+    }
+    rc = xs_send (pub, long_topic, strlen (long_topic), 0);
+    assert (rc == (int) strlen (long_topic));
+
+    //  Drop most of the subscriptions before receiving the messages. The
+    //  messages for the dropped subscriptions are filtered out by
+    //  the subscriber.
+    for (int i = 0; i != 5; i++) {
+        sprintf (topic, "t%02d", i);
+        rc = xs_setsockopt (sub, XS_UNSUBSCRIBE, topic, strlen (topic));
+        assert (rc == 0);
+    }
+    rc = xs_setsockopt (sub, XS_UNSUBSCRIBE, long_topic, strlen (long_topic));
+    assert (rc == 0);
+    for (int i = 5; i != 10; i++) {
+        char expected [16];
+        sprintf (expected, "t%02d-msg", i);
+        rc = xs_recv (sub, buff, sizeof (buff), 0);
+        assert (rc == (int) strlen (expected));
+        assert (memcmp (buff, expected, rc) == 0);
+    }
+    rc = xs_recv (sub, buff, sizeof (buff), XS_DONTWAIT);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    //  Subscribe to the long topic anew.
+    rc = xs_setsockopt (sub, XS_SUBSCRIBE, long_topic, strlen (long_topic));
+    assert (rc == 0);
+    rc = xs_send (pub, "t00-msg", 7, 0);
+    assert (rc == 7);
+    rc = xs_send (pub, long_topic, strlen (long_topic), 0);
+    assert (rc == (int) strlen (long_topic));
+    rc = xs_send (pub, "t05-msg", 7, 0);
+    assert (rc == 7);
+    rc = xs_recv (sub, buff, sizeof (buff), 0);
+    assert (rc == (int) strlen (long_topic));
+    assert (memcmp (buff, long_topic, rc) == 0);
+    rc = xs_recv (sub, buff, sizeof (buff), 0);
+    assert (rc == 7 && memcmp (buff, "t05-msg", 7) == 0);
+
+    //  Clean up.
+    rc = xs_close (sub);
+    assert (rc == 0);
+    rc = xs_close (pub);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -19,7 +19,9 @@
 */
 
 //  This file is used only in MSVC build.
-//  It gathers all the tests into a single executable.
+//  It gathers all the tests into a single executable. Tests that compile
+//  parts of the library in (decoder_buffer, routing_table, timers)
+//  are not included.
 
 #include "testutil.hpp"
 
@@ -99,6 +101,86 @@
 #include "polltimeo.cpp"
 #undef XS_TEST_MAIN
 
+#define XS_TEST_MAIN msg_batch
+#include "msg_batch.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN msg_pool
+#include "msg_pool.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN router
+#include "router.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN xpub_match
+#include "xpub_match.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN sub_filter
+#include "sub_filter.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN mailbox_stress
+#include "mailbox_stress.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN wakeup_spin
+#include "wakeup_spin.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN io_uring
+#include "io_uring.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN busy_poll
+#include "busy_poll.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN cpu_affinity
+#include "cpu_affinity.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN io_thread_stats
+#include "io_thread_stats.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN reuseport
+#include "reuseport.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN stats
+#include "stats.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN latency
+#include "latency.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN shm
+#include "shm.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN zero_copy_recv
+#include "zero_copy_recv.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN batch_frames
+#include "batch_frames.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN hwm_bytes
+#include "hwm_bytes.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN memory_budget
+#include "memory_budget.cpp"
+#undef XS_TEST_MAIN
+
+#define XS_TEST_MAIN partial_write
+#include "partial_write.cpp"
+#undef XS_TEST_MAIN
+
 int main ()
 {
     int rc;
@@ -137,6 +219,55 @@ int main ()
     assert (rc == 0);
     rc = polltimeo ();
     assert (rc == 0);
+    rc = msg_batch ();
+    assert (rc == 0);
+    rc = msg_pool ();
+    assert (rc == 0);
+    rc = router ();
+    assert (rc == 0);
+    rc = xpub_match ();
+    assert (rc == 0);
+    rc = sub_filter ();
+    assert (rc == 0);
+    rc = mailbox_stress ();
+    assert (rc == 0);
+    rc = wakeup_spin ();
+    assert (rc == 0);
+    rc = io_uring ();
+    assert (rc == 0);
+    rc = busy_poll ();
+    assert (rc == 0);
+    rc = cpu_affinity ();
+    assert (rc == 0);
+    rc = io_thread_stats ();
+    assert (rc == 0);
+
+    rc = reuseport ();
+    assert (rc == 0);
+
+    rc = stats ();
+    assert (rc == 0);
+
+    rc = latency ();
+    assert (rc == 0);
+
+    rc = shm ();
+    assert (rc == 0);
+
+    rc = zero_copy_recv ();
+    assert (rc == 0);
+
+    rc = batch_frames ();
+    assert (rc == 0);
+
+    rc = hwm_bytes ();
+    assert (rc == 0);
+
+    rc = memory_budget ();
+    assert (rc == 0);
+
+    rc = partial_write ();
+    assert (rc == 0);
 
     fprintf (stderr, "SUCCESS\n");
     sleep (1);
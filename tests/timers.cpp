@@ -0,0 +1,248 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//  Timers are internal to the library and their symbols are not exported.
+//  Thus, the implementation is compiled directly into the test program.
+#include "../src/timers.cpp"
+#include "../src/clock.cpp"
+#include "../src/err.cpp"
+
+#include "testutil.hpp"
+
+#include <set>
+#include <vector>
+
+static uint64_t now;
+
+//  Timers that have fired, in the order they have fired.
+struct fired_t
+{
+    int id;
+    uint64_t time;
+};
+static std::vector <fired_t> fired;
+
+struct sink_t : public xs::i_poll_events
+{
+    sink_t () :
+        timers (NULL),
+        id (0),
+        handle (NULL),
+        expiration (0),
+        cancel (NULL),
+        readd (false)
+    {
+    }
+
+    void add (xs::timers_t *timers_, int id_, int timeout_)
+    {
+        timers = timers_;
+        id = id_;
+        expiration = now + (timeout_ > 0 ? timeout_ : 0);
+        handle = timers->add (now, timeout_, this);
+    }
+
+    void in_event (xs::fd_t) {}
+    void out_event (xs::fd_t) {}
+
+    void timer_event (xs::handle_t handle_)
+    {
+        assert (handle_ == handle);
+        fired_t f = {id, now};
+        fired.push_back (f);
+        handle = NULL;
+
+        //  Cancel another timer from within the callback.
+        if (cancel && cancel->handle) {
+            timers->rm (cancel->handle);
+            cancel->handle = NULL;
+        }
+
+        //  Add a new timer from within the callback.
+        if (readd) {
+            readd = false;
+            add (timers, id + 1000, 0);
+        }
+    }
+
+    xs::timers_t *timers;
+    int id;
+    xs::handle_t handle;
+    uint64_t expiration;
+    sink_t *cancel;
+    bool readd;
+};
+
+//  Runs the timers the way an I/O thread would, i.e. waiting for the time
+//  returned by execute, till there are no timers left. Checks that each
+//  timer fires exactly at its expiration time.
+static void run (xs::timers_t &timers_, sink_t *ts_, int count_)
+{
+    while (true) {
+        size_t before = fired.size ();
+        uint64_t wait = timers_.execute (now);
+        for (size_t i = before; i != fired.size (); i++) {
+            for (int j = 0; j != count_; j++) {
+                if (ts_ [j].id == fired [i].id)
+                    assert (ts_ [j].expiration == fired [i].time);
+            }
+        }
+        if (!wait)
+            break;
+        now += wait;
+    }
+    assert (timers_.empty ());
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "timers test running...\n");
+
+    now = 1000000;
+
+    //  Zero and negative timeouts are due straight away.
+    {
+        xs::timers_t timers;
+        assert (timers.empty ());
+        uint64_t wait = timers.execute (now);
+        assert (wait == 0);
+        sink_t t [2];
+        t [0].add (&timers, 0, 0);
+        t [1].add (&timers, 1, -100);
+        assert (!timers.empty ());
+        fired.clear ();
+        wait = timers.execute (now);
+        assert (wait == 0);
+        assert (fired.size () == 2);
+        assert (fired [0].id == 0 && fired [0].time == now);
+        assert (fired [1].id == 1 && fired [1].time == now);
+        assert (timers.empty ());
+    }
+
+    //  Timers that expire at the same time fire in the order they were
+    //  added, also when cascaded down from the upper levels together.
+    {
+        xs::timers_t timers;
+        sink_t t [4];
+        t [0].add (&timers, 0, 20000);
+        now += 10000;
+        t [1].add (&timers, 1, 10000);
+        now += 9900;
+        t [2].add (&timers, 2, 100);
+        t [3].add (&timers, 3, 100);
+        fired.clear ();
+        run (timers, t, 4);
+        assert (fired.size () == 4);
+        for (int i = 0; i != 4; i++)
+            assert (fired [i].id == i);
+    }
+
+    //  Timers on all the levels are cascaded down and fire on time. Adding
+    //  them in reverse order checks that they fire ordered by expiration.
+    {
+        const int timeouts [] = {1, 255, 256, 257, 16383, 16384, 16385,
+            1048575, 1048576, 1048577, 67108863, 67108864, 67108865,
+            500000000, 2147483647};
+        const int count = sizeof (timeouts) / sizeof (timeouts [0]);
+        xs::timers_t timers;
+        sink_t t [count];
+        now += 12345;
+        for (int i = count - 1; i >= 0; i--)
+            t [i].add (&timers, i, timeouts [i]);
+        fired.clear ();
+        run (timers, t, count);
+        assert (fired.size () == (size_t) count);
+        for (int i = 0; i != count; i++)
+            assert (fired [i].id == i);
+    }
+
+    //  If the wheel hasn't moved for a long time, a timer may expire beyond
+    //  the span of the top level. It is parked in the top level and moved
+    //  down once the wheel catches up. The overdue timer fires late, when
+    //  the wheel is moved next.
+    {
+        xs::timers_t timers;
+        sink_t t [2];
+        t [0].add (&timers, 0, 1);
+        now += 3000000000u;
+        t [1].add (&timers, 1, 2000000000);
+        fired.clear ();
+        run (timers, &t [1], 1);
+        assert (fired.size () == 2);
+        assert (fired [0].id == 0 && fired [0].time == now - 2000000000);
+        assert (fired [1].id == 1 && fired [1].time == now);
+    }
+
+    //  Timers can be cancelled from within a callback, both those due at
+    //  the same time and those due later. Timers added from within
+    //  a callback fire in a subsequent millisecond at the earliest.
+    {
+        xs::timers_t timers;
+        sink_t t [4];
+        t [0].add (&timers, 0, 10);
+        t [1].add (&timers, 1, 10);
+        t [2].add (&timers, 2, 5000);
+        t [3].add (&timers, 3, 10);
+        t [0].cancel = &t [1];
+        t [3].cancel = &t [2];
+        t [3].readd = true;
+        now += 10;
+        fired.clear ();
+        uint64_t wait = timers.execute (now);
+        assert (wait == 1);
+        assert (fired.size () == 2);
+        assert (fired [0].id == 0 && fired [1].id == 3);
+        now += wait;
+        wait = timers.execute (now);
+        assert (wait == 0);
+        assert (fired.size () == 3);
+        assert (fired [2].id == 1003 && fired [2].time == now);
+        assert (timers.empty ());
+    }
+
+    //  Entries of cancelled timers are reused. The reused entry doesn't
+    //  carry anything over from the cancelled timer.
+    {
+        xs::timers_t timers;
+        std::vector <sink_t> t (xs::timer_chunk_size + 1);
+        std::set <xs::handle_t> handles;
+        for (size_t i = 0; i != t.size (); i++) {
+            t [i].add (&timers, (int) i, 100 + (int) i);
+            handles.insert (t [i].handle);
+        }
+        for (size_t i = 0; i != t.size (); i++)
+            timers.rm (t [i].handle);
+        assert (timers.empty ());
+        for (size_t i = 0; i != t.size (); i++) {
+            t [i].add (&timers, (int) i, 50);
+            assert (handles.count (t [i].handle) == 1);
+        }
+        xs::handle_t handle = t [0].handle;
+        timers.rm (handle);
+        t [0].add (&timers, 0, 7);
+        assert (t [0].handle == handle);
+        fired.clear ();
+        run (timers, &t [0], (int) t.size ());
+        assert (fired.size () == t.size ());
+        assert (fired [0].id == 0);
+    }
+
+    return 0 ;
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+extern "C"
+{
+    static void wakeup_spin_worker (void *s_)
+    {
+        int rc;
+        int i;
+        char buf [3];
+
+        //  Echo the messages back. Every now and then reply with a delay
+        //  so that the peer stops spinning and falls asleep.
+        for (i = 0; i != 1000; i++) {
+            rc = xs_recv (s_, buf, sizeof (buf), 0);
+            assert (rc == 3);
+            if (i % 100 == 0) {
+                rc = xs_poll (NULL, 0, 10);
+                assert (rc == 0);
+            }
+            rc = xs_send (s_, buf, sizeof (buf), 0);
+            assert (rc == 3);
+        }
+    }
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "wakeup_spin test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    int spin = -1;
+    int rc = xs_setctxopt (ctx, XS_WAKEUP_SPIN, &spin, sizeof (spin));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    spin = 100;
+    rc = xs_setctxopt (ctx, XS_WAKEUP_SPIN, &spin, sizeof (spin));
+    assert (rc == 0);
+    spin = 0;
+    size_t spin_size = sizeof (spin);
+    rc = xs_getctxopt (ctx, XS_WAKEUP_SPIN, &spin, &spin_size);
+    assert (rc == 0);
+    assert (spin == 100);
+
+    void *sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    rc = xs_bind (sb, "inproc://a");
+    assert (rc == 0);
+    void *sc = xs_socket (ctx, XS_PAIR);
+    assert (sc);
+    rc = xs_connect (sc, "inproc://a");
+    assert (rc == 0);
+
+    //  Ping-pong the messages between two threads. Both of them wait for
+    //  the messages in the blocking recv.
+    void *thread = thread_create (wakeup_spin_worker, sc);
+    assert (thread);
+    char buf [3];
+    for (int i = 0; i != 1000; i++) {
+        rc = xs_send (sb, "ABC", 3, 0);
+        assert (rc == 3);
+        rc = xs_recv (sb, buf, sizeof (buf), 0);
+        assert (rc == 3);
+        assert (memcmp (buf, "ABC", 3) == 0);
+    }
+    thread_join (thread);
+
+    //  The timeouts still work when spinning.
+    int timeo = 50;
+    rc = xs_setsockopt (sb, XS_RCVTIMEO, &timeo, sizeof (timeo));
+    assert (rc == 0);
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    //  Spinning doesn't extend the timeouts even if it is set to take
+    //  longer than they do.
+    ctx = xs_init ();
+    assert (ctx);
+    spin = 500000;
+    rc = xs_setctxopt (ctx, XS_WAKEUP_SPIN, &spin, sizeof (spin));
+    assert (rc == 0);
+    sb = xs_socket (ctx, XS_PAIR);
+    assert (sb);
+    timeo = 10;
+    rc = xs_setsockopt (sb, XS_RCVTIMEO, &timeo, sizeof (timeo));
+    assert (rc == 0);
+    void *watch = xs_stopwatch_start ();
+    rc = xs_recv (sb, buf, sizeof (buf), 0);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+    unsigned long elapsed = xs_stopwatch_stop (watch);
+    assert (elapsed < 250000);
+    rc = xs_close (sb);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "xpub_match test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+    void *xpub = xs_socket (ctx, XS_XPUB);
+    assert (xpub);
+    int rc = xs_bind (xpub, "inproc://a");
+    assert (rc == 0);
+    void *sub1 = xs_socket (ctx, XS_SUB);
+    assert (sub1);
+    rc = xs_connect (sub1, "inproc://a");
+    assert (rc == 0);
+    void *sub2 = xs_socket (ctx, XS_SUB);
+    assert (sub2);
+    rc = xs_connect (sub2, "inproc://a");
+    assert (rc == 0);
+
+    //  Subscribe to overlapping topics.
+    rc = xs_setsockopt (sub1, XS_SUBSCRIBE, "abc", 3);
+    assert (rc == 0);
+    rc = xs_setsockopt (sub1, XS_SUBSCRIBE, "abd", 3);
+    assert (rc == 0);
+    rc = xs_setsockopt (sub2, XS_SUBSCRIBE, "ab", 2);
+    assert (rc == 0);
+    rc = xs_setsockopt (sub2, XS_SUBSCRIBE, "abc", 3);
+    assert (rc == 0);
+
+    //  Only the unique subscriptions are passed to the user.
+    char buff [32];
+    bool seen [3] = {false, false, false};
+    for (int i = 0; i != 3; i++) {
+        rc = xs_recv (xpub, buff, sizeof (buff), 0);
+        assert (rc >= 1 && buff [0] == 1);
+        if (rc == 4 && memcmp (buff + 1, "abc", 3) == 0)
+            seen [0] = true;
+        else if (rc == 4 && memcmp (buff + 1, "abd", 3) == 0)
+            seen [1] = true;
+        else if (rc == 3 && memcmp (buff + 1, "ab", 2) == 0)
+            seen [2] = true;
+        else
+            assert (false);
+    }
+    assert (seen [0] && seen [1] && seen [2]);
+    rc = xs_recv (xpub, buff, sizeof (buff), XS_DONTWAIT);
+    assert (rc == -1 && xs_errno () == EAGAIN);
+
+    //  Publish the messages. The last one is received by both subscribers.
+    const char *topics [] = {"abcx", "abdx", "ax", "ab", "abc."};
+    for (int i = 0; i != 5; i++) {
+        rc = xs_send (xpub, topics [i], strlen (topics [i]), 0);
+        assert (rc == (int) strlen (topics [i]));
+    }
+    const char *expected1 [] = {"abcx", "abdx", "abc."};
+    for (int i = 0; i != 3; i++) {
+        rc = xs_recv (sub1, buff, sizeof (buff), 0);
+        assert (rc == (int) strlen (expected1 [i]));
+        assert (memcmp (buff, expected1 [i], rc) == 0);
+    }
+    const char *expected2 [] = {"abcx", "abdx", "ab", "abc."};
+    for (int i = 0; i != 4; i++) {
+        rc = xs_recv (sub2, buff, sizeof (buff), 0);
+        assert (rc == (int) strlen (expected2 [i]));
+        assert (memcmp (buff, expected2 [i], rc) == 0);
+    }
+
+    //  Unsubscription is passed to the user only when the last subscriber
+    //  unsubscribes.
+    rc = xs_setsockopt (sub1, XS_UNSUBSCRIBE, "abc", 3);
+    assert (rc == 0);
+    rc = xs_setsockopt (sub2, XS_UNSUBSCRIBE, "abc", 3);
+    assert (rc == 0);
+    rc = xs_recv (xpub, buff, sizeof (buff), 0);
+    assert (rc == 4 && buff [0] == 0 && memcmp (buff + 1, "abc", 3) == 0);
+
+    //  Publish the messages after the unsubscriptions.
+    rc = xs_send (xpub, "abcx", 4, 0);
+    assert (rc == 4);
+    rc = xs_send (xpub, "abd.", 4, 0);
+    assert (rc == 4);
+    rc = xs_recv (sub1, buff, sizeof (buff), 0);
+    assert (rc == 4 && memcmp (buff, "abd.", 4) == 0);
+    rc = xs_recv (sub2, buff, sizeof (buff), 0);
+    assert (rc == 4 && memcmp (buff, "abcx", 4) == 0);
+    rc = xs_recv (sub2, buff, sizeof (buff), 0);
+    assert (rc == 4 && memcmp (buff, "abd.", 4) == 0);
+
+    //  When the subscriber disconnects, its unique subscriptions are
+    //  cancelled.
+    rc = xs_close (sub1);
+    assert (rc == 0);
+    rc = xs_recv (xpub, buff, sizeof (buff), 0);
+    assert (rc == 4 && buff [0] == 0 && memcmp (buff + 1, "abd", 3) == 0);
+
+    //  Clean up.
+    rc = xs_close (sub2);
+    assert (rc == 0);
+    rc = xs_close (xpub);
+    assert (rc == 0);
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2012 250bpm s.r.o.
+    Copyright (c) 2012 Other contributors as noted in the AUTHORS file
+
+    This file is part of Crossroads I/O project.
+
+    Crossroads I/O is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Crossroads is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "testutil.hpp"
+
+static size_t msg_size (int i_)
+{
+    //  Mix of very small messages, messages that typically fit into the
+    //  receive buffer and messages that are larger than the buffer.
+    if (i_ % 50 == 0)
+        return 100000;
+    if (i_ % 7 == 0)
+        return i_ % 20;
+    return 100 + (i_ * 37) % 3900;
+}
+
+static void zero_copy_recv (void *ctx_, const char *addr_)
+{
+    const int count = 1000;
+
+    void *sb = xs_socket (ctx_, XS_PULL);
+    assert (sb);
+    int zero_copy = 1;
+    int rc = xs_setsockopt (sb, XS_ZERO_COPY_RECV, &zero_copy,
+        sizeof (zero_copy));
+    assert (rc == 0);
+    rc = xs_bind (sb, addr_);
+    assert (rc != -1);
+    void *sc = xs_socket (ctx_, XS_PUSH);
+    assert (sc);
+    rc = xs_connect (sc, addr_);
+    assert (rc != -1);
+
+    char *buf = (char*) malloc (100000);
+    assert (buf);
+    for (int i = 0; i != count; i++) {
+        memset (buf, i & 0xff, msg_size (i));
+        rc = xs_send (sc, buf, msg_size (i), 0);
+        assert (rc == (int) msg_size (i));
+    }
+    free (buf);
+
+    //  Keep all the messages open while receiving the subsequent ones so
+    //  that the receive buffers they refer to can't be reused.
+    xs_msg_t *msgs = (xs_msg_t*) malloc (count * sizeof (xs_msg_t));
+    assert (msgs);
+    for (int i = 0; i != count; i++) {
+        rc = xs_msg_init (&msgs [i]);
+        assert (rc == 0);
+        rc = xs_recvmsg (sb, &msgs [i], 0);
+        assert (rc == (int) msg_size (i));
+    }
+
+    //  Copies of the messages outlive the originals.
+    xs_msg_t copy;
+    rc = xs_msg_init (&copy);
+    assert (rc == 0);
+    rc = xs_msg_copy (&copy, &msgs [1]);
+    assert (rc == 0);
+
+    for (int i = 0; i != count; i++) {
+        assert (xs_msg_size (&msgs [i]) == msg_size (i));
+        unsigned char *data = (unsigned char*) xs_msg_data (&msgs [i]);
+        for (size_t j = 0; j != msg_size (i); j++)
+            assert (data [j] == (i & 0xff));
+        rc = xs_msg_close (&msgs [i]);
+        assert (rc == 0);
+    }
+    free (msgs);
+
+    assert (xs_msg_size (&copy) == msg_size (1));
+    unsigned char *data = (unsigned char*) xs_msg_data (&copy);
+    for (size_t j = 0; j != msg_size (1); j++)
+        assert (data [j] == 1);
+    rc = xs_msg_close (&copy);
+    assert (rc == 0);
+
+    rc = xs_close (sc);
+    assert (rc == 0);
+    rc = xs_close (sb);
+    assert (rc == 0);
+}
+
+int XS_TEST_MAIN ()
+{
+    fprintf (stderr, "zero_copy_recv test running...\n");
+
+    void *ctx = xs_init ();
+    assert (ctx);
+
+    void *s = xs_socket (ctx, XS_PULL);
+    assert (s);
+    int zero_copy = 2;
+    int rc = xs_setsockopt (s, XS_ZERO_COPY_RECV, &zero_copy,
+        sizeof (zero_copy));
+    assert (rc == -1 && xs_errno () == EINVAL);
+    zero_copy = 1;
+    rc = xs_setsockopt (s, XS_ZERO_COPY_RECV, &zero_copy, sizeof (zero_copy));
+    assert (rc == 0);
+    zero_copy = 0;
+    size_t zero_copy_size = sizeof (zero_copy);
+    rc = xs_getsockopt (s, XS_ZERO_COPY_RECV, &zero_copy, &zero_copy_size);
+    assert (rc == 0);
+    assert (zero_copy == 1);
+    rc = xs_close (s);
+    assert (rc == 0);
+
+    zero_copy_recv (ctx, "tcp://127.0.0.1:5560");
+#if !defined XS_HAVE_WINDOWS && !defined XS_HAVE_OPENVMS
+    zero_copy_recv (ctx, "ipc:///tmp/tester");
+#endif
+
+    rc = xs_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}